@@ -3,8 +3,12 @@
    See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
 
  *********************************************************************/
+#ifndef MAX_BLOCK_SIZE
 #define MAX_BLOCK_SIZE 1600
+#endif
+#ifndef MAX_BLOCK_COUNT
 #define MAX_BLOCK_COUNT 16
+#endif
 
 #define DECLARE_HEAP(type, orderby) \
     struct heap_ ## type {   \
@@ -232,6 +232,10 @@ static inline uint64_t long_long_be(uint64_t le)
 # include "arch/pico_posix.h"
 #endif
 
+#if defined(PICO_SUPPORT_MM) && defined(PICO_SUPPORT_MULTI_INSTANCE)
+#error "The memory manager serves a single stack: it cannot be used with multiple instances"
+#endif
+
 #ifdef PICO_SUPPORT_MM
 #define PICO_ZALLOC(x) pico_mem_zalloc(x)
 #define PICO_FREE(x) pico_mem_free(x)
@@ -15,9 +15,21 @@
 #define PICO_SIZE_IEEE802154_EXT (8u)
 #define PICO_SIZE_IEEE802154_SHORT (2u)
 
+/* Storage class of all mutable stack state. With PICO_SUPPORT_MULTI_INSTANCE
+ * the state is thread-local: every thread that calls pico_stack_init() then
+ * drives its own independent stack (devices, routes, sockets, timers). */
+#ifndef PICO_TLS
+# ifdef PICO_SUPPORT_MULTI_INSTANCE
+#  define PICO_TLS __thread
+# else
+#  define PICO_TLS
+# endif
+#endif
+
 /** Endian-dependant constants **/
 typedef uint64_t pico_time;
-extern volatile uint64_t pico_tick;
+#define PICO_TIME_NEVER ((pico_time)-1)
+extern PICO_TLS volatile uint64_t pico_tick;
 
 
 /*** *** *** *** *** *** ***
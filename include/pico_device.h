@@ -9,7 +9,7 @@
 #include "pico_frame.h"
 #include "pico_addressing.h"
 #include "pico_tree.h"
-extern struct pico_tree Device_tree;
+extern PICO_TLS struct pico_tree Device_tree;
 #include "pico_ipv6_nd.h"
 #define MAX_DEVICE_NAME 16
 
@@ -18,6 +18,16 @@ struct pico_ethdev {
     struct pico_eth mac;
 };
 
+/* Frames moved by a single send_batch/poll_batch call, and the size of each
+ * buffer offered to poll_batch.
+ */
+#ifndef PICO_DEVICE_BATCH
+#define PICO_DEVICE_BATCH 16
+#endif
+#ifndef PICO_DEVICE_BATCH_BUFSIZE
+#define PICO_DEVICE_BATCH_BUFSIZE 2048
+#endif
+
 struct pico_device {
     char name[MAX_DEVICE_NAME];
     uint32_t hash;
@@ -25,13 +35,25 @@ struct pico_device {
     uint32_t mtu;
     struct pico_ethdev *eth; /* Null if non-ethernet */
     enum pico_ll_mode mode;
-    struct pico_queue *q_in;
+    struct pico_queue *q_in;  /* pico_queue_ring_init() lets a driver thread feed it lock-free */
     struct pico_queue *q_out;
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    struct pico_queue *q_rx_free; /* Empty frames for pico_stack_recv_ring(), refilled by the stack */
+    struct pico_frame *rx_spare;  /* Taken by the driver, not queued yet */
+    uint32_t rx_frame_len;
+#endif
     int (*link_state)(struct pico_device *self);
     int (*send)(struct pico_device *self, void *buf, int len); /* Send function. Return 0 if busy */
+    int (*send_iov)(struct pico_device *self, const struct pico_iovec *iov, int iovcnt); /* Optional: send a scatter-gather frame */
+    int (*send_batch)(struct pico_device *self, struct pico_frame **f, int count); /* Optional: send up to count frames, return how many were sent */
+#ifdef PICO_SUPPORT_TCP_GSO
+    int (*send_tso)(struct pico_device *self, const struct pico_iovec *iov, int iovcnt, uint16_t mss); /* Optional: send a TCP super-segment, cut in packets of mss payload bytes by the device */
+#endif
     int (*poll)(struct pico_device *self, int loop_score);
+    int (*poll_batch)(struct pico_device *self, struct pico_iovec *pkt, int count); /* Optional: receive up to count packets in pkt, return how many */
     void (*destroy)(struct pico_device *self);
     int (*dsr)(struct pico_device *self, int loop_score);
+    int (*wait_fd)(struct pico_device *self); /* Optional: fd that becomes readable when poll has work */
     int __serving_interrupt;
     /* used to signal the upper layer the number of events arrived since the last processing */
     volatile int eventCnt;
@@ -43,7 +65,11 @@ struct pico_device {
 
 int pico_device_init(struct pico_device *dev, const char *name, const uint8_t *mac);
 void pico_device_destroy(struct pico_device *dev);
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+int pico_device_rx_ring_init(struct pico_device *dev, uint32_t slots, uint32_t frame_len);
+#endif
 int pico_devices_loop(int loop_score, int direction);
+int pico_devices_pending(void);
 struct pico_device*pico_get_device(const char*name);
 int32_t pico_device_broadcast(struct pico_frame *f);
 int pico_device_link_state(struct pico_device *dev);
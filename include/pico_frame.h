@@ -14,6 +14,8 @@
 #define PICO_FRAME_FLAG_SACKED              (0x80)
 #define PICO_FRAME_FLAG_LL_SEC              (0x40)
 #define PICO_FRAME_FLAG_SLP_FRAG            (0x20)
+#define PICO_FRAME_FLAG_POOL_DESC           (0x08)
+#define PICO_FRAME_FLAG_POOL_BUF            (0x10)
 #define IS_BCAST(f) ((f->flags & PICO_FRAME_FLAG_BCAST) == PICO_FRAME_FLAG_BCAST)
 
 
@@ -87,13 +89,37 @@ struct pico_frame {
     int8_t priority;
     uint8_t transport_flags_saved;
 
+    /* TCP: retransmission state of a segment in the output queue */
+    uint8_t scoreboard;
+
     /* Callback to notify listener when the buffer has been discarded */
     void (*notify_free)(uint8_t *);
 
     uint8_t send_ttl; /* Special TTL/HOPS value, 0 = auto assign */
     uint8_t send_tos; /* Type of service */
+
+    /* Next segment of a scatter-gather frame: the data on the wire is
+     * start/len of this frame, followed by start/len of each chained one.
+     */
+    struct pico_frame *chain;
+
+#ifdef PICO_SUPPORT_TCP_GSO
+    /* TCP super-segment: payload bytes of each packet it is cut into before
+     * reaching the device. 0 for a regular frame.
+     */
+    uint16_t gso_size;
+#endif
 };
 
+/* One segment of a scatter-gather frame, as passed to pico_device::send_iov */
+struct pico_iovec {
+    void *base;
+    uint32_t len;
+};
+
+/* Longest chain handed to a device as is, longer ones are linearized */
+#define PICO_FRAME_MAX_SEGMENTS 4
+
 /** frame alloc/dealloc/copy **/
 void pico_frame_discard(struct pico_frame *f);
 struct pico_frame *pico_frame_copy(struct pico_frame *f);
@@ -103,8 +129,43 @@ int pico_frame_grow(struct pico_frame *f, uint32_t size);
 int pico_frame_grow_head(struct pico_frame *f, uint32_t size);
 struct pico_frame *pico_frame_alloc_skeleton(uint32_t size, int ext_buffer);
 int pico_frame_skeleton_set_buffer(struct pico_frame *f, void *buf);
+int pico_frame_prepend_segment(struct pico_frame *f, uint32_t size);
+int pico_frame_linearize(struct pico_frame *f);
+uint32_t pico_frame_total_len(struct pico_frame *f);
+int pico_frame_segments(struct pico_frame *f, struct pico_iovec *iov, int max);
+struct pico_frame *pico_frame_payload_ref(struct pico_frame *f, uint32_t off, uint32_t len);
+void pico_checksum_init(void);
 uint16_t pico_checksum(void *inbuf, uint32_t len);
 uint16_t pico_dualbuffer_checksum(void *b1, uint32_t len1, void *b2, uint32_t len2);
+uint16_t pico_frame_dualbuffer_checksum(void *b1, uint32_t len1, struct pico_frame *f, void *b2, uint32_t len2);
+uint16_t pico_checksum_adjust16(uint16_t crc, uint16_t old_val, uint16_t new_val);
+uint16_t pico_checksum_adjust32(uint16_t crc, uint32_t old_val, uint32_t new_val);
+
+#ifdef PICO_SUPPORT_FRAME_POOL
+/* Frame pool size classes: class 0 holds bare descriptors (copies, zero-copy
+ * frames), the others a descriptor plus a buffer of up to SIZE_n bytes.
+ * Larger frames fall back to the heap.
+ */
+#define PICO_FRAME_POOL_CLASSES 4
+#define PICO_FRAME_POOL_SIZE_1  128
+#define PICO_FRAME_POOL_SIZE_2  512
+#define PICO_FRAME_POOL_SIZE_3  2048
+/* Memory preallocated at first use, shared evenly between the classes */
+#ifndef PICO_FRAME_POOL_BUDGET
+#define PICO_FRAME_POOL_BUDGET  (128 * 1024)
+#endif
+
+struct pico_frame_pool_stats {
+    uint32_t size;       /* Buffer size of the class */
+    uint32_t hits;       /* Allocations served from the free list */
+    uint32_t misses;     /* Allocations that had to grow the pool */
+    uint32_t in_use;
+    uint32_t high_water; /* Highest in_use so far */
+    uint32_t free;
+};
+
+int pico_frame_pool_stats(uint32_t class_idx, struct pico_frame_pool_stats *stats);
+#endif
 
 static inline int pico_is_digit(char c)
 {
@@ -63,7 +63,7 @@ enum pico_err_e {
 };
 
 typedef enum pico_err_e pico_err_t;
-extern volatile pico_err_t pico_err;
+extern PICO_TLS volatile pico_err_t pico_err;
 
 #define IS_IPV6(f) (f && f->net_hdr && ((((uint8_t *)(f->net_hdr))[0] & 0xf0) == 0x60))
 #define IS_IPV4(f) (f && f->net_hdr && ((((uint8_t *)(f->net_hdr))[0] & 0xf0) == 0x40))
@@ -82,8 +82,35 @@ struct pico_protocol {
     int (*process_out)(struct pico_protocol *self, struct pico_frame *p);  /* Send loop. */
     int (*process_in)(struct pico_protocol *self, struct pico_frame *p);  /* Recv loop. */
     uint16_t (*get_mtu)(struct pico_protocol *self);
+#ifdef PICO_SUPPORT_MULTI_INSTANCE
+    struct pico_queue q_in_store;
+    struct pico_queue q_out_store;
+#endif
 };
 
+/* Protocol queues. The address of a thread-local variable is not a constant,
+ * so with multi-instance support the queues are kept in the (thread-local)
+ * protocol itself and hooked up by pico_protocol_init(). */
+#ifdef PICO_SUPPORT_MULTI_INSTANCE
+#define PICO_PROTO_QUEUE_DECLARE(name)
+#define PICO_PROTO_QUEUE(name) NULL
+#else
+#define PICO_PROTO_QUEUE_DECLARE(name) static struct pico_queue name = { 0 }
+#define PICO_PROTO_QUEUE(name) (&name)
+#endif
+
+/* Run-to-completion: maximum nesting of layers processed in one call chain
+ * before frames fall back to the per-layer queues. */
+#ifndef PICO_RUN_TO_COMPLETION_DEPTH
+#define PICO_RUN_TO_COMPLETION_DEPTH 8
+#endif
+
+/* Hand a frame to a protocol's input/output. Frames are queued for the next
+ * protocol loop, or processed right away when built with
+ * PICO_SUPPORT_RUN_TO_COMPLETION. Returns <= 0 if the frame was not taken. */
+int32_t pico_protocol_deliver_in(struct pico_protocol *proto, struct pico_frame *f);
+int32_t pico_protocol_deliver_out(struct pico_protocol *proto, struct pico_frame *f);
+
 int pico_protocols_loop(int loop_score);
 void pico_protocol_init(struct pico_protocol *p);
 
@@ -91,5 +118,6 @@ int pico_protocol_datalink_loop(int loop_score, int direction);
 int pico_protocol_network_loop(int loop_score, int direction);
 int pico_protocol_transport_loop(int loop_score, int direction);
 int pico_protocol_socket_loop(int loop_score, int direction);
+int pico_protocols_pending(void);
 
 #endif
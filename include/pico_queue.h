@@ -33,6 +33,12 @@ struct pico_queue {
 #endif
     uint8_t shared;
     uint16_t overhead;
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    struct pico_frame **ring;
+    uint32_t ring_mask;
+    uint32_t ring_head;         /* written by the consumer only */
+    uint32_t ring_tail;         /* written by the producer only */
+#endif
 };
 
 #ifdef PICO_SUPPORT_MUTEX
@@ -50,6 +56,22 @@ struct pico_queue {
 #define PICOTCP_MUTEX_DEL(x) do {} while(0)
 #endif
 
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+/* Ports without the GCC/clang __atomic builtins can provide their own */
+#ifndef PICO_QUEUE_LOAD_ACQUIRE
+#define PICO_QUEUE_LOAD_ACQUIRE(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#endif
+#ifndef PICO_QUEUE_STORE_RELEASE
+#define PICO_QUEUE_STORE_RELEASE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#endif
+#ifndef PICO_QUEUE_ADD
+#define PICO_QUEUE_ADD(x, v) __atomic_add_fetch(&(x), (v), __ATOMIC_RELAXED)
+#endif
+#ifndef PICO_QUEUE_SUB
+#define PICO_QUEUE_SUB(x, v) __atomic_sub_fetch(&(x), (v), __ATOMIC_RELAXED)
+#endif
+#endif
+
 #ifdef PICO_SUPPORT_DEBUG_TOOLS
 static void debug_q(struct pico_queue *q)
 {
@@ -67,6 +89,77 @@ static void debug_q(struct pico_queue *q)
 #define debug_q(x) do {} while(0)
 #endif
 
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+/* Lock-free ring mode: one producer and one consumer (the stack) may use
+ * the queue concurrently without a mutex. Only pico_enqueue is safe on the
+ * producer side, with frames allocated beforehand on the stack thread and
+ * filled in by the driver: the frame allocator and pico_frame_discard take
+ * no lock, and pico_stack_recv also feeds pico_rand, so a driver thread or
+ * ISR must not call them. pico_stack_recv_ring() is the receive path that
+ * follows these rules. A frame that does not fit stays with the producer.
+ * The counters are updated before a slot is published and after it is
+ * released, so they never underflow. */
+
+/* Producer side: no slot left */
+static inline int pico_queue_ring_full(struct pico_queue *q)
+{
+    return (q->ring_tail - PICO_QUEUE_LOAD_ACQUIRE(q->ring_head)) > q->ring_mask;
+}
+
+static inline int32_t pico_queue_ring_push(struct pico_queue *q, struct pico_frame *p)
+{
+    uint32_t tail = q->ring_tail;
+    int32_t size;
+
+    if (pico_queue_ring_full(q))
+        return -1;
+
+    p->next = NULL;
+    q->ring[tail & q->ring_mask] = p;
+    PICO_QUEUE_ADD(q->frames, 1U);
+    size = (int32_t)PICO_QUEUE_ADD(q->size, p->buffer_len + q->overhead);
+    PICO_QUEUE_STORE_RELEASE(q->ring_tail, tail + 1);
+    return size;
+}
+
+static inline struct pico_frame *pico_queue_ring_pop(struct pico_queue *q)
+{
+    uint32_t head = q->ring_head;
+    struct pico_frame *p;
+
+    if (head == PICO_QUEUE_LOAD_ACQUIRE(q->ring_tail))
+        return NULL;
+
+    p = q->ring[head & q->ring_mask];
+    PICO_QUEUE_SUB(q->frames, 1U);
+    PICO_QUEUE_SUB(q->size, p->buffer_len + q->overhead);
+    PICO_QUEUE_STORE_RELEASE(q->ring_head, head + 1);
+    return p;
+}
+
+/* Switch an empty queue to ring mode with room for at least 'slots' frames
+ * (rounded up to a power of two). max_frames/max_size keep applying. */
+static inline int pico_queue_ring_init(struct pico_queue *q, uint32_t slots)
+{
+    uint32_t n = 1;
+
+    if (q->ring || q->frames || !slots)
+        return -1;
+
+    while (n < slots)
+        n <<= 1;
+    q->ring = PICO_ZALLOC(n * sizeof(struct pico_frame *));
+    if (!q->ring)
+        return -1;
+
+    q->ring_mask = n - 1;
+    q->ring_head = 0;
+    q->ring_tail = 0;
+    q->size = 0;
+    return 0;
+}
+#endif
+
 static inline int32_t pico_enqueue(struct pico_queue *q, struct pico_frame *p)
 {
     if ((q->max_frames) && (q->max_frames <= q->frames))
@@ -81,6 +174,11 @@ static inline int32_t pico_enqueue(struct pico_queue *q, struct pico_frame *p)
     if ((q->max_size) && (q->max_size < (p->buffer_len + q->size)))
         return -1;
 
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    if (q->ring)
+        return pico_queue_ring_push(q, p);
+
+#endif
     if (q->shared)
         PICOTCP_MUTEX_LOCK(q->mutex);
 
@@ -108,6 +206,11 @@ static inline int32_t pico_enqueue(struct pico_queue *q, struct pico_frame *p)
 static inline struct pico_frame *pico_dequeue(struct pico_queue *q)
 {
     struct pico_frame *p = q->head;
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    if (q->ring)
+        return pico_queue_ring_pop(q);
+
+#endif
     if (!p)
         return NULL;
 
@@ -135,6 +238,15 @@ static inline struct pico_frame *pico_dequeue(struct pico_queue *q)
 static inline struct pico_frame *pico_queue_peek(struct pico_queue *q)
 {
     struct pico_frame *p = q->head;
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    if (q->ring) {
+        if (q->ring_head == PICO_QUEUE_LOAD_ACQUIRE(q->ring_tail))
+            return NULL;
+
+        return q->ring[q->ring_head & q->ring_mask];
+    }
+
+#endif
     if (q->frames < 1)
         return NULL;
 
@@ -142,11 +254,68 @@ static inline struct pico_frame *pico_queue_peek(struct pico_queue *q)
     return p;
 }
 
+/* Up to 'max' frames from the head of the queue, which stay queued */
+static inline int pico_queue_peek_batch(struct pico_queue *q, struct pico_frame **frames, int max)
+{
+    struct pico_frame *p;
+    int n = 0;
+
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    if (q->ring) {
+        uint32_t i, tail = PICO_QUEUE_LOAD_ACQUIRE(q->ring_tail);
+        for (i = q->ring_head; (i != tail) && (n < max); i++)
+            frames[n++] = q->ring[i & q->ring_mask];
+        return n;
+    }
+
+#endif
+    if (q->shared)
+        PICOTCP_MUTEX_LOCK(q->mutex);
+
+    for (p = q->head; p && (n < max) && ((uint32_t)n < q->frames); p = p->next)
+        frames[n++] = p;
+
+    if (q->shared)
+        PICOTCP_MUTEX_UNLOCK(q->mutex);
+
+    return n;
+}
+
+/* A frame still in the queue got a new buffer instead of the one of old_len
+ * bytes it was queued with (e.g. linearized while at the head): account for
+ * the buffer it will leave with.
+ */
+static inline void pico_queue_resize_frame(struct pico_queue *q, struct pico_frame *p, uint32_t old_len)
+{
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    if (q->ring) {
+        PICO_QUEUE_ADD(q->size, p->buffer_len - old_len);
+        return;
+    }
+
+#endif
+    if (q->shared)
+        PICOTCP_MUTEX_LOCK(q->mutex);
+
+    q->size += p->buffer_len - old_len;
+
+    if (q->shared)
+        PICOTCP_MUTEX_UNLOCK(q->mutex);
+}
+
 static inline void pico_queue_deinit(struct pico_queue *q)
 {
     if (q->shared) {
         PICOTCP_MUTEX_DEL(q->mutex);
     }
+
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    if (q->ring) {
+        PICO_FREE(q->ring);
+        q->ring = NULL;
+    }
+
+#endif
 }
 
 static inline void pico_queue_empty(struct pico_queue *q)
@@ -75,6 +75,12 @@ struct pico_socket {
     uint16_t ev_pending;
 
     struct pico_device *dev;
+#ifdef PICO_SUPPORT_FLOW_TABLE
+    /* Connected sockets are also chained in the hashed flow table */
+    struct pico_socket *flow_next;
+    uint32_t flow_hash;
+    uint8_t flow_linked;
+#endif
 
     /* Private field. */
     int id;
@@ -100,6 +106,50 @@ struct pico_ip_mreq_source {
     union pico_address mcast_link_addr;
 };
 
+/* Received data handed out by pico_socket_recv_zerocopy() */
+struct pico_zerocopy_chunk {
+    uint8_t *data;
+    uint32_t len;
+    void *handle;       /* pass back to pico_socket_zerocopy_release() */
+};
+
+/* PICO_TCP_PACING_STATS */
+struct pico_tcp_pacing_stats {
+    uint32_t rate;      /* current pacing rate, bytes per second (0: not paced) */
+    uint32_t holds;     /* times output was held back for the next slot */
+    uint64_t delay;     /* total time output was held back, ms */
+};
+
+/* PICO_TCP_INFO: fields are only ever appended, with a new version */
+#define PICO_TCP_INFO_VERSION 1
+struct pico_tcp_info {
+    uint8_t version;        /* PICO_TCP_INFO_VERSION of the stack that filled it */
+    uint8_t state;          /* PICO_SOCKET_STATE_TCP_* >> 8 */
+    uint8_t backoff;        /* RTO backoff exponent */
+    uint8_t dupacks;
+    uint32_t rtt;           /* smoothed RTT, ms */
+    uint32_t rttvar;        /* ms */
+    uint32_t rto;           /* ms */
+    uint32_t mss;
+    uint32_t cwnd;          /* bytes */
+    uint32_t ssthresh;      /* bytes */
+    uint32_t in_flight;     /* packets */
+    uint32_t snd_wnd;       /* window advertised by the peer, bytes */
+    uint32_t rcv_wnd;       /* window advertised to the peer, bytes */
+    uint32_t segs_out;      /* packets sent, retransmissions included */
+    uint32_t segs_in;
+    uint64_t bytes_out;     /* payload bytes sent, retransmissions included */
+    uint64_t bytes_in;      /* payload bytes received, duplicates included */
+    uint32_t retrans;       /* segments retransmitted */
+    uint32_t fast_retrans;  /* ... on duplicate ACKs, SACK or tail loss probes */
+    uint32_t rto_events;    /* ... on retransmission timeouts */
+    uint32_t ooo_segs;      /* segments received ahead of rcv_nxt */
+    uint32_t zero_wnd_local;  /* times a zero window was advertised */
+    uint32_t zero_wnd_remote; /* times the peer advertised a zero window */
+    uint64_t cwnd_limited;  /* time output waited for the congestion window, ms */
+    uint64_t rwnd_limited;  /* time output waited for the peer's window, ms */
+};
+
 
 #define PICO_SOCKET_STATE_UNDEFINED       0x0000u
 #define PICO_SOCKET_STATE_SHUT_LOCAL      0x0001u
@@ -127,6 +177,14 @@ struct pico_ip_mreq_source {
 
 /* Socket options */
 # define PICO_TCP_NODELAY                     1
+# define PICO_TCP_CONGESTION                  2
+# define PICO_TCP_PACING                      3
+# define PICO_TCP_PACING_STATS                7
+# define PICO_TCP_ZEROCOPY_RX                 8
+# define PICO_TCP_DELACK                      9
+# define PICO_TCP_DELACK_TIMEOUT              10
+# define PICO_TCP_INFO                        11
+# define PICO_TCP_FASTOPEN                    12
 # define PICO_SOCKET_OPT_TCPNODELAY           0x0000u
 
 # define PICO_IP_MULTICAST_EXCLUDE            0
@@ -192,6 +250,15 @@ int pico_socket_recvfrom_extended(struct pico_socket *s, void *buf, int len, voi
 
 int pico_socket_send(struct pico_socket *s, const void *buf, int len);
 int pico_socket_recv(struct pico_socket *s, void *buf, int len);
+int pico_socket_recv_zerocopy(struct pico_socket *s, struct pico_zerocopy_chunk *chunks, int max);
+void pico_socket_zerocopy_release(struct pico_zerocopy_chunk *chunk);
+/* Zero-copy sends are tracked by the address of buf: until done is called for
+ * it, another zero-copy send from the same address fails with PICO_ERR_EBUSY,
+ * on any socket. */
+int pico_socket_send_zerocopy(struct pico_socket *s, const void *buf, int len,
+                              void (*done)(const void *buf, int len, void *arg), void *arg);
+int pico_socket_sendto_zerocopy(struct pico_socket *s, const void *buf, int len, void *dst, uint16_t remote_port,
+                                void (*done)(const void *buf, int len, void *arg), void *arg);
 
 int pico_socket_bind(struct pico_socket *s, void *local_addr, uint16_t *port);
 int pico_socket_getname(struct pico_socket *s, void *local_addr, uint16_t *port, uint16_t *proto);
@@ -244,7 +311,11 @@ int pico_transport_error(struct pico_frame *f, uint8_t proto, int code);
 
 /* Socket loop */
 int pico_sockets_loop(int loop_score);
+pico_time pico_sockets_next_deadline(pico_time now);
 struct pico_socket*pico_sockets_find(uint16_t local, uint16_t remote);
+#ifdef PICO_SUPPORT_FLOW_TABLE
+struct pico_socket *pico_socket_flow_find(uint16_t proto, struct pico_frame *f);
+#endif
 /* Port check */
 int pico_is_port_free(uint16_t proto, uint16_t port, void *addr, void *net);
 
@@ -10,6 +10,7 @@
 #include "pico_constants.h"
 
 #define PICO_MAX_TIMERS 20
+#define PICO_TIMER_WHEEL_POOL 64  /* Expired timers kept for reuse by the timer wheel */
 
 #define PICO_ETH_MRU (1514u)
 #define PICO_IP_MRU (1500u)
@@ -59,6 +60,10 @@ int32_t pico_stack_recv_zerocopy(struct pico_device *dev, uint8_t *buffer, uint3
 int32_t pico_stack_recv_zerocopy_ext_buffer(struct pico_device *dev, uint8_t *buffer, uint32_t len);
 int32_t pico_stack_recv_zerocopy_ext_buffer_notify(struct pico_device *dev, uint8_t *buffer, uint32_t len, void (*notify_free)(uint8_t *buffer));
 struct pico_frame *pico_stack_recv_new_frame(struct pico_device *dev, uint8_t *buffer, uint32_t len);
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+/* Safe from a driver thread or ISR, on a device set up with pico_device_rx_ring_init() */
+int32_t pico_stack_recv_ring(struct pico_device *dev, uint8_t *buffer, uint32_t len);
+#endif
 
 /* ----- Initialization ----- */
 int pico_stack_init(void);
@@ -66,6 +71,8 @@ int pico_stack_init(void);
 /* ----- Loop Function. ----- */
 void pico_stack_tick(void);
 void pico_stack_loop(void);
+/* Time (ms) at which pico_stack_tick() has work to do, PICO_TIME_NEVER if idle */
+pico_time pico_stack_next_deadline(void);
 
 /* ---- Notifications for stack errors */
 int pico_notify_socket_unreachable(struct pico_frame *f);
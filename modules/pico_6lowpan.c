@@ -109,14 +109,10 @@ struct frag_ctx {
  *  Global Variables
  ******************************************************************************/
 
-static struct pico_queue pico_6lowpan_in = {
-    0
-};
-static struct pico_queue pico_6lowpan_out = {
-    0
-};
+PICO_PROTO_QUEUE_DECLARE(pico_6lowpan_in);
+PICO_PROTO_QUEUE_DECLARE(pico_6lowpan_out);
 
-static uint16_t dgram_tag = 0;
+static PICO_TLS uint16_t dgram_tag = 0;
 
 /*******************************************************************************
  *  Private functions
@@ -176,8 +172,8 @@ frag_cmp(void *a, void *b)
     }
 }
 
-PICO_TREE_DECLARE(FragTree, &frag_ctx_cmp);
-PICO_TREE_DECLARE(ReassemblyTree, &frag_cmp);
+PICO_TLS PICO_TREE_DECLARE(FragTree, &frag_ctx_cmp);
+PICO_TLS PICO_TREE_DECLARE(ReassemblyTree, &frag_cmp);
 
 /* Find a fragmentation cookie for transmission of subsequent fragments */
 static struct frag_ctx *
@@ -1626,13 +1622,13 @@ pico_6lowpan_pull(struct pico_frame *f)
     return -1;
 }
 
-struct pico_protocol pico_proto_6lowpan = {
+PICO_TLS struct pico_protocol pico_proto_6lowpan = {
     .name = "6lowpan",
     .layer = PICO_LAYER_DATALINK,
     .process_in = pico_6lowpan_process_in,
     .process_out = pico_6lowpan_process_out,
-    .q_in = &pico_6lowpan_in,
-    .q_out = &pico_6lowpan_out
+    .q_in = PICO_PROTO_QUEUE(pico_6lowpan_in),
+    .q_out = PICO_PROTO_QUEUE(pico_6lowpan_out)
 };
 
 int pico_6lowpan_init(void)
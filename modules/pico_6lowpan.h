@@ -28,7 +28,7 @@
  * Public variables
  ******************************************************************************/
 
-extern struct pico_protocol pico_proto_6lowpan;
+extern PICO_TLS struct pico_protocol pico_proto_6lowpan;
 
 /******************************************************************************
  * Public functions
@@ -55,14 +55,10 @@ static const struct pico_6lowpan_ll_protocol pico_6lowpan_ll_none = {
 };
 
 /* Declare a global lookup-table for distribution of link layer specific tasks */
-struct pico_6lowpan_ll_protocol pico_6lowpan_lls[PICO_6LOWPAN_LLS + 1];
+PICO_TLS struct pico_6lowpan_ll_protocol pico_6lowpan_lls[PICO_6LOWPAN_LLS + 1];
 
-static struct pico_queue pico_6lowpan_ll_in = {
-    0
-};
-static struct pico_queue pico_6lowpan_ll_out = {
-    0
-};
+PICO_PROTO_QUEUE_DECLARE(pico_6lowpan_ll_in);
+PICO_PROTO_QUEUE_DECLARE(pico_6lowpan_ll_out);
 
 /*******************************************************************************
  *  CTX
@@ -89,7 +85,7 @@ static int32_t compare_ctx(void *a, void *b)
     return compare_prefix(ca->prefix.addr, cb->prefix.addr, ca->size);
 }
 
-PICO_TREE_DECLARE(CTXtree, compare_ctx);
+PICO_TLS PICO_TREE_DECLARE(CTXtree, compare_ctx);
 
 /* Searches in the context tree if there's a context entry available with the
  * prefix of the IPv6 address */
@@ -424,14 +420,14 @@ pico_6lowpan_ll_push(struct pico_frame *f)
     return -1; // Return ERROR
 }
 
-struct pico_protocol pico_proto_6lowpan_ll = {
+PICO_TLS struct pico_protocol pico_proto_6lowpan_ll = {
     .name = "6lowpan_ll",
     .layer = PICO_LAYER_DATALINK,
     .alloc = pico_6lowpan_frame_alloc,
     .process_in = pico_6lowpan_ll_process_in,
     .process_out = pico_6lowpan_ll_process_out,
-    .q_in = &pico_6lowpan_ll_in,
-    .q_out = &pico_6lowpan_ll_out
+    .q_in = PICO_PROTO_QUEUE(pico_6lowpan_ll_in),
+    .q_out = PICO_PROTO_QUEUE(pico_6lowpan_ll_out)
 };
 
 void pico_6lowpan_ll_init(void)
@@ -105,8 +105,8 @@ struct pico_6lowpan_ll_protocol
  * Public variables
  ******************************************************************************/
 
-extern struct pico_6lowpan_ll_protocol pico_6lowpan_lls[];
-extern struct pico_protocol pico_proto_6lowpan_ll;
+extern PICO_TLS struct pico_6lowpan_ll_protocol pico_6lowpan_lls[];
+extern PICO_TLS struct pico_protocol pico_proto_6lowpan_ll;
 
 /******************************************************************************
  * Public functions
@@ -26,8 +26,8 @@ extern const uint8_t PICO_ETHADDR_ALL[6];
     #define arp_dbg(...) do {} while(0)
 #endif
 
-static int max_arp_reqs = PICO_ARP_MAX_RATE;
-static struct pico_frame *frames_queued[PICO_ARP_MAX_PENDING] = {
+static PICO_TLS int max_arp_reqs = PICO_ARP_MAX_RATE;
+static PICO_TLS struct pico_frame *frames_queued[PICO_ARP_MAX_PENDING] = {
     0
 };
 
@@ -93,7 +93,7 @@ struct arp_service_ipconflict {
     void (*conflict)(int);
 };
 
-static struct arp_service_ipconflict conflict_ipv4;
+static PICO_TLS struct arp_service_ipconflict conflict_ipv4;
 
 
 
@@ -125,7 +125,7 @@ static int arp_compare(void *ka, void *kb)
     return pico_ipv4_compare(&a->ipv4, &b->ipv4);
 }
 
-static PICO_TREE_DECLARE(arp_tree, arp_compare);
+static PICO_TLS PICO_TREE_DECLARE(arp_tree, arp_compare);
 
 /*********************/
 /**  END ARP TREE **/
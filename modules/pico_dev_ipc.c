@@ -5,6 +5,9 @@
    Authors: Michiel Kustermans
  *********************************************************************/
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* sendmmsg, recvmmsg */
+#endif
 #include <sys/poll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -26,6 +29,69 @@ static int pico_ipc_send(struct pico_device *dev, void *buf, int len)
     return (int)write(ipc->fd, buf, (uint32_t)len);
 }
 
+#ifdef __linux__
+/* One sendmmsg()/recvmmsg() call for a whole batch of packets */
+static int pico_ipc_send_batch(struct pico_device *dev, struct pico_frame **f, int count)
+{
+    struct pico_device_ipc *ipc = (struct pico_device_ipc *) dev;
+    struct mmsghdr msg[PICO_DEVICE_BATCH];
+    struct iovec v[PICO_DEVICE_BATCH][PICO_FRAME_MAX_SEGMENTS];
+    struct pico_iovec iov[PICO_FRAME_MAX_SEGMENTS];
+    int i, j, n, sent;
+
+    if (count > PICO_DEVICE_BATCH)
+        count = PICO_DEVICE_BATCH;
+
+    memset(msg, 0, sizeof(msg));
+    for (i = 0; i < count; i++) {
+        n = pico_frame_segments(f[i], iov, PICO_FRAME_MAX_SEGMENTS);
+        if ((n < 0) && (pico_frame_linearize(f[i]) == 0))
+            n = pico_frame_segments(f[i], iov, PICO_FRAME_MAX_SEGMENTS);
+
+        if (n < 0)
+            break;
+
+        for (j = 0; j < n; j++) {
+            v[i][j].iov_base = iov[j].base;
+            v[i][j].iov_len = iov[j].len;
+        }
+        msg[i].msg_hdr.msg_iov = v[i];
+        msg[i].msg_hdr.msg_iovlen = (size_t)n;
+    }
+
+    if (i == 0)
+        return 0;
+
+    sent = sendmmsg(ipc->fd, msg, (unsigned int)i, MSG_DONTWAIT);
+    return (sent < 0) ? 0 : sent;
+}
+
+static int pico_ipc_poll_batch(struct pico_device *dev, struct pico_iovec *pkt, int count)
+{
+    struct pico_device_ipc *ipc = (struct pico_device_ipc *) dev;
+    struct mmsghdr msg[PICO_DEVICE_BATCH];
+    struct iovec v[PICO_DEVICE_BATCH];
+    int i, n;
+
+    if (count > PICO_DEVICE_BATCH)
+        count = PICO_DEVICE_BATCH;
+
+    memset(msg, 0, sizeof(msg));
+    for (i = 0; i < count; i++) {
+        v[i].iov_base = pkt[i].base;
+        v[i].iov_len = pkt[i].len;
+        msg[i].msg_hdr.msg_iov = &v[i];
+        msg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    n = recvmmsg(ipc->fd, msg, (unsigned int)count, MSG_DONTWAIT, NULL);
+    for (i = 0; i < n; i++)
+        pkt[i].len = msg[i].msg_len;
+
+    return (n < 0) ? 0 : n;
+}
+#endif
+
 static int pico_ipc_poll(struct pico_device *dev, int loop_score)
 {
     struct pico_device_ipc *ipc = (struct pico_device_ipc *) dev;
@@ -47,6 +113,12 @@ static int pico_ipc_poll(struct pico_device *dev, int loop_score)
     return 0;
 }
 
+static int pico_ipc_wait_fd(struct pico_device *dev)
+{
+    struct pico_device_ipc *ipc = (struct pico_device_ipc *) dev;
+    return ipc->fd;
+}
+
 /* Public interface: create/destroy. */
 
 void pico_ipc_destroy(struct pico_device *dev)
@@ -103,6 +175,11 @@ struct pico_device *pico_ipc_create(const char *sock_path, const char *name, con
 
     ipc->dev.send = pico_ipc_send;
     ipc->dev.poll = pico_ipc_poll;
+#ifdef __linux__
+    ipc->dev.send_batch = pico_ipc_send_batch;
+    ipc->dev.poll_batch = pico_ipc_poll_batch;
+#endif
+    ipc->dev.wait_fd = pico_ipc_wait_fd;
     ipc->dev.destroy = pico_ipc_destroy;
     dbg("Device %s created.\n", ipc->dev.name);
     return (struct pico_device *)ipc;
@@ -102,8 +102,8 @@ static const unsigned char PPPF_CTRL_ESC  = 0x7du;
 static const unsigned char PPPF_ADDR      = 0xffu;
 static const unsigned char PPPF_CTRL      = 0x03u;
 
-static int ppp_devnum = 0;
-static uint8_t ppp_recv_buf[PPP_MAXPKT];
+static PICO_TLS int ppp_devnum = 0;
+static PICO_TLS uint8_t ppp_recv_buf[PPP_MAXPKT];
 
 PACKED_STRUCT_DEF pico_lcp_hdr {
     uint8_t code;
@@ -505,7 +505,7 @@ static int pico_ppp_ctl_send(struct pico_device *dev, uint16_t code, uint8_t *pk
     return (int)len;
 }
 
-static uint8_t pico_ppp_data_buffer[PPP_HDR_SIZE + PPP_PROTO_SLOT_SIZE + PICO_PPP_MTU + PPP_FCS_SIZE + 1];
+static PICO_TLS uint8_t pico_ppp_data_buffer[PPP_HDR_SIZE + PPP_PROTO_SLOT_SIZE + PICO_PPP_MTU + PPP_FCS_SIZE + 1];
 static int pico_ppp_send(struct pico_device *dev, void *buf, int len)
 {
     struct pico_device_ppp *ppp = (struct pico_device_ppp *) dev;
@@ -2024,7 +2024,7 @@ static void evaluate_ipcp_state(struct pico_device_ppp *ppp, enum ppp_ipcp_event
 static int pico_ppp_poll(struct pico_device *dev, int loop_score)
 {
     struct pico_device_ppp *ppp = (struct pico_device_ppp *) dev;
-    static uint32_t len = 0;
+    static PICO_TLS uint32_t len = 0;
     int r;
     if (ppp->serial_recv) {
         do {
@@ -2033,7 +2033,7 @@ static int pico_ppp_poll(struct pico_device *dev, int loop_score)
                 break;
 
             if (ppp->modem_state == PPP_MODEM_STATE_CONNECTED) {
-                static int control_escape = 0;
+                static PICO_TLS int control_escape = 0;
 
                 if (ppp_recv_buf[len] == PPPF_FLAG_SEQ) {
                     if (control_escape) {
@@ -2058,7 +2058,7 @@ static int pico_ppp_poll(struct pico_device *dev, int loop_score)
                     len++;
                 }
             } else {
-                static int s3 = 0;
+                static PICO_TLS int s3 = 0;
 
                 if (ppp_recv_buf[len] == AT_S3) {
                     s3 = 1;
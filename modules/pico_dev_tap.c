@@ -8,6 +8,7 @@
 
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <net/if.h>
 #include <signal.h>
 #include "pico_device.h"
@@ -31,7 +32,7 @@ struct pico_device_tap {
 /* can't spread these out over an arbitrary amount of devices. When you unplug */
 /* one tap, you unplug all of them. */
 
-static int tapdev_link_state = 0;
+static PICO_TLS int tapdev_link_state = 0;
 
 static void sig_handler(int signo)
 {
@@ -56,6 +57,58 @@ static int pico_tap_send(struct pico_device *dev, void *buf, int len)
     return (int)write(tap->fd, buf, (uint32_t)len);
 }
 
+static int pico_tap_send_iov(struct pico_device *dev, const struct pico_iovec *iov, int iovcnt)
+{
+    struct pico_device_tap *tap = (struct pico_device_tap *) dev;
+    struct iovec v[PICO_FRAME_MAX_SEGMENTS];
+    int i;
+
+    if (iovcnt > PICO_FRAME_MAX_SEGMENTS)
+        return 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        v[i].iov_base = iov[i].base;
+        v[i].iov_len = iov[i].len;
+    }
+    return (int)writev(tap->fd, v, iovcnt);
+}
+
+/* The fd is non-blocking: each call writes frames until the device is busy */
+static int pico_tap_send_batch(struct pico_device *dev, struct pico_frame **f, int count)
+{
+    struct pico_iovec iov[PICO_FRAME_MAX_SEGMENTS];
+    int i, n;
+
+    for (i = 0; i < count; i++) {
+        n = pico_frame_segments(f[i], iov, PICO_FRAME_MAX_SEGMENTS);
+        if ((n < 0) && (pico_frame_linearize(f[i]) == 0))
+            n = pico_frame_segments(f[i], iov, PICO_FRAME_MAX_SEGMENTS);
+
+        if (n == 0)
+            continue; /* Nothing to send */
+
+        if ((n < 0) || (pico_tap_send_iov(dev, iov, n) <= 0))
+            break;
+    }
+    return i;
+}
+
+/* Reads until the fd is drained, without a poll() for each packet */
+static int pico_tap_poll_batch(struct pico_device *dev, struct pico_iovec *pkt, int count)
+{
+    struct pico_device_tap *tap = (struct pico_device_tap *) dev;
+    int n, len;
+
+    for (n = 0; n < count; n++) {
+        len = (int)read(tap->fd, pkt[n].base, pkt[n].len);
+        if (len <= 0)
+            break;
+
+        pkt[n].len = (uint32_t)len;
+    }
+    return n;
+}
+
 static int pico_tap_poll(struct pico_device *dev, int loop_score)
 {
     struct pico_device_tap *tap = (struct pico_device_tap *) dev;
@@ -78,6 +131,12 @@ static int pico_tap_poll(struct pico_device *dev, int loop_score)
     return 0;
 }
 
+static int pico_tap_wait_fd(struct pico_device *dev)
+{
+    struct pico_device_tap *tap = (struct pico_device_tap *) dev;
+    return tap->fd;
+}
+
 /* Public interface: create/destroy. */
 
 void pico_tap_destroy(struct pico_device *dev)
@@ -199,6 +258,9 @@ struct pico_device *pico_tap_create(char *name)
         return NULL;
     }
 
+    /* Batched polling reads until EAGAIN */
+    fcntl(tap->fd, F_SETFL, fcntl(tap->fd, F_GETFL) | O_NONBLOCK);
+
     /* Host's mac address is generated * by the host kernel and is
      * retrieved via tap_get_mac().
      */
@@ -222,7 +284,11 @@ struct pico_device *pico_tap_create(char *name)
     }
 
     tap->dev.send = pico_tap_send;
+    tap->dev.send_iov = pico_tap_send_iov;
+    tap->dev.send_batch = pico_tap_send_batch;
     tap->dev.poll = pico_tap_poll;
+    tap->dev.poll_batch = pico_tap_poll_batch;
+    tap->dev.wait_fd = pico_tap_wait_fd;
     tap->dev.destroy = pico_tap_destroy;
     dbg("Device %s created.\n", tap->dev.name);
     return (struct pico_device *)tap;
@@ -8,6 +8,7 @@
 
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <net/if.h>
 #include <linux/if_tun.h>
 #include "pico_device.h"
@@ -29,6 +30,58 @@ static int pico_tun_send(struct pico_device *dev, void *buf, int len)
     return (int)write(tun->fd, buf, (uint32_t)len);
 }
 
+static int pico_tun_send_iov(struct pico_device *dev, const struct pico_iovec *iov, int iovcnt)
+{
+    struct pico_device_tun *tun = (struct pico_device_tun *) dev;
+    struct iovec v[PICO_FRAME_MAX_SEGMENTS];
+    int i;
+
+    if (iovcnt > PICO_FRAME_MAX_SEGMENTS)
+        return 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        v[i].iov_base = iov[i].base;
+        v[i].iov_len = iov[i].len;
+    }
+    return (int)writev(tun->fd, v, iovcnt);
+}
+
+/* The fd is non-blocking: each call writes frames until the device is busy */
+static int pico_tun_send_batch(struct pico_device *dev, struct pico_frame **f, int count)
+{
+    struct pico_iovec iov[PICO_FRAME_MAX_SEGMENTS];
+    int i, n;
+
+    for (i = 0; i < count; i++) {
+        n = pico_frame_segments(f[i], iov, PICO_FRAME_MAX_SEGMENTS);
+        if ((n < 0) && (pico_frame_linearize(f[i]) == 0))
+            n = pico_frame_segments(f[i], iov, PICO_FRAME_MAX_SEGMENTS);
+
+        if (n == 0)
+            continue; /* Nothing to send */
+
+        if ((n < 0) || (pico_tun_send_iov(dev, iov, n) <= 0))
+            break;
+    }
+    return i;
+}
+
+/* Reads until the fd is drained, without a poll() for each packet */
+static int pico_tun_poll_batch(struct pico_device *dev, struct pico_iovec *pkt, int count)
+{
+    struct pico_device_tun *tun = (struct pico_device_tun *) dev;
+    int n, len;
+
+    for (n = 0; n < count; n++) {
+        len = (int)read(tun->fd, pkt[n].base, pkt[n].len);
+        if (len <= 0)
+            break;
+
+        pkt[n].len = (uint32_t)len;
+    }
+    return n;
+}
+
 static int pico_tun_poll(struct pico_device *dev, int loop_score)
 {
     struct pico_device_tun *tun = (struct pico_device_tun *) dev;
@@ -50,6 +103,12 @@ static int pico_tun_poll(struct pico_device *dev, int loop_score)
     return 0;
 }
 
+static int pico_tun_wait_fd(struct pico_device *dev)
+{
+    struct pico_device_tun *tun = (struct pico_device_tun *) dev;
+    return tun->fd;
+}
+
 /* Public interface: create/destroy. */
 
 void pico_tun_destroy(struct pico_device *dev)
@@ -101,8 +160,15 @@ struct pico_device *pico_tun_create(char *name)
         return NULL;
     }
 
+    /* Batched polling reads until EAGAIN */
+    fcntl(tun->fd, F_SETFL, fcntl(tun->fd, F_GETFL) | O_NONBLOCK);
+
     tun->dev.send = pico_tun_send;
+    tun->dev.send_iov = pico_tun_send_iov;
+    tun->dev.send_batch = pico_tun_send_batch;
     tun->dev.poll = pico_tun_poll;
+    tun->dev.poll_batch = pico_tun_poll_batch;
+    tun->dev.wait_fd = pico_tun_wait_fd;
     tun->dev.destroy = pico_tun_destroy;
     dbg("Device %s created.\n", tun->dev.name);
     return (struct pico_device *)tun;
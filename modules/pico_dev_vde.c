@@ -68,6 +68,12 @@ static int pico_vde_poll(struct pico_device *dev, int loop_score)
     return 0;
 }
 
+static int pico_vde_wait_fd(struct pico_device *dev)
+{
+    struct pico_device_vde *vde = (struct pico_device_vde *) dev;
+    return vde_datafd(vde->conn);
+}
+
 /* Public interface: create/destroy. */
 
 void pico_vde_destroy(struct pico_device *dev)
@@ -115,6 +121,7 @@ struct pico_device *MOCKABLE pico_vde_create(char *sock, char *name, uint8_t *ma
 
     vde->dev.send = pico_vde_send;
     vde->dev.poll = pico_vde_poll;
+    vde->dev.wait_fd = pico_vde_wait_fd;
     vde->dev.destroy = pico_vde_destroy;
     dbg("Device %s created.\n", vde->dev.name);
     return (struct pico_device *)vde;
@@ -41,8 +41,8 @@
 #   define MOCKABLE
 #endif
 
-static char dhcpc_host_name[PICO_DHCP_HOSTNAME_MAXLEN] = "";
-static char dhcpc_domain_name[PICO_DHCP_HOSTNAME_MAXLEN] = "";
+static PICO_TLS char dhcpc_host_name[PICO_DHCP_HOSTNAME_MAXLEN] = "";
+static PICO_TLS char dhcpc_domain_name[PICO_DHCP_HOSTNAME_MAXLEN] = "";
 
 
 enum dhcp_client_state {
@@ -122,7 +122,7 @@ static int dhcp_cookies_cmp(void *ka, void *kb)
 
     return (a->xid < b->xid) ? (-1) : (1);
 }
-static PICO_TREE_DECLARE(DHCPCookies, dhcp_cookies_cmp);
+static PICO_TLS PICO_TREE_DECLARE(DHCPCookies, dhcp_cookies_cmp);
 
 static struct pico_dhcp_client_cookie *pico_dhcp_client_add_cookie(uint32_t xid, struct pico_device *dev, void (*cb)(void *dhcpc, int code), uint32_t *uid)
 {
@@ -46,7 +46,7 @@ static int dns_ns_cmp(void *ka, void *kb)
     struct pico_dns_ns *a = ka, *b = kb;
     return pico_ipv4_compare(&a->ns, &b->ns);
 }
-static PICO_TREE_DECLARE(NSTable, dns_ns_cmp);
+static PICO_TLS PICO_TREE_DECLARE(NSTable, dns_ns_cmp);
 
 struct pico_dns_query
 {
@@ -70,7 +70,7 @@ static int dns_query_cmp(void *ka, void *kb)
 
     return (a->id < b->id) ? (-1) : (1);
 }
-static PICO_TREE_DECLARE(DNSTable, dns_query_cmp);
+static PICO_TLS PICO_TREE_DECLARE(DNSTable, dns_query_cmp);
 
 static int pico_dns_client_del_ns(struct pico_ip4 *ns_addr)
 {
@@ -499,7 +499,7 @@ static int pico_dns_client_user_callback(struct pico_dns_record_suffix *asuffix,
     return 0;
 }
 
-static char dns_response[PICO_IP_MRU] = {
+static PICO_TLS char dns_response[PICO_IP_MRU] = {
     0
 };
 
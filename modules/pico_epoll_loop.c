@@ -0,0 +1,103 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+ *********************************************************************/
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/epoll.h>
+
+#include "pico_device.h"
+#include "pico_stack.h"
+#include "pico_tree.h"
+#include "pico_epoll_loop.h"
+
+#define EPOLL_LOOP_EVENTS 16
+
+static PICO_TLS int epoll_fd = -1;
+
+/* Register the wait fd of every device. Devices may come and go between two
+ * waits, and a closed fd leaves the epoll set by itself, so adding is simply
+ * retried each time and an already registered fd is not an error.
+ */
+static int pico_epoll_sync_devices(void)
+{
+    struct pico_tree_node *index;
+    struct pico_device *dev;
+    struct epoll_event ev;
+    int fd;
+
+    pico_tree_foreach(index, &Device_tree) {
+        dev = index->keyValue;
+        if (!dev->wait_fd)
+            continue;
+
+        fd = dev->wait_fd(dev);
+        if (fd < 0)
+            continue;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if ((epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) && (errno != EEXIST))
+            return -1;
+    }
+    return 0;
+}
+
+static int pico_epoll_timeout(void)
+{
+    pico_time deadline = pico_stack_next_deadline();
+    pico_time now;
+
+    if (deadline == PICO_TIME_NEVER)
+        return -1;
+
+    now = PICO_TIME_MS();
+    if (deadline <= now)
+        return 0;
+
+    if ((deadline - now) > (pico_time)INT_MAX)
+        return INT_MAX;
+
+    return (int)(deadline - now);
+}
+
+int pico_stack_epoll_wait(void)
+{
+    struct epoll_event events[EPOLL_LOOP_EVENTS];
+    int timeout;
+    int ret;
+
+    if (epoll_fd < 0) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0)
+            return -1;
+    }
+
+    if (pico_epoll_sync_devices() < 0)
+        return -1;
+
+    timeout = pico_epoll_timeout();
+    if (timeout == 0)
+        return 0;
+
+    do {
+        ret = epoll_wait(epoll_fd, events, EPOLL_LOOP_EVENTS, timeout);
+    } while ((ret < 0) && (errno == EINTR));
+    return ret;
+}
+
+void pico_stack_loop_epoll(void)
+{
+    while(1) {
+        pico_stack_tick();
+        if (pico_stack_epoll_wait() < 0)
+            PICO_IDLE();
+    }
+}
+
+#endif
@@ -0,0 +1,18 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+ *********************************************************************/
+#ifndef INCLUDE_PICO_EPOLL_LOOP
+#define INCLUDE_PICO_EPOLL_LOOP
+#include "pico_config.h"
+
+/* Block until a device fd is readable or the stack's next deadline, whichever
+ * comes first. Returns the number of ready fds, 0 on timeout, -1 on error.
+ */
+int pico_stack_epoll_wait(void);
+
+/* Tickless replacement for pico_stack_loop() */
+void pico_stack_loop_epoll(void);
+
+#endif
@@ -46,12 +46,8 @@ static const uint8_t PICO_ETHADDR_MCAST6[6] = {
  */
 
 /* Queues */
-static struct pico_queue ethernet_in = {
-    0
-};
-static struct pico_queue ethernet_out = {
-    0
-};
+PICO_PROTO_QUEUE_DECLARE(ethernet_in);
+PICO_PROTO_QUEUE_DECLARE(ethernet_out);
 
 int32_t MOCKABLE pico_ethernet_send(struct pico_frame *f);
 static int32_t pico_ethernet_receive(struct pico_frame *f);
@@ -90,14 +86,14 @@ static struct pico_frame *pico_ethernet_alloc(struct pico_protocol *self, struct
 }
 
 /* Interface: protocol definition */
-struct pico_protocol pico_proto_ethernet = {
+PICO_TLS struct pico_protocol pico_proto_ethernet = {
     .name = "ethernet",
     .layer = PICO_LAYER_DATALINK,
     .alloc = pico_ethernet_alloc,
     .process_in = pico_ethernet_process_in,
     .process_out = pico_ethernet_process_out,
-    .q_in = &ethernet_in,
-    .q_out = &ethernet_out,
+    .q_in = PICO_PROTO_QUEUE(ethernet_in),
+    .q_out = PICO_PROTO_QUEUE(ethernet_out),
 };
 
 static int destination_is_bcast(struct pico_frame *f)
@@ -144,8 +140,9 @@ static int destination_is_mcast(struct pico_frame *f)
 #ifdef PICO_SUPPORT_IPV4
 static int32_t pico_ipv4_ethernet_receive(struct pico_frame *f)
 {
+    int32_t len = (int32_t)f->buffer_len;
     if (IS_IPV4(f)) {
-        if (pico_enqueue(pico_proto_ipv4.q_in, f) < 0) {
+        if (pico_protocol_deliver_in(&pico_proto_ipv4, f) < 0) {
             pico_frame_discard(f);
             return -1;
         }
@@ -155,15 +152,16 @@ static int32_t pico_ipv4_ethernet_receive(struct pico_frame *f)
         return -1;
     }
 
-    return (int32_t)f->buffer_len;
+    return len;
 }
 #endif
 
 #ifdef PICO_SUPPORT_IPV6
 static int32_t pico_ipv6_ethernet_receive(struct pico_frame *f)
 {
+    int32_t len = (int32_t)f->buffer_len;
     if (IS_IPV6(f)) {
-        if (pico_enqueue(pico_proto_ipv6.q_in, f) < 0) {
+        if (pico_protocol_deliver_in(&pico_proto_ipv6, f) < 0) {
             pico_frame_discard(f);
             return -1;
         }
@@ -173,7 +171,7 @@ static int32_t pico_ipv6_ethernet_receive(struct pico_frame *f)
         return -1;
     }
 
-    return (int32_t)f->buffer_len;
+    return len;
 }
 #endif
 
@@ -306,6 +304,12 @@ static int32_t pico_ethsend_local(struct pico_frame *f, struct pico_eth_hdr *hdr
     if(!memcmp(hdr->daddr, hdr->saddr, PICO_SIZE_ETH)) {
         struct pico_frame *clone = pico_frame_copy(f);
         dbg("sending out packet destined for our own mac\n");
+        /* The receive path expects the whole frame in one buffer */
+        if (clone && (pico_frame_linearize(clone) < 0)) {
+            pico_frame_discard(clone);
+            return 1;
+        }
+
         if (pico_ethernet_receive(clone) < 0) {
             dbg("pico_ethernet_receive() failed\n");
         }
@@ -339,13 +343,13 @@ static int32_t pico_ethsend_dispatch(struct pico_frame *f)
 }
 
 /* Checks whether or not there's enough headroom allocated in the frame to
- * prepend the Ethernet header. Reallocates if this is not the case. */
+ * prepend the Ethernet header. If this is not the case, the header goes in a
+ * segment of its own, chained in front of the packet. */
 static int eth_check_headroom(struct pico_frame *f)
 {
     uint32_t headroom = (uint32_t)(f->net_hdr - f->buffer);
-    uint32_t grow = (uint32_t)(PICO_SIZE_ETHHDR - headroom);
     if (headroom < (uint32_t)PICO_SIZE_ETHHDR) {
-        return pico_frame_grow_head(f, (uint32_t)(f->buffer_len + grow));
+        return pico_frame_prepend_segment(f, PICO_SIZE_ETHHDR);
     }
     return 0;
 }
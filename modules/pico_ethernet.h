@@ -13,6 +13,6 @@
 #include "pico_config.h"
 #include "pico_frame.h"
 
-extern struct pico_protocol pico_proto_ethernet;
+extern PICO_TLS struct pico_protocol pico_proto_ethernet;
 
 #endif /* INCLUDE_PICO_ETHERNET */
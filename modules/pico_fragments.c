@@ -67,8 +67,8 @@ static uint16_t pico_fragments_get_header_length(uint8_t net);
 static void pico_fragments_empty_tree(struct pico_tree *tree);
 
 #if defined(PICO_SUPPORT_IPV6) && defined(PICO_SUPPORT_IPV6FRAG)
-static uint32_t ipv6_cur_frag_id = 0u;
-static uint32_t ipv6_fragments_timer = 0u;
+static PICO_TLS uint32_t ipv6_cur_frag_id = 0u;
+static PICO_TLS uint32_t ipv6_fragments_timer = 0u;
 
 static int pico_ipv6_frag_compare(void *ka, void *kb)
 {
@@ -81,7 +81,7 @@ static int pico_ipv6_frag_compare(void *ka, void *kb)
 
     return 0;
 }
-static PICO_TREE_DECLARE(ipv6_fragments, pico_ipv6_frag_compare);
+static PICO_TLS PICO_TREE_DECLARE(ipv6_fragments, pico_ipv6_frag_compare);
 
 static void pico_ipv6_fragments_complete(unsigned int len, uint8_t proto)
 {
@@ -123,8 +123,8 @@ static int pico_ipv6_frag_match(struct pico_frame *a, struct pico_frame *b)
 #endif
 
 #if defined(PICO_SUPPORT_IPV4) && defined(PICO_SUPPORT_IPV4FRAG)
-static uint32_t ipv4_cur_frag_id = 0u;
-static uint32_t ipv4_fragments_timer = 0u;
+static PICO_TLS uint32_t ipv4_cur_frag_id = 0u;
+static PICO_TLS uint32_t ipv4_fragments_timer = 0u;
 
 static int pico_ipv4_frag_compare(void *ka, void *kb)
 {
@@ -137,7 +137,7 @@ static int pico_ipv4_frag_compare(void *ka, void *kb)
 
     return 0;
 }
-static PICO_TREE_DECLARE(ipv4_fragments, pico_ipv4_frag_compare);
+static PICO_TLS PICO_TREE_DECLARE(ipv4_fragments, pico_ipv4_frag_compare);
 
 static void pico_ipv4_fragments_complete(unsigned int len, uint8_t proto)
 {
@@ -17,12 +17,8 @@
 #include "pico_tree.h"
 
 /* Queues */
-static struct pico_queue icmp_in = {
-    0
-};
-static struct pico_queue icmp_out = {
-    0
-};
+PICO_PROTO_QUEUE_DECLARE(icmp_in);
+PICO_PROTO_QUEUE_DECLARE(icmp_out);
 
 
 /* Functions */
@@ -47,9 +43,9 @@ static void ping_recv_reply(struct pico_frame *f);
 static int pico_icmp4_process_in(struct pico_protocol *self, struct pico_frame *f)
 {
     struct pico_icmp4_hdr *hdr = (struct pico_icmp4_hdr *) f->transport_hdr;
-    static int firstpkt = 1;
-    static uint16_t last_id = 0;
-    static uint16_t last_seq = 0;
+    static PICO_TLS int firstpkt = 1;
+    static PICO_TLS uint16_t last_id = 0;
+    static PICO_TLS uint16_t last_seq = 0;
     IGNORE_PARAMETER(self);
 
     if (hdr->type == PICO_ICMP_ECHO) {
@@ -93,14 +89,14 @@ static int pico_icmp4_process_out(struct pico_protocol *self, struct pico_frame
 }
 
 /* Interface: protocol definition */
-struct pico_protocol pico_proto_icmp4 = {
+PICO_TLS struct pico_protocol pico_proto_icmp4 = {
     .name = "icmp4",
     .proto_number = PICO_PROTO_ICMP4,
     .layer = PICO_LAYER_TRANSPORT,
     .process_in = pico_icmp4_process_in,
     .process_out = pico_icmp4_process_out,
-    .q_in = &icmp_in,
-    .q_out = &icmp_out,
+    .q_in = PICO_PROTO_QUEUE(icmp_in),
+    .q_out = PICO_PROTO_QUEUE(icmp_out),
 };
 
 static int pico_icmp4_notify(struct pico_frame *f, uint8_t type, uint8_t code)
@@ -225,7 +221,7 @@ static int cookie_compare(void *ka, void *kb)
     return (a->seq - b->seq);
 }
 
-static PICO_TREE_DECLARE(Pings, cookie_compare);
+static PICO_TLS PICO_TREE_DECLARE(Pings, cookie_compare);
 
 static int8_t pico_icmp4_send_echo(struct pico_icmp4_ping_cookie *cookie)
 {
@@ -367,7 +363,7 @@ static void ping_recv_reply(struct pico_frame *f)
 
 int pico_icmp4_ping(char *dst, int count, int interval, int timeout, int size, void (*cb)(struct pico_icmp4_stats *))
 {
-    static uint16_t next_id = 0x91c0;
+    static PICO_TLS uint16_t next_id = 0x91c0;
     struct pico_icmp4_ping_cookie *cookie;
 
     if((dst == NULL) || (interval == 0) || (timeout == 0) || (count == 0)) {
@@ -12,7 +12,7 @@
 #include "pico_protocol.h"
 
 
-extern struct pico_protocol pico_proto_icmp4;
+extern PICO_TLS struct pico_protocol pico_proto_icmp4;
 
 PACKED_STRUCT_DEF pico_icmp4_hdr {
     uint8_t type;
@@ -24,8 +24,8 @@
     #define icmp6_dbg(...) do { } while(0)
 #endif
 
-static struct pico_queue icmp6_in;
-static struct pico_queue icmp6_out;
+PICO_PROTO_QUEUE_DECLARE(icmp6_in);
+PICO_PROTO_QUEUE_DECLARE(icmp6_out);
 
 /******************************************************************************
  *  Function prototypes
@@ -140,14 +140,14 @@ static int pico_icmp6_process_out(struct pico_protocol *self, struct pico_frame
 }
 
 /* Interface: protocol definition */
-struct pico_protocol pico_proto_icmp6 = {
+PICO_TLS struct pico_protocol pico_proto_icmp6 = {
     .name = "icmp6",
     .proto_number = PICO_PROTO_ICMP6,
     .layer = PICO_LAYER_TRANSPORT,
     .process_in = pico_icmp6_process_in,
     .process_out = pico_icmp6_process_out,
-    .q_in = &icmp6_in,
-    .q_out = &icmp6_out,
+    .q_in = PICO_PROTO_QUEUE(icmp6_in),
+    .q_out = PICO_PROTO_QUEUE(icmp6_out),
 };
 
 static int pico_icmp6_notify(struct pico_frame *f, uint8_t type, uint8_t code, uint32_t ptr)
@@ -683,7 +683,7 @@ static int icmp6_cookie_compare(void *ka, void *kb)
 
     return (a->seq - b->seq);
 }
-static PICO_TREE_DECLARE(IPV6Pings, icmp6_cookie_compare);
+static PICO_TLS PICO_TREE_DECLARE(IPV6Pings, icmp6_cookie_compare);
 
 static int pico_icmp6_send_echo(struct pico_icmp6_ping_cookie *cookie)
 {
@@ -835,7 +835,7 @@ static void pico_icmp6_ping_recv_reply(struct pico_frame *f)
 
 int pico_icmp6_ping(char *dst, int count, int interval, int timeout, int size, void (*cb)(struct pico_icmp6_stats *), struct pico_device *dev)
 {
-    static uint16_t next_id = 0x91c0;
+    static PICO_TLS uint16_t next_id = 0x91c0;
     struct pico_icmp6_ping_cookie *cookie = NULL;
 
     if(!dst || !count || !interval || !timeout) {
@@ -110,7 +110,7 @@
 /* Address registration lifetime */
 #define PICO_6LP_ND_DEFAULT_LIFETIME    (120) /* TWO HOURS */
 
-extern struct pico_protocol pico_proto_icmp6;
+extern PICO_TLS struct pico_protocol pico_proto_icmp6;
 
 PACKED_STRUCT_DEF pico_icmp6_hdr {
     uint8_t type;
@@ -129,12 +129,8 @@ struct igmp_timer {
 };
 
 /* queues */
-static struct pico_queue igmp_in = {
-    0
-};
-static struct pico_queue igmp_out = {
-    0
-};
+PICO_PROTO_QUEUE_DECLARE(igmp_in);
+PICO_PROTO_QUEUE_DECLARE(igmp_out);
 
 /* finite state machine caller */
 static int pico_igmp_process_event(struct mcast_parameters *p);
@@ -179,7 +175,7 @@ static int igmp_timer_cmp(void *ka, void *kb)
     return igmpt_link_compare(a, b);
 
 }
-static PICO_TREE_DECLARE(IGMPTimers, igmp_timer_cmp);
+static PICO_TLS PICO_TREE_DECLARE(IGMPTimers, igmp_timer_cmp);
 
 static inline int igmpparm_group_compare(struct mcast_parameters *a,  struct mcast_parameters *b)
 {
@@ -200,15 +196,15 @@ static int igmp_parameters_cmp(void *ka, void *kb)
 
     return igmpparm_link_compare(a, b);
 }
-static PICO_TREE_DECLARE(IGMPParameters, igmp_parameters_cmp);
+static PICO_TLS PICO_TREE_DECLARE(IGMPParameters, igmp_parameters_cmp);
 
 static int igmp_sources_cmp(void *ka, void *kb)
 {
     struct pico_ip4 *a = ka, *b = kb;
     return pico_ipv4_compare(a, b);
 }
-static PICO_TREE_DECLARE(IGMPAllow, igmp_sources_cmp);
-static PICO_TREE_DECLARE(IGMPBlock, igmp_sources_cmp);
+static PICO_TLS PICO_TREE_DECLARE(IGMPAllow, igmp_sources_cmp);
+static PICO_TLS PICO_TREE_DECLARE(IGMPBlock, igmp_sources_cmp);
 
 static struct mcast_parameters *pico_igmp_find_parameter(struct pico_ip4 *mcast_link, struct pico_ip4 *mcast_group)
 {
@@ -593,14 +589,14 @@ static int pico_igmp_process_out(struct pico_protocol *self, struct pico_frame *
 }
 
 /* Interface: protocol definition */
-struct pico_protocol pico_proto_igmp = {
+PICO_TLS struct pico_protocol pico_proto_igmp = {
     .name = "igmp",
     .proto_number = PICO_PROTO_IGMP,
     .layer = PICO_LAYER_TRANSPORT,
     .process_in = pico_igmp_process_in,
     .process_out = pico_igmp_process_out,
-    .q_in = &igmp_in,
-    .q_out = &igmp_out,
+    .q_in = PICO_PROTO_QUEUE(igmp_in),
+    .q_out = PICO_PROTO_QUEUE(igmp_out),
 };
 
 int pico_igmp_state_change(struct pico_ip4 *mcast_link, struct pico_ip4 *mcast_group, uint8_t filter_mode, struct pico_tree *_MCASTFilter, uint8_t state)
@@ -1124,12 +1120,8 @@ static int pico_igmp_process_event(struct mcast_parameters *p)
 }
 
 #else
-static struct pico_queue igmp_in = {
-    0
-};
-static struct pico_queue igmp_out = {
-    0
-};
+PICO_PROTO_QUEUE_DECLARE(igmp_in);
+PICO_PROTO_QUEUE_DECLARE(igmp_out);
 
 static int pico_igmp_process_in(struct pico_protocol *self, struct pico_frame *f)
 {
@@ -1147,14 +1139,14 @@ static int pico_igmp_process_out(struct pico_protocol *self, struct pico_frame *
 }
 
 /* Interface: protocol definition */
-struct pico_protocol pico_proto_igmp = {
+PICO_TLS struct pico_protocol pico_proto_igmp = {
     .name = "igmp",
     .proto_number = PICO_PROTO_IGMP,
     .layer = PICO_LAYER_TRANSPORT,
     .process_in = pico_igmp_process_in,
     .process_out = pico_igmp_process_out,
-    .q_in = &igmp_in,
-    .q_out = &igmp_out,
+    .q_in = PICO_PROTO_QUEUE(igmp_in),
+    .q_out = PICO_PROTO_QUEUE(igmp_out),
 };
 
 int pico_igmp_state_change(struct pico_ip4 *mcast_link, struct pico_ip4 *mcast_group, uint8_t filter_mode, struct pico_tree *_MCASTFilter, uint8_t state)
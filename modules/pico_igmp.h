@@ -20,7 +20,7 @@
 
 #define PICO_IGMP_QUERY_INTERVAL  125
 
-extern struct pico_protocol pico_proto_igmp;
+extern PICO_TLS struct pico_protocol pico_proto_igmp;
 
 int pico_igmp_state_change(struct pico_ip4 *mcast_link, struct pico_ip4 *mcast_group, uint8_t filter_mode, struct pico_tree *_MCASTFilter, uint8_t state);
 #endif /* _INCLUDE_PICO_IGMP */
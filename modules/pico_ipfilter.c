@@ -53,7 +53,7 @@ struct filter_node {
     int (*function_ptr)(struct filter_node *filter, struct pico_frame *f);
 };
 
-static PICO_TREE_DECLARE(filter_tree, &filter_compare);
+static PICO_TLS PICO_TREE_DECLARE(filter_tree, &filter_compare);
 
 static inline int ipfilter_uint32_cmp(uint32_t a, uint32_t b)
 {
@@ -365,7 +365,7 @@ uint32_t pico_ipv4_filter_add(struct pico_device *dev, uint8_t proto,
                               uint16_t out_port, uint16_t in_port, int8_t priority,
                               uint8_t tos, enum filter_action action)
 {
-    static uint32_t filter_id = 1u; /* 0 is a special value used in the binary-tree search for packets being processed */
+    static PICO_TLS uint32_t filter_id = 1u; /* 0 is a special value used in the binary-tree search for packets being processed */
     struct filter_node *new_filter;
 
     if (pico_ipv4_filter_add_validate(priority, action) < 0) {
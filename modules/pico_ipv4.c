@@ -37,16 +37,12 @@
 
 # define PICO_MCAST_ALL_HOSTS long_be(0xE0000001) /* 224.0.0.1 */
 /* Default network interface for multicast transmission */
-static struct pico_ipv4_link *mcast_default_link = NULL;
+static PICO_TLS struct pico_ipv4_link *mcast_default_link = NULL;
 #endif
 
 /* Queues */
-static struct pico_queue in = {
-    0
-};
-static struct pico_queue out = {
-    0
-};
+PICO_PROTO_QUEUE_DECLARE(in);
+PICO_PROTO_QUEUE_DECLARE(out);
 
 /* Functions */
 static int ipv4_route_compare(void *ka, void *kb);
@@ -287,7 +283,7 @@ static int ipv4_link_compare(void *ka, void *kb)
     return 0;
 }
 
-static PICO_TREE_DECLARE(Tree_dev_link, ipv4_link_compare);
+static PICO_TLS PICO_TREE_DECLARE(Tree_dev_link, ipv4_link_compare);
 
 static int pico_ipv4_process_bcast_in(struct pico_frame *f)
 {
@@ -296,7 +292,7 @@ static int pico_ipv4_process_bcast_in(struct pico_frame *f)
     if (pico_ipv4_is_broadcast(hdr->dst.addr) && (hdr->proto == PICO_PROTO_UDP)) {
         /* Receiving UDP broadcast datagram */
         f->flags |= PICO_FRAME_FLAG_BCAST;
-        pico_enqueue(pico_proto_udp.q_in, f);
+        pico_protocol_deliver_in(&pico_proto_udp, f);
         return 1;
     }
 
@@ -306,7 +302,7 @@ static int pico_ipv4_process_bcast_in(struct pico_frame *f)
     if (pico_ipv4_is_broadcast(hdr->dst.addr) && (hdr->proto == PICO_PROTO_ICMP4)) {
         /* Receiving ICMP4 bcast packet */
         f->flags |= PICO_FRAME_FLAG_BCAST;
-        pico_enqueue(pico_proto_icmp4.q_in, f);
+        pico_protocol_deliver_in(&pico_proto_icmp4, f);
         return 1;
     }
 
@@ -325,7 +321,7 @@ static int pico_ipv4_process_mcast_in(struct pico_frame *f)
             pico_transport_receive(f, PICO_PROTO_IGMP);
             return 1;
         } else if ((pico_ipv4_mcast_filter(f) == 0) && (hdr->proto == PICO_PROTO_UDP)) {
-            pico_enqueue(pico_proto_udp.q_in, f);
+            pico_protocol_deliver_in(&pico_proto_udp, f);
             return 1;
         }
 
@@ -356,7 +352,7 @@ static int pico_ipv4_process_local_unicast_in(struct pico_frame *f)
         /* XXX KRO: is obsolete. Broadcast flag is set on outgoing DHCP messages.
          * incomming DHCP messages are to be broadcasted. Our current DHCP server
          * implementation does not take this flag into account yet though ... */
-        pico_enqueue(pico_proto_udp.q_in, f);
+        pico_protocol_deliver_in(&pico_proto_udp, f);
         return 1;
 #endif
     }
@@ -469,7 +465,7 @@ static int pico_ipv4_process_in(struct pico_protocol *self, struct pico_frame *f
     return 0;
 }
 
-PICO_TREE_DECLARE(Routes, ipv4_route_compare);
+PICO_TLS PICO_TREE_DECLARE(Routes, ipv4_route_compare);
 
 
 static int pico_ipv4_process_out(struct pico_protocol *self, struct pico_frame *f)
@@ -511,7 +507,7 @@ static struct pico_frame *pico_ipv4_alloc(struct pico_protocol *self, struct pic
 static int pico_ipv4_frame_sock_push(struct pico_protocol *self, struct pico_frame *f);
 
 /* Interface: protocol definition */
-struct pico_protocol pico_proto_ipv4 = {
+PICO_TLS struct pico_protocol pico_proto_ipv4 = {
     .name = "ipv4",
     .proto_number = PICO_PROTO_IPV4,
     .layer = PICO_LAYER_NETWORK,
@@ -519,8 +515,8 @@ struct pico_protocol pico_proto_ipv4 = {
     .process_in = pico_ipv4_process_in,
     .process_out = pico_ipv4_process_out,
     .push = pico_ipv4_frame_sock_push,
-    .q_in = &in,
-    .q_out = &out,
+    .q_in = PICO_PROTO_QUEUE(in),
+    .q_out = PICO_PROTO_QUEUE(out),
 };
 
 
@@ -554,7 +550,7 @@ static int ipv4_route_compare(void *ka, void *kb)
 }
 
 
-static struct pico_ipv4_route default_bcast_route = {
+static PICO_TLS struct pico_ipv4_route default_bcast_route = {
     .dest = {PICO_IP4_BCAST},
     .netmask = {PICO_IP4_BCAST},
     .gateway  = { 0 },
@@ -968,7 +964,7 @@ int pico_ipv4_frame_push(struct pico_frame *f, struct pico_ip4 *dst, uint8_t pro
     uint8_t ttl = PICO_IPV4_DEFAULT_TTL;
     uint8_t vhl = 0x45; /* version 4, header length 20 */
     int32_t retval = 0;
-    static uint16_t ipv4_progressive_id = 0x91c0;
+    static PICO_TLS uint16_t ipv4_progressive_id = 0x91c0;
 #ifdef PICO_SUPPORT_MCAST
     struct pico_tree_node *index;
 #endif
@@ -1100,7 +1096,7 @@ int pico_ipv4_frame_push(struct pico_frame *f, struct pico_ip4 *dst, uint8_t pro
                 goto drop;
             }
 
-            retval = pico_enqueue(&in, cpy);
+            retval = pico_enqueue(pico_proto_ipv4.q_in, cpy);
             if (retval <= 0)
                 pico_frame_discard(cpy);
         }
@@ -1120,12 +1116,12 @@ int pico_ipv4_frame_push(struct pico_frame *f, struct pico_ip4 *dst, uint8_t pro
 
     if (pico_ipv4_link_get(&hdr->dst)) {
         /* it's our own IP */
-        retval = pico_enqueue(&in, f);
+        retval = pico_enqueue(pico_proto_ipv4.q_in, f);
         if (retval > 0)
             return retval;
     } else{
         /* TODO: Check if there are members subscribed here */
-        retval = pico_enqueue(&out, f);
+        retval = pico_protocol_deliver_out(&pico_proto_ipv4, f);
         if (retval > 0)
             return retval;
     }
@@ -1534,17 +1530,19 @@ int pico_ipv4_rebound(struct pico_frame *f)
 
 static int pico_ipv4_pre_forward_checks(struct pico_frame *f)
 {
-    static uint16_t last_id = 0;
-    static uint16_t last_proto = 0;
-    static struct pico_ip4 last_src = {
+    static PICO_TLS uint16_t last_id = 0;
+    static PICO_TLS uint16_t last_proto = 0;
+    static PICO_TLS struct pico_ip4 last_src = {
         0
     };
-    static struct pico_ip4 last_dst = {
+    static PICO_TLS struct pico_ip4 last_dst = {
         0
     };
     struct pico_ipv4_hdr *hdr = (struct pico_ipv4_hdr *)f->net_hdr;
+    uint16_t old_word, new_word;
 
     /* Decrease TTL, check if expired */
+    memcpy(&old_word, &hdr->ttl, sizeof(old_word));
     hdr->ttl = (uint8_t)(hdr->ttl - 1);
     if (hdr->ttl < 1) {
         pico_notify_ttl_expired(f);
@@ -1552,8 +1550,9 @@ static int pico_ipv4_pre_forward_checks(struct pico_frame *f)
         return -1;
     }
 
-    /* HACK: increase crc to compensate decreased TTL */
-    hdr->crc++;
+    /* Update the header checksum for the ttl/proto word */
+    memcpy(&new_word, &hdr->ttl, sizeof(new_word));
+    hdr->crc = pico_checksum_adjust16(hdr->crc, old_word, new_word);
 
     /* If source is local, discard anyway (packets bouncing back and forth) */
     if (pico_ipv4_link_get(&hdr->src))
@@ -27,7 +27,7 @@
     #define PICO_IPV4_FRAG_MAX_SIZE PICO_DEFAULT_SOCKETQ
 #endif
 
-extern struct pico_protocol pico_proto_ipv4;
+extern PICO_TLS struct pico_protocol pico_proto_ipv4;
 
 PACKED_STRUCT_DEF pico_ipv4_hdr {
     uint8_t vhl;
@@ -77,7 +77,7 @@ struct pico_ipv4_route
     uint32_t metric;
 };
 
-extern struct pico_tree Routes;
+extern PICO_TLS struct pico_tree Routes;
 
 
 int pico_ipv4_compare(struct pico_ip4 *a, struct pico_ip4 *b);
@@ -51,11 +51,11 @@
 #define ipv6_mcast_dbg(...) do { } while(0)
 #endif
 
-static struct pico_ipv6_link *mcast_default_link_ipv6 = NULL;
+static PICO_TLS struct pico_ipv6_link *mcast_default_link_ipv6 = NULL;
 #endif
 /* queues */
-static struct pico_queue ipv6_in;
-static struct pico_queue ipv6_out;
+PICO_PROTO_QUEUE_DECLARE(ipv6_in);
+PICO_PROTO_QUEUE_DECLARE(ipv6_out);
 
 const uint8_t PICO_IP6_ANY[PICO_SIZE_IP6] = {
     0
@@ -132,9 +132,9 @@ static int ipv6_route_compare(void *ka, void *kb)
 
 }
 
-static PICO_TREE_DECLARE(Tree_dev_ip6_link, ipv6_link_compare);
-PICO_TREE_DECLARE(IPV6Routes, ipv6_route_compare);
-static PICO_TREE_DECLARE(IPV6Links, ipv6_link_compare);
+static PICO_TLS PICO_TREE_DECLARE(Tree_dev_ip6_link, ipv6_link_compare);
+PICO_TLS PICO_TREE_DECLARE(IPV6Routes, ipv6_route_compare);
+static PICO_TLS PICO_TREE_DECLARE(IPV6Links, ipv6_link_compare);
 
 static char pico_ipv6_dec_to_char(uint8_t u)
 {
@@ -661,16 +661,20 @@ static int pico_ipv6_check_headers_sequence(struct pico_frame *f)
     struct pico_ipv6_hdr *hdr = (struct pico_ipv6_hdr *)f->net_hdr;
     int ptr = sizeof(struct pico_ipv6_hdr);
     int cur_nexthdr = 6; /* Starts with nexthdr field in ipv6 pkt */
+    int avail = (int)((f->buffer + f->buffer_len) - f->net_hdr);
     uint8_t nxthdr = hdr->nxthdr;
     for (;; ) {
-        uint8_t optlen = *(f->net_hdr + ptr + 1);
+        int optlen;
         switch (nxthdr) {
         case PICO_IPV6_EXTHDR_DESTOPT:
         case PICO_IPV6_EXTHDR_ROUTING:
         case PICO_IPV6_EXTHDR_HOPBYHOP:
         case PICO_IPV6_EXTHDR_ESP:
         case PICO_IPV6_EXTHDR_AUTH:
-            optlen = (uint8_t)IPV6_OPTLEN(optlen);
+            if (ptr + 2 > avail)
+                return -1; /* Truncated extension header */
+
+            optlen = IPV6_OPTLEN(*(f->net_hdr + ptr + 1));
             break;
         case PICO_IPV6_EXTHDR_FRAG:
             optlen = 8;
@@ -687,6 +691,9 @@ static int pico_ipv6_check_headers_sequence(struct pico_frame *f)
             pico_icmp6_parameter_problem(f, PICO_ICMP6_PARAMPROB_NXTHDR, (uint32_t)cur_nexthdr);
             return -1;
         }
+        if (ptr + optlen > avail)
+            return -1; /* Truncated extension header */
+
         cur_nexthdr = ptr;
         nxthdr = *(f->net_hdr + ptr);
         ptr += optlen;
@@ -822,7 +829,7 @@ static int pico_ipv6_process_mcast_in(struct pico_frame *f)
             pico_transport_receive(f, PICO_PROTO_ICMP6);
             return 1;
         } else if ((pico_ipv6_mcast_filter(f) == 0) && (hdr->nxthdr == PICO_PROTO_UDP)) {
-            pico_enqueue(pico_proto_udp.q_in, f);
+            pico_protocol_deliver_in(&pico_proto_udp, f);
             return 1;
         }
 
@@ -1358,10 +1365,10 @@ static int ipv6_frame_push_final(struct pico_frame *f)
     struct pico_ipv6_hdr *hdr = NULL;
     hdr = (struct pico_ipv6_hdr *)f->net_hdr;
     if(pico_ipv6_link_get(&hdr->dst)) {
-        return pico_enqueue(&ipv6_in, f);
+        return pico_enqueue(pico_proto_ipv6.q_in, f);
     }
     else {
-        return pico_enqueue(&ipv6_out, f);
+        return pico_protocol_deliver_out(&pico_proto_ipv6, f);
     }
 }
 
@@ -1443,7 +1450,7 @@ static int pico_ipv6_frame_sock_push(struct pico_protocol *self, struct pico_fra
 }
 
 /* interface: protocol definition */
-struct pico_protocol pico_proto_ipv6 = {
+PICO_TLS struct pico_protocol pico_proto_ipv6 = {
     .name = "ipv6",
     .proto_number = PICO_PROTO_IPV6,
     .layer = PICO_LAYER_NETWORK,
@@ -1451,8 +1458,8 @@ struct pico_protocol pico_proto_ipv6 = {
     .process_in = pico_ipv6_process_in,
     .process_out = pico_ipv6_process_out,
     .push = pico_ipv6_frame_sock_push,
-    .q_in = &ipv6_in,
-    .q_out = &ipv6_out,
+    .q_in = PICO_PROTO_QUEUE(ipv6_in),
+    .q_out = PICO_PROTO_QUEUE(ipv6_out),
 };
 
 #ifdef DEBUG_IPV6_ROUTE
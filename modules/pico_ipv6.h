@@ -31,8 +31,8 @@
 #define IPV6_OPTLEN(x) ((uint16_t)(((x + 1) << 3)))
 
 extern const uint8_t PICO_IP6_ANY[PICO_SIZE_IP6];
-extern struct pico_protocol pico_proto_ipv6;
-extern struct pico_tree IPV6Routes;
+extern PICO_TLS struct pico_protocol pico_proto_ipv6;
+extern PICO_TLS struct pico_tree IPV6Routes;
 
 PACKED_STRUCT_DEF pico_ipv6_hdr {
     uint32_t vtf;
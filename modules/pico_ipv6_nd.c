@@ -36,7 +36,7 @@
     #define MAX_RTR_SOLICITATION_INTERVAL   (60000)
 #endif
 
-static struct pico_frame *frames_queued_v6[PICO_ND_MAX_FRAMES_QUEUED] = {
+static PICO_TLS struct pico_frame *frames_queued_v6[PICO_ND_MAX_FRAMES_QUEUED] = {
     0
 };
 
@@ -74,7 +74,7 @@ static int pico_ipv6_neighbor_compare(void *ka, void *kb)
     struct pico_ipv6_neighbor *a = ka, *b = kb;
     return pico_ipv6_compare(&a->address, &b->address);
 }
-PICO_TREE_DECLARE(NCache, pico_ipv6_neighbor_compare);
+PICO_TLS PICO_TREE_DECLARE(NCache, pico_ipv6_neighbor_compare);
 
 static struct pico_ipv6_neighbor *pico_nd_find_neighbor(struct pico_ip6 *dst)
 {
@@ -1503,7 +1503,7 @@ struct pico_eth *pico_ipv6_get_neighbor(struct pico_frame *f)
 void pico_ipv6_nd_postpone(struct pico_frame *f)
 {
     int i;
-    static int last_enq = -1;
+    static PICO_TLS int last_enq = -1;
     for (i = 0; i < PICO_ND_MAX_FRAMES_QUEUED; i++)
     {
         if (!frames_queued_v6[i]) {
@@ -113,7 +113,7 @@ struct pico_mdns_cookie
 /* MARK: TREES & GLOBAL VARIABLES */
 
 /* MDNS Communication variables */
-static struct pico_socket *mdns_sock_ipv4 = NULL;
+static PICO_TLS struct pico_socket *mdns_sock_ipv4 = NULL;
 static uint16_t mdns_port = 5353u;
 static struct pico_ip4 inaddr_any = {
     0
@@ -123,9 +123,9 @@ static struct pico_ip4 inaddr_any = {
  *  Hostname for this machine, only 1 hostname can be set.
  *  Following RFC6267: 15.4 Recommendation
  * *****************************************************************************/
-static char *_hostname = NULL;
+static PICO_TLS char *_hostname = NULL;
 
-static void (*init_callback)(pico_mdns_rtree *, char *, void *) = 0;
+static PICO_TLS void (*init_callback)(pico_mdns_rtree *, char *, void *) = 0;
 
 /* ****************************************************************************
  *  Compares 2 mDNS records by name and type only
@@ -222,7 +222,7 @@ pico_mdns_cookie_cmp( void *ka, void *kb )
 /*
  *  Hash to identify mDNS timers with
  */
-static uint32_t mdns_hash = 0;
+static PICO_TLS uint32_t mdns_hash = 0;
 
 /*
  *  mDNS specific timer creation, to identify if timers are
@@ -238,14 +238,14 @@ pico_mdns_timer_add(pico_time expire,
 
 #if PICO_MDNS_ALLOW_CACHING == 1
 /* Cache records from mDNS peers on the network */
-static PICO_TREE_DECLARE(Cache, &pico_mdns_record_cmp);
+static PICO_TLS PICO_TREE_DECLARE(Cache, &pico_mdns_record_cmp);
 #endif
 
 /* My records for which I want to have the authority */
-static PICO_TREE_DECLARE(MyRecords, &pico_mdns_record_cmp_name_type);
+static PICO_TLS PICO_TREE_DECLARE(MyRecords, &pico_mdns_record_cmp_name_type);
 
 /* Cookie-tree */
-static PICO_TREE_DECLARE(Cookies, &pico_mdns_cookie_cmp);
+static PICO_TLS PICO_TREE_DECLARE(Cookies, &pico_mdns_cookie_cmp);
 
 /* ****************************************************************************
  *  MARK: PROTOTYPES                                                          */
@@ -1269,7 +1269,7 @@ pico_mdns_my_records_add( pico_mdns_rtree *records, uint8_t reclaim )
 {
     struct pico_tree_node *node = NULL;
     struct pico_mdns_record *record = NULL;
-    static uint8_t claim_id_count = 0;
+    static PICO_TLS uint8_t claim_id_count = 0;
 
     if (!reclaim) {
         ++claim_id_count;
@@ -79,7 +79,7 @@
 
 #define MLD_TIMER_STOPPED                (1)
 #define MLD_MAX_SOURCES                  (89)
-extern struct pico_protocol pico_proto_mld;
+extern PICO_TLS struct pico_protocol pico_proto_mld;
 
 struct mld_multicast_address_record {
     uint8_t type;
@@ -46,7 +46,7 @@ struct pico_nat_tuple {
     struct pico_ip4 nat_addr;
 };
 
-static struct pico_ipv4_link *nat_link = NULL;
+static PICO_TLS struct pico_ipv4_link *nat_link = NULL;
 
 static int nat_cmp_natport(struct pico_nat_tuple *a, struct pico_nat_tuple *b)
 {
@@ -120,8 +120,8 @@ static int nat_cmp_outbound(void *ka, void *kb)
     return nat_cmp_proto(a, b);
 }
 
-static PICO_TREE_DECLARE(NATOutbound, nat_cmp_outbound);
-static PICO_TREE_DECLARE(NATInbound, nat_cmp_inbound);
+static PICO_TLS PICO_TREE_DECLARE(NATOutbound, nat_cmp_outbound);
+static PICO_TLS PICO_TREE_DECLARE(NATInbound, nat_cmp_inbound);
 
 void pico_ipv4_nat_print_table(void)
 {
@@ -421,6 +421,46 @@ int pico_ipv4_port_forward(struct pico_ip4 nat_addr, uint16_t nat_port, struct p
     return 0;
 }
 
+/* Adjust the IP and transport checksums for an address/port rewrite, instead
+ * of recomputing them over the whole header and segment (RFC 1624). Must be
+ * called before the fields are overwritten.
+ */
+static void pico_ipv4_nat_adjust_crc(struct pico_frame *f, uint32_t old_addr, uint32_t new_addr, uint16_t old_port, uint16_t new_port)
+{
+    struct pico_ipv4_hdr *net = (struct pico_ipv4_hdr *)f->net_hdr;
+
+    net->crc = pico_checksum_adjust32(net->crc, old_addr, new_addr);
+    switch (net->proto) {
+#ifdef PICO_SUPPORT_TCP
+    case PICO_PROTO_TCP:
+    {
+        struct pico_tcp_hdr *tcp = (struct pico_tcp_hdr *)f->transport_hdr;
+        tcp->crc = pico_checksum_adjust32(tcp->crc, old_addr, new_addr);
+        tcp->crc = pico_checksum_adjust16(tcp->crc, old_port, new_port);
+        break;
+    }
+#endif
+#ifdef PICO_SUPPORT_UDP
+    case PICO_PROTO_UDP:
+    {
+        struct pico_udp_hdr *udp = (struct pico_udp_hdr *)f->transport_hdr;
+        /* A zero UDP checksum means no checksum: leave it alone */
+        if (!udp->crc)
+            break;
+
+        udp->crc = pico_checksum_adjust32(udp->crc, old_addr, new_addr);
+        udp->crc = pico_checksum_adjust16(udp->crc, old_port, new_port);
+        if (!udp->crc)
+            udp->crc = 0xFFFF;
+
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+}
+
 int pico_ipv4_nat_inbound(struct pico_frame *f, struct pico_ip4 *link_addr)
 {
     struct pico_nat_tuple *tuple = NULL;
@@ -440,12 +480,10 @@ int pico_ipv4_nat_inbound(struct pico_frame *f, struct pico_ip4 *link_addr)
         if (!tuple)
             return -1;
 
-        /* replace dst IP and dst PORT */
+        /* replace dst IP and dst PORT, updating the CRCs */
+        pico_ipv4_nat_adjust_crc(f, net->dst.addr, tuple->src_addr.addr, trans->dport, tuple->src_port);
         net->dst = tuple->src_addr;
         trans->dport = tuple->src_port;
-        /* recalculate CRC */
-        tcp->crc = 0;
-        tcp->crc = short_be(pico_tcp_checksum_ipv4(f));
         break;
     }
 #endif
@@ -458,12 +496,10 @@ int pico_ipv4_nat_inbound(struct pico_frame *f, struct pico_ip4 *link_addr)
         if (!tuple)
             return -1;
 
-        /* replace dst IP and dst PORT */
+        /* replace dst IP and dst PORT, updating the CRCs */
+        pico_ipv4_nat_adjust_crc(f, net->dst.addr, tuple->src_addr.addr, trans->dport, tuple->src_port);
         net->dst = tuple->src_addr;
         trans->dport = tuple->src_port;
-        /* recalculate CRC */
-        udp->crc = 0;
-        udp->crc = short_be(pico_udp_checksum_ipv4(f));
         break;
     }
 #endif
@@ -477,8 +513,6 @@ int pico_ipv4_nat_inbound(struct pico_frame *f, struct pico_ip4 *link_addr)
     }
 
     pico_ipv4_nat_sniff_session(tuple, f, PICO_NAT_INBOUND);
-    net->crc = 0;
-    net->crc = short_be(pico_checksum(net, f->net_len));
 
     nat_dbg("NAT: inbound translation {dst.addr, dport}: {%08X,%u} -> {%08X,%u}\n",
             tuple->nat_addr.addr, short_be(tuple->nat_port), tuple->src_addr.addr, short_be(tuple->src_port));
@@ -505,12 +539,10 @@ int pico_ipv4_nat_outbound(struct pico_frame *f, struct pico_ip4 *link_addr)
         if (!tuple)
             tuple = pico_ipv4_nat_generate_tuple(f);
 
-        /* replace src IP and src PORT */
+        /* replace src IP and src PORT, updating the CRCs */
+        pico_ipv4_nat_adjust_crc(f, net->src.addr, tuple->nat_addr.addr, trans->sport, tuple->nat_port);
         net->src = tuple->nat_addr;
         trans->sport = tuple->nat_port;
-        /* recalculate CRC */
-        tcp->crc = 0;
-        tcp->crc = short_be(pico_tcp_checksum_ipv4(f));
         break;
     }
 #endif
@@ -523,12 +555,10 @@ int pico_ipv4_nat_outbound(struct pico_frame *f, struct pico_ip4 *link_addr)
         if (!tuple)
             tuple = pico_ipv4_nat_generate_tuple(f);
 
-        /* replace src IP and src PORT */
+        /* replace src IP and src PORT, updating the CRCs */
+        pico_ipv4_nat_adjust_crc(f, net->src.addr, tuple->nat_addr.addr, trans->sport, tuple->nat_port);
         net->src = tuple->nat_addr;
         trans->sport = tuple->nat_port;
-        /* recalculate CRC */
-        udp->crc = 0;
-        udp->crc = short_be(pico_udp_checksum_ipv4(f));
         break;
     }
 #endif
@@ -542,8 +572,6 @@ int pico_ipv4_nat_outbound(struct pico_frame *f, struct pico_ip4 *link_addr)
     }
 
     pico_ipv4_nat_sniff_session(tuple, f, PICO_NAT_OUTBOUND);
-    net->crc = 0;
-    net->crc = short_be(pico_checksum(net, f->net_len));
 
     nat_dbg("NAT: outbound translation {src.addr, sport}: {%08X,%u} -> {%08X,%u}\n",
             tuple->src_addr.addr, short_be(tuple->src_port), tuple->nat_addr.addr, short_be(tuple->nat_port));
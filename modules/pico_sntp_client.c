@@ -73,10 +73,10 @@ struct sntp_server_ns_cookie
 
 /* global variables */
 static uint16_t sntp_port = 123u;
-static struct pico_timeval server_time = {
+static PICO_TLS struct pico_timeval server_time = {
     0
 };
-static pico_time tick_stamp = 0ull;
+static PICO_TLS pico_time tick_stamp = 0ull;
 static union pico_address sntp_inaddr_any = {
     .ip6.addr = { 0 }
 };
@@ -32,6 +32,33 @@ int pico_getsockopt_tcp(struct pico_socket *s, int option, void *value)
         *(int *)value = PICO_SOCKET_GETOPT(s, PICO_SOCKET_OPT_TCPNODELAY);
         return 0;
     }
+    else if (option == PICO_TCP_CONGESTION) {
+        /* name of the congestion control algorithm */
+        return pico_tcp_get_congestion(s, (const char **)value);
+    }
+    else if (option == PICO_TCP_PACING) {
+        return pico_tcp_get_pacing(s, (int *)value);
+    }
+    else if (option == PICO_TCP_ZEROCOPY_RX) {
+        return pico_tcp_get_zerocopy_rx(s, (int *)value);
+    }
+    else if (option == PICO_TCP_PACING_STATS) {
+        /* current rate and time spent waiting for pacing slots */
+        return pico_tcp_get_pacing_stats(s, (struct pico_tcp_pacing_stats *)value);
+    }
+    else if (option == PICO_TCP_DELACK) {
+        return pico_tcp_get_delack(s, (int *)value);
+    }
+    else if (option == PICO_TCP_DELACK_TIMEOUT) {
+        return pico_tcp_get_delack_timeout(s, (uint32_t *)value);
+    }
+    else if (option == PICO_TCP_FASTOPEN) {
+        return pico_tcp_get_fastopen(s, (int *)value);
+    }
+    else if (option == PICO_TCP_INFO) {
+        /* connection state and counters, struct pico_tcp_info */
+        return pico_tcp_get_info(s, (struct pico_tcp_info *)value);
+    }
     else if (option == PICO_SOCKET_OPT_RCVBUF) {
         return pico_tcp_get_bufsize_in(s, (uint32_t *)value);
     }
@@ -66,6 +93,29 @@ int pico_setsockopt_tcp(struct pico_socket *s, int option, void *value)
         tcp_set_nagle_option(s, value);
         return 0;
     }
+    else if (option == PICO_TCP_CONGESTION) {
+        /* value points to the algorithm name, e.g. "reno" or "cubic" */
+        return pico_tcp_set_congestion(s, *(const char **)value);
+    }
+    else if (option == PICO_TCP_PACING) {
+        return pico_tcp_set_pacing(s, *(int *)value);
+    }
+    else if (option == PICO_TCP_ZEROCOPY_RX) {
+        /* in-order segments keep a reference to the received frame */
+        return pico_tcp_set_zerocopy_rx(s, *(int *)value);
+    }
+    else if (option == PICO_TCP_DELACK) {
+        /* 0: acknowledge every segment, 1: delayed ACKs */
+        return pico_tcp_set_delack(s, *(int *)value);
+    }
+    else if (option == PICO_TCP_DELACK_TIMEOUT) {
+        /* longest delay of an ACK, ms */
+        return pico_tcp_set_delack_timeout(s, *(uint32_t *)value);
+    }
+    else if (option == PICO_TCP_FASTOPEN) {
+        /* data on the SYN: before connect(), or on a listener */
+        return pico_tcp_set_fastopen(s, *(int *)value);
+    }
     else if (option == PICO_SOCKET_OPT_RCVBUF) {
         uint32_t *val = (uint32_t*)value;
         pico_tcp_set_bufsize_in(s, *val);
@@ -202,6 +252,13 @@ int pico_socket_tcp_deliver(struct pico_sockport *sp, struct pico_frame *f)
     struct pico_tree_node *_tmp;
     struct pico_socket *s = NULL;
 
+#ifdef PICO_SUPPORT_FLOW_TABLE
+    /* Established connections: exact match, whatever the number of sockets */
+    target = pico_socket_flow_find(PICO_PROTO_TCP, f);
+    if (target)
+        return socket_tcp_do_deliver(target, f);
+
+#endif
     pico_tree_foreach_safe(index, &sp->socks, _tmp){
         s = index->keyValue;
         /* 4-tuple identification of socket (port-IP) */
@@ -222,6 +279,12 @@ int pico_socket_tcp_deliver(struct pico_sockport *sp, struct pico_frame *f)
         }
     } /* FOREACH */
 
+#ifdef PICO_SUPPORT_TCP_TIMEWAIT
+    /* Connections in TIME_WAIT no longer have a socket */
+    if ((!target || !target->remote_port) && (pico_tcp_timewait_input(f) == 0))
+        return 0;
+
+#endif
     return socket_tcp_do_deliver(target, f);
 }
 
@@ -262,6 +325,20 @@ int pico_socket_tcp_read(struct pico_socket *s, void *buf, uint32_t len)
 #endif
 }
 
+int pico_socket_tcp_read_zerocopy(struct pico_socket *s, struct pico_zerocopy_chunk *chunks, int max)
+{
+#ifdef PICO_SUPPORT_TCP
+    if ((s->state & PICO_SOCKET_STATE_SHUT_REMOTE) && pico_tcp_queue_in_is_empty(s)) {
+        pico_err = PICO_ERR_ESHUTDOWN;
+        return -1;
+    }
+
+    return pico_tcp_read_zerocopy(s, chunks, max);
+#else
+    return 0;
+#endif
+}
+
 void transport_flags_update(struct pico_frame *f, struct pico_socket *s)
 {
 #ifdef PICO_SUPPORT_TCP
@@ -194,6 +194,21 @@ int pico_socket_udp_deliver(struct pico_sockport *sp, struct pico_frame *f)
     pico_err = PICO_ERR_EPROTONOSUPPORT;
     #ifdef PICO_SUPPORT_UDP
     pico_err = PICO_ERR_NOERR;
+#ifdef PICO_SUPPORT_FLOW_TABLE
+    /* Datagram to a connected socket: exact match first */
+    s = pico_socket_flow_find(PICO_PROTO_UDP, f);
+#ifdef PICO_SUPPORT_IPV4
+    if (s && IS_IPV4(f))
+        return pico_socket_udp_deliver_ipv4(s, f);
+
+#endif
+#ifdef PICO_SUPPORT_IPV6
+    if (s && IS_IPV6(f))
+        return pico_socket_udp_deliver_ipv6(s, f);
+
+#endif
+
+#endif
     pico_tree_foreach_safe(index, &sp->socks, _tmp){
         s = index->keyValue;
         if (IS_IPV4(f)) { /* IPV4 */
@@ -14,8 +14,10 @@
 #include "pico_stack.h"
 #include "pico_socket.h"
 #include "pico_socket_tcp.h"
+#include "pico_tcp_cc.h"
 #include "pico_queue.h"
 #include "pico_tree.h"
+#include "pico_6lowpan.h"
 
 #define TCP_IS_STATE(s, st) ((s->state & PICO_SOCKET_STATE_TCP) == st)
 #define TCP_SOCK(s) ((struct pico_socket_tcp *)s)
@@ -26,10 +28,131 @@
 
 #define PICO_TCP_RTO_MIN (70)
 #define PICO_TCP_RTO_MAX (120000)
-#define PICO_TCP_IW          2
+/* G of RTO = SRTT + max(G, 4 * RTTVAR): on a path with a steady RTT, an ACK
+ * held back a little by the peer must not look like a loss. 0 leaves it out. */
+#ifndef PICO_TCP_RTO_G
+#define PICO_TCP_RTO_G   40u
+#endif
+#define TCP_RTO_VAR(t)   ((((t)->rttvar << 2) > PICO_TCP_RTO_G) ? ((t)->rttvar << 2) : PICO_TCP_RTO_G)
 #define PICO_TCP_SYN_TO  2000u
 #define PICO_TCP_ZOMBIE_TO 30000
 
+/* Pacing: rate = gain * cwnd / srtt, gain in percent, released in slots of
+ * PICO_TCP_PACING_SLOT ms. */
+#ifndef PICO_TCP_PACING_DEFAULT
+#define PICO_TCP_PACING_DEFAULT  0
+#endif
+#ifndef PICO_TCP_PACING_SS_GAIN
+#define PICO_TCP_PACING_SS_GAIN  200u
+#endif
+#ifndef PICO_TCP_PACING_CA_GAIN
+#define PICO_TCP_PACING_CA_GAIN  120u
+#endif
+#ifndef PICO_TCP_PACING_SLOT
+#define PICO_TCP_PACING_SLOT     1u
+#endif
+
+/* GSO: payload of the largest super-segment queued at once. It is cut in
+ * MSS-sized packets just before the device. */
+#ifndef PICO_TCP_GSO_MAX
+#define PICO_TCP_GSO_MAX         65000u
+#endif
+
+/* GRO: payload of the largest segment merged from received ones */
+#ifndef PICO_TCP_GRO_MAX
+#define PICO_TCP_GRO_MAX         65000u
+#endif
+
+/* Delayed ACKs (RFC 1122, RFC 5681): in-order data is acknowledged every
+ * second full segment, or PICO_TCP_DELACK_TIMEOUT ms after it arrived. The
+ * first PICO_TCP_QUICKACKS segments of a connection, and those that follow
+ * out-of-order data, are acknowledged at once while the sender is in slow
+ * start or recovery. Off unless enabled per socket (PICO_TCP_DELACK): Reno
+ * grows its window per ACK rather than per byte acknowledged, so a peer
+ * running it would open its window half as fast. */
+#ifndef PICO_TCP_DELACK_DEFAULT
+#define PICO_TCP_DELACK_DEFAULT  0
+#endif
+#ifndef PICO_TCP_DELACK_TIMEOUT
+#define PICO_TCP_DELACK_TIMEOUT  40u
+#endif
+#define PICO_TCP_DELACK_TIMEOUT_MAX 500u
+#ifndef PICO_TCP_QUICKACKS
+#define PICO_TCP_QUICKACKS       16u
+#endif
+
+/* Loss recovery with SACK (RFC 6675) and RACK-TLP (RFC 8985): a segment is
+ * lost once PICO_TCP_DUPTHRESH segments above it are SACKed, or once it is
+ * overdue by a quarter of the minimum RTT compared to a segment sent after it
+ * that was delivered. A tail loss probe goes out after two smoothed RTTs
+ * without ACKs, plus PICO_TCP_TLP_DELACK if a single segment is in flight. */
+#define PICO_TCP_DUPTHRESH       3u
+#ifndef PICO_TCP_TLP_MIN
+#define PICO_TCP_TLP_MIN         10u
+#endif
+#ifndef PICO_TCP_TLP_DELACK
+#define PICO_TCP_TLP_DELACK      200u
+#endif
+
+/* Half-open connections (RFC 4987): with PICO_SUPPORT_TCP_HALFOPEN, a SYN to
+ * a listener only takes an entry in a small hash table until the final ACK of
+ * the handshake arrives, and expires with it after PICO_SOCKET_BOUND_TIMEOUT
+ * ms. Otherwise it clones the listener at once. Past the backlog, the SYN-ACK
+ * carries a SYN cookie instead if PICO_SUPPORT_TCP_SYNCOOKIES. */
+#ifndef PICO_TCP_HALFOPEN_BUCKETS
+#define PICO_TCP_HALFOPEN_BUCKETS 64u
+#endif
+#ifndef PICO_TCP_HALFOPEN_SWEEP
+#define PICO_TCP_HALFOPEN_SWEEP   1000u
+#endif
+
+#ifdef PICO_SUPPORT_TCP_TIMEWAIT
+/* TIME_WAIT: a connection closed on our side is kept as a small record in a
+ * hash table for the linger timeout of its socket, which is released at once.
+ * Expired records are dropped every PICO_TCP_TIMEWAIT_SWEEP ms. */
+#ifndef PICO_TCP_TIMEWAIT_MIN_BUCKETS
+#define PICO_TCP_TIMEWAIT_MIN_BUCKETS 64u
+#endif
+#ifndef PICO_TCP_TIMEWAIT_SWEEP
+#define PICO_TCP_TIMEWAIT_SWEEP   500u
+#endif
+#endif
+
+/* TCP Fast Open (RFC 7413): a listener hands out cookies bound to the address
+ * of the client, and takes the data of a SYN that comes back with one. A
+ * client remembers the cookies of its last PICO_TCP_FASTOPEN_CACHE servers. */
+#ifndef PICO_TCP_FASTOPEN_CACHE
+#define PICO_TCP_FASTOPEN_CACHE   8u
+#endif
+#define TCP_FASTOPEN_COOKIE       8u
+#define TCP_FASTOPEN_COOKIE_MAX   16u
+#define TCP_FASTOPEN_ON           0x01u /* PICO_TCP_FASTOPEN set */
+#define TCP_FASTOPEN_CHILD        0x02u /* accepted with the data of its SYN */
+
+/* Buffer autotuning: the receive queue grows to twice what the application
+ * read in the last round trip (dynamic right-sizing), the send queue to twice
+ * the congestion window, up to PICO_TCP_RMEM_MAX and PICO_TCP_WMEM_MAX. What
+ * all connections take beyond PICO_DEFAULT_SOCKETQ is bounded by
+ * PICO_TCP_AUTOTUNE_MEM. A size set by the application is left alone. */
+#ifndef PICO_TCP_RMEM_MAX
+#define PICO_TCP_RMEM_MAX         (64u * PICO_DEFAULT_SOCKETQ)
+#endif
+#ifndef PICO_TCP_WMEM_MAX
+#define PICO_TCP_WMEM_MAX         (64u * PICO_DEFAULT_SOCKETQ)
+#endif
+#ifndef PICO_TCP_AUTOTUNE_MEM
+#define PICO_TCP_AUTOTUNE_MEM     (128u * PICO_DEFAULT_SOCKETQ)
+#endif
+#define TCP_AUTOTUNE_RCV          0x01u
+#define TCP_AUTOTUNE_SND          0x02u
+#define TCP_AUTOTUNE_SND_FULL     0x04u /* a write did not fit in the send queue */
+#define TCP_AUTOTUNE_SSTHRESH     0x08u /* no loss yet: ssthresh follows the send queue */
+#ifdef PICO_SUPPORT_TCP_AUTOTUNE
+#define TCP_AUTOTUNE_DEFAULT      (TCP_AUTOTUNE_RCV | TCP_AUTOTUNE_SND)
+#else
+#define TCP_AUTOTUNE_DEFAULT      0u
+#endif
+
 #define PICO_TCP_MAX_RETRANS         10
 #define PICO_TCP_MAX_CONNECT_RETRIES 3
 
@@ -49,6 +172,11 @@
 #define IS_TCP_HOLDQ_EMPTY(t)   (t->tcpq_hold.size == 0)
 
 #define IS_INPUT_QUEUE(q)  (q->pool.compare == input_segment_compare)
+
+/* Scoreboard state of the segments in tcpq_out */
+#define TCP_SEG_RETRANS 0x01u   /* retransmitted since it was last marked lost */
+#define TCP_SEG_LOST    0x02u   /* waiting for retransmission */
+#define TCP_SEG_FLAGS(f) ((f)->scoreboard)
 #define TCP_INPUT_OVERHEAD (sizeof(struct tcp_input_segment) + sizeof(struct pico_tree_node))
 
 
@@ -79,12 +207,19 @@ static void *Mutex = NULL;
 
 
 /* Input segment, used to keep only needed data, not the full frame */
+struct pico_socket_tcp;
+
 struct tcp_input_segment
 {
     uint32_t seq;
     /* Pointer to payload */
     unsigned char *payload;
     uint16_t payload_len;
+    /* Zero-copy receive: reference to the frame holding the payload */
+    struct pico_frame *frame;
+    /* Handed out to the application: still charged to the owner's window */
+    struct pico_socket_tcp *owner;
+    struct tcp_input_segment *held_next;
 };
 
 /* Function to compare input segments */
@@ -94,57 +229,236 @@ static int input_segment_compare(void *ka, void *kb)
     return pico_seq_compare(a->seq, b->seq);
 }
 
-static struct tcp_input_segment *segment_from_frame(struct pico_frame *f)
+/* Segment with len bytes of the payload of f from offset off, copied out of
+ * the frame and the frames chained to it */
+static struct tcp_input_segment *segment_from_frame_at(struct pico_frame *f, uint16_t off, uint16_t len)
 {
     struct tcp_input_segment *seg;
+    struct pico_frame *c = f->chain;
+    uint8_t *src = f->payload;
+    uint32_t n = (uint32_t)f->payload_len - pico_frame_total_len(f->chain);
+    uint32_t done = 0;
 
-    if (!f->payload_len)
+    if (!len || ((uint32_t)off + len > f->payload_len))
         return NULL;
 
     seg = PICO_ZALLOC(sizeof(struct tcp_input_segment));
     if (!seg)
         return NULL;
 
-    seg->payload = PICO_ZALLOC(f->payload_len);
+    seg->payload_len = len;
+    seg->payload = PICO_ZALLOC(seg->payload_len);
     if(!seg->payload)
     {
         PICO_FREE(seg);
         return NULL;
     }
 
+    seg->seq = SEQN(f) + off;
+    while (done < seg->payload_len) {
+        if (off < n) {
+            if (n - off > (uint32_t)seg->payload_len - done)
+                n = (uint32_t)seg->payload_len - done + off;
+
+            memcpy(seg->payload + done, src + off, n - off);
+            done += n - off;
+            off = 0;
+        } else {
+            off = (uint16_t)(off - n);
+        }
+
+        if (!c)
+            break;
+
+        src = c->start;
+        n = c->len;
+        c = c->chain;
+    }
+    return seg;
+}
+
+static struct tcp_input_segment *segment_from_frame(struct pico_frame *f)
+{
+    return segment_from_frame_at(f, 0, f->payload_len);
+}
+
+/* Same as segment_from_frame(), but the payload stays in the frame buffer */
+static struct tcp_input_segment *segment_ref_frame(struct pico_frame *f)
+{
+    struct tcp_input_segment *seg;
+
+    /* Chained payloads are not contiguous: take a copy instead */
+    if (!f->payload_len || f->chain)
+        return segment_from_frame(f);
+
+    seg = PICO_ZALLOC(sizeof(struct tcp_input_segment));
+    if (!seg)
+        return NULL;
+
+    seg->frame = pico_frame_copy(f);
+    if (!seg->frame) {
+        PICO_FREE(seg);
+        return NULL;
+    }
+
     seg->seq = SEQN(f);
     seg->payload_len = f->payload_len;
-    memcpy(seg->payload, f->payload, seg->payload_len);
+    seg->payload = f->payload;
     return seg;
 }
 
+static void segment_free(struct tcp_input_segment *seg)
+{
+    if (seg->frame)
+        pico_frame_discard(seg->frame);
+    else
+        PICO_FREE(seg->payload);
+
+    PICO_FREE(seg);
+}
+
 static int segment_compare(void *ka, void *kb)
 {
     struct pico_frame *a = ka, *b = kb;
     return pico_seq_compare(SEQN(a), SEQN(b));
 }
 
+/* The input queue keeps its segments in a tree. The output and hold
+ * queues keep their frames in a ring of pointers, in sequence order: the
+ * sender only appends at the tail and releases from the head, so both are
+ * O(1), and the sequence order leaves a binary search for SACK blocks.
+ */
 struct pico_tcp_queue
 {
     struct pico_tree pool;
+    struct pico_frame **ring;
+    uint32_t ring_size;     /* slots, a power of two */
+    uint32_t head;          /* slot of the first frame */
+    uint32_t cursor;        /* position of the last frame looked up */
     uint32_t max_size;
     uint32_t size;
     uint32_t frames;
+    /* Output queue scoreboard, in packets */
+    uint32_t sacked;        /* SACKed */
+    uint32_t lost;          /* waiting for retransmission */
+    uint32_t retrans;       /* retransmitted and not SACKed */
 };
 
+#ifndef PICO_TCP_RING_MIN
+#define PICO_TCP_RING_MIN 16u
+#endif
+
+/* Frame at position pos (0 is the first) of an output queue */
+#define TCP_RING_AT(tq, pos) ((tq)->ring[((tq)->head + (pos)) & ((tq)->ring_size - 1u)])
+
+#define tcp_ring_foreach(tq, pos, f) \
+    for ((pos) = 0; ((pos) < (tq)->frames) && (((f) = TCP_RING_AT(tq, pos)) != NULL); (pos)++)
+
+#define tcp_ring_foreach_reverse(tq, pos, f) \
+    for ((pos) = (tq)->frames; ((pos)-- > 0) && (((f) = TCP_RING_AT(tq, pos)) != NULL); )
+
+/* Position of the first frame that does not start before seq */
+static uint32_t tcp_ring_search(struct pico_tcp_queue *tq, uint32_t seq)
+{
+    uint32_t lo = 0, hi = tq->frames, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (pico_seq_compare(SEQN(TCP_RING_AT(tq, mid)), seq) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int tcp_ring_grow(struct pico_tcp_queue *tq)
+{
+    uint32_t size = tq->ring_size ? (tq->ring_size << 1) : PICO_TCP_RING_MIN;
+    struct pico_frame **ring;
+    uint32_t i;
+
+    ring = PICO_ZALLOC(size * sizeof(struct pico_frame *));
+    if (!ring)
+        return -1;
+
+    for (i = 0; i < tq->frames; i++)
+        ring[i] = TCP_RING_AT(tq, i);
+    if (tq->ring)
+        PICO_FREE(tq->ring);
+
+    tq->ring = ring;
+    tq->ring_size = size;
+    tq->head = 0;
+    return 0;
+}
+
+static int tcp_ring_insert(struct pico_tcp_queue *tq, struct pico_frame *f)
+{
+    uint32_t pos = tq->frames, i;
+
+    /* Anything but an append (a split segment) shifts the tail */
+    if (pos && (pico_seq_compare(SEQN(TCP_RING_AT(tq, pos - 1)), SEQN(f)) >= 0)) {
+        pos = tcp_ring_search(tq, SEQN(f));
+        if (SEQN(TCP_RING_AT(tq, pos)) == SEQN(f))
+            return -1;
+    }
+
+    if ((tq->frames == tq->ring_size) && (tcp_ring_grow(tq) < 0))
+        return -1;
+
+    for (i = tq->frames; i > pos; i--)
+        TCP_RING_AT(tq, i) = TCP_RING_AT(tq, i - 1);
+    TCP_RING_AT(tq, pos) = f;
+    return 0;
+}
+
+static struct pico_frame *tcp_ring_remove(struct pico_tcp_queue *tq, struct pico_frame *f)
+{
+    uint32_t pos = 0, i;
+
+    if (!tq->frames)
+        return NULL;
+
+    if (TCP_RING_AT(tq, 0) == f) {
+        tq->head = (tq->head + 1u) & (tq->ring_size - 1u);
+        if (tq->cursor)
+            tq->cursor--;
+
+        return f;
+    }
+
+    pos = tcp_ring_search(tq, SEQN(f));
+    if ((pos >= tq->frames) || (SEQN(TCP_RING_AT(tq, pos)) != SEQN(f)))
+        return NULL;
+
+    f = TCP_RING_AT(tq, pos);
+    for (i = pos; i + 1 < tq->frames; i++)
+        TCP_RING_AT(tq, i) = TCP_RING_AT(tq, i + 1);
+    return f;
+}
+
+/* Walks in sequence order look the next frame up right after the cursor */
+static struct pico_frame *tcp_ring_peek(struct pico_tcp_queue *tq, uint32_t seq)
+{
+    uint32_t pos = tq->cursor + 1u;
+
+    if ((pos >= tq->frames) || (SEQN(TCP_RING_AT(tq, pos)) != seq)) {
+        pos = tcp_ring_search(tq, seq);
+        if ((pos >= tq->frames) || (SEQN(TCP_RING_AT(tq, pos)) != seq))
+            return NULL;
+    }
+
+    tq->cursor = pos;
+    return TCP_RING_AT(tq, pos);
+}
+
 static void tcp_discard_all_segments(struct pico_tcp_queue *tq);
 static void *peek_segment(struct pico_tcp_queue *tq, uint32_t seq)
 {
     if(!IS_INPUT_QUEUE(tq))
     {
-        struct pico_tcp_hdr H;
-        struct pico_frame f = {
-            0
-        };
-        f.transport_hdr = (uint8_t *) (&H);
-        H.seq = long_be(seq);
-
-        return pico_tree_findKey(&tq->pool, &f);
+        return tcp_ring_peek(tq, seq);
     }
     else
     {
@@ -160,6 +474,9 @@ static void *peek_segment(struct pico_tcp_queue *tq, uint32_t seq)
 
 static void *first_segment(struct pico_tcp_queue *tq)
 {
+    if (!IS_INPUT_QUEUE(tq))
+        return tq->frames ? TCP_RING_AT(tq, 0) : NULL;
+
     return pico_tree_first(&tq->pool);
 }
 
@@ -178,12 +495,62 @@ static void *next_segment(struct pico_tcp_queue *tq, void *cur)
     }
 }
 
+/* Memory held by an output segment, including the application data a
+ * zero-copy frame refers to.
+ */
+static uint16_t output_segment_len(struct pico_frame *f)
+{
+    return (uint16_t)(f->buffer_len + pico_frame_total_len(f->chain));
+}
+
+/* Number of packets an output segment goes out as */
+static uint16_t output_segment_packets(struct pico_frame *f)
+{
+#ifdef PICO_SUPPORT_TCP_GSO
+    if (f->gso_size && (f->payload_len > f->gso_size))
+        return (uint16_t)((f->payload_len + f->gso_size - 1u) / f->gso_size);
+
+#endif
+    (void)f;
+    return 1;
+}
+
+/* Scoreboard counter an output segment is accounted in, if any */
+static uint32_t *tcp_scoreboard_counter(struct pico_tcp_queue *tq, struct pico_frame *f)
+{
+    if (f->flags & PICO_FRAME_FLAG_SACKED)
+        return &tq->sacked;
+
+    if (TCP_SEG_FLAGS(f) & TCP_SEG_LOST)
+        return &tq->lost;
+
+    if (TCP_SEG_FLAGS(f) & TCP_SEG_RETRANS)
+        return &tq->retrans;
+
+    return NULL;
+}
+
+static void tcp_scoreboard_add(struct pico_tcp_queue *tq, struct pico_frame *f)
+{
+    uint32_t *cnt = tcp_scoreboard_counter(tq, f);
+    if (cnt)
+        *cnt += output_segment_packets(f);
+}
+
+static void tcp_scoreboard_sub(struct pico_tcp_queue *tq, struct pico_frame *f)
+{
+    uint32_t *cnt = tcp_scoreboard_counter(tq, f);
+    uint16_t packets = output_segment_packets(f);
+    if (cnt)
+        *cnt = (*cnt > packets) ? (*cnt - packets) : 0;
+}
+
 static uint16_t enqueue_segment_len(struct pico_tcp_queue *tq, void *f)
 {
     if (IS_INPUT_QUEUE(tq)) {
         return ((struct tcp_input_segment *)f)->payload_len;
     } else {
-        return (uint16_t)(((struct pico_frame *)f)->buffer_len);
+        return output_segment_len((struct pico_frame *)f);
     }
 }
 
@@ -198,7 +565,7 @@ static int32_t do_enqueue_segment(struct pico_tcp_queue *tq, void *f, uint16_t p
         goto out;
     }
 
-    if (pico_tree_insert(&tq->pool, f) != 0)
+    if (IS_INPUT_QUEUE(tq) ? (pico_tree_insert(&tq->pool, f) != 0) : (tcp_ring_insert(tq, f) != 0))
     {
         ret = 0;
         goto out;
@@ -208,6 +575,9 @@ static int32_t do_enqueue_segment(struct pico_tcp_queue *tq, void *f, uint16_t p
     if (payload_len > 0)
         tq->frames++;
 
+    if (!IS_INPUT_QUEUE(tq))
+        tcp_scoreboard_add(tq, (struct pico_frame *)f);
+
     ret = (int32_t)payload_len;
 
 out:
@@ -233,26 +603,35 @@ static int32_t pico_enqueue_segment(struct pico_tcp_queue *tq, void *f)
     return do_enqueue_segment(tq, f, payload_len);
 }
 
-static void pico_discard_segment(struct pico_tcp_queue *tq, void *f)
+/* Remove a segment from the queue without freeing it */
+static void *pico_unlink_segment(struct pico_tcp_queue *tq, void *f)
 {
     void *f1;
-    uint16_t payload_len = (uint16_t)((IS_INPUT_QUEUE(tq)) ?
-                                      (((struct tcp_input_segment *)f)->payload_len) :
-                                      (((struct pico_frame *)f)->buffer_len));
-    PICOTCP_MUTEX_LOCK(Mutex);
-    f1 = pico_tree_delete(&tq->pool, f);
+    uint16_t payload_len = enqueue_segment_len(tq, f);
+    if (IS_INPUT_QUEUE(tq))
+        f1 = pico_tree_delete(&tq->pool, f);
+    else
+        f1 = tcp_ring_remove(tq, f);
+
     if (f1) {
         tq->size -= (uint16_t)payload_len;
         if (payload_len > 0)
             tq->frames--;
+
+        if (!IS_INPUT_QUEUE(tq))
+            tcp_scoreboard_sub(tq, (struct pico_frame *)f1);
     }
 
+    return f1;
+}
+
+static void pico_discard_segment(struct pico_tcp_queue *tq, void *f)
+{
+    void *f1;
+    PICOTCP_MUTEX_LOCK(Mutex);
+    f1 = pico_unlink_segment(tq, f);
     if(f1 && IS_INPUT_QUEUE(tq))
-    {
-        struct tcp_input_segment *inp = f1;
-        PICO_FREE(inp->payload);
-        PICO_FREE(inp);
-    }
+        segment_free(f1);
     else
         pico_frame_discard(f);
 
@@ -289,11 +668,52 @@ struct pico_socket_tcp {
     uint32_t retrans_tmr;
     pico_time retrans_tmr_due;
     uint16_t cwnd_counter;
-    uint16_t cwnd;
-    uint16_t ssthresh;
+    uint32_t cwnd;      /* segments, derived from cc.cwnd */
+    struct pico_tcp_cc cc;
+
+    /* zero-copy receive */
+    uint8_t zerocopy_rx;
+    struct tcp_input_segment *rcv_held_list; /* chunks the application holds */
+    uint32_t rcv_held;                       /* and their bytes */
+
+    /* pacing */
+    uint8_t pacing;
+    uint32_t pacing_tmr;
+    uint32_t pacing_rate;   /* bytes per second, 0 if not paced */
+    uint32_t pacing_tokens; /* bytes allowed out in the current slot */
+    pico_time pacing_stamp; /* last token refill */
+    pico_time pacing_wait;  /* output held back since, 0 if not */
+    uint32_t pacing_holds;
+    uint64_t pacing_delay;  /* total time output was held back, ms */
     uint16_t recv_wnd;
     uint16_t recv_wnd_scale;
 
+    /* delayed ACK */
+    uint8_t delack;
+    uint8_t quickack;       /* segments still acknowledged at once */
+    uint32_t delack_tmr;
+    uint32_t delack_timeout;
+
+    /* SACK recovery and RACK-TLP */
+    uint32_t snd_recover;   /* snd_nxt when loss recovery started */
+    uint32_t tlp_high;      /* snd_nxt when the tail loss probe went out */
+    pico_time rack_xmit_ts; /* send time of the most recently delivered segment */
+    uint32_t rack_end;      /* end of that segment */
+    uint32_t rack_rtt;
+    uint32_t rack_min_rtt;
+    uint32_t rack_tmr;
+    pico_time rack_tmr_due;
+    uint8_t rack_tlp;       /* rack_tmr is a probe timeout, not a reordering one */
+    uint32_t rack_hint;     /* segments before it are all SACKed or lost */
+    uint32_t lost_hint;     /* no segment before it waits for retransmission */
+    uint32_t sack_mark;     /* the scoreboard has marked the segments before it */
+    uint32_t sack_high;     /* end of the highest segment SACKed or lost */
+    uint8_t sack_fresh;     /* segments were SACKed since the scoreboard ran */
+    uint32_t delivered;     /* segments acknowledged or SACKed by this ACK */
+    uint32_t prr_delivered;
+    uint32_t prr_out;
+    uint32_t prr_recover_fs;
+
     /* tcp_input */
     uint32_t rcv_nxt;
     uint32_t rcv_ackd;
@@ -313,6 +733,17 @@ struct pico_socket_tcp {
     uint8_t jumbo;
     uint32_t linger_timeout;
 
+    /* Fast Open */
+    uint8_t fastopen;       /* TCP_FASTOPEN_* */
+    uint16_t syn_data;      /* payload on the SYN, ours or the peer's */
+
+    /* buffer autotuning */
+    uint8_t autotune;       /* TCP_AUTOTUNE_*: queues still sized by the stack */
+    uint8_t rcv_wscale;     /* window shift announced on our SYN */
+    uint32_t rcv_rtt;       /* from the timestamps echoed by the peer, ms */
+    uint32_t rcv_space_seq; /* rcv_processed at the start of the round trip */
+    pico_time rcv_space_stamp;
+
     /* Transmission */
     uint8_t x_mode;
     uint8_t dupacks;
@@ -329,15 +760,27 @@ struct pico_socket_tcp {
 
     /* FIN timer */
     uint32_t fin_tmr;
+
+    /* PICO_TCP_INFO counters */
+    uint32_t segs_out;
+    uint32_t segs_in;
+    uint64_t bytes_out;
+    uint64_t bytes_in;
+    uint32_t retrans;
+    uint32_t fast_retrans;
+    uint32_t rto_events;
+    uint32_t ooo_segs;
+    uint32_t zero_wnd_local;
+    uint32_t zero_wnd_remote;
+    uint8_t limited;            /* TCP_LIMITED_*: what output waits for */
+    pico_time limited_since;
+    uint64_t cwnd_limited;      /* ms */
+    uint64_t rwnd_limited;      /* ms */
 };
 
 /* Queues */
-static struct pico_queue tcp_in = {
-    0
-};
-static struct pico_queue tcp_out = {
-    0
-};
+PICO_PROTO_QUEUE_DECLARE(tcp_in);
+PICO_PROTO_QUEUE_DECLARE(tcp_out);
 
 /* If Nagle enabled, this function can make 1 new segment from smaller segments in hold queue */
 static struct pico_frame *pico_hold_segment_make(struct pico_socket_tcp *t);
@@ -388,15 +831,12 @@ static int release_until(struct pico_tcp_queue *q, uint32_t seq)
 static int release_all_until(struct pico_tcp_queue *q, uint32_t seq, pico_time *timestamp)
 {
     void *f = NULL;
-    struct pico_tree_node *idx, *temp;
     int seq_result;
     int ret = 0;
     *timestamp = 0;
 
-    pico_tree_foreach_safe(idx, &q->pool, temp)
+    while ((f = first_segment(q)) != NULL)
     {
-        f = idx->keyValue;
-
         if (IS_INPUT_QUEUE(q))
             seq_result = pico_seq_compare(((struct tcp_input_segment *)f)->seq + ((struct tcp_input_segment *)f)->payload_len, seq);
         else
@@ -404,11 +844,16 @@ static int release_all_until(struct pico_tcp_queue *q, uint32_t seq, pico_time *
 
         if (seq_result <= 0) {
             tcp_dbg("Releasing %p\n", f);
-            if ((seq_result == 0) && !IS_INPUT_QUEUE(q))
-                *timestamp = ((struct pico_frame *)f)->timestamp;
+            if (IS_INPUT_QUEUE(q)) {
+                ret++;
+            } else {
+                if (seq_result == 0)
+                    *timestamp = ((struct pico_frame *)f)->timestamp;
+
+                ret += output_segment_packets((struct pico_frame *)f);
+            }
 
             pico_discard_segment(q, f);
-            ret++;
         } else {
             return ret;
         }
@@ -442,7 +887,7 @@ uint16_t pico_tcp_checksum_ipv4(struct pico_frame *f)
     pseudo.proto = PICO_PROTO_TCP;
     pseudo.len = (uint16_t)short_be(f->transport_len);
 
-    return pico_dualbuffer_checksum(&pseudo, sizeof(struct pico_ipv4_pseudo_hdr), tcp_hdr, f->transport_len);
+    return pico_frame_dualbuffer_checksum(&pseudo, sizeof(struct pico_ipv4_pseudo_hdr), f, tcp_hdr, f->transport_len);
 }
 
 #ifdef PICO_SUPPORT_IPV6
@@ -471,7 +916,7 @@ uint16_t pico_tcp_checksum_ipv6(struct pico_frame *f)
     pseudo.len = long_be(f->transport_len);
     pseudo.nxthdr = PICO_PROTO_TCP;
 
-    return pico_dualbuffer_checksum(&pseudo, sizeof(struct pico_ipv6_pseudo_hdr), tcp_hdr, f->transport_len);
+    return pico_frame_dualbuffer_checksum(&pseudo, sizeof(struct pico_ipv6_pseudo_hdr), f, tcp_hdr, f->transport_len);
 }
 #endif
 
@@ -532,27 +977,36 @@ static int pico_tcp_process_out(struct pico_protocol *self, struct pico_frame *f
         tcp_dbg("%s: non-pure ACK with len=0, fl:%04x\n", __FUNCTION__, hdr->flags);
     }
 
+    t->segs_out += output_segment_packets(f);
+    t->bytes_out += f->payload_len;
     pico_network_send(f);
     return 0;
 }
 
 int pico_tcp_push(struct pico_protocol *self, struct pico_frame *data);
+#ifdef PICO_SUPPORT_TCP_GRO
+static int pico_tcp_process_in(struct pico_protocol *self, struct pico_frame *f);
+#endif
 
 /* Interface: protocol definition */
-struct pico_protocol pico_proto_tcp = {
+PICO_TLS struct pico_protocol pico_proto_tcp = {
     .name = "tcp",
     .proto_number = PICO_PROTO_TCP,
     .layer = PICO_LAYER_TRANSPORT,
+#ifdef PICO_SUPPORT_TCP_GRO
+    .process_in = pico_tcp_process_in,
+#else
     .process_in = pico_transport_process_in,
+#endif
     .process_out = pico_tcp_process_out,
     .push = pico_tcp_push,
-    .q_in = &tcp_in,
-    .q_out = &tcp_out,
+    .q_in = PICO_PROTO_QUEUE(tcp_in),
+    .q_out = PICO_PROTO_QUEUE(tcp_out),
 };
 
 static uint32_t pico_paws(void)
 {
-    static uint32_t _paws = 0;
+    static PICO_TLS uint32_t _paws = 0;
     _paws = pico_rand();
     return long_be(_paws);
 }
@@ -668,8 +1122,12 @@ static inline void tcp_set_space_check_winupdate(struct pico_socket_tcp *t, int3
         t->wnd = (uint16_t)space;
         t->wnd_scale = (uint16_t)shift;
 
-        if(t->wnd == 0) /* mark the entering to zero window state */
+        if(t->wnd == 0) { /* mark the entering to zero window state */
+            if (!t->localZeroWindow)
+                t->zero_wnd_local++;
+
             t->localZeroWindow = 1u;
+        }
         else if(t->localZeroWindow)
         {
             t->localZeroWindow = 0u;
@@ -681,17 +1139,23 @@ static inline void tcp_set_space_check_winupdate(struct pico_socket_tcp *t, int3
 static void tcp_set_space(struct pico_socket_tcp *t)
 {
     int32_t space;
-    uint32_t shift = 0;
+    uint32_t shift = t->rcv_wscale;
 
     if (t->tcpq_in.max_size == 0) {
         space = ONE_GIGABYTE;
     } else {
-        space = (int32_t)(t->tcpq_in.max_size - t->tcpq_in.size);
+        space = (int32_t)(t->tcpq_in.max_size - t->tcpq_in.size - t->rcv_held);
     }
 
     if (space < 0)
         space = 0;
 
+    /* A peer that did not offer window scaling on its SYN reads ours unscaled */
+    if (!t->scale_ok && ((t->sock.state & PICO_SOCKET_STATE_TCP) > PICO_SOCKET_STATE_TCP_SYN_SENT) && (space > 0xFFFF))
+        space = 0xFFFF;
+
+    /* Peers that only read the window shift of our SYN keep using it */
+    space = (int32_t)((uint32_t)space >> shift);
     while(space > 0xFFFF) {
         space = (int32_t)(((uint32_t)space >> 1u));
         shift++;
@@ -699,6 +1163,139 @@ static void tcp_set_space(struct pico_socket_tcp *t)
     tcp_set_space_check_winupdate(t, space, shift);
 }
 
+/* The window of a SYN is never scaled (RFC 7323) */
+static uint16_t tcp_syn_window(struct pico_socket_tcp *t)
+{
+    uint32_t space;
+
+    if (t->tcpq_in.max_size == 0)
+        return 0xFFFFu;
+
+    if (t->tcpq_in.size >= t->tcpq_in.max_size)
+        return 0;
+
+    space = t->tcpq_in.max_size - t->tcpq_in.size;
+    return (uint16_t)((space > 0xFFFFu) ? 0xFFFFu : space);
+}
+
+/* Window shift to announce, large enough for what autotuning may reach */
+static uint8_t tcp_autotune_wscale(uint8_t autotune)
+{
+    uint32_t space = PICO_TCP_RMEM_MAX;
+    uint8_t shift = 0;
+
+    if (!(autotune & TCP_AUTOTUNE_RCV))
+        return 0;
+
+    while (space > 0xFFFFu) {
+        space >>= 1u;
+        shift++;
+    }
+    return shift;
+}
+
+/* Bytes all queues took beyond PICO_DEFAULT_SOCKETQ */
+static PICO_TLS uint32_t tcp_autotune_mem = 0;
+
+/* Grow q towards size, within max and what is left of PICO_TCP_AUTOTUNE_MEM */
+static void tcp_autotune_grow(struct pico_tcp_queue *q, uint32_t size, uint32_t max)
+{
+    uint32_t left = PICO_TCP_AUTOTUNE_MEM - tcp_autotune_mem;
+
+    if (size > max)
+        size = max;
+
+    if (size <= q->max_size)
+        return;
+
+    if (size - q->max_size > left)
+        size = q->max_size + left;
+
+    tcp_autotune_mem += size - q->max_size;
+    q->max_size = size;
+}
+
+/* Stop tuning the queues in which, and give back what they took */
+static void tcp_autotune_release(struct pico_socket_tcp *t, uint8_t which)
+{
+    if (t->autotune & which & TCP_AUTOTUNE_RCV)
+        tcp_autotune_mem -= t->tcpq_in.max_size - PICO_DEFAULT_SOCKETQ;
+
+    if (t->autotune & which & TCP_AUTOTUNE_SND)
+        tcp_autotune_mem -= t->tcpq_out.max_size - PICO_DEFAULT_SOCKETQ;
+
+    t->autotune &= (uint8_t)~which;
+}
+
+/* Round trip seen by the receiver: the peer echoes the timestamp of the ACK
+ * that opened the window for this data. The lowest samples are kept. */
+static void tcp_autotune_rcv_rtt(struct pico_socket_tcp *t, struct pico_frame *f)
+{
+    uint32_t rtt;
+
+    if (!(t->autotune & TCP_AUTOTUNE_RCV) || !f->timestamp || !f->payload_len)
+        return;
+
+    rtt = (uint32_t)TCP_TIME - (uint32_t)f->timestamp;
+    if (rtt > PICO_TCP_RTO_MAX)
+        return;
+
+    if (!rtt)
+        rtt = 1;
+
+    if (!t->rcv_rtt || (rtt < t->rcv_rtt))
+        t->rcv_rtt = rtt;
+    else
+        t->rcv_rtt = (7u * t->rcv_rtt + rtt) >> 3u;
+}
+
+/* Dynamic right-sizing: once per round trip, make room for twice what the
+ * application read meanwhile, so that the window keeps ahead of the sender
+ * as long as the application keeps up with it. */
+static void tcp_autotune_rcv(struct pico_socket_tcp *t)
+{
+    uint32_t rtt = t->rcv_rtt ? t->rcv_rtt : t->avg_rtt;
+    uint32_t max = (uint32_t)0xFFFFu << t->rcv_wscale;
+
+    if (!(t->autotune & TCP_AUTOTUNE_RCV) || !rtt)
+        return;
+
+    if (t->rcv_space_stamp && ((TCP_TIME - t->rcv_space_stamp) < rtt))
+        return;
+
+    if (max > PICO_TCP_RMEM_MAX)
+        max = PICO_TCP_RMEM_MAX;
+
+    if (t->rcv_space_stamp)
+        tcp_autotune_grow(&t->tcpq_in, (t->rcv_processed - t->rcv_space_seq) << 1u, max);
+
+    t->rcv_space_seq = t->rcv_processed;
+    t->rcv_space_stamp = TCP_TIME;
+}
+
+/* Once the application ran out of send queue, make room for two congestion
+ * windows, to refill one while the other is acked */
+/* Slow start runs up to the largest window the send queue can fill. The
+ * queue also counts the headers of its frames: an eighth is left for them. */
+static uint32_t tcp_ssthresh_queue(struct pico_socket_tcp *t)
+{
+    uint32_t segs = t->tcpq_out.max_size / t->mss;
+
+    segs -= segs >> 3u;
+    return ((segs > 2u) ? segs : 2u) * t->mss;
+}
+
+static void tcp_autotune_snd(struct pico_socket_tcp *t)
+{
+    if ((t->autotune & (TCP_AUTOTUNE_SND | TCP_AUTOTUNE_SND_FULL)) != (TCP_AUTOTUNE_SND | TCP_AUTOTUNE_SND_FULL))
+        return;
+
+    tcp_autotune_grow(&t->tcpq_out, t->cc.cwnd << 1u, PICO_TCP_WMEM_MAX);
+    t->autotune &= (uint8_t)~TCP_AUTOTUNE_SND_FULL;
+    if ((t->autotune & TCP_AUTOTUNE_SSTHRESH) && (tcp_ssthresh_queue(t) > t->cc.ssthresh))
+        t->cc.ssthresh = tcp_ssthresh_queue(t);
+}
+
 /* Return 32-bit aligned option size */
 static uint16_t tcp_options_size(struct pico_socket_tcp *t, uint16_t flags)
 {
@@ -739,66 +1336,141 @@ uint16_t pico_tcp_overhead(struct pico_socket *s)
 
 }
 
-static inline int tcp_sack_marker(struct pico_frame *f, uint32_t start, uint32_t end, uint16_t *count)
+/* Keep sack_high at the end of the highest segment SACKed or lost. Called
+ * before the segment is accounted. */
+static void tcp_sack_raise(struct pico_socket_tcp *t, struct pico_frame *f)
 {
-    int cmp;
-    cmp = pico_seq_compare(SEQN(f), start);
-    if (cmp > 0)
-        return 0;
-
-    if (cmp == 0) {
-        cmp = pico_seq_compare(SEQN(f) + f->payload_len, end);
-        if (cmp > 0) {
-            tcp_dbg("Invalid SACK: ignoring.\n");
-        }
-
-        tcp_dbg("Marking (by SACK) segment %08x BLK:[%08x::%08x]\n", SEQN(f), start, end);
-        f->flags |= PICO_FRAME_FLAG_SACKED;
-        (*count)++;
-    }
+    uint32_t end = SEQN(f) + f->payload_len;
 
-    return cmp;
+    if ((!t->tcpq_out.sacked && !t->tcpq_out.lost) || (pico_seq_compare(end, t->sack_high) > 0))
+        t->sack_high = end;
 }
 
-static void tcp_process_sack(struct pico_socket_tcp *t, uint32_t start, uint32_t end)
+/* Change the scoreboard state of a segment in tcpq_out */
+static void tcp_seg_mark(struct pico_socket_tcp *t, struct pico_frame *f, uint8_t flags)
 {
-    struct pico_frame *f;
-    struct pico_tree_node *index, *temp;
-    uint16_t count = 0;
+    uint8_t was_lost = (uint8_t)(TCP_SEG_FLAGS(f) & TCP_SEG_LOST);
 
-    pico_tree_foreach_safe(index, &t->tcpq_out.pool, temp){
-        f = index->keyValue;
-        if (tcp_sack_marker(f, start, end, &count) == 0)
-            goto done;
+    tcp_scoreboard_sub(&t->tcpq_out, f);
+    if ((flags & TCP_SEG_LOST) && !(f->flags & PICO_FRAME_FLAG_SACKED)) {
+        tcp_sack_raise(t, f);
+        if (pico_seq_compare(SEQN(f), t->lost_hint) < 0)
+            t->lost_hint = SEQN(f);
+    } else if (was_lost && (pico_seq_compare(SEQN(f), t->rack_hint) < 0)) {
+        t->rack_hint = SEQN(f);
     }
 
-done:
-    if (t->x_mode > PICO_TCP_LOOKAHEAD) {
-        if (t->in_flight > (count))
-            t->in_flight -= (count);
-        else
-            t->in_flight = 0;
-    }
+    TCP_SEG_FLAGS(f) = flags;
+    tcp_scoreboard_add(&t->tcpq_out, f);
 }
 
-inline static void tcp_add_header(struct pico_socket_tcp *t, struct pico_frame *f)
+static void tcp_seg_sack(struct pico_socket_tcp *t, struct pico_frame *f)
 {
-    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
-    f->timestamp = TCP_TIME;
-    tcp_add_options(t, f, 0, (uint16_t)(f->transport_len - f->payload_len - (uint16_t)PICO_SIZE_TCPHDR));
-    hdr->rwnd = short_be(t->wnd);
-    hdr->flags |= PICO_TCP_PSH | PICO_TCP_ACK;
-    hdr->ack = long_be(t->rcv_nxt);
-    hdr->crc = 0;
-    hdr->crc = short_be(pico_tcp_checksum(f));
+    tcp_scoreboard_sub(&t->tcpq_out, f);
+    tcp_sack_raise(t, f);
+    f->flags |= PICO_FRAME_FLAG_SACKED;
+    TCP_SEG_FLAGS(f) &= (uint8_t)~TCP_SEG_LOST;
+    tcp_scoreboard_add(&t->tcpq_out, f);
+    t->sack_fresh = 1;
 }
 
-static void tcp_rcv_sack(struct pico_socket_tcp *t, uint8_t *opt, int len)
+/* Bring the scoreboard hints up to the first segment still queued */
+static void tcp_scoreboard_rebase(struct pico_socket_tcp *t, uint32_t una)
 {
-    uint32_t start, end;
-    int i = 0;
-    if (len % 8) {
-        tcp_dbg("SACK: Invalid len.\n");
+    struct pico_frame *first = first_segment(&t->tcpq_out);
+    uint32_t base = first ? SEQN(first) : una;
+
+    if ((pico_seq_compare(t->rack_hint, base) < 0) || (pico_seq_compare(t->rack_hint, t->snd_nxt) > 0))
+        t->rack_hint = base;
+
+    if ((pico_seq_compare(t->lost_hint, base) < 0) || (pico_seq_compare(t->lost_hint, t->snd_nxt) > 0))
+        t->lost_hint = base;
+
+    if ((pico_seq_compare(t->sack_mark, base) < 0) || (pico_seq_compare(t->sack_mark, t->snd_nxt) > 0))
+        t->sack_mark = base;
+
+    if (!t->tcpq_out.sacked && !t->tcpq_out.lost)
+        t->sack_high = base;
+}
+
+/* RACK: remember the send time of the most recently sent segment known to
+ * be delivered. The ACK of a retransmission sent less than a minimum RTT ago
+ * is likely for the original transmission, and does not count. */
+static void tcp_rack_delivered(struct pico_socket_tcp *t, struct pico_frame *f, pico_time now)
+{
+    uint32_t end = SEQN(f) + f->payload_len;
+
+    if (!f->timestamp || (now < f->timestamp))
+        return;
+
+    if ((TCP_SEG_FLAGS(f) & TCP_SEG_RETRANS) && ((now - f->timestamp) < t->rack_min_rtt))
+        return;
+
+    if ((f->timestamp > t->rack_xmit_ts) ||
+        ((f->timestamp == t->rack_xmit_ts) && (pico_seq_compare(end, t->rack_end) > 0))) {
+        t->rack_xmit_ts = f->timestamp;
+        t->rack_end = end;
+        t->rack_rtt = (uint32_t)(now - f->timestamp);
+    }
+}
+
+static inline int tcp_sack_marker(struct pico_socket_tcp *t, struct pico_frame *f, uint32_t start, uint32_t end, uint16_t *count)
+{
+    int cmp;
+    cmp = pico_seq_compare(SEQN(f), end);
+    if (cmp >= 0)
+        return 0;
+
+    /* Only segments the block covers entirely */
+    if ((pico_seq_compare(SEQN(f), start) >= 0) && (pico_seq_compare(SEQN(f) + f->payload_len, end) <= 0) &&
+        !(f->flags & PICO_FRAME_FLAG_SACKED)) {
+        tcp_dbg("Marking (by SACK) segment %08x BLK:[%08x::%08x]\n", SEQN(f), start, end);
+        tcp_seg_sack(t, f);
+        tcp_rack_delivered(t, f, TCP_TIME);
+        (*count) = (uint16_t)(*count + output_segment_packets(f));
+    }
+
+    return -1;
+}
+
+static void tcp_process_sack(struct pico_socket_tcp *t, uint32_t start, uint32_t end)
+{
+    uint32_t pos;
+    uint16_t count = 0;
+
+    /* Only segments from start on can be covered */
+    for (pos = tcp_ring_search(&t->tcpq_out, start); pos < t->tcpq_out.frames; pos++) {
+        if (tcp_sack_marker(t, TCP_RING_AT(&t->tcpq_out, pos), start, end, &count) == 0)
+            break;
+    }
+
+    t->delivered += count;
+    if (t->x_mode > PICO_TCP_LOOKAHEAD) {
+        if (t->in_flight > (count))
+            t->in_flight -= (count);
+        else
+            t->in_flight = 0;
+    }
+}
+
+inline static void tcp_add_header(struct pico_socket_tcp *t, struct pico_frame *f)
+{
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    f->timestamp = TCP_TIME;
+    tcp_add_options(t, f, 0, (uint16_t)(f->transport_len - f->payload_len - (uint16_t)PICO_SIZE_TCPHDR));
+    hdr->rwnd = short_be(t->wnd);
+    hdr->flags |= PICO_TCP_PSH | PICO_TCP_ACK;
+    hdr->ack = long_be(t->rcv_nxt);
+    hdr->crc = 0;
+    hdr->crc = short_be(pico_tcp_checksum(f));
+}
+
+static void tcp_rcv_sack(struct pico_socket_tcp *t, uint8_t *opt, int len)
+{
+    uint32_t start, end;
+    int i = 0;
+    if (len % 8) {
+        tcp_dbg("SACK: Invalid len.\n");
         return;
     }
 
@@ -821,11 +1493,14 @@ static int tcpopt_len_check(uint32_t *idx, uint8_t len, uint8_t expected)
     return 0;
 }
 
-static inline void tcp_parse_option_ws(struct pico_socket_tcp *t, uint8_t len, uint8_t *opt, uint32_t *idx)
+static inline void tcp_parse_option_ws(struct pico_socket_tcp *t, struct pico_frame *f, uint8_t len, uint8_t *opt, uint32_t *idx)
 {
     if (tcpopt_len_check(idx, len, PICO_TCPOPTLEN_WS) < 0)
         return;
 
+    if(((struct pico_tcp_hdr *)(f->transport_hdr))->flags & PICO_TCP_SYN )
+        t->scale_ok = 1;
+
     t->recv_wnd_scale = opt[(*idx)++];
     tcp_dbg_options("TCP Window scale: received %d\n", t->recv_wnd_scale);
 
@@ -840,6 +1515,50 @@ static inline void tcp_parse_option_sack_ok(struct pico_socket_tcp *t, struct pi
         t->sack_ok = 1;
 }
 
+/* Refresh the segment window the output path works with */
+static void tcp_cc_sync(struct pico_socket_tcp *t)
+{
+    uint32_t cwnd = t->cc.ops->get_cwnd(&t->cc) / t->cc.mss;
+    t->cwnd = cwnd ? cwnd : 1u;
+}
+
+static void tcp_cc_set_cwnd(struct pico_socket_tcp *t, uint32_t segments)
+{
+    t->cc.cwnd = segments * t->cc.mss;
+    tcp_cc_sync(t);
+}
+
+static void tcp_cc_init(struct pico_socket_tcp *t)
+{
+    if (!t->cc.ops)
+        t->cc.ops = pico_tcp_cc_default();
+
+    /* An autotuned queue raises ssthresh as it grows, until the first loss */
+    if (t->autotune & TCP_AUTOTUNE_SND)
+        t->autotune |= TCP_AUTOTUNE_SSTHRESH;
+    else
+        t->autotune &= (uint8_t)~TCP_AUTOTUNE_SSTHRESH;
+
+    t->cc.mss = t->mss;
+    t->cc.cwnd = PICO_TCP_IW * t->cc.mss;
+    t->cc.ssthresh = tcp_ssthresh_queue(t);
+    t->cc.srtt = 0;
+    t->cc.ops->init(&t->cc);
+    tcp_cc_sync(t);
+}
+
+/* Keep the byte windows worth the same number of segments */
+static void tcp_cc_mss_update(struct pico_socket_tcp *t)
+{
+    if (!t->cc.mss || (t->cc.mss == t->mss))
+        return;
+
+    t->cc.cwnd = (t->cc.cwnd / t->cc.mss) * t->mss;
+    t->cc.ssthresh = (t->cc.ssthresh / t->cc.mss) * t->mss;
+    t->cc.mss = t->mss;
+    tcp_cc_sync(t);
+}
+
 static inline void tcp_parse_option_mss(struct pico_socket_tcp *t, uint8_t len, uint8_t *opt, uint32_t *idx)
 {
     uint16_t mss;
@@ -849,8 +1568,10 @@ static inline void tcp_parse_option_mss(struct pico_socket_tcp *t, uint8_t len,
     t->mss_ok = 1;
     mss = short_from(opt + *idx);
     *idx += (uint32_t)sizeof(uint16_t);
-    if (t->mss > short_be(mss))
+    if (t->mss > short_be(mss)) {
         t->mss = short_be(mss);
+        tcp_cc_mss_update(t);
+    }
 }
 
 static inline void tcp_parse_option_timestamp(struct pico_socket_tcp *t, struct pico_frame *f, uint8_t len, uint8_t *opt, uint32_t *idx)
@@ -891,7 +1612,7 @@ static void tcp_parse_options(struct pico_frame *f)
         case PICO_TCP_OPTION_END:
             break;
         case PICO_TCP_OPTION_WS:
-            tcp_parse_option_ws(t, len, opt, &i);
+            tcp_parse_option_ws(t, f, len, opt, &i);
             break;
         case PICO_TCP_OPTION_SACK_OK:
             tcp_parse_option_sack_ok(t, f, len, &i);
@@ -949,9 +1670,9 @@ static inline int tcp_send_try_enqueue(struct pico_socket_tcp *ts, struct pico_f
         return -1;
     }
 
-    if ((pico_enqueue(&tcp_out, cpy) > 0)) {
+    if ((pico_enqueue(pico_proto_tcp.q_out, cpy) > 0)) {
         if (f->payload_len > 0) {
-            ts->in_flight++;
+            ts->in_flight += output_segment_packets(f);
             ts->snd_nxt += f->payload_len; /* update next pointer here to prevent sending same segment twice when called twice in same tick */
         }
 
@@ -1058,12 +1779,18 @@ struct pico_socket *pico_tcp_open(uint16_t family)
     t->sock.timestamp = TCP_TIME;
     pico_socket_set_family(&t->sock, family);
     t->mss = (uint16_t)(pico_socket_get_mss(&t->sock) - PICO_SIZE_TCPHDR);
+    t->cc.ops = pico_tcp_cc_default();
+    t->pacing = PICO_TCP_PACING_DEFAULT;
+    t->delack = PICO_TCP_DELACK_DEFAULT;
+    t->delack_timeout = PICO_TCP_DELACK_TIMEOUT;
+    t->quickack = PICO_TCP_QUICKACKS;
     t->tcpq_in.pool.root = t->tcpq_hold.pool.root = t->tcpq_out.pool.root = &LEAF;
     t->tcpq_hold.pool.compare = t->tcpq_out.pool.compare = segment_compare;
     t->tcpq_in.pool.compare = input_segment_compare;
     t->tcpq_in.max_size = PICO_DEFAULT_SOCKETQ;
     t->tcpq_out.max_size = PICO_DEFAULT_SOCKETQ;
     t->tcpq_hold.max_size = 2u * t->mss;
+    t->autotune = TCP_AUTOTUNE_DEFAULT;
     rto_set(t, PICO_TCP_RTO_MIN);
 
     /* Uncomment next line and disable Nagle by default */
@@ -1098,6 +1825,7 @@ struct pico_socket *pico_tcp_open(uint16_t family)
 static uint32_t tcp_read_finish(struct pico_socket *s, uint32_t tot_rd_len)
 {
     struct pico_socket_tcp *t = TCP_SOCK(s);
+    tcp_autotune_rcv(t);
     tcp_set_space(t);
     if (t->tcpq_in.size == 0) {
         s->ev_pending &= (uint16_t)(~PICO_SOCK_EV_RD);
@@ -1181,6 +1909,79 @@ uint32_t pico_tcp_read(struct pico_socket *s, void *buf, uint32_t len)
     return tcp_read_finish(s, tot_rd_len);
 }
 
+/* Hand in-order segments over to the application, up to max chunks.
+ * Each chunk must be given back with pico_tcp_zerocopy_release(). */
+int pico_tcp_read_zerocopy(struct pico_socket *s, struct pico_zerocopy_chunk *chunks, int max)
+{
+    struct pico_socket_tcp *t = TCP_SOCK(s);
+    struct tcp_input_segment *f;
+    int32_t in_frame_off;
+    uint32_t tot_rd_len = 0;
+    int n = 0;
+
+    while (n < max) {
+        release_until(&t->tcpq_in, t->rcv_processed);
+        f = first_segment(&t->tcpq_in);
+        if (!f)
+            break;
+
+        in_frame_off = pico_seq_compare(t->rcv_processed, f->seq);
+        /* Hole at the beginning of data, awaiting retransmissions. */
+        if (in_frame_off < 0)
+            break;
+
+        PICOTCP_MUTEX_LOCK(Mutex);
+        pico_unlink_segment(&t->tcpq_in, f);
+        PICOTCP_MUTEX_UNLOCK(Mutex);
+        /* The window stays closed over it until it is released */
+        f->owner = t;
+        f->held_next = t->rcv_held_list;
+        t->rcv_held_list = f;
+        t->rcv_held += f->payload_len;
+        chunks[n].data = f->payload + in_frame_off;
+        chunks[n].len = (uint32_t)(f->payload_len - (uint32_t)in_frame_off);
+        chunks[n].handle = f;
+        t->rcv_processed += chunks[n].len;
+        tot_rd_len += chunks[n].len;
+        n++;
+    }
+    tcp_read_finish(s, tot_rd_len);
+    return n;
+}
+
+void pico_tcp_zerocopy_release(void *handle)
+{
+    struct tcp_input_segment *seg = (struct tcp_input_segment *)handle;
+    struct pico_socket_tcp *t = seg->owner;
+    struct tcp_input_segment **prev;
+
+    /* No owner: the socket is gone already */
+    if (t) {
+        for (prev = &t->rcv_held_list; *prev; prev = &(*prev)->held_next) {
+            if (*prev == seg) {
+                *prev = seg->held_next;
+                break;
+            }
+        }
+        t->rcv_held -= seg->payload_len;
+        tcp_set_space(t);
+    }
+
+    segment_free(seg);
+}
+
+/* Chunks outstanding when the socket goes away are freed on release */
+static void tcp_zerocopy_disown(struct pico_socket_tcp *t)
+{
+    struct tcp_input_segment *seg = t->rcv_held_list;
+    while (seg) {
+        seg->owner = NULL;
+        seg = seg->held_next;
+    }
+    t->rcv_held_list = NULL;
+    t->rcv_held = 0;
+}
+
 int pico_tcp_initconn(struct pico_socket *s);
 static void initconn_retry(pico_time when, void *arg)
 {
@@ -1208,34 +2009,172 @@ static void initconn_retry(pico_time when, void *arg)
     }
 }
 
-int pico_tcp_initconn(struct pico_socket *s)
+static void tcp_payload_copy(struct pico_frame *f, uint16_t off, uint8_t *dst, uint16_t len);
+static struct pico_frame *tcp_split_segment(struct pico_socket_tcp *t, struct pico_frame *f, uint16_t size);
+
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+/* Bytes of options tcp_add_options() writes on a SYN */
+#define TCP_SYN_OPTIONS (PICO_TCPOPTLEN_MSS + PICO_TCPOPTLEN_SACK_OK + PICO_TCPOPTLEN_WS + PICO_TCPOPTLEN_TIMESTAMP)
+
+/* Cookie of a server, with the MSS of the connection that got it */
+struct tcp_fastopen_entry {
+    union pico_address addr;
+    pico_time stamp;
+    uint16_t mss;
+    uint8_t addr_len;
+    uint8_t len;            /* 0 if unused */
+    uint8_t cookie[TCP_FASTOPEN_COOKIE_MAX];
+};
+
+static PICO_TLS struct tcp_fastopen_entry tcp_fastopen_cache[PICO_TCP_FASTOPEN_CACHE];
+
+static struct tcp_fastopen_entry *tcp_fastopen_find(struct pico_socket *s)
 {
-    struct pico_socket_tcp *ts = TCP_SOCK(s);
+    uint8_t addr_len = (uint8_t)(IS_SOCK_IPV4(s) ? PICO_SIZE_IP4 : PICO_SIZE_IP6);
+    uint32_t i;
+
+    for (i = 0; i < PICO_TCP_FASTOPEN_CACHE; i++) {
+        if (tcp_fastopen_cache[i].len && (tcp_fastopen_cache[i].addr_len == addr_len) &&
+            !memcmp(&tcp_fastopen_cache[i].addr, &s->remote_addr, addr_len))
+            return &tcp_fastopen_cache[i];
+    }
+    return NULL;
+}
+
+/* Cookie in the Fast Open option of f, NULL if there is no such option */
+static const uint8_t *tcp_fastopen_option(struct pico_frame *f, uint8_t *len)
+{
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    uint8_t *opt = f->transport_hdr + PICO_SIZE_TCPHDR;
+    uint32_t optlen = (uint32_t)((hdr->len & 0xf0u) >> 2u);
+    uint32_t i = 0;
+    uint8_t type;
+
+    if ((optlen < PICO_SIZE_TCPHDR) || (optlen > f->transport_len))
+        return NULL;
+
+    optlen -= PICO_SIZE_TCPHDR;
+    while (i < optlen) {
+        type = opt[i++];
+        if (type == PICO_TCP_OPTION_END)
+            break;
+
+        if (type == PICO_TCP_OPTION_NOOP)
+            continue;
+
+        if ((i >= optlen) || (opt[i] < 2) || (i + opt[i] - 1u > optlen))
+            break;
+
+        if (type == PICO_TCP_OPTION_FASTOPEN) {
+            *len = (uint8_t)(opt[i] - PICO_TCPOPTLEN_FASTOPEN);
+            return opt + i + 1;
+        }
+
+        i += opt[i] - 1u;
+    }
+    return NULL;
+}
+
+/* Options of a SYN carrying the cookie of e, or asking for one */
+static uint16_t tcp_fastopen_syn_optlen(const struct tcp_fastopen_entry *e)
+{
+    uint16_t size = (uint16_t)(TCP_SYN_OPTIONS + PICO_TCPOPTLEN_FASTOPEN + PICO_TCPOPTLEN_END);
+
+    if (e)
+        size = (uint16_t)(size + e->len);
+
+    return (uint16_t)(((size + 3u) >> 2u) << 2u);
+}
+
+/* Keep the cookie of a SYN-ACK. A server that took our cookie sends none,
+ * so the one we have stays until another replaces it. One that acknowledged
+ * only the SYN of our data did not take it (RFC 7413, 4.1.3): it is dropped,
+ * and the next SYN asks for a new one. */
+static void tcp_fastopen_synack(struct pico_socket_tcp *t, struct pico_frame *f, int data_acked)
+{
+    struct tcp_fastopen_entry *e;
+    const uint8_t *cookie;
+    uint8_t len = 0;
+    uint32_t i;
+
+    if (!(t->fastopen & TCP_FASTOPEN_ON))
+        return;
+
+    e = tcp_fastopen_find(&t->sock);
+    cookie = tcp_fastopen_option(f, &len);
+    if (!cookie || (len < 4u) || (len > TCP_FASTOPEN_COOKIE_MAX) || (len & 1u)) {
+        if (e && t->syn_data && !data_acked)
+            e->len = 0;
+
+        return;
+    }
+
+    if (!e) {
+        /* An unused entry, or else the least recently used one */
+        e = &tcp_fastopen_cache[0];
+        for (i = 1; (i < PICO_TCP_FASTOPEN_CACHE) && e->len; i++) {
+            if (!tcp_fastopen_cache[i].len || (tcp_fastopen_cache[i].stamp < e->stamp))
+                e = &tcp_fastopen_cache[i];
+        }
+        memset(e, 0, sizeof(struct tcp_fastopen_entry));
+        e->addr_len = (uint8_t)(IS_SOCK_IPV4((&t->sock)) ? PICO_SIZE_IP4 : PICO_SIZE_IP6);
+        memcpy(&e->addr, &t->sock.remote_addr, e->addr_len);
+    }
+
+    e->mss = t->mss;
+    e->len = len;
+    memcpy(e->cookie, cookie, len);
+    e->stamp = TCP_TIME;
+}
+#endif
+
+/* SYN of an active open, with the first bytes of data if not NULL. Those
+ * stay in tcpq_out, numbered after the SYN: the frame keeps a payload_len
+ * of 0 so that sending it does not move snd_nxt past them. */
+static int tcp_send_syn(struct pico_socket_tcp *ts, struct pico_frame *data)
+{
+    struct pico_socket *s = &ts->sock;
     struct pico_frame *syn;
     struct pico_tcp_hdr *hdr;
-    uint16_t mtu, opt_len = tcp_options_size(ts, PICO_TCP_SYN);
+    uint16_t len = data ? data->payload_len : 0u;
+    uint16_t opt_len = tcp_options_size(ts, PICO_TCP_SYN);
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    struct tcp_fastopen_entry *e = NULL;
+
+    if (ts->fastopen & TCP_FASTOPEN_ON) {
+        e = tcp_fastopen_find(s);
+        opt_len = tcp_fastopen_syn_optlen(e);
+    }
 
-    syn = s->net->alloc(s->net, NULL, (uint16_t)(PICO_SIZE_TCPHDR + opt_len));
+#endif
+
+    syn = s->net->alloc(s->net, NULL, (uint16_t)(PICO_SIZE_TCPHDR + opt_len + len));
     if (!syn)
         return -1;
 
     hdr = (struct pico_tcp_hdr *) syn->transport_hdr;
-
-    if (!ts->snd_nxt)
-        ts->snd_nxt = long_be(pico_paws());
-
-    ts->snd_last = ts->snd_nxt;
-    ts->cwnd = PICO_TCP_IW;
-    mtu = (uint16_t)pico_socket_get_mss(s);
-    ts->mss = (uint16_t)(mtu - PICO_SIZE_TCPHDR);
-    ts->ssthresh = (uint16_t)((uint16_t)(PICO_DEFAULT_SOCKETQ / ts->mss) -  (((uint16_t)(PICO_DEFAULT_SOCKETQ / ts->mss)) >> 3u));
     syn->sock = s;
     hdr->seq = long_be(ts->snd_nxt);
     hdr->len = (uint8_t)((PICO_SIZE_TCPHDR + opt_len) << 2 | ts->jumbo);
     hdr->flags = PICO_TCP_SYN;
     tcp_set_space(ts);
-    hdr->rwnd = short_be(ts->wnd);
+    hdr->rwnd = short_be(tcp_syn_window(ts));
     tcp_add_options(ts, syn, PICO_TCP_SYN, opt_len);
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    if (ts->fastopen & TCP_FASTOPEN_ON) {
+        /* An empty cookie asks the server for one */
+        syn->start[TCP_SYN_OPTIONS] = PICO_TCP_OPTION_FASTOPEN;
+        syn->start[TCP_SYN_OPTIONS + 1] = (uint8_t)(PICO_TCPOPTLEN_FASTOPEN + (e ? e->len : 0u));
+        if (e)
+            memcpy(syn->start + TCP_SYN_OPTIONS + PICO_TCPOPTLEN_FASTOPEN, e->cookie, e->len);
+    }
+
+#endif
+    if (data) {
+        tcp_payload_copy(data, 0, syn->transport_hdr + PICO_SIZE_TCPHDR + opt_len, len);
+        ts->bytes_out += len;
+    }
+
     hdr->trans.sport = ts->sock.local_port;
     hdr->trans.dport = ts->sock.remote_port;
 
@@ -1247,13 +2186,73 @@ int pico_tcp_initconn(struct pico_socket *s)
     ts->retrans_tmr = pico_timer_add(PICO_TCP_SYN_TO << ts->backoff, initconn_retry, ts);
     if (!ts->retrans_tmr) {
         tcp_dbg("TCP: Failed to start initconn_retry timer\n");
-        PICO_FREE(syn);
+        pico_frame_discard(syn);
         return -1;
     }
-    pico_enqueue(&tcp_out, syn);
+
+    pico_enqueue(pico_proto_tcp.q_out, syn);
     return 0;
 }
 
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+/* The SYN to a server we have a cookie for was held back for one tick: what
+ * the application wrote after connect() meanwhile goes out with it. */
+static void tcp_fastopen_connect(pico_time now, void *arg)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)arg;
+    struct tcp_fastopen_entry *e = tcp_fastopen_find(&t->sock);
+    struct pico_frame *data = first_segment(&t->tcpq_out);
+    uint16_t mss = t->mss;
+
+    IGNORE_PARAMETER(now);
+    t->retrans_tmr = 0;
+    if (e && data) {
+        e->stamp = TCP_TIME;
+        if (e->mss && (e->mss < mss))
+            mss = e->mss;
+
+        if (mss > tcp_fastopen_syn_optlen(e)) {
+            data = tcp_split_segment(t, data, (uint16_t)(mss - tcp_fastopen_syn_optlen(e)));
+            if (data)
+                t->syn_data = data->payload_len;
+        }
+    }
+
+    if (tcp_send_syn(t, t->syn_data ? data : NULL) < 0)
+        t->retrans_tmr = pico_timer_add(PICO_TCP_SYN_TO, initconn_retry, t);
+}
+#endif
+
+int pico_tcp_initconn(struct pico_socket *s)
+{
+    struct pico_socket_tcp *ts = TCP_SOCK(s);
+    uint16_t mtu;
+
+    if (!ts->snd_nxt)
+        ts->snd_nxt = long_be(pico_paws());
+
+    /* A retry must not renumber the data queued meanwhile */
+    if (!ts->backoff) {
+        ts->snd_last = ts->snd_nxt;
+        ts->rcv_wscale = tcp_autotune_wscale(ts->autotune);
+    }
+
+    mtu = (uint16_t)pico_socket_get_mss(s);
+    ts->mss = (uint16_t)(mtu - PICO_SIZE_TCPHDR);
+    tcp_cc_init(ts);
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    if ((ts->fastopen & TCP_FASTOPEN_ON) && !ts->backoff && tcp_fastopen_find(s)) {
+        ts->retrans_tmr = pico_timer_add(0, tcp_fastopen_connect, ts);
+        if (!ts->retrans_tmr)
+            return -1;
+
+        return 0;
+    }
+
+#endif
+    return tcp_send_syn(ts, NULL);
+}
+
 static int tcp_send_synack(struct pico_socket *s)
 {
     struct pico_socket_tcp *ts = TCP_SOCK(s);
@@ -1270,11 +2269,13 @@ static int tcp_send_synack(struct pico_socket *s)
     synack->sock = s;
     hdr->len = (uint8_t)((PICO_SIZE_TCPHDR + opt_len) << 2 | ts->jumbo);
     hdr->flags = PICO_TCP_SYN | PICO_TCP_ACK;
-    hdr->rwnd = short_be(ts->wnd);
     hdr->seq = long_be(ts->snd_nxt);
-    ts->rcv_processed = long_be(hdr->seq);
+    if (!(ts->fastopen & TCP_FASTOPEN_CHILD)) /* its SYN data may be unread */
+        ts->rcv_processed = long_be(hdr->seq);
+
     ts->snd_last = ts->snd_nxt;
     tcp_set_space(ts);
+    hdr->rwnd = short_be(tcp_syn_window(ts));
     tcp_add_options(ts, synack, hdr->flags, opt_len);
     synack->payload_len = 0;
     synack->timestamp = TCP_TIME;
@@ -1318,7 +2319,7 @@ static void tcp_send_empty(struct pico_socket_tcp *t, uint16_t flags, int is_kee
     hdr->crc = short_be(pico_tcp_checksum(f));
 
     /* TCP: ENQUEUE to PROTO */
-    pico_enqueue(&tcp_out, f);
+    pico_enqueue(pico_proto_tcp.q_out, f);
 }
 
 static void tcp_send_ack(struct pico_socket_tcp *t)
@@ -1363,7 +2364,7 @@ static int tcp_do_send_rst(struct pico_socket *s, uint32_t seq)
     hdr->crc = short_be(pico_tcp_checksum(f));
 
     /* TCP: ENQUEUE to PROTO */
-    pico_enqueue(&tcp_out, f);
+    pico_enqueue(pico_proto_tcp.q_out, f);
     tcp_dbg("TCP SEND_RST >>>>>>>>>>>>>>> DONE\n");
     return 0;
 }
@@ -1441,6 +2442,22 @@ static inline void tcp_fill_rst_header(struct pico_frame *fr, struct pico_tcp_hd
     hdr->crc = short_be(pico_tcp_checksum(f));
 }
 
+/* Send a segment built by tcp_fill_rst_payload(), which has no socket */
+static void tcp_reply_push(struct pico_frame *f)
+{
+    if (0) {
+#ifdef PICO_SUPPORT_IPV4
+    } else if (IS_IPV4(f)) {
+        tcp_dbg("Pushing IPv4 reply frame...\n");
+        pico_ipv4_frame_push(f, &(((struct pico_ipv4_hdr *)(f->net_hdr))->dst), PICO_PROTO_TCP);
+#endif
+#ifdef PICO_SUPPORT_IPV6
+    } else {
+        pico_ipv6_frame_push(f, NULL, &(((struct pico_ipv6_hdr *)(f->net_hdr))->dst), PICO_PROTO_TCP, 0);
+#endif
+    }
+}
+
 int pico_tcp_reply_rst(struct pico_frame *fr)
 {
     struct pico_tcp_hdr *hdr, *hdr1;
@@ -1467,20 +2484,7 @@ int pico_tcp_reply_rst(struct pico_frame *fr)
     hdr->flags = PICO_TCP_RST;
 
     tcp_fill_rst_header(fr, hdr1, f, hdr);
-
-    if (0) {
-#ifdef PICO_SUPPORT_IPV4
-    } else if (IS_IPV4(f)) {
-        tcp_dbg("Pushing IPv4 reset frame...\n");
-        pico_ipv4_frame_push(f, &(((struct pico_ipv4_hdr *)(f->net_hdr))->dst), PICO_PROTO_TCP);
-#endif
-#ifdef PICO_SUPPORT_IPV6
-    } else {
-        pico_ipv6_frame_push(f, NULL, &(((struct pico_ipv6_hdr *)(f->net_hdr))->dst), PICO_PROTO_TCP, 0);
-#endif
-    }
-
-
+    tcp_reply_push(f);
     return 0;
 }
 
@@ -1535,7 +2539,7 @@ static int tcp_nosync_rst(struct pico_socket *s, struct pico_frame *fr)
     hdr->crc = short_be(pico_tcp_checksum(f));
 
     /* TCP: ENQUEUE to PROTO */
-    pico_enqueue(&tcp_out, f);
+    pico_enqueue(pico_proto_tcp.q_out, f);
 
     /***************************************************************************/
 
@@ -1545,6 +2549,7 @@ static int tcp_nosync_rst(struct pico_socket *s, struct pico_frame *fr)
 }
 
 static void tcp_deltcb(pico_time when, void *arg);
+static void tcp_time_wait(struct pico_socket_tcp *t);
 
 static void tcp_linger(struct pico_socket_tcp *t)
 {
@@ -1585,7 +2590,7 @@ static void tcp_send_fin(struct pico_socket_tcp *t)
     hdr->crc = short_be(pico_tcp_checksum(f));
     /* tcp_dbg("SENDING FIN...\n"); */
     if (t->linger_timeout > 0) {
-        pico_enqueue(&tcp_out, f);
+        pico_enqueue(pico_proto_tcp.q_out, f);
         t->snd_nxt++;
     } else {
         pico_frame_discard(f);
@@ -1656,72 +2661,179 @@ static void tcp_sack_prepare(struct pico_socket_tcp *t)
     }
 }
 
-static inline int tcp_data_in_expected(struct pico_socket_tcp *t, struct pico_frame *f)
+/* The queued segment that holds seq, or else the first one after it.
+ * Segments never overlap: only the last one starting at or before seq
+ * may hold it, so a single descent of the tree finds both.
+ */
+static struct tcp_input_segment *tcp_input_segment_from(struct pico_socket_tcp *t, uint32_t seq)
 {
-    struct tcp_input_segment *nxt;
-    if (pico_seq_compare(SEQN(f), t->rcv_nxt) == 0) { /* Exactly what we expected */
-        /* Create new segment and enqueue it */
-        struct tcp_input_segment *input = segment_from_frame(f);
-        if (!input) {
-            pico_err = PICO_ERR_ENOMEM;
-            return -1;
-        }
+    struct pico_tree_node *node = t->tcpq_in.pool.root;
+    struct tcp_input_segment *seg, *below = NULL, *above = NULL;
 
-        if(pico_enqueue_segment(&t->tcpq_in, input) <= 0)
-        {
-            /* failed to enqueue, destroy segment */
-            PICO_FREE(input->payload);
-            PICO_FREE(input);
-            return -1;
+    while (node != &LEAF) {
+        seg = node->keyValue;
+        if (pico_seq_compare(seg->seq, seq) <= 0) {
+            below = seg;
+            node = node->rightChild;
         } else {
-            t->rcv_nxt = SEQN(f) + f->payload_len;
-            nxt = peek_segment(&t->tcpq_in, t->rcv_nxt);
-            while(nxt) {
-                tcp_dbg("scrolling rcv_nxt...%08x\n", t->rcv_nxt);
-                t->rcv_nxt += nxt->payload_len;
-                nxt = peek_segment(&t->tcpq_in, t->rcv_nxt);
-            }
-            t->sock.ev_pending |= PICO_SOCK_EV_RD;
+            above = seg;
+            node = node->leftChild;
         }
-    } else {
-        tcp_dbg("TCP> lo segment. Uninteresting retransmission. (exp: %x got: %x)\n", t->rcv_nxt, SEQN(f));
     }
 
-    return 0;
+    if (below && (pico_seq_compare(below->seq + below->payload_len, seq) > 0))
+        return below;
+
+    return above;
 }
 
-static inline int tcp_data_in_high_segment(struct pico_socket_tcp *t, struct pico_frame *f)
+/* Nothing queued from seq on */
+static int tcp_input_queue_ends_by(struct pico_socket_tcp *t, uint32_t seq)
 {
-    tcp_dbg("TCP> hi segment. Possible packet loss. I'll dupack this. (exp: %x got: %x)\n", t->rcv_nxt, SEQN(f));
-    if (t->sack_ok) {
-        struct tcp_input_segment *input = segment_from_frame(f);
-        if (!input) {
-            pico_err = PICO_ERR_ENOMEM;
-            return -1;
+    struct tcp_input_segment *last = pico_tree_last(&t->tcpq_in.pool);
+    return !last || (pico_seq_compare(last->seq + last->payload_len, seq) <= 0);
+}
+
+/* Queues the payload of f from *pos on, only where nothing is queued yet:
+ * a coalesced segment may span data that arrived earlier in smaller
+ * segments, and queued segments never overlap. On return *pos is the end of
+ * the data that is queued without holes from the initial *pos.
+ */
+static int tcp_data_in_insert(struct pico_socket_tcp *t, struct pico_frame *f, uint32_t *pos, int zerocopy)
+{
+    struct tcp_input_segment *seg, *input;
+    uint32_t end = SEQN(f) + f->payload_len;
+    uint32_t gap;
+
+    while (pico_seq_compare(*pos, end) < 0) {
+        /* In order, and nothing out of order queued: append */
+        if ((*pos == t->rcv_nxt) && tcp_input_queue_ends_by(t, *pos))
+            seg = NULL;
+        else
+            seg = tcp_input_segment_from(t, *pos);
+
+        if (seg && (pico_seq_compare(seg->seq, *pos) <= 0)) {
+            *pos = seg->seq + seg->payload_len;
+            continue;
+        }
+
+        gap = end;
+        if (seg && (pico_seq_compare(seg->seq, end) < 0))
+            gap = seg->seq;
+
+        if (zerocopy && (*pos == SEQN(f)) && (gap == end))
+            input = segment_ref_frame(f);
+        else
+            input = segment_from_frame_at(f, (uint16_t)(*pos - SEQN(f)), (uint16_t)(gap - *pos));
+
+        if (!input) {
+            pico_err = PICO_ERR_ENOMEM;
+            return -1;
         }
 
-        if(pico_enqueue_segment(&t->tcpq_in, input) <= 0) {
+        if (pico_enqueue_segment(&t->tcpq_in, input) <= 0) {
             /* failed to enqueue, destroy segment */
-            PICO_FREE(input->payload);
-            PICO_FREE(input);
+            segment_free(input);
             return -1;
         }
 
+        *pos = gap;
+    }
+    return 0;
+}
+
+static inline int tcp_data_in_expected(struct pico_socket_tcp *t, struct pico_frame *f)
+{
+    struct tcp_input_segment *nxt;
+    uint32_t pos = t->rcv_nxt;
+    int ret = 0;
+
+    if ((pico_seq_compare(SEQN(f), t->rcv_nxt) <= 0) &&
+        (pico_seq_compare(SEQN(f) + f->payload_len, t->rcv_nxt) > 0)) { /* What we expected, maybe behind some old data */
+        /* Create new segments and enqueue them */
+        ret = tcp_data_in_insert(t, f, &pos, t->zerocopy_rx);
+        if (pos != t->rcv_nxt) {
+            t->rcv_nxt = pos;
+            nxt = peek_segment(&t->tcpq_in, t->rcv_nxt);
+            while(nxt) {
+                tcp_dbg("scrolling rcv_nxt...%08x\n", t->rcv_nxt);
+                t->rcv_nxt += nxt->payload_len;
+                nxt = peek_segment(&t->tcpq_in, t->rcv_nxt);
+            }
+            t->sock.ev_pending |= PICO_SOCK_EV_RD;
+        }
+    } else {
+        tcp_dbg("TCP> lo segment. Uninteresting retransmission. (exp: %x got: %x)\n", t->rcv_nxt, SEQN(f));
+    }
+
+    return ret;
+}
+
+static inline int tcp_data_in_high_segment(struct pico_socket_tcp *t, struct pico_frame *f)
+{
+    uint32_t pos = SEQN(f);
+
+    tcp_dbg("TCP> hi segment. Possible packet loss. I'll dupack this. (exp: %x got: %x)\n", t->rcv_nxt, SEQN(f));
+    t->ooo_segs++;
+    if (t->sack_ok) {
+        if (tcp_data_in_insert(t, f, &pos, 0) < 0)
+            return -1;
+
         tcp_sack_prepare(t);
     }
 
     return 0;
 }
 
-static inline void tcp_data_in_send_ack(struct pico_socket_tcp *t, struct pico_frame *f)
+static void tcp_delack_timeout(pico_time now, void *arg)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)arg;
+    IGNORE_PARAMETER(now);
+
+    t->delack_tmr = 0;
+    /* The ACK may have left with an outgoing segment in the meantime */
+    if (pico_seq_compare(t->rcv_ackd, t->rcv_nxt) != 0)
+        tcp_send_ack(t);
+}
+
+/* Whether data that moved rcv_nxt forward by adv bytes is acknowledged at once */
+static int tcp_data_in_ack_now(struct pico_socket_tcp *t, struct pico_frame *f, uint32_t adv)
+{
+    struct tcp_input_segment *last = pico_tree_last(&t->tcpq_in.pool);
+
+    if (!t->delack)
+        return 1;
+
+    /* Out of order, duplicate or filling a hole: the sender is recovering */
+    if ((adv != f->payload_len) || (last && (pico_seq_compare(last->seq, t->rcv_nxt) >= 0))) {
+        t->quickack = PICO_TCP_QUICKACKS;
+        return 1;
+    }
+
+    if (t->quickack > 0) {
+        t->quickack--;
+        return 1;
+    }
+
+    return pico_seq_compare(t->rcv_nxt, t->rcv_ackd) >= (int32_t)(2u * t->mss);
+}
+
+static inline void tcp_data_in_send_ack(struct pico_socket_tcp *t, struct pico_frame *f, uint32_t adv)
 {
     struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *) f->transport_hdr;
     /* In either case, ack til recv_nxt, unless received data raises a RST flag. */
     if (((t->sock.state & PICO_SOCKET_STATE_TCP) != PICO_SOCKET_STATE_TCP_CLOSE_WAIT) &&
         ((t->sock.state & PICO_SOCKET_STATE_TCP) != PICO_SOCKET_STATE_TCP_SYN_SENT) &&
         ((t->sock.state & PICO_SOCKET_STATE_TCP) != PICO_SOCKET_STATE_TCP_SYN_RECV) &&
-        ((hdr->flags & PICO_TCP_RST) == 0))
-        tcp_send_ack(t);
+        ((hdr->flags & PICO_TCP_RST) == 0)) {
+        if (tcp_data_in_ack_now(t, f, adv))
+            tcp_send_ack(t);
+        else if (!t->delack_tmr)
+            t->delack_tmr = pico_timer_add(t->delack_timeout, tcp_delack_timeout, t);
+
+        if (!t->delack_tmr && (pico_seq_compare(t->rcv_ackd, t->rcv_nxt) != 0))
+            tcp_send_ack(t);
+    }
 }
 
 static int tcp_data_in(struct pico_socket *s, struct pico_frame *f)
@@ -1729,6 +2841,7 @@ static int tcp_data_in(struct pico_socket *s, struct pico_frame *f)
     struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
     struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *) f->transport_hdr;
     uint16_t payload_len = (uint16_t)(f->transport_len - ((hdr->len & 0xf0u) >> 2u));
+    uint32_t rcv_nxt = t->rcv_nxt;
     int ret = 0;
     (void)hdr;
 
@@ -1736,6 +2849,7 @@ static int tcp_data_in(struct pico_socket *s, struct pico_frame *f)
         tcp_parse_options(f);
         f->payload = f->transport_hdr + ((hdr->len & 0xf0u) >> 2u);
         f->payload_len = payload_len;
+        tcp_autotune_rcv_rtt(t, f);
         tcp_dbg("TCP> Received segment. (exp: %x got: %x)\n", t->rcv_nxt, SEQN(f));
 
         if (pico_seq_compare(SEQN(f), t->rcv_nxt) <= 0) {
@@ -1744,7 +2858,7 @@ static int tcp_data_in(struct pico_socket *s, struct pico_frame *f)
             ret = tcp_data_in_high_segment(t, f);
         }
 
-        tcp_data_in_send_ack(t, f);
+        tcp_data_in_send_ack(t, f, t->rcv_nxt - rcv_nxt);
         return ret;
     } else {
         tcp_dbg("TCP: invalid data in pkt len, exp: %d, got %d\n", (hdr->len & 0xf0) >> 2, f->transport_len);
@@ -1752,13 +2866,47 @@ static int tcp_data_in(struct pico_socket *s, struct pico_frame *f)
     }
 }
 
+#ifdef PICO_SUPPORT_TCP_GSO
+/* A super-segment that is only partly acknowledged is cut at the ACK, so
+ * that the packets that made it are released and accounted for. */
+static void tcp_gso_trim(struct pico_socket_tcp *t, uint32_t ack)
+{
+    struct pico_frame *una = first_segment(&t->tcpq_out);
+    int32_t acked;
+
+    if (!una || !una->gso_size)
+        return;
+
+    acked = pico_seq_compare(ack, SEQN(una));
+    if ((acked > 0) && (acked < una->payload_len))
+        tcp_split_segment(t, una, (uint16_t)acked);
+}
+
+/* Only the first packet of a super-segment is retransmitted */
+static struct pico_frame *tcp_gso_first(struct pico_socket_tcp *t, struct pico_frame *f)
+{
+    struct pico_frame *first;
+
+    if (output_segment_packets(f) < 2)
+        return f;
+
+    first = tcp_split_segment(t, f, f->gso_size);
+    return first ? first : f;
+}
+#endif
+
 static int tcp_ack_advance_una(struct pico_socket_tcp *t, struct pico_frame *f, pico_time *timestamp)
 {
-    int ret =  release_all_until(&t->tcpq_out, ACKN(f), timestamp);
+    int ret;
+#ifdef PICO_SUPPORT_TCP_GSO
+    tcp_gso_trim(t, ACKN(f));
+#endif
+    ret = release_all_until(&t->tcpq_out, ACKN(f), timestamp);
     if (ret > 0) {
         t->sock.ev_pending |= PICO_SOCK_EV_WR;
     }
 
+    tcp_scoreboard_rebase(t, ACKN(f));
     return ret;
 }
 
@@ -1775,6 +2923,9 @@ static void tcp_rtt(struct pico_socket_tcp *t, uint32_t rtt)
 
     uint32_t avg = t->avg_rtt;
     uint32_t rvar = t->rttvar;
+    if (!t->rack_min_rtt || (rtt < t->rack_min_rtt))
+        t->rack_min_rtt = rtt;
+
     if (!avg) {
         /* This follows RFC2988
          * (2.2) When the first RTT measurement R is made, the host MUST set
@@ -1785,7 +2936,7 @@ static void tcp_rtt(struct pico_socket_tcp *t, uint32_t rtt)
          */
         t->avg_rtt = rtt;
         t->rttvar = rtt >> 1;
-        rto_set(t, t->avg_rtt + (t->rttvar << 2));
+        rto_set(t, t->avg_rtt + TCP_RTO_VAR(t));
     } else {
         int32_t var = (int32_t)t->avg_rtt - (int32_t)rtt;
         if (var < 0)
@@ -1806,29 +2957,119 @@ static void tcp_rtt(struct pico_socket_tcp *t, uint32_t rtt)
         t->avg_rtt >>= 3;
 
         /* Finally, assign a new value for the RTO, as specified in the RFC, with K=4 */
-        rto_set(t, t->avg_rtt + (t->rttvar << 2));
+        rto_set(t, t->avg_rtt + TCP_RTO_VAR(t));
     }
 
     tcp_dbg(" -----=============== RTT CUR: %u AVG: %u RTTVAR: %u RTO: %u ======================----\n", rtt, t->avg_rtt, t->rttvar, t->rto);
 }
 
-static void tcp_congestion_control(struct pico_socket_tcp *t)
+static void tcp_congestion_control(struct pico_socket_tcp *t, uint32_t acked)
 {
     if (t->x_mode > PICO_TCP_LOOKAHEAD)
         return;
 
     tcp_dbg("Doing congestion control\n");
-    if (t->cwnd < t->ssthresh) {
-        t->cwnd++;
+    t->cc.srtt = t->avg_rtt;
+    t->cc.ops->on_ack(&t->cc, acked * t->cc.mss, TCP_TIME);
+    tcp_cc_sync(t);
+
+    tcp_dbg("TCP_CWND, %lu, %u, %u, %u\n", TCP_TIME, t->cwnd, t->cc.ssthresh, t->in_flight);
+}
+
+static void tcp_pacing_timer(pico_time now, void *arg)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)arg;
+    IGNORE_PARAMETER(now);
+    t->pacing_tmr = 0;
+    if (t->cwnd >= t->in_flight)
+        pico_tcp_output(&t->sock, (int)t->cwnd - (int)t->in_flight);
+}
+
+static uint32_t tcp_pacing_rate(struct pico_socket_tcp *t)
+{
+    uint64_t rate;
+    uint32_t gain;
+
+    if (!t->pacing || !t->avg_rtt)
+        return 0;
+
+    gain = (t->cc.cwnd < t->cc.ssthresh) ? PICO_TCP_PACING_SS_GAIN : PICO_TCP_PACING_CA_GAIN;
+    rate = ((uint64_t)t->cc.cwnd * 1000u * gain) / (100u * (uint64_t)t->avg_rtt);
+    if (rate > 0xFFFFFFFFu)
+        rate = 0xFFFFFFFFu;
+
+    return (uint32_t)rate;
+}
+
+/* Bytes released per slot at rate: one slot worth of data, but never less
+ * than two segments */
+static uint32_t tcp_pacing_burst(struct pico_socket_tcp *t, uint32_t rate)
+{
+    uint32_t burst = (uint32_t)(((uint64_t)rate * PICO_TCP_PACING_SLOT) / 1000u);
+    if (burst < 2u * t->mss)
+        burst = 2u * t->mss;
+
+    return burst;
+}
+
+/* Returns 1 if a segment of len bytes has to wait for the next slot */
+static int tcp_pacing_hold(struct pico_socket_tcp *t, uint32_t len, pico_time now)
+{
+    uint64_t tokens;
+    uint32_t burst, wait;
+
+    t->pacing_rate = tcp_pacing_rate(t);
+    if (!t->pacing_rate)
+        return 0;
+
+    burst = tcp_pacing_burst(t, t->pacing_rate);
+    if (len > burst)
+        len = burst; /* Larger segments go as soon as the bucket is full */
+
+    if (!t->pacing_stamp) {
+        tokens = burst;
     } else {
-        t->cwnd_counter++;
-        if (t->cwnd_counter >= t->cwnd) {
-            t->cwnd++;
-            t->cwnd_counter = 0;
+        tokens = t->pacing_tokens + (((uint64_t)(now - t->pacing_stamp) * t->pacing_rate) / 1000u);
+        if (tokens > burst)
+            tokens = burst;
+    }
+
+    t->pacing_tokens = (uint32_t)tokens;
+    t->pacing_stamp = now;
+    if (len <= t->pacing_tokens) {
+        if (t->pacing_wait) {
+            t->pacing_delay += now - t->pacing_wait;
+            t->pacing_wait = 0;
         }
+
+        return 0;
+    }
+
+    if (!t->pacing_wait) {
+        t->pacing_wait = now;
+        t->pacing_holds++;
+    }
+
+    if (!t->pacing_tmr) {
+        wait = (uint32_t)((((uint64_t)(len - t->pacing_tokens) * 1000u) + t->pacing_rate - 1u) / t->pacing_rate);
+        if (wait < PICO_TCP_PACING_SLOT)
+            wait = PICO_TCP_PACING_SLOT;
+
+        t->pacing_tmr = pico_timer_add(wait, tcp_pacing_timer, t);
     }
 
-    tcp_dbg("TCP_CWND, %lu, %u, %u, %u\n", TCP_TIME, t->cwnd, t->ssthresh, t->in_flight);
+    return 1;
+}
+
+static void tcp_pacing_sent(struct pico_socket_tcp *t, uint32_t len)
+{
+    if (!t->pacing_rate)
+        return;
+
+    if (len > t->pacing_tokens)
+        t->pacing_tokens = 0;
+    else
+        t->pacing_tokens -= len;
 }
 
 static void add_retransmission_timer(struct pico_socket_tcp *t, pico_time next_ts);
@@ -1838,8 +3079,26 @@ static void add_retransmission_timer(struct pico_socket_tcp *t, pico_time next_t
 
 static void tcp_first_timeout(struct pico_socket_tcp *t)
 {
+    uint32_t pos;
+    struct pico_frame *f;
+
+    /* Everything is sent again from snd_una on */
+    if (t->tcpq_out.lost) {
+        tcp_ring_foreach(&t->tcpq_out, pos, f) {
+            if (TCP_SEG_FLAGS(f) & TCP_SEG_LOST)
+                tcp_seg_mark(t, f, (uint8_t)(TCP_SEG_FLAGS(f) & ~TCP_SEG_LOST));
+        }
+    }
+
+    f = first_segment(&t->tcpq_out);
+    if (f)
+        t->sack_mark = SEQN(f);
+
+    t->sack_fresh = 1;
     t->x_mode = PICO_TCP_BLACKOUT;
-    t->cwnd = PICO_TCP_IW;
+    t->autotune &= (uint8_t)~TCP_AUTOTUNE_SSTHRESH;
+    t->cc.ops->on_rto(&t->cc, t->in_flight * t->cc.mss, TCP_TIME);
+    tcp_cc_sync(t);
     t->in_flight = 0;
 }
 
@@ -1853,10 +3112,13 @@ static int tcp_rto_xmit(struct pico_socket_tcp *t, struct pico_frame *f)
         return -1;
     }
 
-    if (pico_enqueue(&tcp_out, cpy) > 0) {
+    if (pico_enqueue(pico_proto_tcp.q_out, cpy) > 0) {
+        tcp_seg_mark(t, f, TCP_SEG_RETRANS);
         t->snd_last_out = SEQN(cpy);
+        t->retrans++;
+        t->rto_events++;
         add_retransmission_timer(t, (t->rto << (++t->backoff)) + TCP_TIME);
-        tcp_dbg("TCP_CWND, %lu, %u, %u, %u\n", TCP_TIME, t->cwnd, t->ssthresh, t->in_flight);
+        tcp_dbg("TCP_CWND, %lu, %u, %u, %u\n", TCP_TIME, t->cwnd, t->cc.ssthresh, t->in_flight);
         tcp_dbg("Sending RTO!\n");
         return 1;
     } else {
@@ -1899,6 +3161,9 @@ static inline int tcp_retrans_timeout_check_queue(struct pico_socket_tcp *t)
         if (t->x_mode != PICO_TCP_BLACKOUT)
             tcp_first_timeout(t);
 
+#ifdef PICO_SUPPORT_TCP_GSO
+        f = tcp_gso_first(t, f);
+#endif
         tcp_add_header(t, f);
         if (tcp_rto_xmit(t, f) > 0) /* A segment has been rexmit'd */
             return -1;
@@ -1955,7 +3220,7 @@ static void tcp_retrans_timeout(pico_time val, void *sock)
 
 static void add_retransmission_timer(struct pico_socket_tcp *t, pico_time next_ts)
 {
-    struct pico_tree_node *index;
+    uint32_t pos;
     pico_time now = TCP_TIME;
     pico_time val = 0;
 
@@ -1963,8 +3228,7 @@ static void add_retransmission_timer(struct pico_socket_tcp *t, pico_time next_t
     if (next_ts == 0) {
         struct pico_frame *f;
 
-        pico_tree_foreach(index, &t->tcpq_out.pool){
-            f = index->keyValue;
+        tcp_ring_foreach(&t->tcpq_out, pos, f) {
             if ((next_ts == 0) || ((f->timestamp < next_ts) && (f->timestamp > 0))) {
                 next_ts = f->timestamp;
                 val = next_ts + (t->rto << t->backoff);
@@ -1995,6 +3259,9 @@ static int tcp_retrans(struct pico_socket_tcp *t, struct pico_frame *f)
 {
     struct pico_frame *cpy;
     if (f) {
+#ifdef PICO_SUPPORT_TCP_GSO
+        f = tcp_gso_first(t, f);
+#endif
         tcp_dbg("TCP> RETRANS (by dupack) frame %08x, len= %d\n", SEQN(f), f->payload_len);
         tcp_add_header(t, f);
         /* TCP: ENQUEUE to PROTO ( retransmit )*/
@@ -2003,9 +3270,12 @@ static int tcp_retrans(struct pico_socket_tcp *t, struct pico_frame *f)
             return -1;
         }
 
-        if (pico_enqueue(&tcp_out, cpy) > 0) {
-            t->in_flight++;
+        if (pico_enqueue(pico_proto_tcp.q_out, cpy) > 0) {
+            tcp_seg_mark(t, f, TCP_SEG_RETRANS);
+            t->in_flight += output_segment_packets(f);
             t->snd_last_out = SEQN(cpy);
+            t->retrans++;
+            t->fast_retrans++;
         } else {
             pico_frame_discard(cpy);
         }
@@ -2022,7 +3292,7 @@ static void tcp_ack_dbg(struct pico_socket *s, struct pico_frame *f)
 {
     uint32_t una, nxt, ack, cur;
     struct pico_frame *una_f = NULL, *cur_f;
-    struct pico_tree_node *idx;
+    uint32_t pos;
     struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
     char info[64];
     char tmp[64];
@@ -2031,9 +3301,8 @@ static void tcp_ack_dbg(struct pico_socket *s, struct pico_frame *f)
     tcp_dbg("===================================\n");
     tcp_dbg("Queue out (%d/%d). ACKED=%08x\n", t->tcpq_out.size, t->tcpq_out.max_size, ack);
 
-    pico_tree_foreach(idx, &t->tcpq_out.pool) {
+    tcp_ring_foreach(&t->tcpq_out, pos, cur_f) {
         info[0] = 0;
-        cur_f = idx->keyValue;
         cur = SEQN(cur_f);
         if (!una_f) {
             una_f = cur_f;
@@ -2069,149 +3338,543 @@ static void tcp_ack_dbg(struct pico_socket *s, struct pico_frame *f)
 }
 #endif
 
-static int tcp_ack(struct pico_socket *s, struct pico_frame *f)
+/* Marks as lost the segments sent before the most recently delivered one
+ * that are overdue by more than the reordering window. Returns when the
+ * next one will be, 0 if none is pending. */
+static pico_time tcp_rack_detect_loss(struct pico_socket_tcp *t, pico_time now)
 {
-    struct pico_frame *f_new;              /* use with Nagle to push to out queue */
-    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
-    struct pico_tcp_hdr *hdr;
-    uint32_t rtt = 0;
-    uint16_t acked = 0;
-    pico_time acked_timestamp = 0;
-    struct pico_frame *una = NULL;
+    uint32_t pos;
+    struct pico_frame *f;
+    pico_time deadline, next = 0;
+    uint32_t reo_wnd = t->rack_min_rtt >> 2;
+    int settled = 1;
 
-    if (!f || !s) {
-        pico_err = PICO_ERR_EINVAL;
-        return -1;
-    }
+    if (!t->rack_xmit_ts)
+        return 0;
 
-    hdr = (struct pico_tcp_hdr *) f->transport_hdr;
+    if (t->avg_rtt && (reo_wnd > t->avg_rtt))
+        reo_wnd = t->avg_rtt;
 
-    if ((hdr->flags & PICO_TCP_ACK) == 0)
-        return -1;
+    for (pos = tcp_ring_search(&t->tcpq_out, t->rack_hint); pos < t->tcpq_out.frames; pos++) {
+        f = TCP_RING_AT(&t->tcpq_out, pos);
+        if (pico_seq_compare(SEQN(f), t->snd_nxt) >= 0)
+            break;
 
-#ifdef TCP_ACK_DBG
-    tcp_ack_dbg(s, f);
-#endif
+        if ((f->flags & PICO_FRAME_FLAG_SACKED) || (TCP_SEG_FLAGS(f) & TCP_SEG_LOST)) {
+            if (settled)
+                t->rack_hint = SEQN(f) + f->payload_len;
 
-    tcp_parse_options(f);
-    t->recv_wnd = short_be(hdr->rwnd);
+            continue;
+        }
 
-    acked = (uint16_t)tcp_ack_advance_una(t, f, &acked_timestamp);
-    una = first_segment(&t->tcpq_out);
-    t->ack_timestamp = TCP_TIME;
+        settled = 0;
+        if (!f->timestamp)
+            continue;
 
-    if ((t->x_mode == PICO_TCP_BLACKOUT) ||
-        ((t->x_mode == PICO_TCP_WINDOW_FULL) && ((t->recv_wnd << t->recv_wnd_scale) > t->mss))) {
-        int prev_mode = t->x_mode;
-        tcp_dbg("Re-entering look-ahead...\n\n\n");
-        t->x_mode = PICO_TCP_LOOKAHEAD;
-        t->backoff = 0;
+        /* Sent after the delivered segment: nothing is known yet. Below
+         * snd_nxt, first transmissions go out in sequence order, so only
+         * retransmissions can be older past a first transmission. */
+        if ((f->timestamp > t->rack_xmit_ts) ||
+            ((f->timestamp == t->rack_xmit_ts) && (pico_seq_compare(SEQN(f) + f->payload_len, t->rack_end) >= 0))) {
+            if (!(TCP_SEG_FLAGS(f) & TCP_SEG_RETRANS))
+                break;
 
-        if((prev_mode == PICO_TCP_BLACKOUT) && (acked > 0) && una)
-        {
-            t->snd_nxt = SEQN(una);
-            /* restart the retrans timer */
-            if (t->retrans_tmr) {
-                t->retrans_tmr_due = 0ull;
-            }
+            continue;
         }
-    }
-
-    /* One should be acked. */
-    if ((acked == 0) && (f->payload_len  == 0) && (t->in_flight > 0))
-        t->in_flight--;
-
-    if (!una || acked > 0) {
-        t->x_mode = PICO_TCP_LOOKAHEAD;
-        tcp_dbg("Mode: Look-ahead. In flight: %d/%d buf: %d\n", t->in_flight, t->cwnd, t->tcpq_out.frames);
-        t->backoff = 0;
 
-        /* Do rtt/rttvar/rto calculations */
-        /* First, try with timestamps, using the value from options */
-        if(f->timestamp != 0) {
-            rtt = time_diff(TCP_TIME, f->timestamp);
-            if (rtt)
-                tcp_rtt(t, rtt);
-        } else if(acked_timestamp) {
-            /* If no timestamps are there, use conservative estimation on the una */
-            rtt = time_diff(TCP_TIME, acked_timestamp);
-            if (rtt)
-                tcp_rtt(t, rtt);
+        deadline = f->timestamp + t->rack_rtt + reo_wnd;
+        if (deadline <= now) {
+            tcp_dbg("RACK: segment %08x lost\n", SEQN(f));
+            tcp_seg_mark(t, f, TCP_SEG_LOST);
+        } else if (!next || (deadline < next)) {
+            next = deadline;
         }
+    }
+    return next;
+}
 
-        tcp_dbg("TCP ACK> FRESH ACK %08x (acked %d) Queue size: %u/%u frames: %u cwnd: %u in_flight: %u snd_una: %u\n", ACKN(f), acked, t->tcpq_out.size, t->tcpq_out.max_size, t->tcpq_out.frames, t->cwnd, t->in_flight, SEQN(una));
-        if (acked > t->in_flight) {
-            tcp_dbg("WARNING: in flight < 0\n");
-            t->in_flight = 0;
-        } else
-            t->in_flight -= (acked);
+/* Packets sent from tcpq_out, the ones before snd_nxt */
+static uint32_t tcp_out_packets_sent(struct pico_socket_tcp *t)
+{
+    uint32_t pos = tcp_ring_search(&t->tcpq_out, t->snd_nxt);
+#ifdef PICO_SUPPORT_TCP_GSO
+    uint32_t i, packets = 0;
 
-    } else if ((t->snd_old_ack == ACKN(f)) &&              /* We've just seen this ack, and... */
-               ((0 == (hdr->flags & (PICO_TCP_PSH | PICO_TCP_SYN))) &&
-                (f->payload_len == 0)) &&              /* This is a pure ack, and... */
-               (ACKN(f) != t->snd_nxt))              /* There is something in flight awaiting to be acked... */
-    {
-        /* Process incoming duplicate ack. */
-        if (t->x_mode < PICO_TCP_RECOVER) {
-            t->x_mode++;
-            tcp_dbg("Mode: DUPACK %d, due to PURE ACK %0x, len = %d\n", t->x_mode, SEQN(f), f->payload_len);
-            /* tcp_dbg("ACK: %x - QUEUE: %x\n", ACKN(f), SEQN(first_segment(&t->tcpq_out))); */
-            if (t->x_mode == PICO_TCP_RECOVER) {              /* Switching mode */
-                if (t->in_flight > PICO_TCP_IW)
-                    t->cwnd = (uint16_t)t->in_flight;
-                else
-                    t->cwnd = PICO_TCP_IW;
+    for (i = 0; i < pos; i++)
+        packets += output_segment_packets(TCP_RING_AT(&t->tcpq_out, i));
 
-                t->snd_retry = SEQN((struct pico_frame *)first_segment(&t->tcpq_out));
-                if (t->ssthresh > t->cwnd)
-                    t->ssthresh >>= 2;
-                else
-                    t->ssthresh = (t->cwnd >> 1);
+    return packets;
+#else
+    return pos;
+#endif
+}
 
-                if (t->ssthresh < 2)
-                    t->ssthresh = 2;
-            }
-        } else if (t->x_mode == PICO_TCP_RECOVER) {
-            /* tcp_dbg("TCP RECOVER> DUPACK! snd_una: %08x, snd_nxt: %08x, acked now: %08x\n", SEQN(first_segment(&t->tcpq_out)), t->snd_nxt, ACKN(f)); */
-            if (t->in_flight <= t->cwnd) {
-                struct pico_frame *nxt = peek_segment(&t->tcpq_out, t->snd_retry);
-                if (!nxt)
-                    nxt = first_segment(&t->tcpq_out);
+/* The scoreboard as a single walk of tcpq_out, for when snd_nxt went back
+ * below SACKed or lost segments after a timeout. */
+static uint32_t tcp_sack_scoreboard_walk(struct pico_socket_tcp *t)
+{
+    uint32_t pos;
+    struct pico_frame *f;
+    uint32_t sacked = 0, pipe = 0;
 
-                while (nxt && (nxt->flags & PICO_FRAME_FLAG_SACKED) && (nxt != first_segment(&t->tcpq_out))) {
-                    tcp_dbg("Skipping %08x because it is sacked.\n", SEQN(nxt));
-                    nxt = next_segment(&t->tcpq_out, nxt);
-                }
-                if (nxt && (pico_seq_compare(SEQN(nxt), t->snd_nxt)) > 0)
-                    nxt = NULL;
+    tcp_ring_foreach_reverse(&t->tcpq_out, pos, f) {
+        if (pico_seq_compare(SEQN(f), t->snd_nxt) >= 0)
+            continue;
 
-                if (nxt && (pico_seq_compare(SEQN(nxt), SEQN((struct pico_frame *)first_segment(&t->tcpq_out))) > (int)(t->recv_wnd << t->recv_wnd_scale)))
-                    nxt = NULL;
+        if (f->flags & PICO_FRAME_FLAG_SACKED) {
+            sacked += output_segment_packets(f);
+            continue;
+        }
 
-                if(!nxt)
-                    nxt = first_segment(&t->tcpq_out);
+        if ((sacked >= PICO_TCP_DUPTHRESH) && !(TCP_SEG_FLAGS(f) & TCP_SEG_RETRANS))
+            tcp_seg_mark(t, f, TCP_SEG_LOST);
 
-                if (nxt) {
-                    tcp_retrans(t, peek_segment(&t->tcpq_out, t->snd_retry));
-                    t->snd_retry = SEQN(nxt);
-                }
-            }
+        if (!(TCP_SEG_FLAGS(f) & TCP_SEG_LOST))
+            pipe += output_segment_packets(f);
+    }
+    return pipe;
+}
 
-            if (++t->cwnd_counter > 1) {
-                t->cwnd--;
-                if (t->cwnd < 2)
-                    t->cwnd = 2;
+/* RFC 6675 scoreboard: marks as lost the segments with PICO_TCP_DUPTHRESH
+ * SACKed segments above them, and returns the estimate of the packets still
+ * in the network (pipe). Only the segments between sack_mark and the new
+ * threshold are visited. */
+static uint32_t tcp_sack_scoreboard(struct pico_socket_tcp *t)
+{
+    struct pico_tcp_queue *tq = &t->tcpq_out;
+    uint32_t pos, top, sacked = 0, sent;
+    struct pico_frame *f;
 
-                t->cwnd_counter = 0;
-            }
-        } else {
-            tcp_dbg("DUPACK in mode %d \n", t->x_mode);
+    if (pico_seq_compare(t->sack_high, t->snd_nxt) > 0)
+        return tcp_sack_scoreboard_walk(t);
 
+    if (t->sack_fresh && (tq->sacked >= PICO_TCP_DUPTHRESH)) {
+        /* Lowest segment with PICO_TCP_DUPTHRESH SACKed packets from it on */
+        top = tcp_ring_search(tq, t->sack_high);
+        while ((top > 0) && (sacked < PICO_TCP_DUPTHRESH)) {
+            f = TCP_RING_AT(tq, --top);
+            if (f->flags & PICO_FRAME_FLAG_SACKED)
+                sacked += output_segment_packets(f);
         }
-    }              /* End case duplicate ack detection */
 
-    /* Linux very special zero-window probe detection (see bug #107) */
-    if ((0 == (hdr->flags & (PICO_TCP_PSH | PICO_TCP_SYN))) && /* This is a pure ack, and... */
+        for (pos = tcp_ring_search(tq, t->sack_mark); pos < top; pos++) {
+            f = TCP_RING_AT(tq, pos);
+            if (!(f->flags & PICO_FRAME_FLAG_SACKED) && !(TCP_SEG_FLAGS(f) & (TCP_SEG_RETRANS | TCP_SEG_LOST)))
+                tcp_seg_mark(t, f, TCP_SEG_LOST);
+        }
+        if (pico_seq_compare(SEQN(TCP_RING_AT(tq, top)), t->sack_mark) > 0)
+            t->sack_mark = SEQN(TCP_RING_AT(tq, top));
+    }
+
+    t->sack_fresh = 0;
+    sent = tcp_out_packets_sent(t);
+    return (sent > (tq->sacked + tq->lost)) ? (sent - tq->sacked - tq->lost) : 0;
+}
+
+static struct pico_frame *tcp_sack_next_lost(struct pico_socket_tcp *t)
+{
+    uint32_t pos;
+    struct pico_frame *f;
+
+    if (!t->tcpq_out.lost)
+        return NULL;
+
+    for (pos = tcp_ring_search(&t->tcpq_out, t->lost_hint); pos < t->tcpq_out.frames; pos++) {
+        f = TCP_RING_AT(&t->tcpq_out, pos);
+        if (pico_seq_compare(SEQN(f), t->snd_nxt) >= 0)
+            break;
+
+        if ((TCP_SEG_FLAGS(f) & TCP_SEG_LOST) && !(f->flags & PICO_FRAME_FLAG_SACKED))
+            return f;
+
+        t->lost_hint = SEQN(f) + f->payload_len;
+    }
+    return NULL;
+}
+
+static void tcp_recovery_start(struct pico_socket_tcp *t)
+{
+    t->x_mode = PICO_TCP_RECOVER;
+    t->snd_recover = t->snd_nxt;
+    t->prr_recover_fs = t->in_flight ? t->in_flight : 1u;
+    t->prr_delivered = 0;
+    t->prr_out = 0;
+    t->autotune &= (uint8_t)~TCP_AUTOTUNE_SSTHRESH;
+    t->cc.ops->on_loss(&t->cc, t->in_flight * t->cc.mss, TCP_TIME);
+    tcp_cc_sync(t);
+    t->snd_retry = SEQN((struct pico_frame *)first_segment(&t->tcpq_out));
+}
+
+static void tcp_rack_timeout(pico_time now, void *arg);
+
+static void tcp_rack_timer_set(struct pico_socket_tcp *t, pico_time due, uint8_t tlp)
+{
+    pico_time now = TCP_TIME;
+
+    /* A pending reordering timeout is not replaced by a probe */
+    if (tlp && t->rack_tmr_due && !t->rack_tlp)
+        return;
+
+    t->rack_tlp = tlp;
+    if (t->rack_tmr && (due < t->rack_tmr_due)) {
+        pico_timer_cancel(t->rack_tmr);
+        t->rack_tmr = 0;
+    }
+
+    t->rack_tmr_due = due;
+    if (!t->rack_tmr) {
+        t->rack_tmr = pico_timer_add((due > now) ? (due - now) : 1, tcp_rack_timeout, t);
+        if (!t->rack_tmr)
+            t->rack_tmr_due = 0;
+    }
+}
+
+/* Tail loss probe: with no ACK for two RTTs, send the next new segment, or
+ * the last one again, so that a loss at the end of a flight is reported by
+ * SACK instead of waiting for the retransmission timeout. */
+static void tcp_tlp_arm(struct pico_socket_tcp *t)
+{
+    uint32_t pto;
+
+    if (!t->sack_ok || (t->x_mode != PICO_TCP_LOOKAHEAD) || t->tlp_high || (t->in_flight == 0))
+        return;
+
+    pto = t->avg_rtt ? (t->avg_rtt << 1) : t->rto;
+    if (t->in_flight == 1)
+        pto += PICO_TCP_TLP_DELACK;
+
+    if (pto < PICO_TCP_TLP_MIN)
+        pto = PICO_TCP_TLP_MIN;
+
+    if (pto >= t->rto)
+        return;
+
+    tcp_rack_timer_set(t, TCP_TIME + pto, 1);
+}
+
+static void tcp_tlp_probe(struct pico_socket_tcp *t)
+{
+    uint32_t pos;
+    struct pico_frame *f = NULL;
+    uint32_t nxt = t->snd_nxt;
+
+    /* One probe per flight */
+    t->tlp_high = nxt;
+    if (t->cwnd >= t->in_flight)
+        pico_tcp_output(&t->sock, 1);
+
+    if (t->snd_nxt == nxt) {
+        tcp_ring_foreach_reverse(&t->tcpq_out, pos, f) {
+            if (pico_seq_compare(SEQN(f), t->snd_nxt) < 0)
+                break;
+
+            f = NULL;
+        }
+        if (!f)
+            return;
+
+        tcp_dbg("TLP: probing with %08x\n", SEQN(f));
+        tcp_retrans(t, f);
+    }
+
+    t->tlp_high = t->snd_nxt;
+}
+
+/* Proportional rate reduction (RFC 6937): the segments the peer reports as
+ * delivered clock out a share of new transmissions, so that the pipe drains
+ * down to ssthresh instead of stalling at it. */
+static uint32_t tcp_prr_sndcnt(struct pico_socket_tcp *t, uint32_t delivered)
+{
+    uint32_t ssthresh = t->cc.ssthresh / t->cc.mss;
+    uint32_t limit;
+
+    if (!ssthresh)
+        ssthresh = 1;
+
+    t->prr_delivered += delivered;
+    if (t->in_flight > ssthresh) {
+        limit = (uint32_t)(((uint64_t)t->prr_delivered * ssthresh + t->prr_recover_fs - 1) / t->prr_recover_fs);
+        return (limit > t->prr_out) ? (limit - t->prr_out) : 0;
+    }
+
+    /* Slow start reduction bound: catch up, at most one segment ahead */
+    limit = (t->prr_delivered > t->prr_out) ? (t->prr_delivered - t->prr_out) : 0;
+    if (limit < delivered)
+        limit = delivered;
+
+    limit++;
+    return ((ssthresh - t->in_flight) < limit) ? (ssthresh - t->in_flight) : limit;
+}
+
+static void tcp_sack_recovery(struct pico_socket_tcp *t)
+{
+    struct pico_frame *lost;
+    uint32_t delivered = t->delivered;
+    uint32_t sndcnt;
+    pico_time reo;
+
+    t->delivered = 0;
+    if ((t->x_mode == PICO_TCP_BLACKOUT) || (t->x_mode == PICO_TCP_WINDOW_FULL))
+        return;
+
+    reo = tcp_rack_detect_loss(t, TCP_TIME);
+    if (reo)
+        tcp_rack_timer_set(t, reo, 0);
+
+    t->in_flight = tcp_sack_scoreboard(t);
+    lost = tcp_sack_next_lost(t);
+    if (t->x_mode != PICO_TCP_RECOVER) {
+        if (!lost)
+            return;
+
+        tcp_dbg("SACK: entering recovery at %08x\n", SEQN(lost));
+        tcp_recovery_start(t);
+    }
+
+    sndcnt = tcp_prr_sndcnt(t, delivered);
+    /* The first lost segment goes out on entry whatever the pipe says */
+    if (!sndcnt && lost && !t->prr_out)
+        sndcnt = 1;
+
+    while (lost && sndcnt) {
+#ifdef PICO_SUPPORT_TCP_GSO
+        /* tcp_retrans() would cut it too, and release 'lost' behind our back */
+        lost = tcp_gso_first(t, lost);
+#endif
+        if ((tcp_retrans(t, lost) <= 0) || (TCP_SEG_FLAGS(lost) & TCP_SEG_LOST))
+            return;
+
+        t->prr_out++;
+        sndcnt--;
+        lost = tcp_sack_next_lost(t);
+    }
+
+    if (sndcnt) {
+        uint32_t before = t->in_flight;
+        tcp_cc_set_cwnd(t, t->in_flight + sndcnt);
+        pico_tcp_output(&t->sock, (int)sndcnt);
+        if (t->in_flight > before)
+            t->prr_out += t->in_flight - before;
+    }
+
+    tcp_cc_set_cwnd(t, t->in_flight);
+}
+
+static void tcp_rack_timeout(pico_time now, void *arg)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)arg;
+
+    t->rack_tmr = 0;
+    if (!t->rack_tmr_due)
+        return;
+
+    if (t->rack_tmr_due > now) {
+        t->rack_tmr = pico_timer_add(t->rack_tmr_due - now, tcp_rack_timeout, t);
+        if (!t->rack_tmr)
+            t->rack_tmr_due = 0;
+
+        return;
+    }
+
+    t->rack_tmr_due = 0;
+    if (!tcp_is_allowed_to_send(t))
+        return;
+
+    if (t->rack_tlp && (t->x_mode == PICO_TCP_LOOKAHEAD) && !t->tlp_high)
+        tcp_tlp_probe(t);
+    else
+        tcp_sack_recovery(t);
+}
+
+/* RACK sees the segments that a cumulative ACK delivers */
+static void tcp_rack_ack(struct pico_socket_tcp *t, uint32_t ack)
+{
+    uint32_t pos;
+    struct pico_frame *f;
+    pico_time now = TCP_TIME;
+
+    /* With no retransmission pending, the segments below snd_nxt went out in
+     * sequence order: the last one acknowledged was sent last. */
+    if (!t->tcpq_out.retrans && (pico_seq_compare(ack, t->snd_nxt) <= 0)) {
+        pos = tcp_ring_search(&t->tcpq_out, ack);
+        while (pos > 0) {
+            f = TCP_RING_AT(&t->tcpq_out, --pos);
+            if ((pico_seq_compare(SEQN(f) + f->payload_len, ack) <= 0) && !(f->flags & PICO_FRAME_FLAG_SACKED)) {
+                tcp_rack_delivered(t, f, now);
+                break;
+            }
+        }
+    } else {
+        tcp_ring_foreach(&t->tcpq_out, pos, f) {
+            if (pico_seq_compare(SEQN(f) + f->payload_len, ack) > 0)
+                break;
+
+            if (!(f->flags & PICO_FRAME_FLAG_SACKED))
+                tcp_rack_delivered(t, f, now);
+        }
+    }
+
+    if (t->tlp_high && (pico_seq_compare(ack, t->tlp_high) >= 0))
+        t->tlp_high = 0;
+}
+
+static int tcp_ack(struct pico_socket *s, struct pico_frame *f)
+{
+    struct pico_frame *f_new;              /* use with Nagle to push to out queue */
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    struct pico_tcp_hdr *hdr;
+    uint32_t rtt = 0;
+    uint16_t acked = 0;
+    pico_time acked_timestamp = 0;
+    struct pico_frame *una = NULL;
+
+    if (!f || !s) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    hdr = (struct pico_tcp_hdr *) f->transport_hdr;
+
+    if ((hdr->flags & PICO_TCP_ACK) == 0)
+        return -1;
+
+#ifdef TCP_ACK_DBG
+    tcp_ack_dbg(s, f);
+#endif
+
+    tcp_parse_options(f);
+    if (!hdr->rwnd && t->recv_wnd)
+        t->zero_wnd_remote++;
+
+    t->recv_wnd = short_be(hdr->rwnd);
+
+    if (t->sack_ok)
+        tcp_rack_ack(t, ACKN(f));
+
+    acked = (uint16_t)tcp_ack_advance_una(t, f, &acked_timestamp);
+    una = first_segment(&t->tcpq_out);
+    t->ack_timestamp = TCP_TIME;
+
+    if ((t->x_mode == PICO_TCP_BLACKOUT) ||
+        ((t->x_mode == PICO_TCP_WINDOW_FULL) && ((t->recv_wnd << t->recv_wnd_scale) > t->mss))) {
+        int prev_mode = t->x_mode;
+        tcp_dbg("Re-entering look-ahead...\n\n\n");
+        t->x_mode = PICO_TCP_LOOKAHEAD;
+        t->backoff = 0;
+
+        if((prev_mode == PICO_TCP_BLACKOUT) && (acked > 0) && una)
+        {
+            t->snd_nxt = SEQN(una);
+            /* restart the retrans timer */
+            if (t->retrans_tmr) {
+                t->retrans_tmr_due = 0ull;
+            }
+        }
+    }
+
+    /* A cumulative ACK may cover data beyond snd_nxt after an RTO rewind */
+    if (una && (pico_seq_compare(SEQN(una), t->snd_nxt) > 0))
+        t->snd_nxt = SEQN(una);
+
+    /* One should be acked. */
+    if ((acked == 0) && (f->payload_len  == 0) && (t->in_flight > 0))
+        t->in_flight--;
+
+    if (!una || acked > 0) {
+        /* With SACK, recovery lasts until all the data sent before it is acknowledged */
+        if (t->sack_ok)
+            t->delivered += acked;
+
+        if (!t->sack_ok || (t->x_mode != PICO_TCP_RECOVER) || !una || (pico_seq_compare(ACKN(f), t->snd_recover) >= 0)) {
+            /* Leaving a proportional rate reduction, cwnd lands on ssthresh */
+            if (t->sack_ok && (t->x_mode == PICO_TCP_RECOVER)) {
+                t->cc.cwnd = t->cc.ssthresh;
+                tcp_cc_sync(t);
+            }
+
+            t->x_mode = PICO_TCP_LOOKAHEAD;
+        }
+
+        tcp_dbg("Mode: Look-ahead. In flight: %d/%d buf: %d\n", t->in_flight, t->cwnd, t->tcpq_out.frames);
+        t->backoff = 0;
+
+        /* Do rtt/rttvar/rto calculations */
+        /* First, try with timestamps, using the value from options */
+        if(f->timestamp != 0) {
+            rtt = time_diff(TCP_TIME, f->timestamp);
+            if (rtt)
+                tcp_rtt(t, rtt);
+        } else if(acked_timestamp) {
+            /* If no timestamps are there, use conservative estimation on the una */
+            rtt = time_diff(TCP_TIME, acked_timestamp);
+            if (rtt)
+                tcp_rtt(t, rtt);
+        }
+
+        tcp_dbg("TCP ACK> FRESH ACK %08x (acked %d) Queue size: %u/%u frames: %u cwnd: %u in_flight: %u snd_una: %u\n", ACKN(f), acked, t->tcpq_out.size, t->tcpq_out.max_size, t->tcpq_out.frames, t->cwnd, t->in_flight, SEQN(una));
+        if (acked > t->in_flight) {
+            tcp_dbg("WARNING: in flight < 0\n");
+            t->in_flight = 0;
+        } else
+            t->in_flight -= (acked);
+
+    } else if ((t->snd_old_ack == ACKN(f)) &&              /* We've just seen this ack, and... */
+               ((0 == (hdr->flags & (PICO_TCP_PSH | PICO_TCP_SYN))) &&
+                (f->payload_len == 0)) &&              /* This is a pure ack, and... */
+               (ACKN(f) != t->snd_nxt))              /* There is something in flight awaiting to be acked... */
+    {
+        /* Process incoming duplicate ack. */
+        if (t->x_mode < PICO_TCP_RECOVER) {
+            t->x_mode++;
+            tcp_dbg("Mode: DUPACK %d, due to PURE ACK %0x, len = %d\n", t->x_mode, SEQN(f), f->payload_len);
+            /* tcp_dbg("ACK: %x - QUEUE: %x\n", ACKN(f), SEQN(first_segment(&t->tcpq_out))); */
+            if (t->x_mode == PICO_TCP_RECOVER)              /* Switching mode */
+                tcp_recovery_start(t);
+        } else if ((t->x_mode == PICO_TCP_RECOVER) && !t->sack_ok) {
+            /* tcp_dbg("TCP RECOVER> DUPACK! snd_una: %08x, snd_nxt: %08x, acked now: %08x\n", SEQN(first_segment(&t->tcpq_out)), t->snd_nxt, ACKN(f)); */
+            if (t->in_flight <= t->cwnd) {
+                struct pico_frame *nxt = peek_segment(&t->tcpq_out, t->snd_retry);
+                if (!nxt)
+                    nxt = first_segment(&t->tcpq_out);
+
+                while (nxt && (nxt->flags & PICO_FRAME_FLAG_SACKED) && (nxt != first_segment(&t->tcpq_out))) {
+                    tcp_dbg("Skipping %08x because it is sacked.\n", SEQN(nxt));
+                    nxt = next_segment(&t->tcpq_out, nxt);
+                }
+                if (nxt && (pico_seq_compare(SEQN(nxt), t->snd_nxt)) > 0)
+                    nxt = NULL;
+
+                if (nxt && (pico_seq_compare(SEQN(nxt), SEQN((struct pico_frame *)first_segment(&t->tcpq_out))) > (int)(t->recv_wnd << t->recv_wnd_scale)))
+                    nxt = NULL;
+
+                if(!nxt)
+                    nxt = first_segment(&t->tcpq_out);
+
+                if (nxt) {
+                    /* The retransmission may split nxt */
+                    uint32_t retry = SEQN(nxt);
+                    tcp_retrans(t, peek_segment(&t->tcpq_out, t->snd_retry));
+                    t->snd_retry = retry;
+                }
+            }
+
+            /* Deflate by one segment every second duplicate ACK */
+            if (++t->cwnd_counter > 1) {
+                if (t->cwnd > 2)
+                    tcp_cc_set_cwnd(t, t->cwnd - 1);
+                else
+                    tcp_cc_set_cwnd(t, 2);
+
+                t->cwnd_counter = 0;
+            }
+        } else {
+            tcp_dbg("DUPACK in mode %d \n", t->x_mode);
+
+        }
+    }              /* End case duplicate ack detection */
+
+    /* Linux very special zero-window probe detection (see bug #107) */
+    if ((0 == (hdr->flags & (PICO_TCP_PSH | PICO_TCP_SYN))) && /* This is a pure ack, and... */
         (ACKN(f) == t->snd_nxt) &&                           /* it's acking our snd_nxt, and... */
         (pico_seq_compare(SEQN(f), t->rcv_nxt) < 0))             /* Has an old seq number */
     {
@@ -2220,7 +3883,8 @@ static int tcp_ack(struct pico_socket *s, struct pico_frame *f)
 
 
     /* Do congestion control */
-    tcp_congestion_control(t);
+    tcp_congestion_control(t, acked);
+    tcp_autotune_snd(t);
     if ((acked > 0) && t->sock.wakeup) {
         if (t->tcpq_out.size < t->tcpq_out.max_size)
             t->sock.wakeup(PICO_SOCK_EV_WR, &(t->sock));
@@ -2242,8 +3906,11 @@ static int tcp_ack(struct pico_socket *s, struct pico_frame *f)
         }
     }
 
+    if (t->sack_ok)
+        tcp_sack_recovery(t);
+
     /* If some space was created, put a few segments out. */
-    tcp_dbg("TCP_CWND, %lu, %u, %u, %u\n", TCP_TIME, t->cwnd, t->ssthresh, t->in_flight);
+    tcp_dbg("TCP_CWND, %lu, %u, %u, %u\n", TCP_TIME, t->cwnd, t->cc.ssthresh, t->in_flight);
     if (t->x_mode ==  PICO_TCP_LOOKAHEAD) {
         if ((t->cwnd >= t->in_flight) && (t->snd_nxt > t->snd_last_out)) {
             pico_tcp_output(&t->sock, (int)t->cwnd - (int)t->in_flight);
@@ -2251,6 +3918,7 @@ static int tcp_ack(struct pico_socket *s, struct pico_frame *f)
     }
 
     add_retransmission_timer(t, 0);
+    tcp_tlp_arm(t);
     t->snd_old_ack = ACKN(f);
     return 0;
 }
@@ -2322,8 +3990,7 @@ static int tcp_finwaitfin(struct pico_socket *s, struct pico_frame *f)
 
     /* send ACK */
     tcp_send_ack(t);
-    /* linger */
-    tcp_linger(t);
+    tcp_time_wait(t);
     return 0;
 }
 
@@ -2339,8 +4006,7 @@ static int tcp_closing_ack(struct pico_socket *s, struct pico_frame *f)
     if (ACKN(f) == t->snd_nxt) {
         s->state &= 0x00FFU;
         s->state |= PICO_SOCKET_STATE_TCP_TIME_WAIT;
-        /* set timer */
-        tcp_linger(t);
+        tcp_time_wait(t);
     }
 
     return 0;
@@ -2366,74 +4032,953 @@ static int tcp_lastackwait(struct pico_socket *s, struct pico_frame *f)
     return 0;
 }
 
-static int tcp_syn(struct pico_socket *s, struct pico_frame *f)
-{
-    struct pico_socket_tcp *new = NULL;
-    struct pico_tcp_hdr *hdr = NULL;
-    uint16_t mtu;
-    if(s->number_of_pending_conn >= s->max_backlog)
-        return -1;
+/* Half-open connection: what the final ACK needs to build the socket */
+struct tcp_halfopen {
+    struct tcp_halfopen *next;
+    struct pico_socket *parent;
+    union pico_address local;
+    union pico_address remote;
+    uint16_t remote_port;
+    uint16_t mss;       /* offered by the peer, 0 if not */
+    uint16_t rwnd;
+    uint8_t wscale;
+    uint8_t ws_ok;
+    uint8_t sack_ok;
+    uint8_t ts_ok;
+    uint8_t jumbo;
+    uint32_t iss;
+    uint32_t irs;
+    uint32_t ts_recent;
+    uint32_t ts_echo;   /* TSecr received, or our TSval for a cookie SYN-ACK */
+    uint32_t hash;
+    pico_time expire;
+};
 
-    new = (struct pico_socket_tcp *)pico_socket_clone(s);
-    hdr = (struct pico_tcp_hdr *)f->transport_hdr;
-    if (!new)
-        return -1;
-
-#ifdef PICO_TCP_SUPPORT_SOCKET_STATS
-    if (!pico_timer_add(2000, sock_stats, s)) {
-        tcp_dbg("TCP: Failed to start socket statistics timer\n");
-        return -1;
-    }
+#ifdef PICO_SUPPORT_TCP_HALFOPEN
+static PICO_TLS struct tcp_halfopen *tcp_halfopen_table[PICO_TCP_HALFOPEN_BUCKETS];
+static PICO_TLS uint32_t tcp_halfopen_count = 0;
+static PICO_TLS uint32_t tcp_halfopen_tmr = 0;
+#endif
+static PICO_TLS struct pico_tcp_syn_stats tcp_syn_counters;
+#if defined(PICO_SUPPORT_TCP_HALFOPEN) || defined(PICO_SUPPORT_TCP_SYNCOOKIES) || \
+    defined(PICO_SUPPORT_TCP_FASTOPEN) || defined(PICO_SUPPORT_TCP_TIMEWAIT)
+static PICO_TLS uint32_t tcp_syn_key[2];
+static PICO_TLS uint8_t tcp_syn_key_set = 0;
+
+#define TCP_SYN_ROTL(x, b) (uint32_t)(((x) << (b)) | ((x) >> (32 - (b))))
+
+static void tcp_syn_sipround(uint32_t *v)
+{
+    v[0] += v[1];
+    v[1] = TCP_SYN_ROTL(v[1], 5);
+    v[1] ^= v[0];
+    v[0] = TCP_SYN_ROTL(v[0], 16);
+    v[2] += v[3];
+    v[3] = TCP_SYN_ROTL(v[3], 8);
+    v[3] ^= v[2];
+    v[0] += v[3];
+    v[3] = TCP_SYN_ROTL(v[3], 7);
+    v[3] ^= v[0];
+    v[2] += v[1];
+    v[1] = TCP_SYN_ROTL(v[1], 13);
+    v[1] ^= v[2];
+    v[2] = TCP_SYN_ROTL(v[2], 16);
+}
+
+/* HalfSipHash-2-4 of m, keyed with a secret drawn at first use. It spreads
+ * the half-open and TIME_WAIT tables and authenticates SYN cookies. */
+static uint32_t tcp_syn_hash(const uint32_t *m, uint32_t words)
+{
+    uint32_t v[4], b = (words * 4u) << 24;
+    uint32_t i, r;
+
+    if (!tcp_syn_key_set) {
+        tcp_syn_key[0] = pico_rand();
+        tcp_syn_key[1] = pico_rand();
+        tcp_syn_key_set = 1;
+    }
+
+    v[0] = tcp_syn_key[0];
+    v[1] = tcp_syn_key[1];
+    v[2] = 0x6c796765u ^ tcp_syn_key[0];
+    v[3] = 0x74656462u ^ tcp_syn_key[1];
+    for (i = 0; i < words; i++) {
+        v[3] ^= m[i];
+        tcp_syn_sipround(v);
+        tcp_syn_sipround(v);
+        v[0] ^= m[i];
+    }
+    v[3] ^= b;
+    tcp_syn_sipround(v);
+    tcp_syn_sipround(v);
+    v[0] ^= b;
+    v[2] ^= 0xffu;
+    for (r = 0; r < 4; r++)
+        tcp_syn_sipround(v);
+    return v[1] ^ v[3];
+}
 #endif
 
-    new->sock.remote_port = ((struct pico_trans *)f->transport_hdr)->sport;
+static void tcp_syn_addresses(struct pico_frame *f, union pico_address *local, union pico_address *remote)
+{
+    memset(local, 0, sizeof(union pico_address));
+    memset(remote, 0, sizeof(union pico_address));
 #ifdef PICO_SUPPORT_IPV4
     if (IS_IPV4(f)) {
-        new->sock.remote_addr.ip4.addr = ((struct pico_ipv4_hdr *)(f->net_hdr))->src.addr;
-        new->sock.local_addr.ip4.addr = ((struct pico_ipv4_hdr *)(f->net_hdr))->dst.addr;
+        local->ip4.addr = ((struct pico_ipv4_hdr *)(f->net_hdr))->dst.addr;
+        remote->ip4.addr = ((struct pico_ipv4_hdr *)(f->net_hdr))->src.addr;
     }
 
 #endif
 #ifdef PICO_SUPPORT_IPV6
     if (IS_IPV6(f)) {
-        new->sock.remote_addr.ip6 = ((struct pico_ipv6_hdr *)(f->net_hdr))->src;
-        new->sock.local_addr.ip6 = ((struct pico_ipv6_hdr *)(f->net_hdr))->dst;
+        local->ip6 = ((struct pico_ipv6_hdr *)(f->net_hdr))->dst;
+        remote->ip6 = ((struct pico_ipv6_hdr *)(f->net_hdr))->src;
+    }
+
+#endif
+}
+
+#if defined(PICO_SUPPORT_TCP_HALFOPEN) || defined(PICO_SUPPORT_TCP_SYNCOOKIES) || \
+    defined(PICO_SUPPORT_TCP_FASTOPEN) || defined(PICO_SUPPORT_TCP_TIMEWAIT)
+/* Words of a connection tuple, for tcp_syn_hash() */
+static uint32_t tcp_tuple_words(const void *local, const void *remote, uint32_t len, uint16_t lport, uint16_t rport, uint32_t *m)
+{
+    memcpy(m, local, len);
+    memcpy((uint8_t *)m + len, remote, len);
+    m[len >> 1] = ((uint32_t)lport << 16) | rport;
+    return (len >> 1) + 1u;
+}
+#endif
+
+#if defined(PICO_SUPPORT_TCP_HALFOPEN) || defined(PICO_SUPPORT_TCP_SYNCOOKIES)
+static uint32_t tcp_syn_tuple(struct pico_frame *f, uint32_t *m)
+{
+    union pico_address local, remote;
+    struct pico_trans *tr = (struct pico_trans *)f->transport_hdr;
+
+    tcp_syn_addresses(f, &local, &remote);
+    return tcp_tuple_words(&local, &remote, IS_IPV4(f) ? PICO_SIZE_IP4 : PICO_SIZE_IP6, tr->dport, tr->sport, m);
+}
+#endif
+
+#ifdef PICO_SUPPORT_TCP_HALFOPEN
+static struct tcp_halfopen *tcp_halfopen_find(struct pico_socket *s, struct pico_frame *f)
+{
+    struct tcp_halfopen *h;
+    union pico_address local, remote;
+    uint32_t m[9];
+    uint32_t hash;
+
+    if (!tcp_halfopen_count)
+        return NULL;
+
+    hash = tcp_syn_hash(m, tcp_syn_tuple(f, m));
+    tcp_syn_addresses(f, &local, &remote);
+    for (h = tcp_halfopen_table[hash % PICO_TCP_HALFOPEN_BUCKETS]; h; h = h->next) {
+        if ((h->hash == hash) && (h->parent == s) && (h->remote_port == ((struct pico_trans *)f->transport_hdr)->sport) &&
+            !memcmp(&h->local, &local, sizeof(local)) && !memcmp(&h->remote, &remote, sizeof(remote)))
+            return h;
+    }
+    return NULL;
+}
+
+static void tcp_halfopen_sweep(pico_time now, void *arg);
+
+static struct tcp_halfopen *tcp_halfopen_add(struct pico_socket *s, struct pico_frame *f)
+{
+    struct tcp_halfopen *h;
+    uint32_t m[9];
+
+    if (!tcp_halfopen_tmr) {
+        tcp_halfopen_tmr = pico_timer_add(PICO_TCP_HALFOPEN_SWEEP, tcp_halfopen_sweep, NULL);
+        if (!tcp_halfopen_tmr)
+            return NULL;
+    }
+
+    h = PICO_ZALLOC(sizeof(struct tcp_halfopen));
+    if (!h)
+        return NULL;
+
+    h->parent = s;
+    h->remote_port = ((struct pico_trans *)f->transport_hdr)->sport;
+    tcp_syn_addresses(f, &h->local, &h->remote);
+    h->hash = tcp_syn_hash(m, tcp_syn_tuple(f, m));
+    h->iss = long_be(pico_paws());
+    h->expire = TCP_TIME + PICO_SOCKET_BOUND_TIMEOUT;
+    h->next = tcp_halfopen_table[h->hash % PICO_TCP_HALFOPEN_BUCKETS];
+    tcp_halfopen_table[h->hash % PICO_TCP_HALFOPEN_BUCKETS] = h;
+    tcp_halfopen_count++;
+    return h;
+}
+
+static void tcp_halfopen_del(struct tcp_halfopen *h)
+{
+    struct tcp_halfopen **pp;
+
+    for (pp = &tcp_halfopen_table[h->hash % PICO_TCP_HALFOPEN_BUCKETS]; *pp; pp = &(*pp)->next) {
+        if (*pp == h) {
+            *pp = h->next;
+            break;
+        }
+    }
+    tcp_halfopen_count--;
+    PICO_FREE(h);
+}
+
+/* Drop the entries of a listener, or the expired ones if s is NULL. Either
+ * way they no longer count against the backlog. */
+static void tcp_halfopen_purge(struct pico_socket *s, pico_time now)
+{
+    struct tcp_halfopen *h, *next;
+    uint32_t i;
+
+    for (i = 0; (i < PICO_TCP_HALFOPEN_BUCKETS) && tcp_halfopen_count; i++) {
+        for (h = tcp_halfopen_table[i]; h; h = next) {
+            next = h->next;
+            if (s ? (h->parent == s) : (h->expire <= now)) {
+                h->parent->number_of_pending_conn--;
+                tcp_halfopen_del(h);
+            }
+        }
+    }
+}
+
+static void tcp_halfopen_sweep(pico_time now, void *arg)
+{
+    IGNORE_PARAMETER(arg);
+    tcp_halfopen_tmr = 0;
+    tcp_halfopen_purge(NULL, now);
+    if (tcp_halfopen_count)
+        tcp_halfopen_tmr = pico_timer_add(PICO_TCP_HALFOPEN_SWEEP, tcp_halfopen_sweep, NULL);
+}
+#else
+/* Without the table, a SYN clones the listener at once (see tcp_syn()) */
+static struct tcp_halfopen *tcp_halfopen_find(struct pico_socket *s, struct pico_frame *f)
+{
+    IGNORE_PARAMETER(s);
+    IGNORE_PARAMETER(f);
+    return NULL;
+}
+
+static void tcp_halfopen_del(struct tcp_halfopen *h)
+{
+    IGNORE_PARAMETER(h);
+}
+
+static void tcp_halfopen_purge(struct pico_socket *s, pico_time now)
+{
+    IGNORE_PARAMETER(s);
+    IGNORE_PARAMETER(now);
+}
+#endif
+
+/* The options of a SYN, kept until the socket exists */
+static void tcp_halfopen_parse(struct tcp_halfopen *h, struct pico_frame *f)
+{
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    uint8_t *opt = f->transport_hdr + PICO_SIZE_TCPHDR;
+    uint32_t optlen = (uint32_t)((hdr->len & 0xf0u) >> 2u) - PICO_SIZE_TCPHDR;
+    uint32_t i = 0;
+    uint8_t type, len;
+
+    h->irs = long_be(hdr->seq);
+    h->rwnd = short_be(hdr->rwnd);
+    h->jumbo = hdr->len & 0x07;
+    h->mss = 0;
+    h->wscale = 0;
+    h->ws_ok = 0;
+    h->sack_ok = 0;
+    h->ts_ok = 0;
+    if (((hdr->len & 0xf0u) >> 2u) < PICO_SIZE_TCPHDR || optlen > (uint32_t)(f->transport_len - PICO_SIZE_TCPHDR))
+        return;
+
+    while (i < optlen) {
+        type = opt[i++];
+        if (type == PICO_TCP_OPTION_END)
+            break;
+
+        if (type == PICO_TCP_OPTION_NOOP)
+            continue;
+
+        if ((i >= optlen) || (opt[i] < 2) || (i + opt[i] - 1u > optlen))
+            break;
+
+        len = opt[i++];
+        if ((type == PICO_TCP_OPTION_MSS) && (len == PICO_TCPOPTLEN_MSS)) {
+            h->mss = short_be(short_from(opt + i));
+        } else if ((type == PICO_TCP_OPTION_WS) && (len == PICO_TCPOPTLEN_WS)) {
+            h->wscale = opt[i];
+            h->ws_ok = 1;
+        } else if ((type == PICO_TCP_OPTION_SACK_OK) && (len == PICO_TCPOPTLEN_SACK_OK)) {
+            h->sack_ok = 1;
+        } else if ((type == PICO_TCP_OPTION_TIMESTAMP) && (len == PICO_TCPOPTLEN_TIMESTAMP)) {
+            h->ts_ok = 1;
+            h->ts_recent = long_be(long_from(opt + i));
+            h->ts_echo = long_be(long_from(opt + i + 4u));
+        }
+
+        i += len - 2u;
     }
+}
+
+#if defined(PICO_SUPPORT_TCP_HALFOPEN) || defined(PICO_SUPPORT_TCP_SYNCOOKIES)
+/* Maximum segment size a SYN-ACK to f can announce */
+static uint16_t tcp_halfopen_mss(struct pico_socket *s, struct pico_frame *f, const struct tcp_halfopen *h)
+{
+    uint32_t mss;
+
+    if (f->dev)
+        mss = f->dev->mtu - (IS_IPV4(f) ? PICO_SIZE_IP4HDR : PICO_SIZE_IP6HDR);
+    else
+        mss = pico_socket_get_mss(s);
+
+    mss -= PICO_SIZE_TCPHDR;
+    if (h->mss && (h->mss < mss))
+        mss = h->mss;
 
+    return (uint16_t)mss;
+}
 #endif
+
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+/* Fast Open cookie for the client of f: a MAC of both addresses */
+static void tcp_fastopen_cookie(struct pico_frame *f, uint8_t *cookie)
+{
+    union pico_address local, remote;
+    uint32_t m[10], mac[2];
+    uint32_t n;
+
+    tcp_syn_addresses(f, &local, &remote);
+    n = tcp_tuple_words(&local, &remote, IS_IPV4(f) ? PICO_SIZE_IP4 : PICO_SIZE_IP6, 0, 0, m);
+    m[n] = 0x54464f30u;
+    mac[0] = tcp_syn_hash(m, n + 1u);
+    m[n] = 0x54464f31u;
+    mac[1] = tcp_syn_hash(m, n + 1u);
+    memcpy(cookie, mac, TCP_FASTOPEN_COOKIE);
+}
+#endif
+
+#if defined(PICO_SUPPORT_TCP_HALFOPEN) || defined(PICO_SUPPORT_TCP_SYNCOOKIES)
+/* SYN-ACK for a connection that has no socket yet. A cookie SYN-ACK only
+ * offers SACK and timestamps if the peer did, as the options of the
+ * connection have to come back in the timestamp echoed. */
+static int tcp_halfopen_synack(struct pico_socket *s, struct pico_frame *f, const struct tcp_halfopen *h, int cookie)
+{
+    struct pico_frame *synack;
+    struct pico_tcp_hdr *hdr;
+    uint32_t tsecr = long_be(h->ts_recent);
+    uint32_t tsval = long_be(cookie ? h->ts_echo : (uint32_t)TCP_TIME);
+    uint16_t mss = tcp_halfopen_mss(s, f, h);
+    uint16_t opt_len = (uint16_t)(PICO_TCPOPTLEN_MSS + PICO_TCPOPTLEN_WS + PICO_TCPOPTLEN_END);
+    uint8_t sack_ok = (uint8_t)(!cookie || h->sack_ok), ts_ok = (uint8_t)(!cookie || h->ts_ok);
+    /* A cookie only keeps the window scale of the peer in the timestamps */
+    uint8_t shift = (h->ws_ok && ts_ok) ? tcp_autotune_wscale(TCP_AUTOTUNE_DEFAULT) : 0u;
+    uint8_t *opt;
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    uint8_t tfo_len = 0;
+    /* The SYN asked for a Fast Open cookie, or had one we did not take */
+    int fastopen = (TCP_SOCK(s)->fastopen & TCP_FASTOPEN_ON) && tcp_fastopen_option(f, &tfo_len);
+
+    if (fastopen)
+        opt_len = (uint16_t)(opt_len + PICO_TCPOPTLEN_FASTOPEN + TCP_FASTOPEN_COOKIE);
+#endif
+
+    if (sack_ok)
+        opt_len = (uint16_t)(opt_len + PICO_TCPOPTLEN_SACK_OK);
+
+    if (ts_ok)
+        opt_len = (uint16_t)(opt_len + PICO_TCPOPTLEN_TIMESTAMP);
+
+    opt_len = (uint16_t)(((opt_len + 3u) >> 2u) << 2u);
+    synack = s->net->alloc(s->net, NULL, (uint16_t)(PICO_SIZE_TCPHDR + opt_len));
+    if (!synack) {
+        pico_err = PICO_ERR_ENOMEM;
+        return -1;
+    }
+
+    tcp_fill_rst_payload(f, synack);
+    hdr = (struct pico_tcp_hdr *)synack->transport_hdr;
+    hdr->len = (uint8_t)((PICO_SIZE_TCPHDR + opt_len) << 2 | h->jumbo);
+    hdr->flags = PICO_TCP_SYN | PICO_TCP_ACK;
+    hdr->rwnd = short_be((uint16_t)((PICO_DEFAULT_SOCKETQ > 0xFFFF) ? 0xFFFF : PICO_DEFAULT_SOCKETQ));
+    hdr->seq = long_be(h->iss);
+    hdr->ack = long_be(h->irs + 1u);
+    hdr->urgent = 0;
+
+    opt = synack->transport_hdr + PICO_SIZE_TCPHDR;
+    memset(opt, PICO_TCP_OPTION_NOOP, opt_len);
+    *opt++ = PICO_TCP_OPTION_MSS;
+    *opt++ = PICO_TCPOPTLEN_MSS;
+    *opt++ = (uint8_t)(mss >> 8);
+    *opt++ = (uint8_t)(mss & 0xFF);
+    if (sack_ok) {
+        *opt++ = PICO_TCP_OPTION_SACK_OK;
+        *opt++ = PICO_TCPOPTLEN_SACK_OK;
+    }
+
+    *opt++ = PICO_TCP_OPTION_WS;
+    *opt++ = PICO_TCPOPTLEN_WS;
+    *opt++ = shift;
+    if (ts_ok) {
+        *opt++ = PICO_TCP_OPTION_TIMESTAMP;
+        *opt++ = PICO_TCPOPTLEN_TIMESTAMP;
+        memcpy(opt, &tsval, 4);
+        memcpy(opt + 4, &tsecr, 4);
+        opt += 8;
+    }
+
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    if (fastopen) {
+        *opt++ = PICO_TCP_OPTION_FASTOPEN;
+        *opt++ = PICO_TCPOPTLEN_FASTOPEN + TCP_FASTOPEN_COOKIE;
+        tcp_fastopen_cookie(f, opt);
+    }
+
+#endif
+    synack->transport_hdr[PICO_SIZE_TCPHDR + opt_len - 1u] = PICO_TCP_OPTION_END;
+    hdr->crc = 0;
+    hdr->crc = short_be(pico_tcp_checksum(synack));
+    tcp_reply_push(synack);
+    return 0;
+}
+#endif
+
+#ifdef PICO_SUPPORT_TCP_SYNCOOKIES
+/* SYN cookie (RFC 4987): our initial sequence number is
+ *   count[5] | MSS index[3] | MAC[24]
+ * where count ticks every 65.5 s and the MAC covers the tuple, the peer's
+ * sequence number, count and MSS index. A cookie is good for one or two ticks.
+ * If the peer uses timestamps, the low bits of our TSval carry its window
+ * scale (TCP_COOKIE_TS_WS if none) and SACK permission, as with Linux. */
+#define TCP_COOKIE_COUNT(now) ((uint32_t)((now) >> 16))
+#define TCP_COOKIE_AGE        1u
+#define TCP_COOKIE_TS_BITS    0x3Fu
+#define TCP_COOKIE_TS_WS      0x0Fu
+#define TCP_COOKIE_TS_SACK    0x10u
+#define TCP_COOKIE_WS_MAX     14u
+
+static const uint16_t tcp_cookie_mss[8] = {
+    216, 536, 1024, 1220, 1300, 1400, 1440, 1460
+};
+
+static PICO_TLS pico_time tcp_cookie_stamp = 0;
+
+static uint32_t tcp_syncookie_mac(struct pico_frame *f, uint32_t irs, uint32_t count, uint32_t mssind)
+{
+    uint32_t m[12];
+    uint32_t n = tcp_syn_tuple(f, m);
+
+    m[n++] = irs;
+    m[n++] = count;
+    m[n++] = mssind;
+    return tcp_syn_hash(m, n) & 0x00FFFFFFu;
+}
+
+static uint32_t tcp_syncookie_make(struct pico_frame *f, struct tcp_halfopen *h)
+{
+    uint32_t count = TCP_COOKIE_COUNT(TCP_TIME);
+    uint32_t mssind = 7;
+
+    while (mssind && h->mss && (tcp_cookie_mss[mssind] > h->mss))
+        mssind--;
+
+    h->mss = tcp_cookie_mss[mssind];
+    return ((count & 0x1Fu) << 27) | (mssind << 24) | tcp_syncookie_mac(f, h->irs, count, mssind);
+}
+
+/* Rebuild the half-open state of the ACK completing a cookie handshake */
+static int tcp_syncookie_check(struct pico_frame *f, struct tcp_halfopen *h)
+{
+    uint32_t cookie = ACKN(f) - 1u;
+    uint32_t count = TCP_COOKIE_COUNT(TCP_TIME);
+    uint32_t mssind = (cookie >> 24) & 0x07u;
+    uint32_t age;
+
+    memset(h, 0, sizeof(struct tcp_halfopen));
+    tcp_halfopen_parse(h, f);
+    h->irs--;
+    for (age = 0; (age <= TCP_COOKIE_AGE) && (age <= count); age++) {
+        if ((((count - age) & 0x1Fu) == (cookie >> 27)) &&
+            (tcp_syncookie_mac(f, h->irs, count - age, mssind) == (cookie & 0x00FFFFFFu)))
+            break;
+    }
+    if ((age > TCP_COOKIE_AGE) || (age > count))
+        return -1;
+
+    h->iss = cookie;
+    h->mss = tcp_cookie_mss[mssind];
+    h->wscale = 0;
+    h->ws_ok = 0;
+    h->sack_ok = 0;
+    if (h->ts_ok) {
+        h->wscale = (uint8_t)(h->ts_echo & TCP_COOKIE_TS_WS);
+        h->ws_ok = (h->wscale != TCP_COOKIE_TS_WS);
+        if (!h->ws_ok)
+            h->wscale = 0;
+
+        h->sack_ok = (h->ts_echo & TCP_COOKIE_TS_SACK) ? 1u : 0u;
+    }
+
+    return 0;
+}
+
+static int tcp_syncookie_reply(struct pico_socket *s, struct pico_frame *f)
+{
+    struct tcp_halfopen h;
+
+    memset(&h, 0, sizeof(h));
+    tcp_halfopen_parse(&h, f);
+    h.iss = tcp_syncookie_make(f, &h);
+    if (h.ts_ok) {
+        h.ts_echo = ((uint32_t)TCP_TIME & ~TCP_COOKIE_TS_BITS) | (h.sack_ok ? TCP_COOKIE_TS_SACK : 0u) |
+                    (!h.ws_ok ? TCP_COOKIE_TS_WS : ((h.wscale < TCP_COOKIE_WS_MAX) ? h.wscale : TCP_COOKIE_WS_MAX));
+        if (h.ts_echo > (uint32_t)TCP_TIME)
+            h.ts_echo -= TCP_COOKIE_TS_BITS + 1u;
+    }
+
+    if (tcp_halfopen_synack(s, f, &h, 1) < 0)
+        return -1;
+
+    tcp_cookie_stamp = TCP_TIME;
+    tcp_syn_counters.cookies_sent++;
+    return 0;
+}
+
+/* Only look for cookies in ACKs while we may have some outstanding */
+static int tcp_syncookie_expected(void)
+{
+    return tcp_cookie_stamp && (TCP_COOKIE_COUNT(TCP_TIME) - TCP_COOKIE_COUNT(tcp_cookie_stamp) <= TCP_COOKIE_AGE);
+}
+#else
+static int tcp_syncookie_reply(struct pico_socket *s, struct pico_frame *f)
+{
+    IGNORE_PARAMETER(s);
+    IGNORE_PARAMETER(f);
+    tcp_syn_counters.syn_dropped++;
+    return -1;
+}
+#endif
+
+/* The final ACK of a handshake arrived: the listener gets its child socket */
+static struct pico_socket_tcp *tcp_halfopen_spawn(struct pico_socket *s, struct pico_frame *f, const struct tcp_halfopen *h)
+{
+    struct pico_socket_tcp *new = NULL;
+    uint16_t mtu;
+
+    new = (struct pico_socket_tcp *)pico_socket_clone(s);
+    if (!new)
+        return NULL;
+
+#ifdef PICO_TCP_SUPPORT_SOCKET_STATS
+    if (!pico_timer_add(2000, sock_stats, s)) {
+        tcp_dbg("TCP: Failed to start socket statistics timer\n");
+        return NULL;
+    }
+#endif
+
+    new->sock.remote_port = ((struct pico_trans *)f->transport_hdr)->sport;
+    tcp_syn_addresses(f, &new->sock.local_addr, &new->sock.remote_addr);
     f->sock = &new->sock;
     mtu = (uint16_t)pico_socket_get_mss(&new->sock);
     new->mss = (uint16_t)(mtu - PICO_SIZE_TCPHDR);
-    tcp_parse_options(f);
+    if (h->mss) {
+        new->mss_ok = 1;
+        if (new->mss > h->mss)
+            new->mss = h->mss;
+    }
+
+    new->recv_wnd_scale = h->wscale;
+    new->scale_ok = h->ws_ok;
+    new->rcv_wscale = h->ws_ok ? tcp_autotune_wscale(TCP_AUTOTUNE_DEFAULT) : 0u;
+    new->autotune = TCP_AUTOTUNE_DEFAULT;
+    new->sack_ok = h->sack_ok;
+    new->ts_ok = h->ts_ok;
+    new->ts_nxt = h->ts_recent;
     new->tcpq_in.max_size = PICO_DEFAULT_SOCKETQ;
     new->tcpq_out.max_size = PICO_DEFAULT_SOCKETQ;
     new->tcpq_hold.max_size = 2u * mtu;
-    new->rcv_nxt = long_be(hdr->seq) + 1;
-    new->snd_nxt = long_be(pico_paws());
-    new->snd_last = new->snd_nxt;
-    new->cwnd = PICO_TCP_IW;
-    new->ssthresh = (uint16_t)((uint16_t)(PICO_DEFAULT_SOCKETQ / new->mss) -  (((uint16_t)(PICO_DEFAULT_SOCKETQ / new->mss)) >> 3u));
-    new->recv_wnd = short_be(hdr->rwnd);
-    new->jumbo = hdr->len & 0x07;
+    new->rcv_nxt = h->irs + 1u;
+    new->rcv_ackd = new->rcv_nxt;
+    new->snd_nxt = h->iss + 1u;
+    new->snd_last = h->iss;
+    new->cc.ops = TCP_SOCK(s)->cc.ops;
+    tcp_cc_init(new);
+    new->pacing = TCP_SOCK(s)->pacing;
+    new->zerocopy_rx = TCP_SOCK(s)->zerocopy_rx;
+    new->delack = TCP_SOCK(s)->delack;
+    new->delack_timeout = TCP_SOCK(s)->delack_timeout;
+    new->quickack = PICO_TCP_QUICKACKS;
+    new->recv_wnd = h->rwnd;
+    new->jumbo = h->jumbo;
     new->linger_timeout = PICO_SOCKET_LINGER_TIMEOUT;
-    s->number_of_pending_conn++;
     new->sock.parent = s;
     new->sock.wakeup = s->wakeup;
     rto_set(new, PICO_TCP_RTO_MIN);
-    /* Initialize timestamp values */
+    tcp_set_space(new);
     new->sock.state = PICO_SOCKET_STATE_BOUND | PICO_SOCKET_STATE_CONNECTED | PICO_SOCKET_STATE_TCP_SYN_RECV;
     pico_socket_add(&new->sock);
+    tcp_dbg("Handshake complete, socket added. snd_nxt is %08x\n", new->snd_nxt);
+    return new;
+}
+
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+static void tcp_wakeup_pending(struct pico_socket *s, uint16_t ev);
+
+/* A SYN with data and a good Fast Open cookie gets its socket at once: the
+ * listener can accept it and read the data before the handshake is over. */
+static int tcp_fastopen_accept(struct pico_socket *s, struct pico_frame *f)
+{
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    struct pico_socket_tcp *new;
+    struct tcp_halfopen h;
+    uint8_t cookie[TCP_FASTOPEN_COOKIE];
+    const uint8_t *opt;
+    uint8_t len = 0;
+
+    if (!(TCP_SOCK(s)->fastopen & TCP_FASTOPEN_ON) || !f->payload_len)
+        return -1;
+
+    opt = tcp_fastopen_option(f, &len);
+    if (!opt || !len)
+        return -1;
+
+    tcp_fastopen_cookie(f, cookie);
+    if ((len != TCP_FASTOPEN_COOKIE) || memcmp(opt, cookie, TCP_FASTOPEN_COOKIE)) {
+        tcp_syn_counters.fastopen_failed++;
+        return -1;
+    }
+
+    if (s->number_of_pending_conn >= s->max_backlog)
+        return -1;
+
+    memset(&h, 0, sizeof(h));
+    tcp_halfopen_parse(&h, f);
+    h.iss = long_be(pico_paws());
+    new = tcp_halfopen_spawn(s, f, &h);
+    if (!new)
+        return -1;
+
+    s->number_of_pending_conn++;
+    tcp_syn_counters.fastopen_accepted++;
+    new->fastopen = TCP_FASTOPEN_CHILD;
+    new->syn_data = f->payload_len;
+    new->rcv_processed = new->rcv_nxt;
+    new->sock.timestamp = TCP_TIME;
+
+    /* The data follows the SYN in sequence space */
+    hdr->seq = long_be(h.irs + 1u);
+    tcp_data_in(&new->sock, f);
+    new->snd_nxt--;
+    tcp_send_synack(&new->sock);
+
+    if (s->wakeup)
+        s->wakeup(PICO_SOCK_EV_CONN, s);
+
+    if (new->sock.ev_pending)
+        tcp_wakeup_pending(&new->sock, new->sock.ev_pending);
+
+    return 0;
+}
+#endif
+
+static int tcp_syn(struct pico_socket *s, struct pico_frame *f)
+{
+#ifdef PICO_SUPPORT_TCP_HALFOPEN
+    struct tcp_halfopen *h = tcp_halfopen_find(s, f);
+
+    if (!h) {
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+        if (tcp_fastopen_accept(s, f) == 0)
+            return 0;
+
+#endif
+        if (s->number_of_pending_conn >= s->max_backlog)
+            return tcp_syncookie_reply(s, f);
+
+        h = tcp_halfopen_add(s, f);
+        if (!h) {
+            tcp_syn_counters.syn_dropped++;
+            return -1;
+        }
+
+        s->number_of_pending_conn++;
+    }
+
+    /* A retransmitted SYN gets the same SYN-ACK again */
+    tcp_halfopen_parse(h, f);
+    tcp_halfopen_synack(s, f, h, 0);
+    tcp_dbg("SYNACK sent, half-open entry added. iss is %08x\n", h->iss);
+    return 0;
+#else
+    struct pico_socket_tcp *new;
+    struct tcp_halfopen h;
+
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    if (tcp_fastopen_accept(s, f) == 0)
+        return 0;
+
+#endif
+    if (s->number_of_pending_conn >= s->max_backlog)
+        return tcp_syncookie_reply(s, f);
+
+    /* The child socket waits for the end of the handshake in SYN_RECV */
+    memset(&h, 0, sizeof(h));
+    tcp_halfopen_parse(&h, f);
+    h.iss = long_be(pico_paws());
+    new = tcp_halfopen_spawn(s, f, &h);
+    if (!new) {
+        tcp_syn_counters.syn_dropped++;
+        return -1;
+    }
+
+    s->number_of_pending_conn++;
+    new->snd_nxt--;
     tcp_send_synack(&new->sock);
     tcp_dbg("SYNACK sent, socket added. snd_nxt is %08x\n", new->snd_nxt);
     return 0;
+#endif
+}
+
+#ifdef PICO_SUPPORT_TCP_TIMEWAIT
+/* TIME_WAIT record: all that is left of a connection once both FINs are
+ * acknowledged. The local and remote addresses follow it, PICO_SIZE_IP4 or
+ * PICO_SIZE_IP6 bytes each, so that an IPv4 record fits in 32 bytes. */
+struct tcp_timewait {
+    struct tcp_timewait *next;
+    uint32_t expire;    /* TCP_TIME, modulo 2^32 */
+    uint32_t snd_nxt;
+    uint32_t rcv_nxt;
+    uint16_t local_port;
+    uint16_t remote_port;
+    uint8_t addr_len;
+};
+
+#define TCP_TW_ADDR(tw) ((uint8_t *)((tw) + 1))
+
+static PICO_TLS struct tcp_timewait **tcp_timewait_table = NULL;
+static PICO_TLS uint32_t tcp_timewait_buckets = 0;
+static PICO_TLS uint32_t tcp_timewait_count = 0;
+static PICO_TLS uint32_t tcp_timewait_tmr = 0;
+
+static uint32_t tcp_timewait_hash(struct tcp_timewait *tw)
+{
+    uint32_t m[9];
+
+    return tcp_syn_hash(m, tcp_tuple_words(TCP_TW_ADDR(tw), TCP_TW_ADDR(tw) + tw->addr_len, tw->addr_len,
+                                           tw->local_port, tw->remote_port, m));
+}
+
+static void tcp_timewait_grow(void)
+{
+    uint32_t n = tcp_timewait_buckets ? (tcp_timewait_buckets << 1) : PICO_TCP_TIMEWAIT_MIN_BUCKETS;
+    struct tcp_timewait **table = PICO_ZALLOC(n * sizeof(struct tcp_timewait *));
+    struct tcp_timewait *tw, *next;
+    uint32_t i, b;
+
+    if (!table)
+        return; /* Keep the current table, chains just get longer */
+
+    for (i = 0; i < tcp_timewait_buckets; i++) {
+        for (tw = tcp_timewait_table[i]; tw; tw = next) {
+            next = tw->next;
+            b = tcp_timewait_hash(tw) & (n - 1);
+            tw->next = table[b];
+            table[b] = tw;
+        }
+    }
+    if (tcp_timewait_table)
+        PICO_FREE(tcp_timewait_table);
+
+    tcp_timewait_table = table;
+    tcp_timewait_buckets = n;
+}
+
+static struct tcp_timewait *tcp_timewait_find(struct pico_frame *f)
+{
+    struct pico_trans *tr = (struct pico_trans *)f->transport_hdr;
+    union pico_address local, remote;
+    struct tcp_timewait *tw;
+    uint32_t len = IS_IPV4(f) ? PICO_SIZE_IP4 : PICO_SIZE_IP6;
+    uint32_t m[9];
+
+    if (!tcp_timewait_count)
+        return NULL;
+
+    tcp_syn_addresses(f, &local, &remote);
+    tw = tcp_timewait_table[tcp_syn_hash(m, tcp_tuple_words(&local, &remote, len, tr->dport, tr->sport, m)) & (tcp_timewait_buckets - 1)];
+    for (; tw; tw = tw->next) {
+        if ((tw->addr_len == len) && (tw->local_port == tr->dport) && (tw->remote_port == tr->sport) &&
+            !memcmp(TCP_TW_ADDR(tw), &local, len) && !memcmp(TCP_TW_ADDR(tw) + len, &remote, len))
+            return tw;
+    }
+    return NULL;
+}
+
+static void tcp_timewait_del(struct tcp_timewait *tw)
+{
+    struct tcp_timewait **pp;
+
+    for (pp = &tcp_timewait_table[tcp_timewait_hash(tw) & (tcp_timewait_buckets - 1)]; *pp; pp = &(*pp)->next) {
+        if (*pp == tw) {
+            *pp = tw->next;
+            break;
+        }
+    }
+    PICO_FREE(tw);
+    if (--tcp_timewait_count == 0) {
+        PICO_FREE(tcp_timewait_table);
+        tcp_timewait_table = NULL;
+        tcp_timewait_buckets = 0;
+    }
+}
+
+static void tcp_timewait_sweep(pico_time now, void *arg)
+{
+    struct tcp_timewait *tw, *next;
+    uint32_t i;
+
+    IGNORE_PARAMETER(arg);
+    tcp_timewait_tmr = 0;
+    for (i = 0; i < tcp_timewait_buckets; i++) {
+        for (tw = tcp_timewait_table[i]; tw; tw = next) {
+            next = tw->next;
+            if ((int32_t)(tw->expire - (uint32_t)now) <= 0)
+                tcp_timewait_del(tw); /* The last one takes the table along, ending the loop */
+        }
+    }
+    if (tcp_timewait_count)
+        tcp_timewait_tmr = pico_timer_add(PICO_TCP_TIMEWAIT_SWEEP, tcp_timewait_sweep, NULL);
+}
+
+static int tcp_timewait_add(struct pico_socket_tcp *t)
+{
+    struct tcp_timewait *tw;
+    uint32_t len = PICO_SIZE_IP4, b;
+
+#ifdef PICO_SUPPORT_IPV6
+    if (t->sock.net == &pico_proto_ipv6)
+        len = PICO_SIZE_IP6;
+#endif
+    if (!tcp_timewait_tmr) {
+        tcp_timewait_tmr = pico_timer_add(PICO_TCP_TIMEWAIT_SWEEP, tcp_timewait_sweep, NULL);
+        if (!tcp_timewait_tmr)
+            return -1;
+    }
+
+    if (tcp_timewait_count >= tcp_timewait_buckets)
+        tcp_timewait_grow();
+
+    if (!tcp_timewait_table)
+        return -1;
+
+    tw = PICO_ZALLOC(sizeof(struct tcp_timewait) + 2u * len);
+    if (!tw)
+        return -1;
+
+    tw->expire = (uint32_t)(TCP_TIME + t->linger_timeout);
+    tw->snd_nxt = t->snd_nxt;
+    tw->rcv_nxt = t->rcv_nxt;
+    tw->local_port = t->sock.local_port;
+    tw->remote_port = t->sock.remote_port;
+    tw->addr_len = (uint8_t)len;
+    memcpy(TCP_TW_ADDR(tw), &t->sock.local_addr, len);
+    memcpy(TCP_TW_ADDR(tw) + len, &t->sock.remote_addr, len);
+    b = tcp_timewait_hash(tw) & (tcp_timewait_buckets - 1);
+    tw->next = tcp_timewait_table[b];
+    tcp_timewait_table[b] = tw;
+    tcp_timewait_count++;
+    return 0;
+}
+
+/* Both FINs are acknowledged: the socket goes now, TIME_WAIT goes on in a
+ * record for the linger timeout. Without memory for it, the socket stays. */
+static void tcp_time_wait(struct pico_socket_tcp *t)
+{
+    if (t->linger_timeout && (tcp_timewait_add(t) < 0)) {
+        tcp_linger(t);
+        return;
+    }
+
+    pico_timer_cancel(t->fin_tmr);
+    t->fin_tmr = 0;
+    tcp_deltcb((pico_time)0, t);
+}
+
+static void tcp_timewait_reply(struct pico_frame *f, struct tcp_timewait *tw, uint8_t flags)
+{
+    struct pico_frame *r = NULL;
+    struct pico_tcp_hdr *hdr;
+
+#ifdef PICO_SUPPORT_IPV4
+    if (IS_IPV4(f))
+        r = pico_proto_ipv4.alloc(&pico_proto_ipv4, NULL, PICO_SIZE_TCPHDR);
+#endif
+#ifdef PICO_SUPPORT_IPV6
+    if (IS_IPV6(f))
+        r = pico_proto_ipv6.alloc(&pico_proto_ipv6, NULL, PICO_SIZE_TCPHDR);
+#endif
+    if (!r)
+        return;
+
+    tcp_fill_rst_payload(f, r);
+    hdr = (struct pico_tcp_hdr *)r->transport_hdr;
+    hdr->len = (uint8_t)(PICO_SIZE_TCPHDR << 2);
+    hdr->flags = (uint8_t)(flags | PICO_TCP_ACK);
+    hdr->rwnd = 0;
+    hdr->seq = long_be(tw->snd_nxt);
+    hdr->ack = long_be(tw->rcv_nxt);
+    hdr->urgent = 0;
+    hdr->crc = 0;
+    hdr->crc = short_be(pico_tcp_checksum(r));
+    tcp_reply_push(r);
+}
+
+/* A segment no socket took, maybe for a connection in TIME_WAIT. Returns 0
+ * and consumes f if so. A retransmitted FIN is acknowledged again, data is
+ * answered with a reset, a SYN beyond the last sequence number opens a new
+ * connection on the tuple and RSTs are ignored (RFC 1337). */
+int pico_tcp_timewait_input(struct pico_frame *f)
+{
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    struct tcp_timewait *tw = tcp_timewait_find(f);
+    uint32_t hlen = (uint32_t)((hdr->len & 0xf0u) >> 2u);
+
+    if (!tw)
+        return -1;
+
+    if (hdr->flags & PICO_TCP_RST) {
+        tcp_dbg("TCP> RST in TIME_WAIT, ignored\n");
+    } else if (hdr->flags == PICO_TCP_SYN) {
+        if (pico_seq_compare(SEQN(f), tw->rcv_nxt) > 0) {
+            tcp_timewait_del(tw);
+            return -1;
+        }
+
+        tcp_timewait_reply(f, tw, PICO_TCP_ACK);
+    } else if ((hdr->flags & PICO_TCP_SYN) || (f->transport_len > hlen)) {
+        tcp_timewait_reply(f, tw, PICO_TCP_RST);
+    } else if (hdr->flags & PICO_TCP_FIN) {
+        tcp_timewait_reply(f, tw, PICO_TCP_ACK);
+    }
+
+    pico_frame_discard(f);
+    return 0;
 }
+#else
+/* Without the records, the socket itself lingers in TIME_WAIT */
+static void tcp_time_wait(struct pico_socket_tcp *t)
+{
+    tcp_linger(t);
+}
+#endif
 
 static int tcp_synrecv_syn(struct pico_socket *s, struct pico_frame *f)
 {
     struct pico_tcp_hdr *hdr = NULL;
     struct pico_socket_tcp *t = TCP_SOCK(s);
     hdr = (struct pico_tcp_hdr *)f->transport_hdr;
-    if (t->rcv_nxt == long_be(hdr->seq) + 1u) {
+    if (t->rcv_nxt == long_be(hdr->seq) + 1u + t->syn_data) {
         /* take back our own SEQ number to its original value,
          * so the synack retransmitted is identical to the original.
          */
@@ -2463,12 +5008,302 @@ uint16_t pico_tcp_get_socket_mss(struct pico_socket *s)
         return (uint16_t)pico_socket_get_mss(s);
 }
 
+#ifdef PICO_SUPPORT_TCP_GSO
+/* Payload of each packet a super-segment is cut into */
+static uint16_t tcp_gso_packet_payload(struct pico_socket_tcp *t)
+{
+    return (uint16_t)(pico_tcp_get_socket_mss(&t->sock) - pico_tcp_overhead(&t->sock));
+}
+
+/* Transport length of the largest segment to queue now: as many packets as
+ * fit in the free space of the output queue, up to PICO_TCP_GSO_MAX bytes.
+ * 6LoWPAN links fragment at their own layer and always get single packets.
+ */
+uint16_t pico_tcp_get_socket_gso(struct pico_socket *s)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *) s;
+    uint32_t overhead = pico_tcp_overhead(s);
+    uint32_t seg = tcp_gso_packet_payload(t);
+    uint32_t room = 0, n;
+
+    /* Room left once the network and link headers are accounted for */
+    if (t->tcpq_out.max_size > t->tcpq_out.size + overhead + PICO_SIZE_IP6HDR + PICO_SIZE_ETHHDR)
+        room = t->tcpq_out.max_size - t->tcpq_out.size - overhead - PICO_SIZE_IP6HDR - PICO_SIZE_ETHHDR;
+
+    if (room > PICO_TCP_GSO_MAX)
+        room = PICO_TCP_GSO_MAX;
+
+    n = room / seg;
+    if ((n < 2) || PICO_DEV_IS_6LOWPAN(get_sock_dev(s)))
+        return pico_tcp_get_socket_mss(s);
+
+    return (uint16_t)(overhead + (n * seg));
+}
+
+/* Cut super-segment f, on its way out of the IP layer, in packets of
+ * f->gso_size payload bytes. The headers are copied and fixed up for each
+ * packet, the payload is referenced. Returns the packets linked through
+ * their next pointer, or NULL if out of memory.
+ */
+struct pico_frame *pico_tcp_gso_segment(struct pico_frame *f)
+{
+    struct pico_frame *pkt, *head = NULL, **tail = &head;
+    struct pico_tcp_hdr *hdr;
+    uint32_t hdr_len, off, n, seq;
+    uint16_t net_len, tcp_len, id = 0, i = 0;
+    uint8_t flags;
+
+    /* Headers and payload are expected in the same segment */
+    if (((f->payload < f->start) || (f->payload > f->start + f->len)) && (pico_frame_linearize(f) < 0))
+        return NULL;
+
+    hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    hdr_len = (uint32_t)(f->payload - f->start);
+    net_len = (uint16_t)(f->transport_hdr - f->net_hdr);
+    tcp_len = (uint16_t)(f->payload - f->transport_hdr);
+    seq = long_be(hdr->seq);
+    flags = hdr->flags;
+#ifdef PICO_SUPPORT_IPV4
+    if (IS_IPV4(f))
+        id = short_be(((struct pico_ipv4_hdr *)f->net_hdr)->id);
+
+#endif
+
+    for (off = 0; off < f->payload_len; off += n) {
+        n = (uint32_t)f->payload_len - off;
+        if (n > f->gso_size)
+            n = f->gso_size;
+
+        pkt = pico_frame_alloc(hdr_len);
+        if (!pkt)
+            goto fail;
+
+        *tail = pkt;
+        tail = &pkt->next;
+        pkt->chain = pico_frame_payload_ref(f, off, n);
+        if (!pkt->chain)
+            goto fail;
+
+        memcpy(pkt->buffer, f->start, hdr_len);
+        pkt->dev = f->dev;
+        pkt->proto = f->proto;
+        pkt->timestamp = f->timestamp;
+        if ((f->datalink_hdr >= f->start) && (f->datalink_hdr < f->net_hdr))
+            pkt->datalink_hdr = pkt->buffer + (f->datalink_hdr - f->start);
+
+        pkt->net_hdr = pkt->buffer + (f->net_hdr - f->start);
+        pkt->net_len = f->net_len;
+        pkt->transport_hdr = pkt->net_hdr + net_len;
+        pkt->transport_len = (uint16_t)(tcp_len + n);
+        pkt->payload = pkt->buffer + hdr_len;
+        pkt->payload_len = (uint16_t)n;
+
+#ifdef PICO_SUPPORT_IPV4
+        if (IS_IPV4(pkt)) {
+            struct pico_ipv4_hdr *ip4 = (struct pico_ipv4_hdr *)pkt->net_hdr;
+            ip4->len = short_be((uint16_t)(net_len + pkt->transport_len));
+            ip4->id = short_be((uint16_t)(id + i));
+            ip4->crc = 0;
+            ip4->crc = short_be(pico_checksum(ip4, net_len));
+        }
+
+#endif
+#ifdef PICO_SUPPORT_IPV6
+        if (IS_IPV6(pkt)) {
+            struct pico_ipv6_hdr *ip6 = (struct pico_ipv6_hdr *)pkt->net_hdr;
+            ip6->len = short_be((uint16_t)(net_len - PICO_SIZE_IP6HDR + pkt->transport_len));
+        }
+
+#endif
+        hdr = (struct pico_tcp_hdr *)pkt->transport_hdr;
+        hdr->seq = long_be(seq + off);
+        if (off + n < f->payload_len)
+            hdr->flags = (uint8_t)(flags & ~(PICO_TCP_FIN | PICO_TCP_PSH));
+
+        /* No socket: the pseudo header comes from the (possibly NATed) IP header */
+        hdr->crc = 0;
+        hdr->crc = short_be(pico_tcp_checksum(pkt));
+        i++;
+    }
+    return head;
+
+fail:
+    while (head) {
+        pkt = head->next;
+        pico_frame_discard(head);
+        head = pkt;
+    }
+    return NULL;
+}
+#endif
+
+#ifdef PICO_SUPPORT_TCP_GRO
+#define TCP_GRO_HDR_LEN(f) ((uint16_t)((((struct pico_tcp_hdr *)(f)->transport_hdr)->len & 0xf0u) >> 2u))
+
+static uint16_t tcp_gro_add(uint16_t a, uint16_t b)
+{
+    uint32_t sum = (uint32_t)a + b;
+    return (uint16_t)((sum & 0xFFFFu) + (sum >> 16));
+}
+
+/* Checksum of the pseudo header and the TCP header of f for a segment of
+ * len bytes. When the checksum of f is valid, with len set to its own
+ * length this is the sum of its payload.
+ */
+static uint16_t tcp_gro_hdr_checksum(struct pico_frame *f, uint16_t len)
+{
+#ifdef PICO_SUPPORT_IPV4
+    if (IS_IPV4(f)) {
+        struct pico_ipv4_hdr *ip = (struct pico_ipv4_hdr *)f->net_hdr;
+        struct pico_ipv4_pseudo_hdr pseudo;
+        pseudo.src.addr = ip->src.addr;
+        pseudo.dst.addr = ip->dst.addr;
+        pseudo.zeros = 0;
+        pseudo.proto = PICO_PROTO_TCP;
+        pseudo.len = short_be(len);
+        return pico_dualbuffer_checksum(&pseudo, sizeof(pseudo), f->transport_hdr, TCP_GRO_HDR_LEN(f));
+    }
+
+#endif
+#ifdef PICO_SUPPORT_IPV6
+    if (IS_IPV6(f)) {
+        struct pico_ipv6_hdr *ip = (struct pico_ipv6_hdr *)f->net_hdr;
+        struct pico_ipv6_pseudo_hdr pseudo;
+        pseudo.src = ip->src;
+        pseudo.dst = ip->dst;
+        pseudo.len = long_be(len);
+        pseudo.zero[0] = 0;
+        pseudo.zero[1] = 0;
+        pseudo.zero[2] = 0;
+        pseudo.nxthdr = PICO_PROTO_TCP;
+        return pico_dualbuffer_checksum(&pseudo, sizeof(pseudo), f->transport_hdr, TCP_GRO_HDR_LEN(f));
+    }
+
+#endif
+    return 0;
+}
+
+/* Bulk data only: no SYN, FIN, RST or URG. PSH does not hold data back in
+ * this stack, so it does not stop a merge either. */
+static int tcp_gro_candidate(struct pico_frame *f)
+{
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+
+    return hdr && !f->chain && ((hdr->flags & (uint8_t)~PICO_TCP_PSH) == PICO_TCP_ACK) &&
+           (f->transport_len > TCP_GRO_HDR_LEN(f)) && (TCP_GRO_HDR_LEN(f) >= PICO_SIZE_TCPHDR);
+}
+
+/* nxt carries the data right after f, on the same flow, acknowledging the
+ * same data with the same options */
+static int tcp_gro_match(struct pico_frame *f, struct pico_frame *nxt)
+{
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    struct pico_tcp_hdr *nhdr = (struct pico_tcp_hdr *)nxt->transport_hdr;
+    uint16_t hlen = TCP_GRO_HDR_LEN(f);
+
+    if (!nhdr || nxt->chain || (nxt->dev != f->dev) || (nxt->net_len != f->net_len))
+        return 0;
+
+    if ((nhdr->flags & (uint8_t)~PICO_TCP_PSH) != PICO_TCP_ACK)
+        return 0;
+
+    if ((TCP_GRO_HDR_LEN(nxt) != hlen) || (nxt->transport_len <= hlen) ||
+        ((uint32_t)f->transport_len + nxt->transport_len - hlen > hlen + PICO_TCP_GRO_MAX))
+        return 0;
+
+    if ((nhdr->trans.sport != hdr->trans.sport) || (nhdr->trans.dport != hdr->trans.dport) ||
+        (nhdr->ack != hdr->ack) || (long_be(nhdr->seq) != long_be(hdr->seq) + f->transport_len - hlen))
+        return 0;
+
+    if (memcmp(nhdr + 1, hdr + 1, (size_t)(hlen - PICO_SIZE_TCPHDR)) != 0)
+        return 0;
+
+#ifdef PICO_SUPPORT_IPV4
+    if (IS_IPV4(f)) {
+        struct pico_ipv4_hdr *ip = (struct pico_ipv4_hdr *)f->net_hdr;
+        struct pico_ipv4_hdr *nip = (struct pico_ipv4_hdr *)nxt->net_hdr;
+        return IS_IPV4(nxt) && (nip->src.addr == ip->src.addr) && (nip->dst.addr == ip->dst.addr);
+    }
+
+#endif
+#ifdef PICO_SUPPORT_IPV6
+    if (IS_IPV6(f)) {
+        struct pico_ipv6_hdr *ip = (struct pico_ipv6_hdr *)f->net_hdr;
+        struct pico_ipv6_hdr *nip = (struct pico_ipv6_hdr *)nxt->net_hdr;
+        return IS_IPV6(nxt) && (memcmp(&nip->src, &ip->src, sizeof(struct pico_ip6)) == 0) &&
+               (memcmp(&nip->dst, &ip->dst, sizeof(struct pico_ip6)) == 0);
+    }
+
+#endif
+    return 0;
+}
+
+/* Receive offload: the segments of the same flow that follow f in q are
+ * chained to it as payload references, so that the socket lookup, the
+ * input state machine and the ACK run once for all of them. The merged
+ * segment gets the checksum it would have had on the wire: it is valid
+ * only if the checksums of all the merged segments were.
+ */
+static struct pico_frame *tcp_gro_merge(struct pico_queue *q, struct pico_frame *f)
+{
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    struct pico_frame *nxt, *ref, **tail = &f->chain;
+    uint16_t hlen, sum, part;
+
+    if (!tcp_gro_candidate(f))
+        return f;
+
+    hlen = TCP_GRO_HDR_LEN(f);
+    f->payload = f->transport_hdr + hlen;
+    f->payload_len = (uint16_t)(f->transport_len - hlen);
+    sum = tcp_gro_hdr_checksum(f, f->transport_len);
+    for (nxt = pico_queue_peek(q); nxt && tcp_gro_match(f, nxt); nxt = pico_queue_peek(q)) {
+        nxt->payload = nxt->transport_hdr + hlen;
+        nxt->payload_len = (uint16_t)(nxt->transport_len - hlen);
+        ref = pico_frame_payload_ref(nxt, 0, nxt->payload_len);
+        if (!ref)
+            break;
+
+        part = tcp_gro_hdr_checksum(nxt, nxt->transport_len);
+        if (f->payload_len & 1u)
+            part = (uint16_t)((part << 8) | (part >> 8));
+
+        sum = tcp_gro_add(sum, part);
+        *tail = ref;
+        while (*tail)
+            tail = &(*tail)->chain;
+        f->payload_len = (uint16_t)(f->payload_len + nxt->payload_len);
+        f->transport_len = (uint16_t)(f->transport_len + nxt->payload_len);
+        hdr->rwnd = ((struct pico_tcp_hdr *)nxt->transport_hdr)->rwnd;
+        hdr->flags |= ((struct pico_tcp_hdr *)nxt->transport_hdr)->flags;
+        pico_frame_discard(pico_dequeue(q));
+    }
+
+    if (f->chain) {
+        hdr->crc = 0;
+        hdr->crc = short_be((uint16_t)~tcp_gro_add((uint16_t)~tcp_gro_hdr_checksum(f, f->transport_len), sum));
+    }
+
+    return f;
+}
+
+static int pico_tcp_process_in(struct pico_protocol *self, struct pico_frame *f)
+{
+    return pico_transport_process_in(self, tcp_gro_merge(self->q_in, f));
+}
+#endif
+
 static int tcp_synack(struct pico_socket *s, struct pico_frame *f)
 {
     struct pico_socket_tcp *t = (struct pico_socket_tcp *) s;
     struct pico_tcp_hdr *hdr  = (struct pico_tcp_hdr *)f->transport_hdr;
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    int data_acked = (pico_seq_compare(ACKN(f), t->snd_nxt + 1u) > 0);
+#endif
 
-    if (ACKN(f) ==  (1u + t->snd_nxt)) {
+    /* The SYN may have carried data the server took or ignored */
+    if ((pico_seq_compare(ACKN(f), t->snd_nxt + 1u) >= 0) &&
+        (pico_seq_compare(ACKN(f), t->snd_nxt + 1u + t->syn_data) <= 0)) {
         /* Get rid of initconn retry */
         pico_timer_cancel(t->retrans_tmr);
         t->retrans_tmr = 0;
@@ -2476,6 +5311,12 @@ static int tcp_synack(struct pico_socket *s, struct pico_frame *f)
         t->rcv_nxt = long_be(hdr->seq);
         t->rcv_processed = t->rcv_nxt + 1;
         tcp_ack(s, f);
+        /* Without window scaling on both sides, ours does not apply */
+        if (!t->scale_ok)
+            t->rcv_wscale = 0;
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+        tcp_fastopen_synack(t, f, data_acked);
+#endif
 
         s->state &= 0x00FFU;
         s->state |= PICO_SOCKET_STATE_TCP_ESTABLISHED;
@@ -2487,7 +5328,7 @@ static int tcp_synack(struct pico_socket *s, struct pico_frame *f)
         s->ev_pending |= PICO_SOCK_EV_WR;
 
         t->rcv_nxt++;
-        t->snd_nxt++;
+        t->snd_nxt = ACKN(f);
         tcp_send_ack(t);              /* return ACK */
 
         return 0;
@@ -2502,17 +5343,37 @@ static int tcp_synack(struct pico_socket *s, struct pico_frame *f)
     }
 }
 
+/* The ACK of our SYN-ACK. A Fast Open child may have sent data since. */
+static int tcp_first_ack_valid(struct pico_socket_tcp *t, struct pico_frame *f)
+{
+    struct pico_frame *una = first_segment(&t->tcpq_out);
+
+    if (t->snd_nxt == ACKN(f))
+        return 1;
+
+    return (t->fastopen & TCP_FASTOPEN_CHILD) && una && (pico_seq_compare(ACKN(f), SEQN(una)) >= 0) &&
+           (pico_seq_compare(ACKN(f), t->snd_nxt) < 0);
+}
+
 static int tcp_first_ack(struct pico_socket *s, struct pico_frame *f)
 {
     struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
     struct pico_tcp_hdr *hdr  = (struct pico_tcp_hdr *)f->transport_hdr;
     tcp_dbg("ACK in SYN_RECV: expecting %08x got %08x\n", t->snd_nxt, ACKN(f));
-    if (t->snd_nxt == ACKN(f)) {
-        tcp_set_init_point(s);
+    if (tcp_first_ack_valid(t, f)) {
+        /* A Fast Open child was announced with the data of its SYN */
+        if (!(t->fastopen & TCP_FASTOPEN_CHILD))
+            tcp_set_init_point(s);
+
         tcp_ack(s, f);
         s->state &= 0x00FFU;
         s->state |= PICO_SOCKET_STATE_TCP_ESTABLISHED;
         tcp_dbg("TCP: Established. State now: %04x\n", s->state);
+        if (t->fastopen & TCP_FASTOPEN_CHILD) {
+            s->ev_pending |= PICO_SOCK_EV_WR;
+            return 0;
+        }
+
         if( !s->parent && s->wakeup) {              /* If the socket has no parent, -> sending socket that has a sim_open */
             tcp_dbg("FIRST ACK - No parent found -> sending socket\n");
             s->wakeup(PICO_SOCK_EV_CONN,  s);
@@ -2627,7 +5488,7 @@ static int tcp_finack(struct pico_socket *s, struct pico_frame *f)
     /* set SHUT_REMOTE */
     s->state |= PICO_SOCKET_STATE_SHUT_REMOTE;
 
-    tcp_linger(t);
+    tcp_time_wait(t);
 
     return 0;
 }
@@ -2727,11 +5588,14 @@ struct tcp_action_entry {
     int (*rst)(struct pico_socket *s, struct pico_frame *f);
 };
 
+static int tcp_listen_ack(struct pico_socket *s, struct pico_frame *f);
+static int tcp_listen_rst(struct pico_socket *s, struct pico_frame *f);
+
 static const struct tcp_action_entry tcp_fsm[] = {
     /* State                              syn              synack             ack                data             fin              finack           rst*/
     { PICO_SOCKET_STATE_TCP_UNDEF,        NULL,            NULL,              NULL,              NULL,            NULL,            NULL,            NULL     },
     { PICO_SOCKET_STATE_TCP_CLOSED,       NULL,            NULL,              NULL,              NULL,            NULL,            NULL,            NULL     },
-    { PICO_SOCKET_STATE_TCP_LISTEN,       &tcp_syn,        NULL,              NULL,              NULL,            NULL,            NULL,            NULL     },
+    { PICO_SOCKET_STATE_TCP_LISTEN,       &tcp_syn,        NULL,              &tcp_listen_ack,   NULL,            NULL,            &tcp_listen_ack, &tcp_listen_rst },
     { PICO_SOCKET_STATE_TCP_SYN_SENT,     NULL,            &tcp_synack,       NULL,              NULL,            NULL,            NULL,            &tcp_rst },
     { PICO_SOCKET_STATE_TCP_SYN_RECV,     &tcp_synrecv_syn, NULL,              &tcp_first_ack,    &tcp_data_in,    NULL,            &tcp_closeconn,  &tcp_rst },
     { PICO_SOCKET_STATE_TCP_ESTABLISHED,  &tcp_halfopencon, &tcp_ack,         &tcp_ack,          &tcp_data_in,    &tcp_closewait,  &tcp_closewait,  &tcp_rst },
@@ -2750,7 +5614,7 @@ static uint8_t invalid_flags(struct pico_socket *s, uint8_t flags)
     static const uint8_t valid_flags[PICO_SOCKET_STATE_TCP_ARRAYSIZ][MAX_VALID_FLAGS] = {
         { /* PICO_SOCKET_STATE_TCP_UNDEF      */ 0, },
         { /* PICO_SOCKET_STATE_TCP_CLOSED     */ 0, },
-        { /* PICO_SOCKET_STATE_TCP_LISTEN     */ PICO_TCP_SYN },
+        { /* PICO_SOCKET_STATE_TCP_LISTEN     */ PICO_TCP_SYN, PICO_TCP_ACK, PICO_TCP_PSHACK, PICO_TCP_FINACK, PICO_TCP_FINPSHACK, PICO_TCP_RST, PICO_TCP_RSTACK},
         { /* PICO_SOCKET_STATE_TCP_SYN_SENT   */ PICO_TCP_SYNACK, PICO_TCP_RST, PICO_TCP_RSTACK},
         { /* PICO_SOCKET_STATE_TCP_SYN_RECV   */ PICO_TCP_SYN, PICO_TCP_ACK, PICO_TCP_PSH, PICO_TCP_PSHACK, PICO_TCP_FINACK, PICO_TCP_FINPSHACK, PICO_TCP_RST},
         { /* PICO_SOCKET_STATE_TCP_ESTABLISHED*/ PICO_TCP_SYN, PICO_TCP_SYNACK, PICO_TCP_ACK, PICO_TCP_PSH, PICO_TCP_PSHACK, PICO_TCP_FIN, PICO_TCP_FINACK, PICO_TCP_FINPSHACK, PICO_TCP_RST, PICO_TCP_RSTACK},
@@ -2807,6 +5671,90 @@ static int tcp_action_by_flags(const struct tcp_action_entry *action, struct pic
     return ret;
 }
 
+/* ACK to a listener: the end of a handshake from the half-open table or
+ * with a SYN cookie, else a segment for a connection we do not know. */
+static int tcp_listen_ack(struct pico_socket *s, struct pico_frame *f)
+{
+    struct tcp_halfopen *h = tcp_halfopen_find(s, f);
+    struct pico_socket_tcp *new = NULL;
+#ifdef PICO_SUPPORT_TCP_SYNCOOKIES
+    struct tcp_halfopen cookie;
+#endif
+
+    if (h) {
+        if ((ACKN(f) != h->iss + 1u) || (SEQN(f) != h->irs + 1u))
+            return pico_tcp_reply_rst(f);
+
+        new = tcp_halfopen_spawn(s, f, h);
+        if (!new)
+            return -1; /* Keep the entry, the peer will send again */
+
+        tcp_halfopen_del(h);
+#ifdef PICO_SUPPORT_TCP_SYNCOOKIES
+    } else if (tcp_syncookie_expected()) {
+        if (tcp_syncookie_check(f, &cookie) < 0) {
+            tcp_syn_counters.cookies_failed++;
+            return pico_tcp_reply_rst(f);
+        }
+
+        new = tcp_halfopen_spawn(s, f, &cookie);
+        if (!new)
+            return -1;
+
+        s->number_of_pending_conn++;
+        tcp_syn_counters.cookies_validated++;
+#endif
+    } else {
+        return pico_tcp_reply_rst(f);
+    }
+
+    tcp_action_by_flags(&tcp_fsm[PICO_SOCKET_STATE_TCP_SYN_RECV >> 8], &new->sock, f, ((struct pico_tcp_hdr *)f->transport_hdr)->flags);
+    if (new->sock.ev_pending)
+        tcp_wakeup_pending(&new->sock, new->sock.ev_pending);
+
+    return 0;
+}
+
+static int tcp_listen_rst(struct pico_socket *s, struct pico_frame *f)
+{
+    struct tcp_halfopen *h = tcp_halfopen_find(s, f);
+
+    if (h && (SEQN(f) == h->irs + 1u)) {
+        s->number_of_pending_conn--;
+        tcp_halfopen_del(h);
+    }
+
+    return 0;
+}
+
+int pico_tcp_syn_stats(struct pico_tcp_syn_stats *stats)
+{
+    if (!stats) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    *stats = tcp_syn_counters;
+#ifdef PICO_SUPPORT_TCP_HALFOPEN
+    stats->half_open = tcp_halfopen_count;
+#endif
+    return 0;
+}
+
+/* A segment merged by GRO counts as the packets it was made of */
+static void tcp_info_received(struct pico_socket_tcp *t, struct pico_frame *f)
+{
+    uint32_t packets = 1;
+#ifdef PICO_SUPPORT_TCP_GRO
+    struct pico_frame *seg;
+
+    for (seg = f->chain; seg; seg = seg->chain)
+        packets++;
+#endif
+    t->segs_in += packets;
+    t->bytes_in += f->payload_len;
+}
+
 int pico_tcp_input(struct pico_socket *s, struct pico_frame *f)
 {
     struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *) (f->transport_hdr);
@@ -2825,6 +5773,7 @@ int pico_tcp_input(struct pico_socket *s, struct pico_frame *f)
     /* This copy of the frame has the current socket as owner */
     f->sock = s;
     s->timestamp = TCP_TIME;
+    tcp_info_received(TCP_SOCK(s), f);
     /* Those are not supported at this time. */
     /* flags &= (uint8_t) ~(PICO_TCP_CWR | PICO_TCP_URG | PICO_TCP_ECN); */
     if(invalid_flags(s, flags)) {
@@ -2850,13 +5799,85 @@ int pico_tcp_input(struct pico_socket *s, struct pico_frame *f)
 inline static int checkLocalClosing(struct pico_socket *s);
 inline static int checkRemoteClosing(struct pico_socket *s);
 
+/* Copy len bytes of payload from offset off. The payload of a zero-copy
+ * frame ends in the segments chained to it.
+ */
+static void tcp_payload_copy(struct pico_frame *f, uint16_t off, uint8_t *dst, uint16_t len)
+{
+    struct pico_frame *seg = f->chain;
+    uint32_t head = f->payload_len - pico_frame_total_len(f->chain);
+    uint32_t n;
+
+    if (off < head) {
+        n = (head - off < len) ? (head - off) : len;
+        memcpy(dst, f->payload + off, n);
+        dst += n;
+        len = (uint16_t)(len - n);
+        off = 0;
+    } else {
+        off = (uint16_t)(off - head);
+    }
+
+    for (; seg && len; seg = seg->chain) {
+        if (off >= seg->len) {
+            off = (uint16_t)(off - seg->len);
+            continue;
+        }
+
+        n = (seg->len - off < len) ? (seg->len - off) : len;
+        memcpy(dst, seg->start + off, n);
+        dst += n;
+        len = (uint16_t)(len - n);
+        off = 0;
+    }
+}
+
+/* New segment carrying len bytes of the payload of f from offset off. Parts
+ * of a super-segment reference its payload, other segments get a copy.
+ */
+static struct pico_frame *tcp_split_part(struct pico_socket_tcp *t, struct pico_frame *f, uint16_t off, uint16_t len)
+{
+    struct pico_frame *part;
+    uint16_t overhead = pico_tcp_overhead(&t->sock);
+
+#ifdef PICO_SUPPORT_TCP_GSO
+    if (f->gso_size) {
+        part = pico_socket_frame_alloc(&t->sock, get_sock_dev(&t->sock), overhead);
+        if (!part)
+            return NULL;
+
+        part->chain = pico_frame_payload_ref(f, off, len);
+        if (!part->chain) {
+            pico_frame_discard(part);
+            return NULL;
+        }
+
+        part->payload += overhead;
+        part->payload_len = len;
+        part->transport_len = (uint16_t)(part->transport_len + len);
+        if (len > f->gso_size)
+            part->gso_size = f->gso_size;
+
+        return part;
+    }
+
+#endif
+    part = pico_socket_frame_alloc(&t->sock, get_sock_dev(&t->sock), (uint16_t) (len + overhead));
+    if (!part)
+        return NULL;
+
+    /* Advance payload pointer to the beginning of segment data */
+    part->payload += overhead;
+    part->payload_len = (uint16_t)(part->payload_len - overhead);
+    tcp_payload_copy(f, off, part->payload, len);
+    return part;
+}
+
 static struct pico_frame *tcp_split_segment(struct pico_socket_tcp *t, struct pico_frame *f, uint16_t size)
 {
     struct pico_frame *f1, *f2;
     uint16_t size1, size2, size_f;
-    uint16_t overhead;
     struct pico_tcp_hdr *hdr1, *hdr2, *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
-    overhead = pico_tcp_overhead(&t->sock);
     size_f = f->payload_len;
 
 
@@ -2866,26 +5887,26 @@ static struct pico_frame *tcp_split_segment(struct pico_socket_tcp *t, struct pi
     size1 = size;
     size2 = (uint16_t)(size_f - size);
 
-    f1 = pico_socket_frame_alloc(&t->sock, get_sock_dev(&t->sock), (uint16_t) (size1 + overhead));
-    f2 = pico_socket_frame_alloc(&t->sock, get_sock_dev(&t->sock), (uint16_t) (size2 + overhead));
+    f1 = tcp_split_part(t, f, 0, size1);
+    f2 = tcp_split_part(t, f, size1, size2);
 
     if (!f1 || !f2) {
+        pico_frame_discard(f1);
+        pico_frame_discard(f2);
         pico_err = PICO_ERR_ENOMEM;
         return NULL;
     }
 
-    /* Advance payload pointer to the beginning of segment data */
-    f1->payload += overhead;
-    f1->payload_len = (uint16_t)(f1->payload_len - overhead);
-    f2->payload += overhead;
-    f2->payload_len = (uint16_t)(f2->payload_len - overhead);
-
     hdr1 = (struct pico_tcp_hdr *)f1->transport_hdr;
     hdr2 = (struct pico_tcp_hdr *)f2->transport_hdr;
 
-    /* Copy payload */
-    memcpy(f1->payload, f->payload, size1);
-    memcpy(f2->payload, f->payload + size1, size2);
+    /* Both parts were sent whenever f was, and share its scoreboard state */
+    f1->timestamp = f->timestamp;
+    f2->timestamp = f->timestamp;
+    f1->flags |= (uint8_t)(f->flags & PICO_FRAME_FLAG_SACKED);
+    f2->flags |= (uint8_t)(f->flags & PICO_FRAME_FLAG_SACKED);
+    TCP_SEG_FLAGS(f1) = TCP_SEG_FLAGS(f);
+    TCP_SEG_FLAGS(f2) = TCP_SEG_FLAGS(f);
 
     /* Copy tcp hdr */
     memcpy(hdr1, hdr, sizeof(struct pico_tcp_hdr));
@@ -2900,20 +5921,91 @@ static struct pico_frame *tcp_split_segment(struct pico_socket_tcp *t, struct pi
     tcp_add_options_frame(t, f1);
     tcp_add_options_frame(t, f2);
 
-    /* Get rid of the full frame */
-    pico_discard_segment(&t->tcpq_out, f);
-
-    /* Enqueue f2 for later send... */
-    if (pico_enqueue_segment(&t->tcpq_out, f2) < 0) {
-        tcp_dbg("Discarding invalid segment\n");
+    /* Replace the full frame with both parts: f1 is sent now, f2 later, and
+     * both must stay queued for retransmission. If they do not fit, keep the
+     * full frame and try again once some data is acknowledged.
+     */
+    PICOTCP_MUTEX_LOCK(Mutex);
+    pico_unlink_segment(&t->tcpq_out, f);
+    PICOTCP_MUTEX_UNLOCK(Mutex);
+    if ((pico_enqueue_segment(&t->tcpq_out, f1) <= 0) || (pico_enqueue_segment(&t->tcpq_out, f2) <= 0)) {
+        tcp_dbg("No room to split segment\n");
+        PICOTCP_MUTEX_LOCK(Mutex);
+        pico_unlink_segment(&t->tcpq_out, f1);
+        pico_unlink_segment(&t->tcpq_out, f2);
+        PICOTCP_MUTEX_UNLOCK(Mutex);
+        pico_enqueue_segment(&t->tcpq_out, f);
+        pico_frame_discard(f1);
         pico_frame_discard(f2);
+        return NULL;
     }
 
+    pico_frame_discard(f);
+
     /* Return the partial frame */
     return f1;
 }
 
 
+#ifdef PICO_SUPPORT_TCP_GSO
+/* Cut a super-segment down to what the congestion window, and the pacing
+ * burst if any, let out now. */
+static struct pico_frame *tcp_gso_fit(struct pico_socket_tcp *t, struct pico_frame *f)
+{
+    uint32_t room = (t->cwnd > t->in_flight) ? (t->cwnd - t->in_flight) : 1u;
+    uint32_t rate, burst;
+
+    if (output_segment_packets(f) < 2)
+        return f;
+
+    rate = tcp_pacing_rate(t);
+    if (rate) {
+        burst = tcp_pacing_burst(t, rate) / f->gso_size;
+        if (burst < room)
+            room = burst ? burst : 1u;
+    }
+
+    if (output_segment_packets(f) <= room)
+        return f;
+
+    /* NULL if it cannot be split now: sending it whole would overrun the
+     * windows, so output waits for the next ACK or timeout instead */
+    return tcp_split_segment(t, f, (uint16_t)(room * f->gso_size));
+}
+#endif
+
+#define TCP_LIMITED_NONE 0u
+#define TCP_LIMITED_CWND 1u
+#define TCP_LIMITED_RWND 2u
+
+/* Time output has waited for the given window, ms */
+static uint64_t tcp_limited_time(struct pico_socket_tcp *t, uint8_t why, pico_time now)
+{
+    uint64_t total = (why == TCP_LIMITED_CWND) ? t->cwnd_limited : t->rwnd_limited;
+
+    if (t->limited == why)
+        total += now - t->limited_since;
+
+    return total;
+}
+
+static void tcp_limited(struct pico_socket_tcp *t, uint8_t why)
+{
+    pico_time now;
+
+    if (why == t->limited)
+        return;
+
+    now = TCP_TIME;
+    if (t->limited == TCP_LIMITED_CWND)
+        t->cwnd_limited = tcp_limited_time(t, TCP_LIMITED_CWND, now);
+    else if (t->limited == TCP_LIMITED_RWND)
+        t->rwnd_limited = tcp_limited_time(t, TCP_LIMITED_RWND, now);
+
+    t->limited = why;
+    t->limited_since = now;
+}
+
 int pico_tcp_output(struct pico_socket *s, int loop_score)
 {
     struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
@@ -2921,13 +6013,27 @@ int pico_tcp_output(struct pico_socket *s, int loop_score)
     int sent = 0;
     int data_sent = 0;
     int32_t seq_diff = 0;
+    uint8_t limited = TCP_LIMITED_NONE;
 
     una = first_segment(&t->tcpq_out);
     f = peek_segment(&t->tcpq_out, t->snd_nxt);
 
     while((f) && (t->cwnd >= t->in_flight)) {
-        f->timestamp = TCP_TIME;
-        add_retransmission_timer(t, t->rto + TCP_TIME);
+#ifdef PICO_SUPPORT_TCP_GSO
+        f = tcp_gso_fit(t, f);
+        if (!f) {
+            /* Nothing in flight to bring an ACK: let the timer retry */
+            if (!t->in_flight)
+                add_retransmission_timer(t, t->rto + TCP_TIME);
+
+            break;
+        }
+
+        una = first_segment(&t->tcpq_out);
+#endif
+        if (tcp_pacing_hold(t, f->payload_len, TCP_TIME))
+            break;
+
         tcp_add_options_frame(t, f);
         seq_diff = pico_seq_compare(SEQN(f), SEQN(una));
         if (seq_diff < 0) {
@@ -2945,6 +6051,7 @@ int pico_tcp_output(struct pico_socket *s, int loop_score)
                 t->x_mode = PICO_TCP_WINDOW_FULL;
             }
 
+            limited = TCP_LIMITED_RWND;
             break;
         }
 
@@ -2954,14 +6061,19 @@ int pico_tcp_output(struct pico_socket *s, int loop_score)
             if (!f)
                 break;
 
+            una = first_segment(&t->tcpq_out);
+
             /* Limit sending window to packets in flight (right sizing) */
-            t->cwnd = (uint16_t)t->in_flight;
-            if (t->cwnd < 1)
-                t->cwnd = 1;
+            tcp_cc_set_cwnd(t, t->in_flight ? t->in_flight : 1u);
         }
 
+        /* Arm the timer only for segments that actually leave: a sender stuck
+         * on a full window must not keep postponing its own retransmission. */
+        f->timestamp = TCP_TIME;
+        add_retransmission_timer(t, t->rto + TCP_TIME);
         tcp_dbg("TCP> DEQUEUED (for output) frame %08x, acks %08x len= %d, remaining frames %d\n", SEQN(f), ACKN(f), f->payload_len, t->tcpq_out.frames);
         tcp_send(t, f);
+        tcp_pacing_sent(t, f->payload_len);
         sent++;
         loop_score--;
         t->snd_last_out = SEQN(f);
@@ -2975,8 +6087,13 @@ int pico_tcp_output(struct pico_socket *s, int loop_score)
             f = NULL;
         }
     }
+    if (f && (t->cwnd < t->in_flight))
+        limited = TCP_LIMITED_CWND;
+
+    tcp_limited(t, limited);
     if ((sent > 0 && data_sent > 0)) {
         rto_set(t, t->rto);
+        tcp_tlp_arm(t);
     } else {
         /* Nothing to transmit. */
     }
@@ -2991,6 +6108,32 @@ int pico_tcp_output(struct pico_socket *s, int loop_score)
     return loop_score;
 }
 
+/* Returns 1 if the next call to pico_tcp_output() would transmit something */
+int pico_tcp_output_pending(struct pico_socket *s)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    struct pico_frame *f, *una;
+    int32_t seq_diff;
+
+    una = first_segment(&t->tcpq_out);
+    f = peek_segment(&t->tcpq_out, t->snd_nxt);
+    /* Held back by pacing: the pacing timer will resume output */
+    if (f && una && !t->pacing_tmr && (t->cwnd >= t->in_flight)) {
+        seq_diff = pico_seq_compare(SEQN(f), SEQN(una));
+        if ((seq_diff >= 0) && ((uint32_t)seq_diff < (uint32_t)(t->recv_wnd << t->recv_wnd_scale)))
+            return 1;
+    }
+
+    /* A FIN is sent once the output queue drains after a local shutdown */
+    if ((t->tcpq_out.frames == 0) && (s->state & PICO_SOCKET_STATE_SHUT_LOCAL)) {
+        if (((s->state & PICO_SOCKET_STATE_TCP) == PICO_SOCKET_STATE_TCP_ESTABLISHED) ||
+            ((s->state & PICO_SOCKET_STATE_TCP) == PICO_SOCKET_STATE_TCP_CLOSE_WAIT))
+            return 1;
+    }
+
+    return 0;
+}
+
 /* function to make new segment from hold queue with specific size (mss) */
 static struct pico_frame *pico_hold_segment_make(struct pico_socket_tcp *t)
 {
@@ -3104,12 +6247,46 @@ static int pico_tcp_push_nagle_hold(struct pico_socket_tcp *t, struct pico_frame
 }
 
 
+/* Zero-copy frames and super-segments are never merged: whatever waits in
+ * the hold queue goes out first, then the frame itself.
+ */
+static int pico_tcp_push_nagle_flush(struct pico_socket_tcp *t, struct pico_frame *f)
+{
+    struct pico_frame *f_new;
+
+    if ((t->tcpq_out.max_size - t->tcpq_out.size) < (t->tcpq_hold.size + f->payload_len)) {
+        pico_err = PICO_ERR_EAGAIN;
+        return 0;
+    }
+
+    while (!IS_TCP_HOLDQ_EMPTY(t)) {
+        f_new = pico_hold_segment_make(t);
+        if (!f_new)
+            return 0;
+
+        if (pico_enqueue_segment(&t->tcpq_out, f_new) <= 0) {
+            pico_frame_discard(f_new);
+            return -1;
+        }
+    }
+    return pico_tcp_push_nagle_enqueue(t, f);
+}
+
 static int pico_tcp_push_nagle_on(struct pico_socket_tcp *t, struct pico_frame *f)
 {
     /* Nagle's algorithm enabled, check if ready to send, or put frame in hold queue */
     if (IS_TCP_IDLE(t) && IS_TCP_HOLDQ_EMPTY(t))
         return pico_tcp_push_nagle_enqueue(t, f);
 
+    if (f->chain)
+        return pico_tcp_push_nagle_flush(t, f);
+
+#ifdef PICO_SUPPORT_TCP_GSO
+    if (f->gso_size)
+        return pico_tcp_push_nagle_flush(t, f);
+
+#endif
+
     return pico_tcp_push_nagle_hold(t, f);
 }
 
@@ -3127,9 +6304,16 @@ int pico_tcp_push(struct pico_protocol *self, struct pico_frame *f)
     hdr->trans.dport = t->sock.remote_port;
     hdr->seq = long_be(t->snd_last + 1);
     hdr->len = (uint8_t)((f->payload - f->transport_hdr) << 2u | (int8_t)t->jumbo);
+#ifdef PICO_SUPPORT_TCP_GSO
+    if (f->payload_len > tcp_gso_packet_payload(t))
+        f->gso_size = tcp_gso_packet_payload(t);
+
+#endif
 
-    if ((uint32_t)f->payload_len > (uint32_t)(t->tcpq_out.max_size - t->tcpq_out.size))
+    if ((uint32_t)f->payload_len > (uint32_t)(t->tcpq_out.max_size - t->tcpq_out.size)) {
         t->sock.ev_pending &= (uint16_t)(~PICO_SOCK_EV_WR);
+        t->autotune |= TCP_AUTOTUNE_SND_FULL;
+    }
 
     /***************************************************************************/
 
@@ -3152,42 +6336,63 @@ int pico_tcp_push(struct pico_protocol *self, struct pico_frame *f)
 inline static void tcp_discard_all_segments(struct pico_tcp_queue *tq)
 {
     struct pico_tree_node *index = NULL, *index_safe = NULL;
+    struct pico_frame *f;
+    uint32_t pos;
     PICOTCP_MUTEX_LOCK(Mutex);
-    pico_tree_foreach_safe(index, &tq->pool, index_safe)
-    {
-        void *f = index->keyValue;
-        if(!f)
-            break;
-
-        pico_tree_delete(&tq->pool, f);
-        if(IS_INPUT_QUEUE(tq))
+    if (IS_INPUT_QUEUE(tq)) {
+        pico_tree_foreach_safe(index, &tq->pool, index_safe)
         {
-            struct tcp_input_segment *inp = (struct tcp_input_segment *)f;
-            PICO_FREE(inp->payload);
-            PICO_FREE(inp);
+            void *seg = index->keyValue;
+            if(!seg)
+                break;
+
+            pico_tree_delete(&tq->pool, seg);
+            segment_free((struct tcp_input_segment *)seg);
         }
-        else
+    } else {
+        tcp_ring_foreach(tq, pos, f) {
             pico_frame_discard(f);
+        }
+        if (tq->ring)
+            PICO_FREE(tq->ring);
+
+        tq->ring = NULL;
+        tq->ring_size = 0;
+        tq->head = 0;
+        tq->cursor = 0;
     }
+
     tq->frames = 0;
     tq->size = 0;
+    tq->sacked = 0;
+    tq->lost = 0;
+    tq->retrans = 0;
     PICOTCP_MUTEX_UNLOCK(Mutex);
 }
 
 void pico_tcp_cleanup_queues(struct pico_socket *sck)
 {
     struct pico_socket_tcp *tcp = (struct pico_socket_tcp *)sck;
+    tcp_autotune_release(tcp, TCP_AUTOTUNE_RCV | TCP_AUTOTUNE_SND);
     pico_timer_cancel(tcp->retrans_tmr);
     pico_timer_cancel(tcp->keepalive_tmr);
     pico_timer_cancel(tcp->fin_tmr);
+    pico_timer_cancel(tcp->pacing_tmr);
+    pico_timer_cancel(tcp->delack_tmr);
+    pico_timer_cancel(tcp->rack_tmr);
 
     tcp->retrans_tmr = 0;
     tcp->keepalive_tmr = 0;
     tcp->fin_tmr = 0;
+    tcp->pacing_tmr = 0;
+    tcp->delack_tmr = 0;
+    tcp->rack_tmr = 0;
 
+    tcp_zerocopy_disown(tcp);
     tcp_discard_all_segments(&tcp->tcpq_in);
     tcp_discard_all_segments(&tcp->tcpq_out);
     tcp_discard_all_segments(&tcp->tcpq_hold);
+    tcp_halfopen_purge(sck, 0);
 }
 
 static int checkLocalClosing(struct pico_socket *s)
@@ -3251,6 +6456,7 @@ void pico_tcp_flags_update(struct pico_frame *f, struct pico_socket *s)
 int pico_tcp_set_bufsize_in(struct pico_socket *s, uint32_t value)
 {
     struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    tcp_autotune_release(t, TCP_AUTOTUNE_RCV);
     t->tcpq_in.max_size = value;
     return 0;
 }
@@ -3258,6 +6464,7 @@ int pico_tcp_set_bufsize_in(struct pico_socket *s, uint32_t value)
 int pico_tcp_set_bufsize_out(struct pico_socket *s, uint32_t value)
 {
     struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    tcp_autotune_release(t, TCP_AUTOTUNE_SND);
     t->tcpq_out.max_size = value;
     return 0;
 }
@@ -3304,4 +6511,188 @@ int pico_tcp_set_linger(struct pico_socket *s, uint32_t value)
     return 0;
 }
 
+int pico_tcp_set_congestion(struct pico_socket *s, const char *name)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    struct pico_tcp_cc_ops *ops = pico_tcp_cc_find(name);
+    if (!ops) {
+        pico_err = PICO_ERR_ENOENT;
+        return -1;
+    }
+
+    t->cc.ops = ops;
+    /* Switching mid-connection keeps the current windows */
+    if (t->cc.mss) {
+        ops->init(&t->cc);
+        tcp_cc_sync(t);
+    }
+
+    return 0;
+}
+
+int pico_tcp_get_congestion(struct pico_socket *s, const char **name)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    *name = t->cc.ops->name;
+    return 0;
+}
+
+int pico_tcp_set_zerocopy_rx(struct pico_socket *s, int enable)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    t->zerocopy_rx = (uint8_t)(enable ? 1 : 0);
+    return 0;
+}
+
+int pico_tcp_get_zerocopy_rx(struct pico_socket *s, int *enable)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    *enable = t->zerocopy_rx;
+    return 0;
+}
+
+int pico_tcp_set_pacing(struct pico_socket *s, int enable)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    t->pacing = (uint8_t)(enable ? 1 : 0);
+    if (!t->pacing) {
+        /* Anything held back goes out with the next socket loop */
+        pico_timer_cancel(t->pacing_tmr);
+        t->pacing_tmr = 0;
+        t->pacing_rate = 0;
+        t->pacing_stamp = 0;
+        if (t->pacing_wait) {
+            t->pacing_delay += TCP_TIME - t->pacing_wait;
+            t->pacing_wait = 0;
+        }
+    }
+
+    return 0;
+}
+
+int pico_tcp_get_pacing(struct pico_socket *s, int *enable)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    *enable = t->pacing;
+    return 0;
+}
+
+int pico_tcp_set_delack(struct pico_socket *s, int enable)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    t->delack = (uint8_t)(enable ? 1 : 0);
+    if (!t->delack && t->delack_tmr) {
+        /* Whatever is held back is acknowledged now */
+        pico_timer_cancel(t->delack_tmr);
+        t->delack_tmr = 0;
+        if (t->sock.net && (pico_seq_compare(t->rcv_ackd, t->rcv_nxt) != 0))
+            tcp_send_ack(t);
+    }
+
+    return 0;
+}
+
+int pico_tcp_get_delack(struct pico_socket *s, int *enable)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    *enable = t->delack;
+    return 0;
+}
+
+int pico_tcp_set_delack_timeout(struct pico_socket *s, uint32_t ms)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    if ((ms == 0) || (ms > PICO_TCP_DELACK_TIMEOUT_MAX)) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    t->delack_timeout = ms;
+    return 0;
+}
+
+int pico_tcp_get_delack_timeout(struct pico_socket *s, uint32_t *ms)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    *ms = t->delack_timeout;
+    return 0;
+}
+
+int pico_tcp_get_pacing_stats(struct pico_socket *s, struct pico_tcp_pacing_stats *stats)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    stats->rate = tcp_pacing_rate(t);
+    stats->holds = t->pacing_holds;
+    stats->delay = t->pacing_delay;
+    if (t->pacing_wait)
+        stats->delay += TCP_TIME - t->pacing_wait;
+
+    return 0;
+}
+
+int pico_tcp_get_info(struct pico_socket *s, struct pico_tcp_info *info)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    pico_time now = TCP_TIME;
+
+    memset(info, 0, sizeof(struct pico_tcp_info));
+    info->version = PICO_TCP_INFO_VERSION;
+    info->state = (uint8_t)(TCPSTATE(s) >> 8);
+    info->backoff = t->backoff;
+    info->dupacks = t->dupacks;
+    info->rtt = t->avg_rtt;
+    info->rttvar = t->rttvar;
+    info->rto = t->rto;
+    info->mss = t->mss;
+    info->cwnd = t->cc.cwnd;
+    info->ssthresh = t->cc.ssthresh;
+    info->in_flight = t->in_flight;
+    info->snd_wnd = (uint32_t)t->recv_wnd << t->recv_wnd_scale;
+    info->rcv_wnd = (uint32_t)t->wnd << t->wnd_scale;
+    info->segs_out = t->segs_out;
+    info->segs_in = t->segs_in;
+    info->bytes_out = t->bytes_out;
+    info->bytes_in = t->bytes_in;
+    info->retrans = t->retrans;
+    info->fast_retrans = t->fast_retrans;
+    info->rto_events = t->rto_events;
+    info->ooo_segs = t->ooo_segs;
+    info->zero_wnd_local = t->zero_wnd_local;
+    info->zero_wnd_remote = t->zero_wnd_remote;
+    info->cwnd_limited = tcp_limited_time(t, TCP_LIMITED_CWND, now);
+    info->rwnd_limited = tcp_limited_time(t, TCP_LIMITED_RWND, now);
+    return 0;
+}
+
+int pico_tcp_set_fastopen(struct pico_socket *s, int enable)
+{
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    if (enable)
+        t->fastopen |= TCP_FASTOPEN_ON;
+    else
+        t->fastopen &= (uint8_t)~TCP_FASTOPEN_ON;
+
+    return 0;
+#else
+    IGNORE_PARAMETER(s);
+    IGNORE_PARAMETER(enable);
+    pico_err = PICO_ERR_EPROTONOSUPPORT;
+    return -1;
+#endif
+}
+
+int pico_tcp_get_fastopen(struct pico_socket *s, int *enable)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)s;
+    *enable = (t->fastopen & TCP_FASTOPEN_ON) ? 1 : 0;
+    return 0;
+}
+
+/* A child taken with the data of its SYN can be accepted before its handshake is over */
+int pico_tcp_fastopen_child(struct pico_socket *s)
+{
+    return (TCP_SOCK(s)->fastopen & TCP_FASTOPEN_CHILD) ? 1 : 0;
+}
+
 #endif /* PICO_SUPPORT_TCP */
@@ -11,7 +11,7 @@
 #include "pico_protocol.h"
 #include "pico_socket.h"
 
-extern struct pico_protocol pico_proto_tcp;
+extern PICO_TLS struct pico_protocol pico_proto_tcp;
 
 PACKED_STRUCT_DEF pico_tcp_hdr {
     struct pico_trans trans;
@@ -52,6 +52,8 @@ PACKED_STRUCT_DEF tcp_pseudo_hdr_ipv4
 #define PICO_TCPOPTLEN_SACK       2 /* Plus the block */
 #define PICO_TCP_OPTION_TIMESTAMP   0x08
 #define PICO_TCPOPTLEN_TIMESTAMP  10u
+#define PICO_TCP_OPTION_FASTOPEN    0x22
+#define PICO_TCPOPTLEN_FASTOPEN   2u /* Plus the cookie */
 
 /* TCP flags */
 #define PICO_TCP_FIN 0x01u
@@ -76,8 +78,21 @@ PACKED_STRUCT_DEF pico_tcp_option
     uint8_t len;
 };
 
+/* Connections to listeners before the handshake completes */
+struct pico_tcp_syn_stats {
+    uint32_t half_open;         /* Entries in the half-open table */
+    uint32_t cookies_sent;      /* SYN-ACKs with a cookie, over the backlog */
+    uint32_t cookies_validated; /* ACKs that came back with a good cookie */
+    uint32_t cookies_failed;    /* ACKs to a listener with a bad cookie */
+    uint32_t syn_dropped;       /* SYNs over the backlog without cookies, or out of memory */
+    uint32_t fastopen_accepted; /* SYNs whose data was taken with a good Fast Open cookie */
+    uint32_t fastopen_failed;   /* SYNs with a Fast Open cookie that did not validate */
+};
+
 struct pico_socket *pico_tcp_open(uint16_t family);
 uint32_t pico_tcp_read(struct pico_socket *s, void *buf, uint32_t len);
+int pico_tcp_read_zerocopy(struct pico_socket *s, struct pico_zerocopy_chunk *chunks, int max);
+void pico_tcp_zerocopy_release(void *handle);
 int pico_tcp_initconn(struct pico_socket *s);
 int pico_tcp_input(struct pico_socket *s, struct pico_frame *f);
 uint16_t pico_tcp_checksum(struct pico_frame *f);
@@ -87,8 +102,12 @@ uint16_t pico_tcp_checksum_ipv6(struct pico_frame *f);
 #endif
 uint16_t pico_tcp_overhead(struct pico_socket *s);
 int pico_tcp_output(struct pico_socket *s, int loop_score);
+int pico_tcp_output_pending(struct pico_socket *s);
 int pico_tcp_queue_in_is_empty(struct pico_socket *s);
 int pico_tcp_reply_rst(struct pico_frame *f);
+#ifdef PICO_SUPPORT_TCP_TIMEWAIT
+int pico_tcp_timewait_input(struct pico_frame *f);
+#endif
 void pico_tcp_cleanup_queues(struct pico_socket *sck);
 void pico_tcp_notify_closing(struct pico_socket *sck);
 void pico_tcp_flags_update(struct pico_frame *f, struct pico_socket *s);
@@ -100,7 +119,27 @@ int pico_tcp_set_keepalive_probes(struct pico_socket *s, uint32_t value);
 int pico_tcp_set_keepalive_intvl(struct pico_socket *s, uint32_t value);
 int pico_tcp_set_keepalive_time(struct pico_socket *s, uint32_t value);
 int pico_tcp_set_linger(struct pico_socket *s, uint32_t value);
+int pico_tcp_set_congestion(struct pico_socket *s, const char *name);
+int pico_tcp_get_congestion(struct pico_socket *s, const char **name);
+int pico_tcp_set_zerocopy_rx(struct pico_socket *s, int enable);
+int pico_tcp_get_zerocopy_rx(struct pico_socket *s, int *enable);
+int pico_tcp_set_pacing(struct pico_socket *s, int enable);
+int pico_tcp_get_pacing(struct pico_socket *s, int *enable);
+int pico_tcp_get_pacing_stats(struct pico_socket *s, struct pico_tcp_pacing_stats *stats);
+int pico_tcp_set_delack(struct pico_socket *s, int enable);
+int pico_tcp_get_delack(struct pico_socket *s, int *enable);
+int pico_tcp_set_delack_timeout(struct pico_socket *s, uint32_t ms);
+int pico_tcp_get_delack_timeout(struct pico_socket *s, uint32_t *ms);
+int pico_tcp_get_info(struct pico_socket *s, struct pico_tcp_info *info);
+int pico_tcp_set_fastopen(struct pico_socket *s, int enable);
+int pico_tcp_get_fastopen(struct pico_socket *s, int *enable);
+int pico_tcp_fastopen_child(struct pico_socket *s);
 uint16_t pico_tcp_get_socket_mss(struct pico_socket *s);
+#ifdef PICO_SUPPORT_TCP_GSO
+uint16_t pico_tcp_get_socket_gso(struct pico_socket *s);
+struct pico_frame *pico_tcp_gso_segment(struct pico_frame *f);
+#endif
 int pico_tcp_check_listen_close(struct pico_socket *s);
+int pico_tcp_syn_stats(struct pico_tcp_syn_stats *stats);
 
 #endif
@@ -0,0 +1,148 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   TCP congestion control registry and the default (Reno) algorithm.
+ *********************************************************************/
+#include "pico_config.h"
+#include "pico_protocol.h"
+#include "pico_tcp_cc.h"
+
+#ifdef PICO_SUPPORT_TCP
+
+/* Reno: one segment per ACK in slow start, one segment per window of ACKs
+ * in congestion avoidance. ACKs are counted rather than bytes, exactly as
+ * the stack always did. */
+struct reno_state {
+    uint32_t ack_count;
+};
+
+static struct reno_state *reno_priv(struct pico_tcp_cc *cc)
+{
+    return (struct reno_state *)cc->priv;
+}
+
+static void reno_init(struct pico_tcp_cc *cc)
+{
+    reno_priv(cc)->ack_count = 0;
+}
+
+static void reno_on_ack(struct pico_tcp_cc *cc, uint32_t acked, pico_time now)
+{
+    struct reno_state *r = reno_priv(cc);
+    IGNORE_PARAMETER(acked);
+    IGNORE_PARAMETER(now);
+    if (cc->cwnd < cc->ssthresh) {
+        cc->cwnd += cc->mss;
+    } else {
+        r->ack_count++;
+        if (r->ack_count >= cc->cwnd / cc->mss) {
+            cc->cwnd += cc->mss;
+            r->ack_count = 0;
+        }
+    }
+}
+
+static void reno_on_loss(struct pico_tcp_cc *cc, uint32_t in_flight, pico_time now)
+{
+    IGNORE_PARAMETER(now);
+    if (in_flight > PICO_TCP_IW * cc->mss)
+        cc->cwnd = in_flight;
+    else
+        cc->cwnd = PICO_TCP_IW * cc->mss;
+
+    if (cc->ssthresh > cc->cwnd)
+        cc->ssthresh >>= 2;
+    else
+        cc->ssthresh = cc->cwnd >> 1;
+
+    if (cc->ssthresh < 2 * cc->mss)
+        cc->ssthresh = 2 * cc->mss;
+}
+
+static void reno_on_rto(struct pico_tcp_cc *cc, uint32_t in_flight, pico_time now)
+{
+    IGNORE_PARAMETER(in_flight);
+    IGNORE_PARAMETER(now);
+    cc->cwnd = PICO_TCP_IW * cc->mss;
+    reno_priv(cc)->ack_count = 0;
+}
+
+static uint32_t reno_get_cwnd(struct pico_tcp_cc *cc)
+{
+    return cc->cwnd;
+}
+
+static uint32_t reno_get_ssthresh(struct pico_tcp_cc *cc)
+{
+    return cc->ssthresh;
+}
+
+struct pico_tcp_cc_ops pico_tcp_cc_reno = {
+    "reno",
+    reno_init,
+    reno_on_ack,
+    reno_on_loss,
+    reno_on_rto,
+    reno_get_cwnd,
+    reno_get_ssthresh,
+    NULL
+};
+
+/* Registry: built-in algorithms first, then anything registered at run time. */
+static struct pico_tcp_cc_ops *cc_builtin[] = {
+    &pico_tcp_cc_reno,
+    &pico_tcp_cc_cubic
+};
+
+static struct pico_tcp_cc_ops *cc_registered = NULL;
+
+static int cc_name_match(const char *a, const char *b)
+{
+    return strncmp(a, b, PICO_TCP_CC_NAME_MAX) == 0;
+}
+
+struct pico_tcp_cc_ops *pico_tcp_cc_find(const char *name)
+{
+    struct pico_tcp_cc_ops *ops;
+    uint32_t i;
+
+    if (!name)
+        return NULL;
+
+    for (i = 0; i < sizeof(cc_builtin) / sizeof(cc_builtin[0]); i++) {
+        if (cc_name_match(cc_builtin[i]->name, name))
+            return cc_builtin[i];
+    }
+    for (ops = cc_registered; ops; ops = ops->next) {
+        if (cc_name_match(ops->name, name))
+            return ops;
+    }
+    return NULL;
+}
+
+int pico_tcp_cc_register(struct pico_tcp_cc_ops *ops)
+{
+    if (!ops || !ops->name || !ops->init || !ops->on_ack || !ops->on_loss ||
+        !ops->on_rto || !ops->get_cwnd || !ops->get_ssthresh) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    if (pico_tcp_cc_find(ops->name)) {
+        pico_err = PICO_ERR_EEXIST;
+        return -1;
+    }
+
+    ops->next = cc_registered;
+    cc_registered = ops;
+    return 0;
+}
+
+struct pico_tcp_cc_ops *pico_tcp_cc_default(void)
+{
+    struct pico_tcp_cc_ops *ops = pico_tcp_cc_find(PICO_TCP_CC_DEFAULT);
+    return ops ? ops : &pico_tcp_cc_reno;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   Pluggable TCP congestion control.
+
+   Each TCP socket owns a struct pico_tcp_cc and points it at an ops table.
+   The TCP core keeps counting segments in flight; the algorithm only sees
+   byte counts and keeps the congestion window and slow-start threshold in
+   bytes, so multi-megabyte windows fit without overflow.
+ *********************************************************************/
+#ifndef INCLUDE_PICO_TCP_CC
+#define INCLUDE_PICO_TCP_CC
+#include "pico_config.h"
+
+/* Initial window, in segments */
+#ifndef PICO_TCP_IW
+#define PICO_TCP_IW          2
+#endif
+
+/* Algorithm selected for new sockets */
+#ifndef PICO_TCP_CC_DEFAULT
+#define PICO_TCP_CC_DEFAULT  "reno"
+#endif
+
+#define PICO_TCP_CC_NAME_MAX 16
+
+struct pico_tcp_cc;
+
+struct pico_tcp_cc_ops {
+    const char *name;
+    /* Reset the private state. cwnd, ssthresh and mss are already set. */
+    void (*init)(struct pico_tcp_cc *cc);
+    /* New ACK outside of recovery; acked is in bytes (may be zero) */
+    void (*on_ack)(struct pico_tcp_cc *cc, uint32_t acked, pico_time now);
+    /* Entering fast recovery (third duplicate ACK) */
+    void (*on_loss)(struct pico_tcp_cc *cc, uint32_t in_flight, pico_time now);
+    /* Retransmission timeout */
+    void (*on_rto)(struct pico_tcp_cc *cc, uint32_t in_flight, pico_time now);
+    uint32_t (*get_cwnd)(struct pico_tcp_cc *cc);
+    uint32_t (*get_ssthresh)(struct pico_tcp_cc *cc);
+    struct pico_tcp_cc_ops *next;
+};
+
+struct pico_tcp_cc {
+    struct pico_tcp_cc_ops *ops;
+    uint32_t cwnd;      /* bytes */
+    uint32_t ssthresh;  /* bytes */
+    uint32_t mss;       /* bytes per segment */
+    uint32_t srtt;      /* smoothed RTT, ms (0 if unknown) */
+    uint64_t priv[6];   /* algorithm private state */
+};
+
+extern struct pico_tcp_cc_ops pico_tcp_cc_reno;
+extern struct pico_tcp_cc_ops pico_tcp_cc_cubic;
+
+int pico_tcp_cc_register(struct pico_tcp_cc_ops *ops);
+struct pico_tcp_cc_ops *pico_tcp_cc_find(const char *name);
+struct pico_tcp_cc_ops *pico_tcp_cc_default(void);
+
+#endif
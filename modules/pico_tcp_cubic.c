@@ -0,0 +1,194 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   CUBIC congestion control (RFC 8312), C = 0.4, beta = 0.7, with fast
+   convergence and the TCP-friendly region. Integer arithmetic only:
+   time is kept in milliseconds and windows in bytes.
+ *********************************************************************/
+#include "pico_config.h"
+#include "pico_tcp_cc.h"
+
+#ifdef PICO_SUPPORT_TCP
+
+/* Largest distance from the inflection point taken into account (ms).
+ * Keeps the cubic term within 64 bits; the target is clamped anyway. */
+#define CUBIC_MAX_OFFS_MS  400000u
+
+struct cubic_state {
+    pico_time epoch_start;  /* start of the current growth epoch, 0 if none */
+    uint64_t ack_acc;       /* fractional window increase, bytes * bytes */
+    uint32_t w_max;         /* window before the last reduction */
+    uint32_t w_epoch;       /* window at epoch start */
+    uint32_t origin;        /* W(t) plateau for this epoch */
+    uint32_t k;             /* time to reach the plateau, ms */
+};
+
+static struct cubic_state *cubic_priv(struct pico_tcp_cc *cc)
+{
+    return (struct cubic_state *)cc->priv;
+}
+
+/* Integer cube root (bitwise, Hacker's Delight) */
+static uint32_t cubic_cbrt(uint64_t x)
+{
+    uint64_t y = 0, b;
+    int s;
+
+    for (s = 63; s >= 0; s -= 3) {
+        y <<= 1;
+        b = 3 * y * (y + 1) + 1;
+        if ((x >> s) >= b) {
+            x -= b << s;
+            y++;
+        }
+    }
+    return (uint32_t)y;
+}
+
+static void cubic_init(struct pico_tcp_cc *cc)
+{
+    memset(cc->priv, 0, sizeof(cc->priv));
+}
+
+static void cubic_epoch_start(struct pico_tcp_cc *cc, pico_time now)
+{
+    struct cubic_state *c = cubic_priv(cc);
+
+    c->epoch_start = now ? now : 1;
+    c->ack_acc = 0;
+    c->w_epoch = cc->cwnd;
+    if (cc->cwnd < c->w_max) {
+        /* K = cbrt((W_max - cwnd) / (C * mss)) s, here in ms */
+        c->k = cubic_cbrt((((uint64_t)(c->w_max - cc->cwnd) * 25u) / cc->mss) * 100000000ull);
+        c->origin = c->w_max;
+    } else {
+        c->k = 0;
+        c->origin = cc->cwnd;
+    }
+}
+
+/* W_cubic(t) = C * (t - K)^3 + W_max, in bytes */
+static uint32_t cubic_target(struct pico_tcp_cc *cc, uint32_t t)
+{
+    struct cubic_state *c = cubic_priv(cc);
+    uint64_t offs, delta;
+
+    offs = (t > c->k) ? (t - c->k) : (c->k - t);
+    if (offs > CUBIC_MAX_OFFS_MS)
+        offs = CUBIC_MAX_OFFS_MS;
+
+    delta = (((offs * offs * offs) / 1000u) * cc->mss * 4u) / 10000000u;
+    if (t > c->k) {
+        if (delta > 0xFFFFFFFFull - c->origin)
+            return 0xFFFFFFFFu;
+
+        return (uint32_t)(c->origin + delta);
+    }
+
+    if (delta >= c->origin)
+        return 0;
+
+    return (uint32_t)(c->origin - delta);
+}
+
+static void cubic_on_ack(struct pico_tcp_cc *cc, uint32_t acked, pico_time now)
+{
+    struct cubic_state *c = cubic_priv(cc);
+    uint32_t t, target, est;
+    uint64_t inc;
+
+    if (acked == 0)
+        return;
+
+    if (cc->cwnd < cc->ssthresh) {
+        /* Slow start with appropriate byte counting, L = 2 */
+        if (acked > 2 * cc->mss)
+            acked = 2 * cc->mss;
+
+        cc->cwnd += acked;
+        return;
+    }
+
+    if (!c->epoch_start)
+        cubic_epoch_start(cc, now);
+
+    t = (uint32_t)(now - c->epoch_start);
+    if (t > CUBIC_MAX_OFFS_MS)
+        t = CUBIC_MAX_OFFS_MS;
+
+    /* Aim one RTT ahead, never more than 1.5 * cwnd */
+    target = cubic_target(cc, t + cc->srtt);
+    if (target > cc->cwnd + (cc->cwnd >> 1))
+        target = cc->cwnd + (cc->cwnd >> 1);
+
+    /* TCP-friendly region: W_est = W_epoch + 3 (1 - beta) / (1 + beta) * t / RTT */
+    if (cc->srtt) {
+        est = (uint32_t)(c->w_epoch + ((uint64_t)t * cc->mss * 529u) / (1000u * (uint64_t)cc->srtt));
+        if (est > target)
+            target = est;
+    }
+
+    if (target <= cc->cwnd)
+        return;
+
+    c->ack_acc += (uint64_t)(target - cc->cwnd) * acked;
+    inc = c->ack_acc / cc->cwnd;
+    c->ack_acc -= inc * cc->cwnd;
+    cc->cwnd += (uint32_t)inc;
+}
+
+static void cubic_reduce(struct pico_tcp_cc *cc)
+{
+    struct cubic_state *c = cubic_priv(cc);
+
+    c->epoch_start = 0;
+    /* Fast convergence: release bandwidth when the plateau keeps shrinking */
+    if (cc->cwnd < c->w_max)
+        c->w_max = (uint32_t)(((uint64_t)cc->cwnd * 17u) / 20u);
+    else
+        c->w_max = cc->cwnd;
+
+    cc->ssthresh = (uint32_t)(((uint64_t)cc->cwnd * 7u) / 10u);
+    if (cc->ssthresh < 2 * cc->mss)
+        cc->ssthresh = 2 * cc->mss;
+}
+
+static void cubic_on_loss(struct pico_tcp_cc *cc, uint32_t in_flight, pico_time now)
+{
+    IGNORE_PARAMETER(in_flight);
+    IGNORE_PARAMETER(now);
+    cubic_reduce(cc);
+    cc->cwnd = cc->ssthresh;
+}
+
+static void cubic_on_rto(struct pico_tcp_cc *cc, uint32_t in_flight, pico_time now)
+{
+    IGNORE_PARAMETER(in_flight);
+    IGNORE_PARAMETER(now);
+    cubic_reduce(cc);
+    cc->cwnd = PICO_TCP_IW * cc->mss;
+}
+
+static uint32_t cubic_get_cwnd(struct pico_tcp_cc *cc)
+{
+    return cc->cwnd;
+}
+
+static uint32_t cubic_get_ssthresh(struct pico_tcp_cc *cc)
+{
+    return cc->ssthresh;
+}
+
+struct pico_tcp_cc_ops pico_tcp_cc_cubic = {
+    "cubic",
+    cubic_init,
+    cubic_on_ack,
+    cubic_on_loss,
+    cubic_on_rto,
+    cubic_get_cwnd,
+    cubic_get_ssthresh,
+    NULL
+};
+
+#endif
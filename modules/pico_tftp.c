@@ -106,9 +106,9 @@ struct automa_events {
     void (*timeout)(struct pico_tftp_session *session, pico_time t);
 };
 
-static struct server_t server;
+static PICO_TLS struct server_t server;
 
-static struct pico_tftp_session *tftp_sessions = NULL;
+static PICO_TLS struct pico_tftp_session *tftp_sessions = NULL;
 
 static inline void session_status_set(struct pico_tftp_session *session, int status)
 {
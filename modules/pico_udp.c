@@ -23,12 +23,8 @@
 #define UDP_FRAME_OVERHEAD (sizeof(struct pico_frame))
 
 /* Queues */
-static struct pico_queue udp_in = {
-    0
-};
-static struct pico_queue udp_out = {
-    0
-};
+PICO_PROTO_QUEUE_DECLARE(udp_in);
+PICO_PROTO_QUEUE_DECLARE(udp_out);
 
 
 /* Functions */
@@ -56,7 +52,7 @@ uint16_t pico_udp_checksum_ipv4(struct pico_frame *f)
     pseudo.proto = PICO_PROTO_UDP;
     pseudo.len = short_be(f->transport_len);
 
-    return pico_dualbuffer_checksum(&pseudo, sizeof(struct pico_ipv4_pseudo_hdr), udp_hdr, f->transport_len);
+    return pico_frame_dualbuffer_checksum(&pseudo, sizeof(struct pico_ipv4_pseudo_hdr), f, udp_hdr, f->transport_len);
 }
 
 #ifdef PICO_SUPPORT_IPV6
@@ -88,7 +84,7 @@ uint16_t pico_udp_checksum_ipv6(struct pico_frame *f)
     pseudo.len = long_be(f->transport_len);
     pseudo.nxthdr = PICO_PROTO_UDP;
 
-    return pico_dualbuffer_checksum(&pseudo, sizeof(struct pico_ipv6_pseudo_hdr), udp_hdr, f->transport_len);
+    return pico_frame_dualbuffer_checksum(&pseudo, sizeof(struct pico_ipv6_pseudo_hdr), f, udp_hdr, f->transport_len);
 }
 #endif
 
@@ -131,15 +127,15 @@ static int pico_udp_push(struct pico_protocol *self, struct pico_frame *f)
 }
 
 /* Interface: protocol definition */
-struct pico_protocol pico_proto_udp = {
+PICO_TLS struct pico_protocol pico_proto_udp = {
     .name = "udp",
     .proto_number = PICO_PROTO_UDP,
     .layer = PICO_LAYER_TRANSPORT,
     .process_in = pico_transport_process_in,
     .process_out = pico_udp_process_out,
     .push = pico_udp_push,
-    .q_in = &udp_in,
-    .q_out = &udp_out,
+    .q_in = PICO_PROTO_QUEUE(udp_in),
+    .q_out = PICO_PROTO_QUEUE(udp_out),
 };
 
 
@@ -0,0 +1 @@
+OPTIONS+=-DPICO_SUPPORT_MULTI_INSTANCE
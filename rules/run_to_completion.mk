@@ -0,0 +1 @@
+OPTIONS+=-DPICO_SUPPORT_RUN_TO_COMPLETION
@@ -0,0 +1 @@
+OPTIONS+=-DPICO_SUPPORT_SPSC_QUEUE
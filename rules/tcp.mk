@@ -1,3 +1,5 @@
 OPTIONS+=-DPICO_SUPPORT_TCP
 MOD_OBJ+=$(LIBBASE)modules/pico_tcp.o
 MOD_OBJ+=$(LIBBASE)modules/pico_socket_tcp.o
+MOD_OBJ+=$(LIBBASE)modules/pico_tcp_cc.o
+MOD_OBJ+=$(LIBBASE)modules/pico_tcp_cubic.o
@@ -0,0 +1 @@
+OPTIONS+=-DPICO_SUPPORT_TCP_AUTOTUNE
@@ -0,0 +1 @@
+OPTIONS+=-DPICO_SUPPORT_TIMER_WHEEL
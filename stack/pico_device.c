@@ -26,7 +26,7 @@ struct pico_devices_rr_info {
     struct pico_tree_node *node_in, *node_out;
 };
 
-static struct pico_devices_rr_info Devices_rr_info = {
+static PICO_TLS struct pico_devices_rr_info Devices_rr_info = {
     NULL, NULL
 };
 
@@ -43,7 +43,7 @@ static int pico_dev_cmp(void *ka, void *kb)
     return 0;
 }
 
-PICO_TREE_DECLARE(Device_tree, pico_dev_cmp);
+PICO_TLS PICO_TREE_DECLARE(Device_tree, pico_dev_cmp);
 
 #ifdef PICO_SUPPORT_6LOWPAN
 static struct pico_ipv6_link * pico_6lowpan_link_add(struct pico_device *dev, const struct pico_ip6 *prefix)
@@ -264,15 +264,72 @@ static void pico_queue_destroy(struct pico_queue *q)
 {
     if (q) {
         pico_queue_empty(q);
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+        if (q->ring)
+            pico_queue_deinit(q);
+
+#endif
         PICO_FREE(q);
     }
 }
 
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+/* Top the empty frames for pico_stack_recv_ring() up. The stack thread is
+ * the producer of q_rx_free, the driver its consumer. */
+static void pico_device_rx_refill(struct pico_device *dev)
+{
+    struct pico_frame *f;
+
+    while (!pico_queue_ring_full(dev->q_rx_free)) {
+        f = pico_frame_alloc(dev->rx_frame_len);
+        if (!f)
+            return;
+
+        f->dev = dev;
+        pico_queue_ring_push(dev->q_rx_free, f);
+    }
+}
+
+/* Let a driver thread or ISR receive with pico_stack_recv_ring(): q_in goes
+ * to ring mode, and up to 'slots' empty frames of frame_len bytes are kept
+ * ready for it. Call before the driver starts receiving. */
+int pico_device_rx_ring_init(struct pico_device *dev, uint32_t slots, uint32_t frame_len)
+{
+    struct pico_queue *q;
+
+    if (!dev || !dev->q_in || dev->q_rx_free || !frame_len) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    q = PICO_ZALLOC(sizeof(struct pico_queue));
+    if (!q) {
+        pico_err = PICO_ERR_ENOMEM;
+        return -1;
+    }
+
+    if ((!dev->q_in->ring && (pico_queue_ring_init(dev->q_in, slots) < 0)) || (pico_queue_ring_init(q, slots) < 0)) {
+        PICO_FREE(q);
+        pico_err = PICO_ERR_ENOMEM;
+        return -1;
+    }
+
+    dev->q_rx_free = q;
+    dev->rx_frame_len = frame_len;
+    pico_device_rx_refill(dev);
+    return 0;
+}
+#endif
+
 void pico_device_destroy(struct pico_device *dev)
 {
 
     pico_queue_destroy(dev->q_in);
     pico_queue_destroy(dev->q_out);
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    pico_queue_destroy(dev->q_rx_free);
+    pico_frame_discard(dev->rx_spare);
+#endif
 
     if (!dev->mode && dev->eth)
         PICO_FREE(dev->eth);
@@ -303,9 +360,45 @@ static int check_dev_serve_interrupt(struct pico_device *dev, int loop_score)
     return loop_score;
 }
 
+/* Receive buffers offered to poll_batch, allocated at first use */
+static PICO_TLS uint8_t *devloop_batch_buf = NULL;
+
+static int devloop_poll_batch(struct pico_device *dev, int loop_score)
+{
+    struct pico_iovec pkt[PICO_DEVICE_BATCH];
+    int i, n, count;
+
+    if (!devloop_batch_buf) {
+        devloop_batch_buf = PICO_ZALLOC(PICO_DEVICE_BATCH * PICO_DEVICE_BATCH_BUFSIZE);
+        if (!devloop_batch_buf)
+            return loop_score;
+    }
+
+    while (loop_score > 0) {
+        count = (loop_score < PICO_DEVICE_BATCH) ? loop_score : PICO_DEVICE_BATCH;
+        for (i = 0; i < count; i++) {
+            pkt[i].base = devloop_batch_buf + i * PICO_DEVICE_BATCH_BUFSIZE;
+            pkt[i].len = PICO_DEVICE_BATCH_BUFSIZE;
+        }
+
+        n = dev->poll_batch(dev, pkt, count);
+        if (n <= 0)
+            break;
+
+        for (i = 0; i < n; i++)
+            pico_stack_recv(dev, pkt[i].base, pkt[i].len);
+        loop_score -= n;
+        if (n < count)
+            break; /* Drained */
+    }
+    return loop_score;
+}
+
 static int check_dev_serve_polling(struct pico_device *dev, int loop_score)
 {
-    if (dev->poll) {
+    if (dev->poll_batch) {
+        loop_score = devloop_poll_batch(dev, loop_score);
+    } else if (dev->poll) {
         loop_score = dev->poll(dev, loop_score);
     }
 
@@ -315,6 +408,11 @@ static int check_dev_serve_polling(struct pico_device *dev, int loop_score)
 static int devloop_in(struct pico_device *dev, int loop_score)
 {
     struct pico_frame *f;
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    if (dev->q_rx_free)
+        pico_device_rx_refill(dev);
+
+#endif
     while(loop_score > 0) {
         if (dev->q_in->frames == 0)
             break;
@@ -329,19 +427,92 @@ static int devloop_in(struct pico_device *dev, int loop_score)
     return loop_score;
 }
 
+/* Hand a frame to the driver, as a list of segments if it was built as a
+ * chain and the driver can take one, as a single buffer otherwise.
+ */
+static int pico_device_send_frame(struct pico_device *dev, struct pico_frame *f)
+{
+    struct pico_iovec iov[PICO_FRAME_MAX_SEGMENTS];
+    int n;
+
+#ifdef PICO_SUPPORT_TCP_GSO
+    /* Only TSO devices are handed super-segments, see pico_sendto_dev() */
+    if (f->gso_size && dev->send_tso) {
+        n = pico_frame_segments(f, iov, PICO_FRAME_MAX_SEGMENTS);
+        if ((n < 0) && (pico_frame_linearize(f) == 0))
+            n = pico_frame_segments(f, iov, PICO_FRAME_MAX_SEGMENTS);
+
+        if (n < 0)
+            return 0; /* Try again later */
+
+        return dev->send_tso(dev, iov, n, f->gso_size);
+    }
+
+#endif
+    if (f->chain && dev->send_iov) {
+        n = pico_frame_segments(f, iov, PICO_FRAME_MAX_SEGMENTS);
+        if (n > 0)
+            return dev->send_iov(dev, iov, n);
+    }
+
+    if (pico_frame_linearize(f) < 0)
+        return 0; /* Try again later */
+
+    return dev->send(dev, f->start, (int)f->len);
+}
+
 static int devloop_sendto_dev(struct pico_device *dev, struct pico_frame *f)
 {
+    uint32_t len = f->buffer_len;
+    int ret;
 #ifdef PICO_SUPPORT_6LOWPAN
     if (PICO_DEV_IS_6LOWPAN(dev)) {
         return (pico_6lowpan_ll_sendto_dev(dev, f) <= 0);
     }
 #endif
-    return (dev->send(dev, f->start, (int)f->len) <= 0);
+    ret = pico_device_send_frame(dev, f);
+
+    /* f is still queued: if it was linearized, it leaves with a new buffer */
+    if (f->buffer_len != len)
+        pico_queue_resize_frame(dev->q_out, f, len);
+
+    return (ret <= 0);
+}
+
+static int devloop_out_batch(struct pico_device *dev, int loop_score)
+{
+    struct pico_frame *batch[PICO_DEVICE_BATCH];
+    struct pico_frame *f;
+    int i, n, sent;
+
+    while (loop_score > 0) {
+        n = pico_queue_peek_batch(dev->q_out, batch, (loop_score < PICO_DEVICE_BATCH) ? loop_score : PICO_DEVICE_BATCH);
+        if (n == 0)
+            break;
+
+        sent = dev->send_batch(dev, batch, n);
+        if (sent <= 0)
+            break; /* Busy, don't discard */
+
+        for (i = 0; i < sent; i++) {
+            f = pico_dequeue(dev->q_out);
+            pico_frame_discard(f);
+        }
+        loop_score -= sent;
+        if (sent < n)
+            break;
+    }
+
+    return loop_score;
 }
 
 static int devloop_out(struct pico_device *dev, int loop_score)
 {
     struct pico_frame *f;
+
+    if (dev->send_batch)
+        return devloop_out_batch(dev, loop_score);
+
     while(loop_score > 0) {
         if (dev->q_out->frames == 0)
             break;
@@ -434,6 +605,28 @@ int pico_devices_loop(int loop_score, int direction)
     return loop_score;
 }
 
+/* Returns 1 if the next tick has work to do on any device. Devices that can
+ * only be polled, and do not expose a wait_fd, always count as pending.
+ */
+int pico_devices_pending(void)
+{
+    struct pico_tree_node *index;
+    struct pico_device *dev;
+
+    pico_tree_foreach(index, &Device_tree) {
+        dev = index->keyValue;
+        if ((dev->q_in->frames > 0) || (dev->q_out->frames > 0))
+            return 1;
+
+        if ((dev->__serving_interrupt) && (dev->dsr))
+            return 1;
+
+        if ((dev->poll || dev->poll_batch) && (!dev->wait_fd))
+            return 1;
+    }
+    return 0;
+}
+
 struct pico_device *pico_get_device(const char*name)
 {
     struct pico_device *dev;
@@ -462,12 +655,12 @@ int32_t pico_device_broadcast(struct pico_frame *f)
                 break;
 
             copy->dev = dev;
-            copy->dev->send(copy->dev, copy->start, (int)copy->len);
+            pico_device_send_frame(copy->dev, copy);
             pico_frame_discard(copy);
         }
         else
         {
-            ret = f->dev->send(f->dev, f->start, (int)f->len);
+            ret = pico_device_send_frame(f->dev, f);
         }
     }
     return ret;
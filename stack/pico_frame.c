@@ -13,26 +13,241 @@
 #include "pico_stack.h"
 #include "pico_socket.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define PICO_CHECKSUM_X86
+# include <immintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+# define PICO_CHECKSUM_NEON
+# include <arm_neon.h>
+#endif
+
 #ifdef PICO_SUPPORT_DEBUG_MEMORY
-static int n_frames_allocated;
+static PICO_TLS int n_frames_allocated;
 #endif
 
+#ifdef PICO_SUPPORT_FRAME_POOL
+/* A pooled frame is one cache aligned chunk: the descriptor, the usage
+ * counter and, except for the bare descriptor class, the packet buffer.
+ * Copies and zero-copy frames only use the descriptor (and counter) of a
+ * chunk from class 0. A chunk goes back to its free list once both its
+ * descriptor and its counter/buffer are released, which may happen in any
+ * order when copies outlive the original frame.
+ */
+#define FRAME_POOL_ALIGN      64u
+#define FRAME_POOL_ROUND(x)   (((x) + (FRAME_POOL_ALIGN - 1u)) & ~(FRAME_POOL_ALIGN - 1u))
+#define FRAME_CHUNK_DESC      0x01u
+#define FRAME_CHUNK_BUF       0x02u
+#define FRAME_CHUNK_DATA      FRAME_POOL_ROUND((uint32_t)sizeof(struct pico_frame_chunk))
+
+struct pico_frame_pool;
+
+struct pico_frame_chunk {
+    struct pico_frame frame;
+    struct pico_frame_chunk *next;
+    struct pico_frame_pool *pool;
+    uint32_t usage_count;
+    uint8_t live;
+};
+
+struct pico_frame_pool {
+    uint32_t size;
+    struct pico_frame_chunk *free;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t in_use;
+    uint32_t high_water;
+};
+
+static PICO_TLS struct pico_frame_pool frame_pools[PICO_FRAME_POOL_CLASSES] = {
+    { 0 }, { PICO_FRAME_POOL_SIZE_1 }, { PICO_FRAME_POOL_SIZE_2 }, { PICO_FRAME_POOL_SIZE_3 }
+};
+static PICO_TLS int frame_pools_ready = 0;
+
+#define FRAME_POOL_STRIDE(pool) FRAME_POOL_ROUND(FRAME_CHUNK_DATA + (pool)->size)
+#define FRAME_CHUNK_BUFFER(c)   (((uint8_t *)(c)) + FRAME_CHUNK_DATA)
+#define FRAME_CHUNK_OF_USAGE(u) ((struct pico_frame_chunk *)(void *)(((uint8_t *)(u)) - offsetof(struct pico_frame_chunk, usage_count)))
+
+static uint8_t *frame_pool_align(uint8_t *p)
+{
+    return (uint8_t *)(((uintptr_t)p + (FRAME_POOL_ALIGN - 1u)) & ~((uintptr_t)FRAME_POOL_ALIGN - 1u));
+}
+
+/* Carve 'count' chunks out of one allocation. Pool memory is never handed
+ * back to the heap, the free lists only grow up to the high-water mark.
+ */
+static int frame_pool_grow(struct pico_frame_pool *pool, uint32_t count)
+{
+    uint32_t stride = FRAME_POOL_STRIDE(pool);
+    struct pico_frame_chunk *c;
+    uint8_t *slab;
+    uint32_t i;
+
+    slab = PICO_ZALLOC((size_t)stride * count + FRAME_POOL_ALIGN - 1u);
+    if (!slab)
+        return -1;
+
+    slab = frame_pool_align(slab);
+    for (i = 0; i < count; i++) {
+        c = (struct pico_frame_chunk *)(void *)(slab + (size_t)stride * i);
+        c->pool = pool;
+        c->next = pool->free;
+        pool->free = c;
+    }
+    return 0;
+}
+
+static void frame_pools_init(void)
+{
+    uint32_t i;
+    frame_pools_ready = 1;
+    for (i = 0; i < PICO_FRAME_POOL_CLASSES; i++) {
+        uint32_t count = (PICO_FRAME_POOL_BUDGET / PICO_FRAME_POOL_CLASSES) / FRAME_POOL_STRIDE(&frame_pools[i]);
+        if (count > 0)
+            frame_pool_grow(&frame_pools[i], count);
+    }
+}
+
+/* Smallest class with a buffer of at least 'size' bytes */
+static struct pico_frame_pool *frame_pool_for_size(uint32_t size)
+{
+    uint32_t i;
+    for (i = 1; i < PICO_FRAME_POOL_CLASSES; i++) {
+        if (frame_pools[i].size >= size)
+            return &frame_pools[i];
+    }
+    return NULL;
+}
+
+static struct pico_frame_chunk *frame_pool_get(struct pico_frame_pool *pool)
+{
+    struct pico_frame_chunk *c;
+
+    if (!frame_pools_ready)
+        frame_pools_init();
+
+    if (pool->free) {
+        pool->hits++;
+    } else {
+        pool->misses++;
+        if (frame_pool_grow(pool, 1) < 0)
+            return NULL;
+    }
+
+    c = pool->free;
+    pool->free = c->next;
+    memset(&c->frame, 0, sizeof(struct pico_frame));
+    c->next = NULL;
+    c->usage_count = 1;
+    c->live = FRAME_CHUNK_DESC | FRAME_CHUNK_BUF;
+    if (++pool->in_use > pool->high_water)
+        pool->high_water = pool->in_use;
+
+    return c;
+}
+
+static void frame_pool_release(struct pico_frame_chunk *c, uint8_t what)
+{
+    c->live = (uint8_t)(c->live & ~what);
+    if (c->live)
+        return;
+
+    c->pool->in_use--;
+    c->next = c->pool->free;
+    c->pool->free = c;
+}
+
+/* Detach a frame from the counter/buffer part of its chunk. Returns 1 if the
+ * buffer lived in the chunk itself and must not be freed by the caller.
+ */
+static int frame_pool_put_buffer(uint32_t *usage_count, uint8_t *buffer)
+{
+    struct pico_frame_chunk *c = FRAME_CHUNK_OF_USAGE(usage_count);
+    int inside = (c->pool->size > 0) && (buffer == FRAME_CHUNK_BUFFER(c));
+    frame_pool_release(c, FRAME_CHUNK_BUF);
+    return inside;
+}
+
+static void frame_pool_put_desc(struct pico_frame *f)
+{
+    frame_pool_release((struct pico_frame_chunk *)(void *)f, FRAME_CHUNK_DESC);
+}
+
+int pico_frame_pool_stats(uint32_t class_idx, struct pico_frame_pool_stats *stats)
+{
+    struct pico_frame_pool *pool;
+    struct pico_frame_chunk *c;
+
+    if (!stats || (class_idx >= PICO_FRAME_POOL_CLASSES))
+        return -1;
+
+    pool = &frame_pools[class_idx];
+    stats->size = pool->size;
+    stats->hits = pool->hits;
+    stats->misses = pool->misses;
+    stats->in_use = pool->in_use;
+    stats->high_water = pool->high_water;
+    stats->free = 0;
+    for (c = pool->free; c; c = c->next)
+        stats->free++;
+    return 0;
+}
+#endif
+
+static struct pico_frame *pico_frame_desc_alloc(void)
+{
+#ifdef PICO_SUPPORT_FRAME_POOL
+    struct pico_frame_chunk *c = frame_pool_get(&frame_pools[0]);
+    if (!c)
+        return NULL;
+
+    /* Only the descriptor of this chunk is in use */
+    c->live = FRAME_CHUNK_DESC;
+    c->frame.flags = PICO_FRAME_FLAG_POOL_DESC;
+    return &c->frame;
+#else
+    return PICO_ZALLOC(sizeof(struct pico_frame));
+#endif
+}
+
+static void pico_frame_desc_free(struct pico_frame *f)
+{
+#ifdef PICO_SUPPORT_FRAME_POOL
+    if (f->flags & PICO_FRAME_FLAG_POOL_DESC) {
+        frame_pool_put_desc(f);
+        return;
+    }
+#endif
+    PICO_FREE(f);
+}
+
 /** frame alloc/dealloc/copy **/
 void pico_frame_discard(struct pico_frame *f)
 {
+    int in_pool = 0;
     if (!f)
         return;
 
+    if (f->chain)
+        pico_frame_discard(f->chain);
+
     (*f->usage_count)--;
     if (*f->usage_count == 0) {
         if (f->flags & PICO_FRAME_FLAG_EXT_USAGE_COUNTER)
             PICO_FREE(f->usage_count);
 
+#ifdef PICO_SUPPORT_FRAME_POOL
+        if (f->flags & PICO_FRAME_FLAG_POOL_BUF)
+            in_pool = frame_pool_put_buffer(f->usage_count, f->buffer);
+#endif
+
 #ifdef PICO_SUPPORT_DEBUG_MEMORY
         dbg("Discarded buffer @%p, caller: %p\n", f->buffer, __builtin_return_address(3));
         dbg("DEBUG MEMORY: %d frames in use.\n", --n_frames_allocated);
 #endif
-        if (!(f->flags & PICO_FRAME_FLAG_EXT_BUFFER))
+        if (in_pool) {
+            /* Buffer went back to the pool with its chunk */
+        } else if (!(f->flags & PICO_FRAME_FLAG_EXT_BUFFER))
             PICO_FREE(f->buffer);
         else if (f->notify_free)
             f->notify_free(f->buffer);
@@ -46,16 +261,23 @@ void pico_frame_discard(struct pico_frame *f)
         dbg("Removed frame @%p(copy), usage count now: %d\n", f, *f->usage_count);
     }
 #endif
-    PICO_FREE(f);
+    pico_frame_desc_free(f);
 }
 
-struct pico_frame *pico_frame_copy(struct pico_frame *f)
+/* New descriptor for the buffer of f alone, without its chain */
+static struct pico_frame *pico_frame_copy_desc(struct pico_frame *f)
 {
-    struct pico_frame *new = PICO_ZALLOC(sizeof(struct pico_frame));
+    struct pico_frame *new;
+    uint8_t flags;
+
+    new = pico_frame_desc_alloc();
     if (!new)
         return NULL;
 
+    flags = new->flags;
     memcpy(new, f, sizeof(struct pico_frame));
+    new->flags = (uint8_t)((f->flags & ~PICO_FRAME_FLAG_POOL_DESC) | flags);
+    new->chain = NULL;
     *(new->usage_count) += 1;
 #ifdef PICO_SUPPORT_DEBUG_MEMORY
     dbg("Copied frame @%p, into %p, usage count now: %d\n", f, new, *new->usage_count);
@@ -64,19 +286,120 @@ struct pico_frame *pico_frame_copy(struct pico_frame *f)
     return new;
 }
 
+struct pico_frame *pico_frame_copy(struct pico_frame *f)
+{
+    struct pico_frame *new, *chain = NULL;
+
+    if (f->chain) {
+        chain = pico_frame_copy(f->chain);
+        if (!chain)
+            return NULL;
+    }
+
+    new = pico_frame_copy_desc(f);
+    if (!new) {
+        pico_frame_discard(chain);
+        return NULL;
+    }
+
+    new->chain = chain;
+    return new;
+}
+
+/* Chain of segments referencing len bytes of the payload of f, starting off
+ * bytes into it. The payload begins at f->payload and ends in the segments
+ * chained to f. No data is copied: the segments share the buffers of f.
+ */
+struct pico_frame *pico_frame_payload_ref(struct pico_frame *f, uint32_t off, uint32_t len)
+{
+    struct pico_frame *ref, *head = NULL, **tail = &head;
+    struct pico_frame *seg = f;
+    uint8_t *start = f->payload;
+    uint32_t seg_len = (uint32_t)f->payload_len - pico_frame_total_len(f->chain);
+    uint32_t n;
+
+    while (seg && len) {
+        if (off < seg_len) {
+            n = (seg_len - off < len) ? (seg_len - off) : len;
+            ref = pico_frame_copy_desc(seg);
+            if (!ref) {
+                pico_frame_discard(head);
+                return NULL;
+            }
+
+            ref->start = start + off;
+            ref->len = n;
+            *tail = ref;
+            tail = &ref->chain;
+            len -= n;
+            off = 0;
+        } else {
+            off -= seg_len;
+        }
+
+        seg = seg->chain;
+        if (seg) {
+            start = seg->start;
+            seg_len = seg->len;
+        }
+    }
+
+    if (len) {
+        /* Past the end of the payload */
+        pico_frame_discard(head);
+        return NULL;
+    }
+
+    return head;
+}
+
+#ifdef PICO_SUPPORT_FRAME_POOL
+/* Whole frame from a single chunk, NULL if no class is large enough */
+static struct pico_frame *pico_frame_pool_alloc(uint32_t size, int zerocopy)
+{
+    struct pico_frame_pool *pool = zerocopy ? &frame_pools[0] : frame_pool_for_size(size);
+    struct pico_frame_chunk *c;
+    struct pico_frame *p;
+
+    if (!pool)
+        return NULL;
+
+    c = frame_pool_get(pool);
+    if (!c)
+        return NULL;
+
+    p = &c->frame;
+    p->flags = PICO_FRAME_FLAG_POOL_DESC | PICO_FRAME_FLAG_POOL_BUF;
+    p->usage_count = &c->usage_count;
+    if (!zerocopy) {
+        p->buffer = FRAME_CHUNK_BUFFER(c);
+        memset(p->buffer, 0, size);
+    }
+
+    return p;
+}
+#endif
+
 static struct pico_frame *pico_frame_do_alloc(uint32_t size, int zerocopy, int ext_buffer)
 {
-    struct pico_frame *p = PICO_ZALLOC(sizeof(struct pico_frame));
+    struct pico_frame *p;
     uint32_t frame_buffer_size = size;
-    if (!p)
-        return NULL;
 
     if (ext_buffer && !zerocopy) {
         /* external buffer implies zerocopy flag! */
-        PICO_FREE(p);
         return NULL;
     }
 
+#ifdef PICO_SUPPORT_FRAME_POOL
+    p = pico_frame_pool_alloc(size, zerocopy);
+    if (p)
+        goto init;
+#endif
+
+    p = pico_frame_desc_alloc();
+    if (!p)
+        return NULL;
+
     if (!zerocopy) {
         unsigned int align = size % sizeof(uint32_t);
         /* Ensure that usage_count starts on an aligned address */
@@ -86,7 +409,7 @@ static struct pico_frame *pico_frame_do_alloc(uint32_t size, int zerocopy, int e
 
         p->buffer = PICO_ZALLOC((size_t)frame_buffer_size + sizeof(uint32_t));
         if (!p->buffer) {
-            PICO_FREE(p);
+            pico_frame_desc_free(p);
             return NULL;
         }
 
@@ -96,11 +419,14 @@ static struct pico_frame *pico_frame_do_alloc(uint32_t size, int zerocopy, int e
         p->flags |= PICO_FRAME_FLAG_EXT_USAGE_COUNTER;
         p->usage_count = PICO_ZALLOC(sizeof(uint32_t));
         if (!p->usage_count) {
-            PICO_FREE(p);
+            pico_frame_desc_free(p);
             return NULL;
         }
     }
 
+#ifdef PICO_SUPPORT_FRAME_POOL
+init:
+#endif
     p->buffer_len = size;
 
     /* By default, frame content is the full buffer. */
@@ -128,8 +454,159 @@ struct pico_frame *pico_frame_alloc(uint32_t size)
     return pico_frame_do_alloc(size, 0, 0);
 }
 
+/* Flags that describe the buffer rather than the packet */
+#define PICO_FRAME_BUFFER_FLAGS (PICO_FRAME_FLAG_EXT_BUFFER | PICO_FRAME_FLAG_EXT_USAGE_COUNTER | PICO_FRAME_FLAG_POOL_BUF)
+
+/* Move the buffer and chain references of f to a new descriptor. The
+ * pointers of f are left untouched, but f no longer owns that memory.
+ */
+static struct pico_frame *pico_frame_detach(struct pico_frame *f)
+{
+    struct pico_frame *d = pico_frame_desc_alloc();
+    uint8_t flags;
+    if (!d)
+        return NULL;
+
+    flags = d->flags;
+    memcpy(d, f, sizeof(struct pico_frame));
+    d->flags = (uint8_t)((f->flags & ~PICO_FRAME_FLAG_POOL_DESC) | flags);
+    d->next = NULL;
+    return d;
+}
+
+/* Make f the owner of the buffer of n, and drop the descriptor of n. The
+ * transport info stays with the old buffer, which frees it.
+ */
+static void pico_frame_adopt(struct pico_frame *f, struct pico_frame *n)
+{
+    f->buffer = n->buffer;
+    f->buffer_len = n->buffer_len;
+    f->usage_count = n->usage_count;
+    f->flags = (uint8_t)((f->flags & ~PICO_FRAME_BUFFER_FLAGS) | (n->flags & PICO_FRAME_BUFFER_FLAGS));
+    f->notify_free = NULL;
+    f->info = NULL;
+    f->chain = NULL;
+    pico_frame_desc_free(n);
+}
+
+/* Move the content of f into a payload segment chained after a new, empty
+ * header segment with 'size' bytes of headroom. Lower layers then prepend
+ * their headers as usual (start -= hdr_len, len += hdr_len), without
+ * reallocating and copying the payload.
+ */
+int pico_frame_prepend_segment(struct pico_frame *f, uint32_t size)
+{
+    struct pico_frame *hdr, *seg;
+
+    hdr = pico_frame_alloc(size);
+    if (!hdr)
+        return -1;
+
+    seg = pico_frame_detach(f);
+    if (!seg) {
+        pico_frame_discard(hdr);
+        return -1;
+    }
+
+    pico_frame_adopt(f, hdr);
+    f->chain = seg;
+    f->start = f->buffer + size;
+    f->len = 0;
+    f->datalink_hdr = f->start;
+    return 0;
+}
+
+uint32_t pico_frame_total_len(struct pico_frame *f)
+{
+    uint32_t len = 0;
+    for (; f; f = f->chain)
+        len += f->len;
+    return len;
+}
+
+/* Fill 'iov' with the non-empty segments of f. Returns their number, or -1
+ * if there are more than 'max'.
+ */
+int pico_frame_segments(struct pico_frame *f, struct pico_iovec *iov, int max)
+{
+    int n = 0;
+    for (; f; f = f->chain) {
+        if (!f->len)
+            continue;
+
+        if (n >= max)
+            return -1;
+
+        iov[n].base = f->start;
+        iov[n].len = f->len;
+        n++;
+    }
+    return n;
+}
+
+/* Where p ends up once the segments of f are copied one after the other
+ * to 'dst', behind the headroom of the first one.
+ */
+static uint8_t *pico_frame_remap(struct pico_frame *f, uint8_t *p, uint8_t *dst)
+{
+    struct pico_frame *seg;
+    uint32_t off = (uint32_t)(f->start - f->buffer) + f->len;
+
+    if ((p >= f->buffer) && (p <= f->start + f->len))
+        return dst + (p - f->buffer);
+
+    for (seg = f->chain; seg; seg = seg->chain) {
+        if ((p >= seg->start) && (p <= seg->start + seg->len))
+            return dst + off + (p - seg->start);
+
+        off += seg->len;
+    }
+    return dst;
+}
+
+/* Copy a scatter-gather frame into a single buffer */
+int pico_frame_linearize(struct pico_frame *f)
+{
+    struct pico_frame *n, *old, *seg;
+    uint32_t headroom;
+    uint8_t *p;
+
+    if (!f->chain)
+        return 0;
+
+    headroom = (uint32_t)(f->start - f->buffer);
+    n = pico_frame_alloc(headroom + pico_frame_total_len(f));
+    if (!n)
+        return -1;
+
+    old = pico_frame_detach(f);
+    if (!old) {
+        pico_frame_discard(n);
+        return -1;
+    }
+
+    p = n->buffer;
+    memcpy(p, f->buffer, (size_t)(headroom + f->len));
+    p += headroom + f->len;
+    for (seg = f->chain; seg; seg = seg->chain) {
+        memcpy(p, seg->start, (size_t)seg->len);
+        p += seg->len;
+    }
+
+    f->datalink_hdr = pico_frame_remap(old, f->datalink_hdr, n->buffer);
+    f->net_hdr = pico_frame_remap(old, f->net_hdr, n->buffer);
+    f->transport_hdr = pico_frame_remap(old, f->transport_hdr, n->buffer);
+    f->app_hdr = pico_frame_remap(old, f->app_hdr, n->buffer);
+    f->payload = pico_frame_remap(old, f->payload, n->buffer);
+    f->start = n->buffer + headroom;
+    f->len = n->buffer_len - headroom;
+    pico_frame_adopt(f, n);
+    pico_frame_discard(old);
+    return 0;
+}
+
 static uint8_t *
-pico_frame_new_buffer(struct pico_frame *f, uint32_t size, uint32_t *oldsize)
+pico_frame_new_buffer(struct pico_frame *f, uint32_t size, uint32_t *oldsize, uint32_t **old_usage)
 {
     uint8_t *oldbuf;
     uint32_t usage_count, *p_old_usage;
@@ -162,13 +639,16 @@ pico_frame_new_buffer(struct pico_frame *f, uint32_t size, uint32_t *oldsize)
 
     if (f->flags & PICO_FRAME_FLAG_EXT_USAGE_COUNTER)
         PICO_FREE(p_old_usage);
+
+    *old_usage = p_old_usage;
     /* Now, the frame is not zerocopy anymore, and the usage counter has been moved within it */
     return oldbuf;
 }
 
 static int
-pico_frame_update_pointers(struct pico_frame *f, ptrdiff_t addr_diff, uint8_t *oldbuf)
+pico_frame_update_pointers(struct pico_frame *f, ptrdiff_t addr_diff, uint8_t *oldbuf, uint32_t *old_usage)
 {
+    int in_pool = 0;
     f->net_hdr += addr_diff;
     f->datalink_hdr += addr_diff;
     f->transport_hdr += addr_diff;
@@ -176,12 +656,22 @@ pico_frame_update_pointers(struct pico_frame *f, ptrdiff_t addr_diff, uint8_t *o
     f->start += addr_diff;
     f->payload += addr_diff;
 
-    if (!(f->flags & PICO_FRAME_FLAG_EXT_BUFFER))
+#ifdef PICO_SUPPORT_FRAME_POOL
+    if (f->flags & PICO_FRAME_FLAG_POOL_BUF)
+        in_pool = frame_pool_put_buffer(old_usage, oldbuf);
+#else
+    (void)old_usage;
+#endif
+
+    if (in_pool) {
+        /* Old buffer went back to the pool with its chunk */
+    } else if (!(f->flags & PICO_FRAME_FLAG_EXT_BUFFER))
         PICO_FREE(oldbuf);
     else if (f->notify_free)
         f->notify_free(oldbuf);
 
-    f->flags = 0;
+    /* The descriptor itself did not move */
+    f->flags = (uint8_t)(f->flags & PICO_FRAME_FLAG_POOL_DESC);
     return 0;
 }
 
@@ -189,7 +679,13 @@ int pico_frame_grow_head(struct pico_frame *f, uint32_t size)
 {
     ptrdiff_t addr_diff = 0;
     uint32_t oldsize = 0;
-    uint8_t *oldbuf = pico_frame_new_buffer(f, size, &oldsize);
+    uint32_t *old_usage = NULL;
+    uint8_t *oldbuf;
+
+    if (f && pico_frame_linearize(f) < 0)
+        return -1;
+
+    oldbuf = pico_frame_new_buffer(f, size, &oldsize, &old_usage);
     if (!oldbuf)
         return -1;
 
@@ -197,14 +693,20 @@ int pico_frame_grow_head(struct pico_frame *f, uint32_t size)
     memcpy(f->buffer + f->buffer_len - oldsize, oldbuf, (size_t)oldsize);
     addr_diff = (ptrdiff_t)(f->buffer + f->buffer_len - oldsize - oldbuf);
 
-    return pico_frame_update_pointers(f, addr_diff, oldbuf);
+    return pico_frame_update_pointers(f, addr_diff, oldbuf, old_usage);
 }
 
 int pico_frame_grow(struct pico_frame *f, uint32_t size)
 {
     ptrdiff_t addr_diff = 0;
     uint32_t oldsize = 0;
-    uint8_t *oldbuf = pico_frame_new_buffer(f, size, &oldsize);
+    uint32_t *old_usage = NULL;
+    uint8_t *oldbuf;
+
+    if (f && pico_frame_linearize(f) < 0)
+        return -1;
+
+    oldbuf = pico_frame_new_buffer(f, size, &oldsize, &old_usage);
     if (!oldbuf)
         return -1;
 
@@ -212,7 +714,7 @@ int pico_frame_grow(struct pico_frame *f, uint32_t size)
     memcpy(f->buffer, oldbuf, (size_t)oldsize);
     addr_diff = (ptrdiff_t)(f->buffer - oldbuf);
 
-    return pico_frame_update_pointers(f, addr_diff, oldbuf);
+    return pico_frame_update_pointers(f, addr_diff, oldbuf, old_usage);
 }
 
 struct pico_frame *pico_frame_alloc_skeleton(uint32_t size, int ext_buffer)
@@ -230,25 +732,54 @@ int pico_frame_skeleton_set_buffer(struct pico_frame *f, void *buf)
     return 0;
 }
 
+static int pico_frame_copy_info(struct pico_frame *dst, struct pico_frame *src)
+{
+    if (src->info) {
+        dst->info = PICO_ZALLOC(sizeof(struct pico_remote_endpoint));
+        if (!dst->info)
+            return -1;
+
+        memcpy(dst->info, src->info, sizeof(struct pico_remote_endpoint));
+    }
+
+    return 0;
+}
+
 struct pico_frame *pico_frame_deepcopy(struct pico_frame *f)
 {
-    struct pico_frame *new = pico_frame_alloc(f->buffer_len);
+    struct pico_frame *new;
     ptrdiff_t addr_diff;
     unsigned char *buf;
     uint32_t *uc;
+    uint8_t pool_flags;
+
+    if (f->chain) {
+        /* A linearized copy has a buffer of its own */
+        new = pico_frame_copy(f);
+        if (!new || (pico_frame_linearize(new) < 0) || (pico_frame_copy_info(new, f) < 0)) {
+            pico_frame_discard(new);
+            return NULL;
+        }
+
+        return new;
+    }
+
+    new = pico_frame_alloc(f->buffer_len);
     if (!new)
         return NULL;
 
     /* Save the two key pointers... */
     buf = new->buffer;
     uc  = new->usage_count;
+    pool_flags = new->flags & (PICO_FRAME_FLAG_POOL_DESC | PICO_FRAME_FLAG_POOL_BUF);
 
     /* Overwrite all fields with originals */
     memcpy(new, f, sizeof(struct pico_frame));
 
-    /* ...restore the two key pointers */
+    /* ...restore the two key pointers, and where they come from */
     new->buffer = buf;
     new->usage_count = uc;
+    new->flags = (uint8_t)((f->flags & ~(PICO_FRAME_FLAG_POOL_DESC | PICO_FRAME_FLAG_POOL_BUF)) | pool_flags);
 
     /* Update in-buffer pointers with offset */
     addr_diff = (ptrdiff_t)(new->buffer - f->buffer);
@@ -259,13 +790,10 @@ struct pico_frame *pico_frame_deepcopy(struct pico_frame *f)
     new->start += addr_diff;
     new->payload += addr_diff;
 
-    if (f->info) {
-        new->info = PICO_ZALLOC(sizeof(struct pico_remote_endpoint));
-        if (!new->info) {
-            pico_frame_discard(new);
-            return NULL;
-        }
-        memcpy(new->info, f->info, sizeof(struct pico_remote_endpoint));
+    new->info = NULL;
+    if (pico_frame_copy_info(new, f) < 0) {
+        pico_frame_discard(new);
+        return NULL;
     }
 
 #ifdef PICO_SUPPORT_DEBUG_MEMORY
@@ -306,6 +834,180 @@ static inline uint16_t pico_checksum_finalize(uint32_t sum)
     return short_be((uint16_t) ~sum);
 }
 
+/* The kernels below return a partial sum that is congruent to the one of
+ * pico_checksum_adder() modulo 0xFFFF (and non zero when it is), which is
+ * all pico_checksum_finalize() needs. Since 2^16, 2^32 and 2^48 are all 1
+ * modulo 0xFFFF, the data can be summed in any word size, as long as the
+ * words are read in host order starting from the same address.
+ */
+static inline uint32_t pico_checksum_fold(uint64_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFFu) + (sum >> 16);
+
+    return (uint32_t)sum;
+}
+
+static uint32_t pico_checksum_adder64(uint32_t sum, void *data, uint32_t len)
+{
+    uint8_t *p = (uint8_t *)data;
+    uint64_t acc = sum;
+    uint64_t w[4];
+
+    while (len >= 32) {
+        memcpy(w, p, 32);
+        acc += (w[0] & 0xFFFFFFFFu) + (w[0] >> 32);
+        acc += (w[1] & 0xFFFFFFFFu) + (w[1] >> 32);
+        acc += (w[2] & 0xFFFFFFFFu) + (w[2] >> 32);
+        acc += (w[3] & 0xFFFFFFFFu) + (w[3] >> 32);
+        p += 32;
+        len -= 32;
+    }
+    while (len >= 8) {
+        memcpy(w, p, 8);
+        acc += (w[0] & 0xFFFFFFFFu) + (w[0] >> 32);
+        p += 8;
+        len -= 8;
+    }
+    /* Less than a word left, including a possible odd byte */
+    return pico_checksum_adder(pico_checksum_fold(acc), p, len);
+}
+
+#ifdef PICO_CHECKSUM_X86
+__attribute__((target("sse2")))
+static uint32_t pico_checksum_adder_sse2(uint32_t sum, void *data, uint32_t len)
+{
+    uint8_t *p = (uint8_t *)data;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    __m128i v0, v1;
+    uint64_t lanes[2];
+
+    if (len < 32)
+        return pico_checksum_adder64(sum, data, len);
+
+    /* Widen 32 bit words into 64 bit lanes, these never overflow */
+    while (len >= 32) {
+        v0 = _mm_loadu_si128((__m128i *)(void *)p);
+        v1 = _mm_loadu_si128((__m128i *)(void *)(p + 16));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v0, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v0, zero));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v1, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v1, zero));
+        p += 32;
+        len -= 32;
+    }
+    _mm_storeu_si128((__m128i *)(void *)lanes, _mm_add_epi64(acc0, acc1));
+    return pico_checksum_adder64(pico_checksum_fold((uint64_t)sum + lanes[0] + lanes[1]), p, len);
+}
+
+__attribute__((target("avx2")))
+static uint32_t pico_checksum_adder_avx2(uint32_t sum, void *data, uint32_t len)
+{
+    uint8_t *p = (uint8_t *)data;
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i v0, v1;
+    uint64_t lanes[4];
+
+    if (len < 64)
+        return pico_checksum_adder_sse2(sum, data, len);
+
+    while (len >= 64) {
+        v0 = _mm256_loadu_si256((__m256i *)(void *)p);
+        v1 = _mm256_loadu_si256((__m256i *)(void *)(p + 32));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v0, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v0, zero));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v1, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v1, zero));
+        p += 64;
+        len -= 64;
+    }
+    _mm256_storeu_si256((__m256i *)(void *)lanes, _mm256_add_epi64(acc0, acc1));
+    return pico_checksum_adder_sse2(pico_checksum_fold((uint64_t)sum + lanes[0] + lanes[1] + lanes[2] + lanes[3]), p, len);
+}
+
+static int pico_checksum_has_sse2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+static int pico_checksum_has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#ifdef PICO_CHECKSUM_NEON
+static uint32_t pico_checksum_adder_neon(uint32_t sum, void *data, uint32_t len)
+{
+    uint8_t *p = (uint8_t *)data;
+    uint64x2_t acc0 = vdupq_n_u64(0);
+    uint64x2_t acc1 = vdupq_n_u64(0);
+    uint64x2_t acc;
+
+    if (len < 32)
+        return pico_checksum_adder64(sum, data, len);
+
+    /* Pairwise add 32 bit words into 64 bit lanes */
+    while (len >= 32) {
+        acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(vld1q_u8(p)));
+        acc1 = vpadalq_u32(acc1, vreinterpretq_u32_u8(vld1q_u8(p + 16)));
+        p += 32;
+        len -= 32;
+    }
+    acc = vaddq_u64(acc0, acc1);
+    return pico_checksum_adder64(pico_checksum_fold((uint64_t)sum + vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1)), p, len);
+}
+#endif
+
+static int pico_checksum_has_64bit(void)
+{
+    return sizeof(void *) >= sizeof(uint64_t);
+}
+
+struct pico_checksum_kernel {
+    const char *name;
+    uint32_t (*adder)(uint32_t sum, void *data, uint32_t len);
+    int (*usable)(void); /* NULL if always usable */
+};
+
+/* In order of preference, the last usable one wins */
+static const struct pico_checksum_kernel pico_checksum_kernels[] = {
+    { "scalar", pico_checksum_adder, NULL },
+    { "word64", pico_checksum_adder64, pico_checksum_has_64bit },
+#ifdef PICO_CHECKSUM_X86
+    { "sse2", pico_checksum_adder_sse2, pico_checksum_has_sse2 },
+    { "avx2", pico_checksum_adder_avx2, pico_checksum_has_avx2 },
+#endif
+#ifdef PICO_CHECKSUM_NEON
+    { "neon", pico_checksum_adder_neon, NULL },
+#endif
+};
+
+#define PICO_CHECKSUM_KERNELS (sizeof(pico_checksum_kernels) / sizeof(pico_checksum_kernels[0]))
+
+/* Portable loop until pico_checksum_init() runs */
+static uint32_t (*pico_checksum_sum)(uint32_t sum, void *data, uint32_t len) = pico_checksum_adder;
+
+static int pico_checksum_kernel_usable(const struct pico_checksum_kernel *k)
+{
+    return (!k->usable) || k->usable();
+}
+
+void pico_checksum_init(void)
+{
+    uint32_t i;
+    for (i = 0; i < PICO_CHECKSUM_KERNELS; i++) {
+        if (pico_checksum_kernel_usable(&pico_checksum_kernels[i]))
+            pico_checksum_sum = pico_checksum_kernels[i].adder;
+    }
+}
+
 /**
  * Calculate checksum of a given string
  */
@@ -313,17 +1015,71 @@ uint16_t pico_checksum(void *inbuf, uint32_t len)
 {
     uint32_t sum;
 
-    sum = pico_checksum_adder(0, inbuf, len);
+    sum = pico_checksum_sum(0, inbuf, len);
     return pico_checksum_finalize(sum);
 }
 
+/**
+ * Incremental checksum update (RFC 1624, eqn. 3): HC' = ~(~HC + ~m + m').
+ * All values are taken as they are stored in the packet, so no byte swapping
+ * is needed on either side.
+ */
+uint16_t pico_checksum_adjust16(uint16_t crc, uint16_t old_val, uint16_t new_val)
+{
+    uint32_t sum = (uint16_t)~crc;
+
+    sum += (uint16_t)~old_val;
+    sum += new_val;
+    return (uint16_t)~pico_checksum_fold(sum);
+}
+
+uint16_t pico_checksum_adjust32(uint16_t crc, uint32_t old_val, uint32_t new_val)
+{
+    uint32_t sum = (uint16_t)~crc;
+
+    sum += (uint16_t)~(old_val >> 16);
+    sum += (uint16_t)~(old_val & 0xFFFFu);
+    sum += new_val >> 16;
+    sum += new_val & 0xFFFFu;
+    return (uint16_t)~pico_checksum_fold(sum);
+}
+
 /* WARNING: len1 MUST be an EVEN number */
 uint16_t pico_dualbuffer_checksum(void *inbuf1, uint32_t len1, void *inbuf2, uint32_t len2)
 {
     uint32_t sum;
 
-    sum = pico_checksum_adder(0, inbuf1, len1);
-    sum = pico_checksum_adder(sum, inbuf2, len2);
+    sum = pico_checksum_sum(0, inbuf1, len1);
+    sum = pico_checksum_sum(sum, inbuf2, len2);
+    return pico_checksum_finalize(sum);
+}
+
+/* As pico_dualbuffer_checksum(), for a transport segment of len2 bytes that
+ * starts at inbuf2 in the first segment of f and ends in the segments
+ * chained to it. A segment starting at an odd offset sums byte-swapped.
+ * WARNING: len1 MUST be an EVEN number
+ */
+uint16_t pico_frame_dualbuffer_checksum(void *inbuf1, uint32_t len1, struct pico_frame *f, void *inbuf2, uint32_t len2)
+{
+    struct pico_frame *seg;
+    uint32_t sum, part, tail;
+    uint32_t odd;
+
+    tail = pico_frame_total_len(f->chain);
+    if (!f->chain || (tail > len2))
+        return pico_dualbuffer_checksum(inbuf1, len1, inbuf2, len2);
+
+    sum = pico_checksum_sum(0, inbuf1, len1);
+    sum = pico_checksum_sum(sum, inbuf2, len2 - tail);
+    odd = (len2 - tail) & 1u;
+    for (seg = f->chain; seg; seg = seg->chain) {
+        part = pico_checksum_fold(pico_checksum_sum(0, seg->start, seg->len));
+        if (odd)
+            part = ((part & 0xFFu) << 8) | (part >> 8);
+
+        sum = pico_checksum_fold((uint64_t)sum + part);
+        odd ^= seg->len & 1u;
+    }
     return pico_checksum_finalize(sum);
 }
 
@@ -13,7 +13,7 @@
 
 struct pico_proto_rr
 {
-    struct pico_tree *t;
+    struct pico_tree t;
     struct pico_tree_node *node_in, *node_out;
 };
 
@@ -30,25 +30,36 @@ static int pico_proto_cmp(void *ka, void *kb)
     return 0;
 }
 
-static PICO_TREE_DECLARE(Datalink_proto_tree, pico_proto_cmp);
-static PICO_TREE_DECLARE(Network_proto_tree, pico_proto_cmp);
-static PICO_TREE_DECLARE(Transport_proto_tree, pico_proto_cmp);
-static PICO_TREE_DECLARE(Socket_proto_tree, pico_proto_cmp);
-
-/* Static variables to keep track of the round robin loop */
-static struct pico_proto_rr proto_rr_datalink   = {
-    &Datalink_proto_tree,     NULL, NULL
+/* Static variables to keep track of the registered protocols and of the round robin loop */
+static PICO_TLS struct pico_proto_rr proto_rr_datalink   = {
+    { &LEAF, pico_proto_cmp }, NULL, NULL
 };
-static struct pico_proto_rr proto_rr_network    = {
-    &Network_proto_tree,      NULL, NULL
+static PICO_TLS struct pico_proto_rr proto_rr_network    = {
+    { &LEAF, pico_proto_cmp }, NULL, NULL
 };
-static struct pico_proto_rr proto_rr_transport  = {
-    &Transport_proto_tree,    NULL, NULL
+static PICO_TLS struct pico_proto_rr proto_rr_transport  = {
+    { &LEAF, pico_proto_cmp }, NULL, NULL
 };
-static struct pico_proto_rr proto_rr_socket     = {
-    &Socket_proto_tree,       NULL, NULL
+static PICO_TLS struct pico_proto_rr proto_rr_socket     = {
+    { &LEAF, pico_proto_cmp }, NULL, NULL
 };
 
+#ifdef PICO_SUPPORT_MULTI_INSTANCE
+/* Per-thread descriptors cannot point at their queues statically: bind them
+ * on first use instead. */
+static void proto_queues_bind(struct pico_protocol *p)
+{
+    if (!p->q_in)
+        p->q_in = &p->q_in_store;
+
+    if (!p->q_out)
+        p->q_out = &p->q_out_store;
+}
+#define PROTO_QUEUES_BIND(p) proto_queues_bind(p)
+#else
+#define PROTO_QUEUES_BIND(p) do {} while(0)
+#endif
+
 static int proto_loop_in(struct pico_protocol *proto, int loop_score)
 {
     struct pico_frame *f;
@@ -79,6 +90,50 @@ static int proto_loop_out(struct pico_protocol *proto, int loop_score)
     return loop_score;
 }
 
+#ifdef PICO_SUPPORT_RUN_TO_COMPLETION
+static PICO_TLS int proto_rtc_depth = 0;
+
+/* A frame may skip the queue only if nothing is waiting in it already (to
+ * keep ordering with frames deferred earlier) and the call chain is not
+ * already too deep. */
+static int proto_rtc_direct(struct pico_queue *q)
+{
+    return (q->frames == 0) && (proto_rtc_depth < PICO_RUN_TO_COMPLETION_DEPTH);
+}
+
+static int32_t proto_rtc_process(struct pico_protocol *proto, struct pico_frame *f,
+                                 int (*process)(struct pico_protocol *, struct pico_frame *))
+{
+    int32_t len = (int32_t)f->buffer_len;
+    proto_rtc_depth++;
+    (void)process(proto, f);
+    proto_rtc_depth--;
+    /* The frame is consumed either way: never report a failure that would
+     * make the caller discard it again. */
+    return (len > 0) ? len : 1;
+}
+#endif
+
+int32_t pico_protocol_deliver_in(struct pico_protocol *proto, struct pico_frame *f)
+{
+    PROTO_QUEUES_BIND(proto);
+#ifdef PICO_SUPPORT_RUN_TO_COMPLETION
+    if (proto_rtc_direct(proto->q_in))
+        return proto_rtc_process(proto, f, proto->process_in);
+#endif
+    return pico_enqueue(proto->q_in, f);
+}
+
+int32_t pico_protocol_deliver_out(struct pico_protocol *proto, struct pico_frame *f)
+{
+    PROTO_QUEUES_BIND(proto);
+#ifdef PICO_SUPPORT_RUN_TO_COMPLETION
+    if (proto_rtc_direct(proto->q_out))
+        return proto_rtc_process(proto, f, proto->process_out);
+#endif
+    return pico_enqueue(proto->q_out, f);
+}
+
 static int proto_loop(struct pico_protocol *proto, int loop_score, int direction)
 {
 
@@ -95,10 +150,10 @@ static struct pico_tree_node *roundrobin_init(struct pico_proto_rr *rr, int dire
     struct pico_tree_node *next_node = NULL;
     /* Initialization (takes place only once) */
     if (rr->node_in == NULL)
-        rr->node_in = pico_tree_firstNode(rr->t->root);
+        rr->node_in = pico_tree_firstNode(rr->t.root);
 
     if (rr->node_out == NULL)
-        rr->node_out = pico_tree_firstNode(rr->t->root);
+        rr->node_out = pico_tree_firstNode(rr->t.root);
 
     if (direction == PICO_LOOP_DIR_IN)
         next_node = rr->node_in;
@@ -136,7 +191,7 @@ static int pico_protocol_generic_loop(struct pico_proto_rr *rr, int loop_score,
         next = next_node->keyValue;
         if (next == NULL)
         {
-            next_node = pico_tree_firstNode(rr->t->root);
+            next_node = pico_tree_firstNode(rr->t.root);
             next = next_node->keyValue;
         }
 
@@ -178,6 +233,28 @@ int pico_protocols_loop(int loop_score)
     return loop_score;
 }
 
+static int proto_tree_pending(struct pico_tree *tree)
+{
+    struct pico_tree_node *index;
+    struct pico_protocol *proto;
+
+    pico_tree_foreach(index, tree) {
+        proto = index->keyValue;
+        if ((proto->q_in->frames > 0) || (proto->q_out->frames > 0))
+            return 1;
+    }
+    return 0;
+}
+
+/* Returns 1 if any protocol has frames queued for the next tick */
+int pico_protocols_pending(void)
+{
+    return proto_tree_pending(&proto_rr_datalink.t) ||
+           proto_tree_pending(&proto_rr_network.t) ||
+           proto_tree_pending(&proto_rr_transport.t) ||
+           proto_tree_pending(&proto_rr_socket.t);
+}
+
 static void proto_layer_rr_reset(struct pico_proto_rr *rr)
 {
     rr->node_in = NULL;
@@ -186,28 +263,24 @@ static void proto_layer_rr_reset(struct pico_proto_rr *rr)
 
 void pico_protocol_init(struct pico_protocol *p)
 {
-    struct pico_tree *tree = NULL;
     struct pico_proto_rr *proto = NULL;
 
     if (!p)
         return;
 
     p->hash = pico_hash(p->name, (uint32_t)strlen(p->name));
+    PROTO_QUEUES_BIND(p);
     switch (p->layer) {
         case PICO_LAYER_DATALINK:
-            tree = &Datalink_proto_tree;
             proto = &proto_rr_datalink;
             break;
         case PICO_LAYER_NETWORK:
-            tree = &Network_proto_tree;
             proto = &proto_rr_network;
             break;
         case PICO_LAYER_TRANSPORT:
-            tree = &Transport_proto_tree;
             proto = &proto_rr_transport;
             break;
         case PICO_LAYER_SOCKET:
-            tree = &Socket_proto_tree;
             proto = &proto_rr_socket;
             break;
         default:
@@ -215,7 +288,7 @@ void pico_protocol_init(struct pico_protocol *p)
             return;
     }
 
-    if (pico_tree_insert(tree, p)) {
+    if (pico_tree_insert(&proto->t, p)) {
         dbg("Failed to insert protocol %s\n", p->name);
         return;
     }
@@ -32,7 +32,7 @@
 #define TCP_STATE(s) (s->state & PICO_SOCKET_STATE_TCP)
 
 #ifdef PICO_SUPPORT_MUTEX
-static void *Mutex = NULL;
+static PICO_TLS void *Mutex = NULL;
 #endif
 
 /* Mockables */
@@ -56,7 +56,7 @@ static void *Mutex = NULL;
 
 #endif
 
-static struct pico_sockport *sp_udp = NULL, *sp_tcp = NULL;
+static PICO_TLS struct pico_sockport *sp_udp = NULL, *sp_tcp = NULL;
 
 struct pico_frame *pico_socket_frame_alloc(struct pico_socket *s, struct pico_device *dev, uint16_t len);
 
@@ -173,8 +173,8 @@ static int sockport_cmp(void *ka, void *kb)
     return 0;
 }
 
-static PICO_TREE_DECLARE(UDPTable, sockport_cmp);
-static PICO_TREE_DECLARE(TCPTable, sockport_cmp);
+static PICO_TLS PICO_TREE_DECLARE(UDPTable, sockport_cmp);
+static PICO_TLS PICO_TREE_DECLARE(TCPTable, sockport_cmp);
 
 struct pico_sockport *pico_get_sockport(uint16_t proto, uint16_t port)
 {
@@ -190,6 +190,175 @@ struct pico_sockport *pico_get_sockport(uint16_t proto, uint16_t port)
     else return NULL;
 }
 
+#ifdef PICO_SUPPORT_FLOW_TABLE
+/* Connected sockets, hashed on the exact (proto, local, remote) tuple so that
+ * demultiplexing does not depend on the number of sockets sharing a port.
+ * Listening and wildcard sockets are only found through the sockport trees. */
+#ifndef PICO_SOCKET_FLOW_MIN_BUCKETS
+#define PICO_SOCKET_FLOW_MIN_BUCKETS 64u
+#endif
+
+static PICO_TLS struct pico_socket **FlowTable = NULL;
+static PICO_TLS uint32_t flow_buckets = 0;
+static PICO_TLS uint32_t flow_count = 0;
+
+static uint32_t socket_flow_mix(uint32_t h, uint32_t k)
+{
+    k *= 0xcc9e2d51u;
+    k = (k << 15) | (k >> 17);
+    k *= 0x1b873593u;
+    h ^= k;
+    h = (h << 13) | (h >> 19);
+    return h * 5u + 0xe6546b64u;
+}
+
+/* murmur3-style: every bit of the tuple must reach the low bucket bits */
+static uint32_t socket_flow_hash(uint16_t proto, const union pico_address *local, const union pico_address *remote,
+                                 uint32_t addr_len, uint16_t lport, uint16_t rport)
+{
+    uint32_t h = proto;
+    uint32_t w, i;
+
+    for (i = 0; i < addr_len; i += 4) {
+        memcpy(&w, (const uint8_t *)local + i, 4);
+        h = socket_flow_mix(h, w);
+        memcpy(&w, (const uint8_t *)remote + i, 4);
+        h = socket_flow_mix(h, w);
+    }
+    h = socket_flow_mix(h, ((uint32_t)lport << 16) | rport);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t socket_flow_addr_len(struct pico_socket *s)
+{
+#ifdef PICO_SUPPORT_IPV6
+    return is_sock_ipv6(s) ? PICO_SIZE_IP6 : PICO_SIZE_IP4;
+#else
+    IGNORE_PARAMETER(s);
+    return PICO_SIZE_IP4;
+#endif
+}
+
+static void socket_flow_grow(void)
+{
+    uint32_t n = flow_buckets ? (flow_buckets << 1) : PICO_SOCKET_FLOW_MIN_BUCKETS;
+    struct pico_socket **table = PICO_ZALLOC(n * sizeof(struct pico_socket *));
+    struct pico_socket *s, *next;
+    uint32_t i;
+
+    if (!table)
+        return; /* Keep the current table, chains just get longer */
+
+    for (i = 0; i < flow_buckets; i++) {
+        for (s = FlowTable[i]; s; s = next) {
+            next = s->flow_next;
+            s->flow_next = table[s->flow_hash & (n - 1)];
+            table[s->flow_hash & (n - 1)] = s;
+        }
+    }
+    if (FlowTable)
+        PICO_FREE(FlowTable);
+
+    FlowTable = table;
+    flow_buckets = n;
+}
+
+static void socket_flow_link(struct pico_socket *s)
+{
+    uint32_t b;
+
+    if (s->remote_port == 0)
+        return;
+
+    if (flow_count >= flow_buckets)
+        socket_flow_grow();
+
+    if (!FlowTable)
+        return;
+
+    s->flow_hash = socket_flow_hash(PROTO(s), &s->local_addr, &s->remote_addr,
+                                    socket_flow_addr_len(s), s->local_port, s->remote_port);
+    b = s->flow_hash & (flow_buckets - 1);
+    s->flow_next = FlowTable[b];
+    FlowTable[b] = s;
+    s->flow_linked = 1;
+    flow_count++;
+}
+
+static void socket_flow_unlink(struct pico_socket *s)
+{
+    struct pico_socket **pp;
+
+    if (!s->flow_linked)
+        return;
+
+    for (pp = &FlowTable[s->flow_hash & (flow_buckets - 1)]; *pp; pp = &(*pp)->flow_next) {
+        if (*pp == s) {
+            *pp = s->flow_next;
+            break;
+        }
+    }
+    s->flow_next = NULL;
+    s->flow_linked = 0;
+    if (--flow_count == 0) {
+        PICO_FREE(FlowTable);
+        FlowTable = NULL;
+        flow_buckets = 0;
+    }
+}
+
+struct pico_socket *pico_socket_flow_find(uint16_t proto, struct pico_frame *f)
+{
+    struct pico_trans *tr = (struct pico_trans *) f->transport_hdr;
+    union pico_address local, remote;
+    struct pico_socket *s;
+    uint32_t h, len;
+    int ip6;
+
+    if (!FlowTable || !tr)
+        return NULL;
+
+    memset(&local, 0, sizeof(local));
+    memset(&remote, 0, sizeof(remote));
+
+    if (IS_IPV4(f)) {
+#ifdef PICO_SUPPORT_IPV4
+        struct pico_ipv4_hdr *hdr = (struct pico_ipv4_hdr *) f->net_hdr;
+        local.ip4.addr = hdr->dst.addr;
+        remote.ip4.addr = hdr->src.addr;
+#endif
+        len = PICO_SIZE_IP4;
+        ip6 = 0;
+    } else if (IS_IPV6(f)) {
+#ifdef PICO_SUPPORT_IPV6
+        struct pico_ipv6_hdr *hdr = (struct pico_ipv6_hdr *) f->net_hdr;
+        local.ip6 = hdr->dst;
+        remote.ip6 = hdr->src;
+#endif
+        len = PICO_SIZE_IP6;
+        ip6 = 1;
+    } else {
+        return NULL;
+    }
+
+    h = socket_flow_hash(proto, &local, &remote, len, tr->dport, tr->sport);
+    for (s = FlowTable[h & (flow_buckets - 1)]; s; s = s->flow_next) {
+        if ((s->flow_hash == h) && (PROTO(s) == proto) &&
+            (s->local_port == tr->dport) && (s->remote_port == tr->sport) &&
+            ((is_sock_ipv6(s) != 0) == ip6) &&
+            (memcmp(&s->local_addr, &local, len) == 0) &&
+            (memcmp(&s->remote_addr, &remote, len) == 0))
+            return s;
+    }
+    return NULL;
+}
+#endif
+
 #ifdef PICO_SUPPORT_IPV4
 
 static int pico_port_in_use_by_nat(uint16_t proto, uint16_t port)
@@ -429,6 +598,11 @@ int8_t pico_socket_add(struct pico_socket *s)
 		PICOTCP_MUTEX_UNLOCK(Mutex);
 		return -1;
 	}
+#ifdef PICO_SUPPORT_FLOW_TABLE
+    /* Re-added on connect(): the tuple may have changed since bind() */
+    socket_flow_unlink(s);
+    socket_flow_link(s);
+#endif
     s->state |= PICO_SOCKET_STATE_BOUND;
     PICOTCP_MUTEX_UNLOCK(Mutex);
 #ifdef DEBUG_SOCKET_TREE
@@ -503,6 +677,9 @@ static void pico_socket_check_empty_sockport(struct pico_socket *s, struct pico_
 int8_t pico_socket_del(struct pico_socket *s)
 {
     struct pico_sockport *sp = pico_get_sockport(PROTO(s), s->local_port);
+#ifdef PICO_SUPPORT_FLOW_TABLE
+    socket_flow_unlink(s);
+#endif
     if (!sp) {
         pico_err = PICO_ERR_ENXIO;
         return -1;
@@ -584,6 +761,11 @@ static int pico_socket_deliver(struct pico_protocol *p, struct pico_frame *f, ui
 
     sp = pico_get_sockport(p->proto_number, localport);
     if (!sp) {
+#ifdef PICO_SUPPORT_TCP_TIMEWAIT
+        if ((p->proto_number == PICO_PROTO_TCP) && (pico_tcp_timewait_input(f) == 0))
+            return 0;
+
+#endif
         dbg("No such port %d\n", short_be(localport));
         return -1;
     }
@@ -747,6 +929,44 @@ int pico_socket_read(struct pico_socket *s, void *buf, int len)
     return pico_socket_transport_read(s, buf, len);
 }
 
+int pico_socket_recv_zerocopy(struct pico_socket *s, struct pico_zerocopy_chunk *chunks, int max)
+{
+    if (!s || !chunks || (max <= 0)) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    if (pico_check_socket(s) != 0) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    if ((s->state & PICO_SOCKET_STATE_BOUND) == 0) {
+        pico_err = PICO_ERR_EIO;
+        return -1;
+    }
+
+    if (PROTO(s) != PICO_PROTO_TCP) {
+        pico_err = PICO_ERR_EPROTONOSUPPORT;
+        return -1;
+    }
+
+    return pico_socket_tcp_read_zerocopy(s, chunks, max);
+}
+
+void pico_socket_zerocopy_release(struct pico_zerocopy_chunk *chunk)
+{
+    if (!chunk || !chunk->handle)
+        return;
+
+#ifdef PICO_SUPPORT_TCP
+    pico_tcp_zerocopy_release(chunk->handle);
+#endif
+    chunk->handle = NULL;
+    chunk->data = NULL;
+    chunk->len = 0;
+}
+
 static int pico_socket_write_check_state(struct pico_socket *s)
 {
     if ((s->state & PICO_SOCKET_STATE_BOUND) == 0) {
@@ -1067,8 +1287,132 @@ static int pico_socket_final_xmit(struct pico_socket *s, struct pico_frame *f)
     }
 }
 
+/* Outstanding zero-copy sends, keyed by the application buffer alone.
+ * notify_free() hands back nothing but the buffer address, so two sends of
+ * the same buffer could not be told apart when their last frame is freed,
+ * whichever sockets they went out on: the second one gets PICO_ERR_EBUSY.
+ */
+struct pico_socket_zc {
+    const uint8_t *buf;
+    int len;
+    void (*done)(const void *buf, int len, void *arg);
+    void *arg;
+};
+
+static int pico_socket_zc_cmp(void *ka, void *kb)
+{
+    struct pico_socket_zc *a = ka, *b = kb;
+    if (a->buf < b->buf)
+        return -1;
+
+    if (a->buf > b->buf)
+        return 1;
+
+    return 0;
+}
+
+static PICO_TLS PICO_TREE_DECLARE(ZerocopyTable, pico_socket_zc_cmp);
+
+/* Last reference to the application buffer dropped */
+static void pico_socket_zc_notify(uint8_t *buf)
+{
+    struct pico_socket_zc test, *zc;
+
+    test.buf = buf;
+    zc = pico_tree_findKey(&ZerocopyTable, &test);
+    if (!zc)
+        return;
+
+    pico_tree_delete(&ZerocopyTable, zc);
+    if (zc->len > 0)
+        zc->done(zc->buf, zc->len, zc->arg);
+
+    PICO_FREE(zc);
+}
+
+/* Descriptor of the whole application buffer. Every frame sending a part
+ * of it chains a copy of this descriptor, so the usage counter tells when
+ * the stack is done with the memory.
+ */
+static struct pico_frame *pico_socket_zc_alloc(const void *buf, int len, void (*done)(const void *buf, int len, void *arg), void *arg)
+{
+    struct pico_socket_zc *zc;
+    struct pico_frame *f;
+    void *ret;
+
+    zc = PICO_ZALLOC(sizeof(struct pico_socket_zc));
+    if (!zc) {
+        pico_err = PICO_ERR_ENOMEM;
+        return NULL;
+    }
+
+    zc->buf = buf;
+    zc->done = done;
+    zc->arg = arg;
+    ret = pico_tree_insert(&ZerocopyTable, zc);
+    if (ret) {
+        /* Same buffer still in flight, or out of memory */
+        pico_err = (ret == &LEAF) ? PICO_ERR_ENOMEM : PICO_ERR_EBUSY;
+        PICO_FREE(zc);
+        return NULL;
+    }
+
+    f = pico_frame_alloc_skeleton((uint32_t)len, 1);
+    if (!f) {
+        pico_tree_delete(&ZerocopyTable, zc);
+        PICO_FREE(zc);
+        pico_err = PICO_ERR_ENOMEM;
+        return NULL;
+    }
+
+    pico_frame_skeleton_set_buffer(f, (void *)(uintptr_t)buf);
+    f->notify_free = pico_socket_zc_notify;
+    return f;
+}
+
+/* Drop the reference of the submitter. len is what was actually queued:
+ * the callback is not invoked for a send that queued nothing.
+ */
+static void pico_socket_zc_release(struct pico_frame *f, int len)
+{
+    struct pico_socket_zc test, *zc;
+
+    test.buf = f->buffer;
+    zc = pico_tree_findKey(&ZerocopyTable, &test);
+    if (zc)
+        zc->len = len;
+
+    pico_frame_discard(f);
+}
+
+/* Header-only frame, followed by a reference to len bytes of the
+ * application buffer described by zc.
+ */
+static struct pico_frame *pico_socket_zc_frame(struct pico_socket *s, struct pico_device *dev, uint16_t hdr_offset,
+                                               struct pico_frame *zc, const void *buf, const int len)
+{
+    struct pico_frame *f, *seg;
+
+    f = pico_socket_frame_alloc(s, dev, hdr_offset);
+    if (!f)
+        return NULL;
+
+    seg = pico_frame_copy(zc);
+    if (!seg) {
+        pico_frame_discard(f);
+        pico_err = PICO_ERR_ENOMEM;
+        return NULL;
+    }
+
+    seg->start = zc->buffer + ((const uint8_t *)buf - zc->buffer);
+    seg->len = (uint32_t)len;
+    f->chain = seg;
+    f->transport_len = (uint16_t)(f->transport_len + len);
+    return f;
+}
+
 static int pico_socket_xmit_one(struct pico_socket *s, const void *buf, const int len, void *src,
-                                struct pico_remote_endpoint *ep, struct pico_msginfo *msginfo)
+                                struct pico_remote_endpoint *ep, struct pico_msginfo *msginfo, struct pico_frame *zc)
 {
     struct pico_frame *f;
     struct pico_device *dev = NULL;
@@ -1096,7 +1440,11 @@ static int pico_socket_xmit_one(struct pico_socket *s, const void *buf, const in
         return -1;
     }
 
-    f = pico_socket_frame_alloc(s, dev, (uint16_t)(len + hdr_offset));
+    if (zc)
+        f = pico_socket_zc_frame(s, dev, hdr_offset, zc, buf, len);
+    else
+        f = pico_socket_frame_alloc(s, dev, (uint16_t)(len + hdr_offset));
+
     if (!f) {
         pico_err = PICO_ERR_ENOMEM;
         return -1;
@@ -1120,7 +1468,9 @@ static int pico_socket_xmit_one(struct pico_socket *s, const void *buf, const in
         f->send_tos = (uint8_t)msginfo->tos;
     }
 
-    memcpy(f->payload, (const uint8_t *)buf, f->payload_len);
+    if (!zc)
+        memcpy(f->payload, (const uint8_t *)buf, f->payload_len);
+
     /* dbg("Pushing segment, hdr len: %d, payload_len: %d\n", header_offset, f->payload_len); */
     ret = pico_socket_final_xmit(s, f);
     return ret;
@@ -1171,7 +1521,7 @@ static int pico_socket_xmit_fragments(struct pico_socket *s, const void *buf, co
     }
 
     if (space > len) {
-        retval = pico_socket_xmit_one(s, buf, len, src, ep, msginfo);
+        retval = pico_socket_xmit_one(s, buf, len, src, ep, msginfo, NULL);
         pico_endpoint_free(ep);
         return retval;
     }
@@ -1179,7 +1529,7 @@ static int pico_socket_xmit_fragments(struct pico_socket *s, const void *buf, co
 #ifdef PICO_SUPPORT_IPV6
     /* Can't fragment IPv6 */
     if (is_sock_ipv6(s)) {
-        retval =  pico_socket_xmit_one(s, buf, space, src, ep, msginfo);
+        retval =  pico_socket_xmit_one(s, buf, space, src, ep, msginfo, NULL);
         pico_endpoint_free(ep);
         return retval;
     }
@@ -1243,7 +1593,7 @@ static int pico_socket_xmit_fragments(struct pico_socket *s, const void *buf, co
     (void) f;
     (void) hdr_offset;
     (void) total_payload_written;
-    retval = pico_socket_xmit_one(s, buf, space, src, ep, msginfo);
+    retval = pico_socket_xmit_one(s, buf, space, src, ep, msginfo, NULL);
     pico_endpoint_free(ep);
     return retval;
 
@@ -1304,7 +1654,11 @@ static int pico_socket_xmit_avail_space(struct pico_socket *s)
 
 #ifdef PICO_SUPPORT_TCP
     if (PROTO(s) == PICO_PROTO_TCP) {
+#ifdef PICO_SUPPORT_TCP_GSO
+        transport_len = (uint16_t)pico_tcp_get_socket_gso(s);
+#else
         transport_len = (uint16_t)pico_tcp_get_socket_mss(s);
+#endif
     } else
 #endif
     transport_len = (uint16_t)pico_socket_get_mss(s);
@@ -1320,7 +1674,7 @@ static int pico_socket_xmit_avail_space(struct pico_socket *s)
 
 
 static int pico_socket_xmit(struct pico_socket *s, const void *buf, const int len, void *src,
-                            struct pico_remote_endpoint *ep, struct pico_msginfo *msginfo)
+                            struct pico_remote_endpoint *ep, struct pico_msginfo *msginfo, struct pico_frame *zc)
 {
     int space = pico_socket_xmit_avail_space(s);
     int total_payload_written = 0;
@@ -1331,6 +1685,13 @@ static int pico_socket_xmit(struct pico_socket *s, const void *buf, const int le
         return -1;
     }
 
+    if ((PROTO(s) == PICO_PROTO_UDP) && (len > space) && zc) {
+        /* Zero-copy datagrams are never fragmented */
+        pico_err = PICO_ERR_EINVAL;
+        pico_endpoint_free(ep);
+        return -1;
+    }
+
     if ((PROTO(s) == PICO_PROTO_UDP) && (len > space)) {
         total_payload_written = pico_socket_xmit_fragments(s, buf, len, src, ep, msginfo);
         /* Implies ep discarding */
@@ -1342,7 +1703,7 @@ static int pico_socket_xmit(struct pico_socket *s, const void *buf, const int le
         if (chunk_len > space)
             chunk_len = space;
 
-        w = pico_socket_xmit_one(s, (const void *)((const uint8_t *)buf + total_payload_written), chunk_len, src, ep, msginfo);
+        w = pico_socket_xmit_one(s, (const void *)((const uint8_t *)buf + total_payload_written), chunk_len, src, ep, msginfo, zc);
         if (w <= 0) {
             break;
         }
@@ -1365,8 +1726,31 @@ static void pico_socket_sendto_set_dport(struct pico_socket *s, uint16_t port)
 }
 
 
-int MOCKABLE pico_socket_sendto_extended(struct pico_socket *s, const void *buf, const int len,
-                                         void *dst, uint16_t remote_port, struct pico_msginfo *msginfo)
+/* sendto() opens a TCP connection with PICO_TCP_FASTOPEN set: the data
+ * written goes out on the SYN if the server gave us a cookie before. */
+static int pico_socket_sendto_connect(struct pico_socket *s, void *dst, uint16_t remote_port)
+{
+#ifdef PICO_SUPPORT_TCP
+    int fastopen = 0;
+
+    if ((PROTO(s) != PICO_PROTO_TCP) || (s->state & PICO_SOCKET_STATE_CONNECTED) ||
+        (TCPSTATE(s) == PICO_SOCKET_STATE_TCP_LISTEN))
+        return 0;
+
+    pico_tcp_get_fastopen(s, &fastopen);
+    if (fastopen)
+        return pico_socket_connect(s, dst, remote_port);
+
+#else
+    IGNORE_PARAMETER(s);
+    IGNORE_PARAMETER(dst);
+    IGNORE_PARAMETER(remote_port);
+#endif
+    return 0;
+}
+
+static int pico_socket_sendto_common(struct pico_socket *s, const void *buf, const int len,
+                                     void *dst, uint16_t remote_port, struct pico_msginfo *msginfo, struct pico_frame *zc)
 {
     struct pico_remote_endpoint *remote_endpoint = NULL;
     void *src = NULL;
@@ -1377,6 +1761,8 @@ int MOCKABLE pico_socket_sendto_extended(struct pico_socket *s, const void *buf,
     if (pico_socket_sendto_initial_checks(s, buf, len, dst, remote_port) < 0)
         return -1;
 
+    if (pico_socket_sendto_connect(s, dst, remote_port) < 0)
+        return -1;
 
     src = pico_socket_sendto_get_src(s, dst);
     if (!src) {
@@ -1399,7 +1785,13 @@ int MOCKABLE pico_socket_sendto_extended(struct pico_socket *s, const void *buf,
     }
 
     pico_socket_sendto_set_dport(s, remote_port);
-    return pico_socket_xmit(s, buf, len, src, remote_endpoint, msginfo); /* Implies discarding the endpoint */
+    return pico_socket_xmit(s, buf, len, src, remote_endpoint, msginfo, zc); /* Implies discarding the endpoint */
+}
+
+int MOCKABLE pico_socket_sendto_extended(struct pico_socket *s, const void *buf, const int len,
+                                         void *dst, uint16_t remote_port, struct pico_msginfo *msginfo)
+{
+    return pico_socket_sendto_common(s, buf, len, dst, remote_port, msginfo, NULL);
 }
 
 int MOCKABLE pico_socket_sendto(struct pico_socket *s, const void *buf, const int len, void *dst, uint16_t remote_port)
@@ -1429,6 +1821,50 @@ int pico_socket_send(struct pico_socket *s, const void *buf, int len)
     return pico_socket_sendto(s, buf, len, &s->remote_addr, s->remote_port);
 }
 
+int pico_socket_sendto_zerocopy(struct pico_socket *s, const void *buf, int len, void *dst, uint16_t remote_port,
+                                void (*done)(const void *buf, int len, void *arg), void *arg)
+{
+    struct pico_frame *zc;
+    int ret;
+
+    if (!s || !buf || !done || (len <= 0)) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    if (pico_check_socket(s) != 0) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    if ((PROTO(s) == PICO_PROTO_TCP) && (pico_socket_write_check_state(s) < 0))
+        return -1;
+
+    zc = pico_socket_zc_alloc(buf, len, done, arg);
+    if (!zc)
+        return -1;
+
+    ret = pico_socket_sendto_common(s, buf, len, dst, remote_port, NULL, zc);
+    pico_socket_zc_release(zc, (ret > 0) ? ret : 0);
+    return ret;
+}
+
+int pico_socket_send_zerocopy(struct pico_socket *s, const void *buf, int len,
+                              void (*done)(const void *buf, int len, void *arg), void *arg)
+{
+    if (!s) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    if ((s->state & PICO_SOCKET_STATE_CONNECTED) == 0) {
+        pico_err = PICO_ERR_ENOTCONN;
+        return -1;
+    }
+
+    return pico_socket_sendto_zerocopy(s, buf, len, &s->remote_addr, s->remote_port, done, arg);
+}
+
 int pico_socket_recvfrom_extended(struct pico_socket *s, void *buf, int len, void *orig,
                                   uint16_t *remote_port, struct pico_msginfo *msginfo)
 {
@@ -1769,7 +2205,8 @@ struct pico_socket *pico_socket_accept(struct pico_socket *s, void *orig, uint16
             /* RB_FOREACH(found, socket_tree, &sp->socks) { */
             pico_tree_foreach(index, &sp->socks){
                 found = index->keyValue;
-                if ((s == found->parent) && ((found->state & PICO_SOCKET_STATE_TCP) == PICO_SOCKET_STATE_TCP_ESTABLISHED)) {
+                if ((s == found->parent) && (((found->state & PICO_SOCKET_STATE_TCP) == PICO_SOCKET_STATE_TCP_ESTABLISHED) ||
+                                             pico_tcp_fastopen_child(found))) {
                     found->parent = NULL;
                     pico_err = PICO_ERR_NOERR;
                     #ifdef PICO_SUPPORT_IPV6
@@ -2025,7 +2462,7 @@ static int pico_sockets_loop_udp(int loop_score)
 {
 
 #ifdef PICO_SUPPORT_UDP
-    static struct pico_tree_node *index_udp;
+    static PICO_TLS struct pico_tree_node *index_udp;
     struct pico_sockport *start;
     struct pico_socket *s;
     struct pico_frame *f;
@@ -2075,7 +2512,7 @@ static int pico_sockets_loop_tcp(int loop_score)
 #ifdef PICO_SUPPORT_TCP
     struct pico_sockport *start;
     struct pico_socket *s;
-    static struct pico_tree_node *index_tcp;
+    static PICO_TLS struct pico_tree_node *index_tcp;
     if (sp_tcp == NULL)
     {
         index_tcp = pico_tree_firstNode(TCPTable.root);
@@ -2139,6 +2576,75 @@ int pico_sockets_loop(int loop_score)
     return loop_score;
 }
 
+static pico_time pico_sockets_next_deadline_udp(pico_time now)
+{
+#ifdef PICO_SUPPORT_UDP
+    struct pico_tree_node *index_sp, *index;
+    struct pico_sockport *sp;
+    struct pico_socket *s;
+
+    pico_tree_foreach(index_sp, &UDPTable) {
+        sp = index_sp->keyValue;
+        pico_tree_foreach(index, &sp->socks) {
+            s = index->keyValue;
+            if (s->q_out.frames > 0)
+                return now;
+        }
+    }
+#endif
+    (void)now;
+    return PICO_TIME_NEVER;
+}
+
+static pico_time pico_sockets_next_deadline_tcp(pico_time now)
+{
+    pico_time deadline = PICO_TIME_NEVER;
+#ifdef PICO_SUPPORT_TCP
+    struct pico_tree_node *index_sp, *index;
+    struct pico_sockport *sp;
+    struct pico_socket *s;
+    pico_time expire;
+
+    pico_tree_foreach(index_sp, &TCPTable) {
+        sp = index_sp->keyValue;
+        pico_tree_foreach(index, &sp->socks) {
+            s = index->keyValue;
+            if (pico_tcp_output_pending(s))
+                return now;
+
+            /* Pending children are woken up on every tick until accepted */
+            if ((s->ev_pending) && (s->wakeup) && (!s->parent))
+                return now;
+
+            /* Stale half-open connections are reaped by check_socket_sanity() */
+            if (TCP_STATE(s) == PICO_SOCKET_STATE_TCP_SYN_RECV) {
+                expire = s->timestamp + PICO_SOCKET_BOUND_TIMEOUT;
+                if (expire < deadline)
+                    deadline = expire;
+            }
+        }
+    }
+#endif
+    (void)now;
+    return deadline;
+}
+
+/* Earliest time at which pico_sockets_loop() has work to do */
+pico_time pico_sockets_next_deadline(pico_time now)
+{
+    pico_time deadline = pico_sockets_next_deadline_udp(now);
+    pico_time tcp_deadline;
+
+    if (deadline <= now)
+        return now;
+
+    tcp_deadline = pico_sockets_next_deadline_tcp(now);
+    if (tcp_deadline < deadline)
+        deadline = tcp_deadline;
+
+    return (deadline < now) ? now : deadline;
+}
+
 int pico_count_sockets(uint8_t proto)
 {
     struct pico_sockport *sp;
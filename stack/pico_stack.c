@@ -41,10 +41,10 @@
 #endif
 
 
-volatile pico_time pico_tick;
-volatile pico_err_t pico_err;
+PICO_TLS volatile pico_time pico_tick;
+PICO_TLS volatile pico_err_t pico_err;
 
-static uint32_t _rand_seed;
+static PICO_TLS uint32_t _rand_seed;
 
 void WEAK pico_rand_feed(uint32_t feed)
 {
@@ -193,32 +193,32 @@ MOCKABLE int32_t pico_transport_receive(struct pico_frame *f, uint8_t proto)
 
 #ifdef PICO_SUPPORT_ICMP4
     case PICO_PROTO_ICMP4:
-        ret = pico_enqueue(pico_proto_icmp4.q_in, f);
+        ret = pico_protocol_deliver_in(&pico_proto_icmp4, f);
         break;
 #endif
 
 #ifdef PICO_SUPPORT_ICMP6
     case PICO_PROTO_ICMP6:
-        ret = pico_enqueue(pico_proto_icmp6.q_in, f);
+        ret = pico_protocol_deliver_in(&pico_proto_icmp6, f);
         break;
 #endif
 
 
 #if defined(PICO_SUPPORT_IGMP) && defined(PICO_SUPPORT_MCAST)
     case PICO_PROTO_IGMP:
-        ret = pico_enqueue(pico_proto_igmp.q_in, f);
+        ret = pico_protocol_deliver_in(&pico_proto_igmp, f);
         break;
 #endif
 
 #ifdef PICO_SUPPORT_UDP
     case PICO_PROTO_UDP:
-        ret = pico_enqueue(pico_proto_udp.q_in, f);
+        ret = pico_protocol_deliver_in(&pico_proto_udp, f);
         break;
 #endif
 
 #ifdef PICO_SUPPORT_TCP
     case PICO_PROTO_TCP:
-        ret = pico_enqueue(pico_proto_tcp.q_in, f);
+        ret = pico_protocol_deliver_in(&pico_proto_tcp, f);
         break;
 #endif
 
@@ -238,16 +238,17 @@ MOCKABLE int32_t pico_transport_receive(struct pico_frame *f, uint8_t proto)
 
 MOCKABLE int32_t pico_network_receive(struct pico_frame *f)
 {
+    int32_t len = (int32_t)f->buffer_len;
     if (0) {}
 
 #ifdef PICO_SUPPORT_IPV4
     else if (IS_IPV4(f)) {
-        pico_enqueue(pico_proto_ipv4.q_in, f);
+        pico_protocol_deliver_in(&pico_proto_ipv4, f);
     }
 #endif
 #ifdef PICO_SUPPORT_IPV6
     else if (IS_IPV6(f)) {
-        pico_enqueue(pico_proto_ipv6.q_in, f);
+        pico_protocol_deliver_in(&pico_proto_ipv6, f);
     }
 #endif
     else {
@@ -255,7 +256,7 @@ MOCKABLE int32_t pico_network_receive(struct pico_frame *f)
         pico_frame_discard(f);
         return -1;
     }
-    return (int32_t)f->buffer_len;
+    return len;
 }
 
 /// Interface towards socket for frame sending
@@ -388,7 +389,7 @@ int pico_datalink_receive(struct pico_frame *f)
             default:
                 #ifdef PICO_SUPPORT_ETH
                 f->datalink_hdr = f->buffer;
-                return pico_enqueue(pico_proto_ethernet.q_in,f);
+                return pico_protocol_deliver_in(&pico_proto_ethernet, f);
                 #else
                 return -1;
                 #endif
@@ -412,7 +413,7 @@ MOCKABLE int pico_datalink_send(struct pico_frame *f)
             #endif
             default:
                 #ifdef PICO_SUPPORT_ETH
-                return pico_enqueue(pico_proto_ethernet.q_out, f);
+                return pico_protocol_deliver_out(&pico_proto_ethernet, f);
                 #else
                 return -1;
                 #endif
@@ -476,6 +477,34 @@ int32_t pico_stack_recv(struct pico_device *dev, uint8_t *buffer, uint32_t len)
     return ret;
 }
 
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+/* The packet is copied into one of the empty frames the stack keeps ready
+ * in dev->q_rx_free, so the driver neither allocates nor frees. A frame that
+ * q_in has no room for is kept for the next packet, this one is dropped. */
+int32_t pico_stack_recv_ring(struct pico_device *dev, uint8_t *buffer, uint32_t len)
+{
+    struct pico_frame *f;
+    int32_t ret;
+
+    if (!dev->q_rx_free || (len == 0) || (len > dev->rx_frame_len))
+        return -1;
+
+    f = dev->rx_spare ? dev->rx_spare : pico_queue_ring_pop(dev->q_rx_free);
+    if (!f)
+        return -1;
+
+    dev->rx_spare = NULL;
+    memcpy(f->buffer, buffer, len);
+    f->start = f->buffer;
+    f->len = len;
+    ret = pico_enqueue(dev->q_in, f);
+    if (ret <= 0)
+        dev->rx_spare = f;
+
+    return ret;
+}
+#endif
+
 static int32_t _pico_stack_recv_zerocopy(struct pico_device *dev, uint8_t *buffer, uint32_t len, int ext_buffer, void (*notify_free)(uint8_t *))
 {
     struct pico_frame *f;
@@ -483,21 +512,21 @@ static int32_t _pico_stack_recv_zerocopy(struct pico_device *dev, uint8_t *buffe
     if (len == 0)
         return -1;
 
-    f = pico_frame_alloc_skeleton(len, ext_buffer);
-    if (!f)
+    if (!buffer)
     {
-        dbg("Cannot alloc incoming frame!\n");
+        dbg("Invalid zero-copy buffer!\n");
         return -1;
     }
 
-    if (pico_frame_skeleton_set_buffer(f, buffer) < 0)
+    f = pico_frame_alloc_skeleton(len, ext_buffer);
+    if (!f)
     {
-        dbg("Invalid zero-copy buffer!\n");
-        PICO_FREE(f->usage_count);
-        PICO_FREE(f);
+        dbg("Cannot alloc incoming frame!\n");
         return -1;
     }
 
+    pico_frame_skeleton_set_buffer(f, buffer);
+
     if (notify_free) {
         f->notify_free = notify_free;
     }
@@ -526,6 +555,40 @@ int32_t pico_stack_recv_zerocopy_ext_buffer_notify(struct pico_device *dev, uint
     return _pico_stack_recv_zerocopy(dev, buffer, len, 1, notify_free);
 }
 
+#ifdef PICO_SUPPORT_TCP_GSO
+/* Cut a TCP super-segment in MTU-sized packets on its way to a device that
+ * cannot do it itself. The packets reference the payload of f, so f is
+ * released once they are all queued.
+ */
+static int32_t pico_sendto_dev_gso(struct pico_frame *f)
+{
+    struct pico_queue *q = f->dev->q_out;
+    struct pico_frame *pkt, *next;
+    uint32_t count = ((uint32_t)f->payload_len + f->gso_size - 1u) / f->gso_size;
+    int full = 0, queued = 0;
+
+    if (q->max_frames && (q->frames + count > q->max_frames))
+        return -1;
+
+    for (pkt = pico_tcp_gso_segment(f); pkt; pkt = next) {
+        next = pkt->next;
+        if (!full && (pico_enqueue(q, pkt) > 0)) {
+            queued++;
+        } else {
+            /* Out of room: the rest is lost, as if dropped on the wire */
+            full = 1;
+            pico_frame_discard(pkt);
+        }
+    }
+
+    if (!queued)
+        return -1; /* f stays with the caller */
+
+    pico_frame_discard(f);
+    return (int32_t)q->size;
+}
+#endif
+
 int32_t pico_sendto_dev(struct pico_frame *f)
 {
     if (!f->dev) {
@@ -539,6 +602,11 @@ int32_t pico_sendto_dev(struct pico_frame *f)
             pico_rand_feed(rand);
         }
 
+#ifdef PICO_SUPPORT_TCP_GSO
+        if (f->gso_size && !f->dev->send_tso && (f->payload_len > f->gso_size))
+            return pico_sendto_dev_gso(f);
+
+#endif
         return pico_enqueue(f->dev->q_out, f);
     }
 }
@@ -547,10 +615,51 @@ struct pico_timer
 {
     void *arg;
     void (*timer)(pico_time timestamp, void *arg);
+#ifdef PICO_SUPPORT_TIMER_WHEEL
+    pico_time expire;
+    uint32_t id;
+    uint32_t hash;
+    uint16_t slot;
+    uint8_t level;
+    struct pico_timer *next;
+    struct pico_timer *prev;
+    struct pico_timer *id_next;
+#endif
 };
 
 
-static uint32_t tmr_id = 0u;
+static PICO_TLS uint32_t tmr_id = 0u;
+#ifdef PICO_SUPPORT_TIMER_WHEEL
+/* Hierarchical timing wheel: level 0 has one slot per millisecond, every
+ * further level covers the whole span of the level below in each slot.
+ * Timers are cascaded one level down when their slot comes due.
+ */
+#define TIMER_WHEEL_L0_BITS   8u
+#define TIMER_WHEEL_LN_BITS   6u
+#define TIMER_WHEEL_LEVELS    4u
+#define TIMER_WHEEL_L0_SIZE   (1u << TIMER_WHEEL_L0_BITS)
+#define TIMER_WHEEL_LN_SIZE   (1u << TIMER_WHEEL_LN_BITS)
+#define TIMER_WHEEL_L0_MASK   (TIMER_WHEEL_L0_SIZE - 1u)
+#define TIMER_WHEEL_LN_MASK   (TIMER_WHEEL_LN_SIZE - 1u)
+#define TIMER_WHEEL_SLOTS     (TIMER_WHEEL_L0_SIZE + ((TIMER_WHEEL_LEVELS - 1u) * TIMER_WHEEL_LN_SIZE))
+#define TIMER_WHEEL_SHIFT(l)  (TIMER_WHEEL_L0_BITS + (TIMER_WHEEL_LN_BITS * ((l) - 1u)))
+#define TIMER_WHEEL_SPAN(l)   ((pico_time)1u << (TIMER_WHEEL_L0_BITS + (TIMER_WHEEL_LN_BITS * (l))))
+#define TIMER_WHEEL_IDS_MIN   64u
+
+struct pico_timer_wheel
+{
+    pico_time now;                  /* Next millisecond to be processed */
+    uint32_t n;                     /* Number of armed timers */
+    uint32_t ids_size;              /* Buckets in the id table, power of two */
+    uint32_t level_n[TIMER_WHEEL_LEVELS];
+    uint32_t pool_n;
+    struct pico_timer *pool;        /* Recycled timers, linked via 'next' */
+    struct pico_timer **ids;        /* Id lookup for O(1) cancel */
+    struct pico_timer *slot[TIMER_WHEEL_SLOTS];
+};
+
+static PICO_TLS struct pico_timer_wheel *Timers;
+#else
 struct pico_timer_ref
 {
     pico_time expire;
@@ -563,7 +672,8 @@ typedef struct pico_timer_ref pico_timer_ref;
 
 DECLARE_HEAP(pico_timer_ref, expire);
 
-static heap_pico_timer_ref *Timers;
+static PICO_TLS heap_pico_timer_ref *Timers;
+#endif
 
 int32_t pico_seq_compare(uint32_t a, uint32_t b)
 {
@@ -590,6 +700,329 @@ int32_t pico_seq_compare(uint32_t a, uint32_t b)
     return 0;
 }
 
+#ifdef PICO_SUPPORT_TIMER_WHEEL
+static inline uint32_t timer_wheel_bucket(uint32_t id)
+{
+    return id & (Timers->ids_size - 1u);
+}
+
+static void timer_wheel_link(struct pico_timer *t)
+{
+    pico_time delta;
+    pico_time when = t->expire;
+    uint32_t level = 0;
+    uint32_t idx;
+
+    if (when < Timers->now)
+        when = Timers->now;
+
+    delta = when - Timers->now;
+    if (delta >= TIMER_WHEEL_SPAN(TIMER_WHEEL_LEVELS - 1u)) {
+        /* Beyond the horizon: park in the last level, re-cascaded until due */
+        when = Timers->now + TIMER_WHEEL_SPAN(TIMER_WHEEL_LEVELS - 1u) - 1u;
+        delta = when - Timers->now;
+    }
+
+    while ((level < (TIMER_WHEEL_LEVELS - 1u)) && (delta >= TIMER_WHEEL_SPAN(level)))
+        level++;
+
+    if (level == 0)
+        idx = (uint32_t)(when & TIMER_WHEEL_L0_MASK);
+    else
+        idx = TIMER_WHEEL_L0_SIZE + ((level - 1u) * TIMER_WHEEL_LN_SIZE) +
+              (uint32_t)((when >> TIMER_WHEEL_SHIFT(level)) & TIMER_WHEEL_LN_MASK);
+
+    t->slot = (uint16_t)idx;
+    t->level = (uint8_t)level;
+    t->prev = NULL;
+    t->next = Timers->slot[idx];
+    if (t->next)
+        t->next->prev = t;
+
+    Timers->slot[idx] = t;
+    Timers->level_n[level]++;
+}
+
+static void timer_wheel_unlink(struct pico_timer *t)
+{
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        Timers->slot[t->slot] = t->next;
+
+    if (t->next)
+        t->next->prev = t->prev;
+
+    t->next = NULL;
+    t->prev = NULL;
+    Timers->level_n[t->level]--;
+}
+
+static int timer_wheel_ids_resize(uint32_t size)
+{
+    struct pico_timer **ids = PICO_ZALLOC(size * sizeof(struct pico_timer *));
+    struct pico_timer **old = Timers->ids;
+    uint32_t old_size = Timers->ids_size;
+    struct pico_timer *t;
+    uint32_t i;
+
+    if (!ids)
+        return -1;
+
+    Timers->ids = ids;
+    Timers->ids_size = size;
+    for (i = 0; i < old_size; i++) {
+        while ((t = old[i])) {
+            old[i] = t->id_next;
+            t->id_next = ids[timer_wheel_bucket(t->id)];
+            ids[timer_wheel_bucket(t->id)] = t;
+        }
+    }
+    if (old)
+        PICO_FREE(old);
+
+    return 0;
+}
+
+/* Detach a timer from the id table, returns the timer or NULL if not found */
+static struct pico_timer *timer_wheel_id_remove(uint32_t id)
+{
+    struct pico_timer **pp;
+    struct pico_timer *t;
+
+    if (!Timers->ids)
+        return NULL;
+
+    pp = &Timers->ids[timer_wheel_bucket(id)];
+    while ((t = *pp)) {
+        if (t->id == id) {
+            *pp = t->id_next;
+            t->id_next = NULL;
+            Timers->n--;
+            return t;
+        }
+
+        pp = &t->id_next;
+    }
+    return NULL;
+}
+
+static void timer_wheel_release(struct pico_timer *t)
+{
+    if (Timers->pool_n < PICO_TIMER_WHEEL_POOL) {
+        t->next = Timers->pool;
+        Timers->pool = t;
+        Timers->pool_n++;
+    } else {
+        PICO_FREE(t);
+    }
+}
+
+static void timer_wheel_cascade(uint32_t level)
+{
+    uint32_t idx = TIMER_WHEEL_L0_SIZE + ((level - 1u) * TIMER_WHEEL_LN_SIZE) +
+                   (uint32_t)((Timers->now >> TIMER_WHEEL_SHIFT(level)) & TIMER_WHEEL_LN_MASK);
+    struct pico_timer *t = Timers->slot[idx];
+
+    Timers->slot[idx] = NULL;
+    while (t) {
+        struct pico_timer *next = t->next;
+        Timers->level_n[level]--;
+        timer_wheel_link(t);
+        t = next;
+    }
+}
+
+/* Advance the wheel, firing every timer that expires before 'until' */
+static void pico_timer_wheel_run(pico_time until)
+{
+    struct pico_timer *t;
+    uint32_t idx, level;
+    pico_time next;
+
+    while (Timers->now < until) {
+        if (Timers->n == 0) {
+            Timers->now = until;
+            break;
+        }
+
+        idx = (uint32_t)(Timers->now & TIMER_WHEEL_L0_MASK);
+        for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if (Timers->now & (TIMER_WHEEL_SPAN(level - 1u) - 1u))
+                break;
+
+            timer_wheel_cascade(level);
+        }
+        while ((t = Timers->slot[idx])) {
+            timer_wheel_unlink(t);
+            timer_wheel_id_remove(t->id);
+            if (t->timer)
+                t->timer(pico_tick, t->arg);
+
+            timer_wheel_release(t);
+        }
+        Timers->now++;
+
+        /* Skip straight to the next cascade point over empty levels */
+        for (level = 0; (level < (TIMER_WHEEL_LEVELS - 1u)) && (Timers->level_n[level] == 0); level++)
+            ;
+        if (level > 0) {
+            next = (Timers->now + (TIMER_WHEEL_SPAN(level - 1u) - 1u)) & ~(TIMER_WHEEL_SPAN(level - 1u) - 1u);
+            Timers->now = (next < until) ? next : until;
+        }
+    }
+}
+
+static void pico_check_timers(void)
+{
+    pico_tick = PICO_TIME_MS();
+    pico_timer_wheel_run(pico_tick);
+}
+
+/* Earliest expiry in the wheel. Level 0 is scanned from the current slot,
+ * higher levels from the bucket after the current one, as the current
+ * bucket only holds timers that wrapped around the level.
+ */
+static pico_time pico_timer_next_expire(void)
+{
+    struct pico_timer *t;
+    pico_time next = PICO_TIME_NEVER;
+    uint32_t level, i, base, size, cur, idx;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (Timers->level_n[level] == 0)
+            continue;
+
+        if (level == 0) {
+            base = 0;
+            size = TIMER_WHEEL_L0_SIZE;
+            cur = (uint32_t)(Timers->now & TIMER_WHEEL_L0_MASK);
+        } else {
+            base = TIMER_WHEEL_L0_SIZE + ((level - 1u) * TIMER_WHEEL_LN_SIZE);
+            size = TIMER_WHEEL_LN_SIZE;
+            cur = (uint32_t)((Timers->now >> TIMER_WHEEL_SHIFT(level)) + 1u);
+        }
+
+        for (i = 0; i < size; i++) {
+            idx = base + ((cur + i) & (size - 1u));
+            if (!Timers->slot[idx])
+                continue;
+
+            for (t = Timers->slot[idx]; t; t = t->next) {
+                if (t->expire < next)
+                    next = t->expire;
+            }
+            break;
+        }
+    }
+    return next;
+}
+
+void MOCKABLE pico_timer_cancel(uint32_t id)
+{
+    struct pico_timer *t;
+    if (id == 0u)
+        return;
+
+    t = timer_wheel_id_remove(id);
+    if (t) {
+        timer_wheel_unlink(t);
+        timer_wheel_release(t);
+    }
+}
+
+/* Hashed timers are only cancelled in bulk at module teardown, so a walk
+ * over the id table is good enough here.
+ */
+void pico_timer_cancel_hashed(uint32_t hash)
+{
+    struct pico_timer **pp;
+    struct pico_timer *t;
+    uint32_t i;
+    if (hash == 0u)
+        return;
+
+    for (i = 0; i < Timers->ids_size; i++) {
+        pp = &Timers->ids[i];
+        while ((t = *pp)) {
+            if (t->hash == hash) {
+                *pp = t->id_next;
+                Timers->n--;
+                timer_wheel_unlink(t);
+                timer_wheel_release(t);
+            } else {
+                pp = &t->id_next;
+            }
+        }
+    }
+}
+
+static uint32_t
+pico_timer_ref_add(pico_time expire, struct pico_timer *t, uint32_t id, uint32_t hash)
+{
+    uint32_t b;
+
+    if (!Timers->ids || ((Timers->n >> 1) >= Timers->ids_size)) {
+        uint32_t size = Timers->ids_size ? (Timers->ids_size << 1) : TIMER_WHEEL_IDS_MIN;
+        /* A failed resize only costs longer chains, unless there is no table yet */
+        if ((timer_wheel_ids_resize(size) < 0) && !Timers->ids) {
+            dbg("Error: failed to insert timer(ID %u) into wheel\n", id);
+            timer_wheel_release(t);
+            pico_err = PICO_ERR_ENOMEM;
+            return 0;
+        }
+    }
+
+    t->expire = PICO_TIME_MS() + expire;
+    t->id = id;
+    t->hash = hash;
+
+    b = timer_wheel_bucket(id);
+    t->id_next = Timers->ids[b];
+    Timers->ids[b] = t;
+    Timers->n++;
+    timer_wheel_link(t);
+
+    if (Timers->n > PICO_MAX_TIMERS) {
+        dbg("Warning: I have %d timers\n", (int)Timers->n);
+    }
+
+    return id;
+}
+
+static struct pico_timer *
+pico_timer_create(void (*timer)(pico_time, void *), void *arg)
+{
+    struct pico_timer *t = Timers->pool;
+
+    if (t) {
+        Timers->pool = t->next;
+        Timers->pool_n--;
+        memset(t, 0, sizeof(struct pico_timer));
+    } else {
+        t = PICO_ZALLOC(sizeof(struct pico_timer));
+    }
+
+    if (!t) {
+        pico_err = PICO_ERR_ENOMEM;
+        return NULL;
+    }
+
+    t->arg = arg;
+    t->timer = timer;
+
+    return t;
+}
+
+static struct pico_timer_wheel *pico_timer_wheel_init(void)
+{
+    struct pico_timer_wheel *w = PICO_ZALLOC(sizeof(struct pico_timer_wheel));
+    if (w)
+        w->now = PICO_TIME_MS();
+
+    return w;
+}
+#else
 static void pico_check_timers(void)
 {
     struct pico_timer *t;
@@ -610,6 +1043,16 @@ static void pico_check_timers(void)
     }
 }
 
+/* Earliest expiry in the heap, cancelled timers may make this early */
+static pico_time pico_timer_next_expire(void)
+{
+    struct pico_timer_ref *tref = heap_first(Timers);
+    if (!tref)
+        return PICO_TIME_NEVER;
+
+    return tref->expire;
+}
+
 void MOCKABLE pico_timer_cancel(uint32_t id)
 {
     uint32_t i;
@@ -650,6 +1093,7 @@ void pico_timer_cancel_hashed(uint32_t hash)
         }
     }
 }
+#endif
 
 #define PROTO_DEF_NR      11
 #define PROTO_DEF_AVG_NR  4
@@ -746,14 +1190,14 @@ static int calc_score(int *score, int *index, int avg[][PROTO_DEF_AVG_NR], int *
 
 void pico_stack_tick(void)
 {
-    static int score[PROTO_DEF_NR] = {
+    static PICO_TLS int score[PROTO_DEF_NR] = {
         PROTO_DEF_SCORE, PROTO_DEF_SCORE, PROTO_DEF_SCORE, PROTO_DEF_SCORE, PROTO_DEF_SCORE, PROTO_DEF_SCORE, PROTO_DEF_SCORE, PROTO_DEF_SCORE, PROTO_DEF_SCORE, PROTO_DEF_SCORE, PROTO_DEF_SCORE
     };
-    static int index[PROTO_DEF_NR] = {
+    static PICO_TLS int index[PROTO_DEF_NR] = {
         0, 0, 0, 0, 0, 0
     };
-    static int avg[PROTO_DEF_NR][PROTO_DEF_AVG_NR];
-    static int ret[PROTO_DEF_NR] = {
+    static PICO_TLS int avg[PROTO_DEF_NR][PROTO_DEF_AVG_NR];
+    static PICO_TLS int ret[PROTO_DEF_NR] = {
         0
     };
 
@@ -815,6 +1259,36 @@ void pico_stack_loop(void)
     }
 }
 
+pico_time pico_stack_next_deadline(void)
+{
+    pico_time now = PICO_TIME_MS();
+    pico_time deadline;
+#if defined (PICO_SUPPORT_IPV4) || defined (PICO_SUPPORT_IPV6)
+#if defined (PICO_SUPPORT_TCP) || defined (PICO_SUPPORT_UDP)
+    pico_time sockets;
+#endif
+#endif
+
+    if (pico_devices_pending() || pico_protocols_pending())
+        return now;
+
+    /* Timers fire on the first tick strictly past their expiry */
+    deadline = pico_timer_next_expire();
+    if (deadline != PICO_TIME_NEVER)
+        deadline++;
+
+#if defined (PICO_SUPPORT_IPV4) || defined (PICO_SUPPORT_IPV6)
+#if defined (PICO_SUPPORT_TCP) || defined (PICO_SUPPORT_UDP)
+    sockets = pico_sockets_next_deadline(now);
+    if (sockets < deadline)
+        deadline = sockets;
+#endif
+#endif
+
+    return (deadline < now) ? now : deadline;
+}
+
+#ifndef PICO_SUPPORT_TIMER_WHEEL
 static uint32_t
 pico_timer_ref_add(pico_time expire, struct pico_timer *t, uint32_t id, uint32_t hash)
 {
@@ -853,6 +1327,7 @@ pico_timer_create(void (*timer)(pico_time, void *), void *arg)
 
     return t;
 }
+#endif
 
 MOCKABLE uint32_t pico_timer_add(pico_time expire, void (*timer)(pico_time, void *), void *arg)
 {
@@ -886,6 +1361,9 @@ uint32_t pico_timer_add_hashed(pico_time expire, void (*timer)(pico_time, void *
 
 int MOCKABLE pico_stack_init(void)
 {
+    /* Pick the fastest checksum routine for this CPU */
+    pico_checksum_init();
+
 #ifdef PICO_SUPPORT_ETH
     pico_protocol_init(&pico_proto_ethernet);
 #endif
@@ -929,8 +1407,13 @@ int MOCKABLE pico_stack_init(void)
 
     pico_rand_feed(123456);
 
+#ifdef PICO_SUPPORT_TIMER_WHEEL
+    /* Initialize timer wheel */
+    Timers = pico_timer_wheel_init();
+#else
     /* Initialize timer heap */
     Timers = heap_init();
+#endif
     if (!Timers)
         return -1;
 
@@ -13,6 +13,28 @@ int tcpbench_mode = 0;
 struct pico_socket *tcpbench_sock = NULL;
 static pico_time tcpbench_time_start, tcpbench_time_end;
 
+static void tcpbench_print_info(struct pico_socket *s)
+{
+    struct pico_tcp_info info;
+
+    if (pico_socket_getoption(s, PICO_TCP_INFO, &info) < 0) {
+        printf("tcpbench> PICO_TCP_INFO failed: %s\n", strerror(pico_err));
+        return;
+    }
+
+    printf("tcpbench> rtt %u ms (var %u) rto %u ms backoff %u dupacks %u\n",
+           info.rtt, info.rttvar, info.rto, info.backoff, info.dupacks);
+    printf("tcpbench> cwnd %u ssthresh %u in flight %u mss %u snd_wnd %u rcv_wnd %u\n",
+           info.cwnd, info.ssthresh, info.in_flight, info.mss, info.snd_wnd, info.rcv_wnd);
+    printf("tcpbench> sent %u segments (%llu bytes), received %u segments (%llu bytes)\n",
+           info.segs_out, (unsigned long long)info.bytes_out, info.segs_in, (unsigned long long)info.bytes_in);
+    printf("tcpbench> retransmits %u (fast %u, timeouts %u), out of order %u\n",
+           info.retrans, info.fast_retrans, info.rto_events, info.ooo_segs);
+    printf("tcpbench> zero windows sent %u received %u, cwnd limited %llu ms, rwnd limited %llu ms\n",
+           info.zero_wnd_local, info.zero_wnd_remote,
+           (unsigned long long)info.cwnd_limited, (unsigned long long)info.rwnd_limited);
+}
+
 void cb_tcpbench(uint16_t ev, struct pico_socket *s)
 {
     static int closed = 0;
@@ -77,6 +99,7 @@ void cb_tcpbench(uint16_t ev, struct pico_socket *s)
             tcpbench_time = (tcpbench_time_end - tcpbench_time_start) / 1000.0; /* get number of seconds */
             printf("tcpbench> received %d bytes in %lf seconds\n", tcpbench_rd_size, tcpbench_time);
             printf("tcpbench> average read throughput %lf kbit/sec\n", ((tcpbench_rd_size * 8.0) / tcpbench_time) / 1000);
+            tcpbench_print_info(s);
             pico_socket_shutdown(s, PICO_SHUT_WR);
             printf("tcpbench> Called shutdown write, ev = %d\n", ev);
         }
@@ -136,6 +159,7 @@ void cb_tcpbench(uint16_t ev, struct pico_socket *s)
                 tcpbench_time = (tcpbench_time_end - tcpbench_time_start) / 1000.0; /* get number of seconds */
                 printf("tcpbench> Transmitted %u bytes in %lf seconds\n", TCPSIZ, tcpbench_time);
                 printf("tcpbench> average write throughput %lf kbit/sec\n", ((TCPSIZ * 8.0) / tcpbench_time) / 1000);
+                tcpbench_print_info(s);
                 closed = 1;
             }
         }
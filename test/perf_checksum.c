@@ -0,0 +1,56 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   Checksum kernel benchmark: 'make checksumbench' runs every kernel usable
+   on this CPU over typical packet sizes and reports the throughput.
+ *********************************************************************/
+#include "pico_config.h"
+#include "stack/pico_frame.c"
+#include <time.h>
+
+#define PERF_CHECKSUM_BYTES (256u * 1024u * 1024u)
+
+static const uint32_t perf_checksum_sizes[] = {
+    20, 64, 576, 1500, 9000, 65535
+};
+
+static double perf_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+int main(void)
+{
+    static uint8_t buf[65536 + 1];
+    volatile uint32_t sink = 0;
+    uint32_t i, k, n, rounds;
+    double t0, ns;
+
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = (uint8_t)(i * 31u + 7u);
+
+    pico_checksum_init();
+    for (k = 0; k < PICO_CHECKSUM_KERNELS; k++) {
+        const struct pico_checksum_kernel *kern = &pico_checksum_kernels[k];
+        if (!pico_checksum_kernel_usable(kern))
+            continue;
+
+        printf("%-7s%s", kern->name, (kern->adder == pico_checksum_sum) ? "*" : " ");
+        for (n = 0; n < sizeof(perf_checksum_sizes) / sizeof(perf_checksum_sizes[0]); n++) {
+            uint32_t len = perf_checksum_sizes[n];
+            rounds = PERF_CHECKSUM_BYTES / len;
+            /* Odd start address, as for a TCP payload after a 14 byte ethernet header */
+            t0 = perf_now_ns();
+            for (i = 0; i < rounds; i++)
+                sink += kern->adder(sink, buf + 1, len);
+            ns = perf_now_ns() - t0;
+            printf(" %5u B: %6.2f GB/s", len, ((double)rounds * len) / ns);
+        }
+        printf("\n");
+    }
+    (void)sink;
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   Socket demultiplexing benchmark: 'make flowbench' fills one local port
+   with connected sockets and compares the per-segment lookup through the
+   hashed flow table with a walk of the sockport tree.
+ *********************************************************************/
+#include "pico_config.h"
+#include "pico_stack.h"
+#include "pico_socket.h"
+#include "pico_ipv4.h"
+#include "pico_ipv6.h"
+#include "pico_tcp.h"
+#include <time.h>
+
+#define PERF_FLOWS_LOOKUPS 200000
+#define PERF_FLOWS_PORT    80
+
+static const uint32_t perf_flows_counts[] = {
+    100, 1000, 10000, 50000
+};
+
+static uint32_t perf_seed = 0x5eed;
+
+static uint32_t perf_rand(void)
+{
+    perf_seed = perf_seed * 1103515245u + 12345u;
+    return perf_seed >> 8;
+}
+
+static double perf_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Peer i: address and port, spread like a server's client population */
+static void perf_flow_peer(uint32_t i, int ip6, union pico_address *a, uint16_t *port)
+{
+    memset(a, 0, sizeof(*a));
+    if (ip6) {
+        a->ip6.addr[0] = 0x20;
+        a->ip6.addr[1] = 0x01;
+        a->ip6.addr[14] = (uint8_t)(i >> 8);
+        a->ip6.addr[15] = (uint8_t)i;
+    } else {
+        a->ip4.addr = long_be(0x0a000000u | (i >> 4));
+    }
+
+    *port = short_be((uint16_t)(1024u + (i & 0x0fu)));
+}
+
+/* The sockport walk the delivery path did for every segment */
+static struct pico_socket *perf_flows_walk(struct pico_sockport *sp, struct pico_frame *f)
+{
+    struct pico_trans *tr = (struct pico_trans *) f->transport_hdr;
+    struct pico_tree_node *index;
+    struct pico_socket *s;
+
+    pico_tree_foreach(index, &sp->socks) {
+        s = index->keyValue;
+        if (s->remote_port != tr->sport)
+            continue;
+
+        if (IS_IPV4(f) && (s->remote_addr.ip4.addr == ((struct pico_ipv4_hdr *)f->net_hdr)->src.addr))
+            return s;
+
+        if (IS_IPV6(f) && (memcmp(s->remote_addr.ip6.addr, ((struct pico_ipv6_hdr *)f->net_hdr)->src.addr, PICO_SIZE_IP6) == 0))
+            return s;
+    }
+    return NULL;
+}
+
+static int perf_flows_run(uint32_t count, int ip6, uint16_t lport)
+{
+    static uint8_t buf[PICO_SIZE_IP6HDR + PICO_SIZE_TCPHDR];
+    struct pico_ipv4_hdr *hdr4 = (struct pico_ipv4_hdr *) buf;
+    struct pico_ipv6_hdr *hdr6 = (struct pico_ipv6_hdr *) buf;
+    union pico_address local, peer;
+    struct pico_sockport *sp;
+    struct pico_socket *s;
+    struct pico_frame f;
+    struct pico_trans *tr;
+    uint16_t port;
+    uint32_t i, misses = 0;
+    double t0, t_hash, t_walk;
+    uint32_t walks;
+
+    memset(&local, 0, sizeof(local));
+    memset(&f, 0, sizeof(f));
+    memset(buf, 0, sizeof(buf));
+    if (ip6) {
+        local.ip6.addr[0] = 0x20;
+        local.ip6.addr[15] = 1;
+        hdr6->vtf = long_be(0x60000000u);
+        hdr6->dst = local.ip6;
+        f.transport_hdr = buf + PICO_SIZE_IP6HDR;
+    } else {
+        local.ip4.addr = long_be(0x0a0000feu);
+        hdr4->vhl = 0x45;
+        hdr4->dst = local.ip4;
+        f.transport_hdr = buf + PICO_SIZE_IP4HDR;
+    }
+
+    f.net_hdr = buf;
+    tr = (struct pico_trans *) f.transport_hdr;
+    tr->dport = short_be(lport);
+
+    /* Bare connected sockets: no TCP state or timers needed to be found */
+    for (i = 0; i < count; i++) {
+        s = PICO_ZALLOC(sizeof(struct pico_socket));
+        if (!s)
+            return -1;
+
+        s->proto = &pico_proto_tcp;
+        s->net = ip6 ? (struct pico_protocol *)&pico_proto_ipv6 : (struct pico_protocol *)&pico_proto_ipv4;
+        s->local_port = short_be(lport);
+        s->local_addr = local;
+        perf_flow_peer(i, ip6, &s->remote_addr, &s->remote_port);
+        if (pico_socket_add(s) != 0)
+            return -1;
+    }
+    sp = pico_get_sockport(PICO_PROTO_TCP, short_be(lport));
+    if (!sp)
+        return -1;
+
+    t0 = perf_now_ns();
+    for (i = 0; i < PERF_FLOWS_LOOKUPS; i++) {
+        perf_flow_peer(perf_rand() % count, ip6, &peer, &port);
+        if (ip6)
+            hdr6->src = peer.ip6;
+        else
+            hdr4->src = peer.ip4;
+
+        tr->sport = port;
+        if (!pico_socket_flow_find(PICO_PROTO_TCP, &f))
+            misses++;
+    }
+    t_hash = (perf_now_ns() - t0) / PERF_FLOWS_LOOKUPS;
+
+    /* The walk is O(n): fewer rounds keep the run short */
+    walks = PERF_FLOWS_LOOKUPS / (1u + count / 100u);
+    t0 = perf_now_ns();
+    for (i = 0; i < walks; i++) {
+        perf_flow_peer(perf_rand() % count, ip6, &peer, &port);
+        if (ip6)
+            hdr6->src = peer.ip6;
+        else
+            hdr4->src = peer.ip4;
+
+        tr->sport = port;
+        if (!perf_flows_walk(sp, &f))
+            misses++;
+    }
+    t_walk = (perf_now_ns() - t0) / walks;
+
+    printf("tcp%c %6u flows: flow table %8.1f ns, sockport walk %10.1f ns%s\n",
+           ip6 ? '6' : '4', count, t_hash, t_walk, misses ? " (MISSES)" : "");
+    return misses ? -1 : 0;
+}
+
+int main(void)
+{
+    uint32_t n;
+    int ip6;
+
+    pico_stack_init();
+    for (ip6 = 0; ip6 < 2; ip6++) {
+        for (n = 0; n < sizeof(perf_flows_counts) / sizeof(perf_flows_counts[0]); n++) {
+            /* Each run uses its own local port */
+            if (perf_flows_run(perf_flows_counts[n], ip6, (uint16_t)(PERF_FLOWS_PORT + n)) < 0) {
+                printf("flowbench: failed\n");
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   TCP send queue benchmark: 'make tcpqbench' fills the output queue with
+   up to 65536 segments and times what the sender does to it (enqueue,
+   the walk of pico_tcp_output, SACK marking and the release on cumulative
+   ACKs), against the same work on the sequence-keyed tree the queue used
+   to be.
+ *********************************************************************/
+#include "pico_config.h"
+#include "pico_stack.h"
+#include "pico_tree.h"
+#include "modules/pico_tcp.c"
+#include <time.h>
+
+#define PERF_TCPQ_SEGMENTS (1u << 18)
+#define PERF_TCPQ_MSS      1000u
+#define PERF_TCPQ_ISS      0xfffff000u  /* wraps during the run */
+#define PERF_TCPQ_BLOCKS   256u         /* SACK blocks per round */
+
+static const uint32_t perf_tcpq_counts[] = {
+    64, 1024, 8192, 65536
+};
+
+struct perf_tcpq_times {
+    double enqueue, walk, sack, release;
+};
+
+/* SACK blocks spread over the flight, each covering two segments */
+static uint32_t perf_tcpq_block_step(uint32_t count)
+{
+    uint32_t step = count / PERF_TCPQ_BLOCKS;
+    return (step < 4) ? 4 : step;
+}
+
+static double perf_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static struct pico_frame *perf_tcpq_frame(uint32_t i)
+{
+    struct pico_frame *f = pico_frame_alloc(PICO_SIZE_TCPHDR);
+
+    if (!f)
+        return NULL;
+
+    f->transport_hdr = f->start;
+    f->transport_len = PICO_SIZE_TCPHDR;
+    f->payload_len = PERF_TCPQ_MSS;
+    ((struct pico_tcp_hdr *)f->transport_hdr)->seq = long_be(PERF_TCPQ_ISS + i * PERF_TCPQ_MSS);
+    return f;
+}
+
+static int perf_tcpq_fill(struct pico_frame **f, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        f[i] = perf_tcpq_frame(i);
+        if (!f[i])
+            return -1;
+    }
+    return 0;
+}
+
+/* The tree queue: next_segment() was a lookup of seq + len, a SACK block
+ * was checked against every segment from the head, an ACK deleted node by
+ * node. */
+static struct pico_frame *perf_tree_peek(struct pico_tree *tree, uint32_t seq)
+{
+    struct pico_tcp_hdr h;
+    struct pico_frame key;
+
+    memset(&key, 0, sizeof(key));
+    key.transport_hdr = (uint8_t *)&h;
+    h.seq = long_be(seq);
+    return pico_tree_findKey(tree, &key);
+}
+
+static int perf_tree_run(struct pico_frame **seg, uint32_t count, struct perf_tcpq_times *tm)
+{
+    struct pico_tree tree = {
+        &LEAF, segment_compare
+    };
+    struct pico_tree_node *index, *temp;
+    struct pico_frame *f;
+    uint32_t i, start, end, ack;
+    double t0;
+
+    t0 = perf_now_ns();
+    for (i = 0; i < count; i++)
+        if (pico_tree_insert(&tree, seg[i]))
+            return -1;
+    tm->enqueue += perf_now_ns() - t0;
+
+    t0 = perf_now_ns();
+    for (i = 0, f = pico_tree_first(&tree); f; i++)
+        f = perf_tree_peek(&tree, SEQN(f) + f->payload_len);
+    tm->walk += perf_now_ns() - t0;
+    if (i != count)
+        return -1;
+
+    t0 = perf_now_ns();
+    for (i = 1; i + 2 < count; i += perf_tcpq_block_step(count)) {
+        start = SEQN(seg[i]);
+        end = start + 2 * PERF_TCPQ_MSS;
+        pico_tree_foreach_safe(index, &tree, temp) {
+            f = index->keyValue;
+            if (pico_seq_compare(SEQN(f), end) >= 0)
+                break;
+
+            if ((pico_seq_compare(SEQN(f), start) >= 0) && (pico_seq_compare(SEQN(f) + f->payload_len, end) <= 0))
+                f->flags |= PICO_FRAME_FLAG_SACKED;
+        }
+    }
+    tm->sack += perf_now_ns() - t0;
+
+    /* An ACK every second segment */
+    t0 = perf_now_ns();
+    for (ack = SEQN(seg[0]) + 2 * PERF_TCPQ_MSS; pico_tree_first(&tree); ack += 2 * PERF_TCPQ_MSS) {
+        pico_tree_foreach_safe(index, &tree, temp) {
+            f = index->keyValue;
+            if (pico_seq_compare(SEQN(f) + f->payload_len, ack) > 0)
+                break;
+
+            pico_tree_delete(&tree, f);
+            pico_frame_discard(f);
+        }
+    }
+    tm->release += perf_now_ns() - t0;
+    return 0;
+}
+
+static int perf_ring_run(struct pico_socket_tcp *t, struct pico_frame **seg, uint32_t count, struct perf_tcpq_times *tm)
+{
+    struct pico_frame *f;
+    uint32_t i, ack;
+    pico_time ts;
+    double t0;
+
+    t0 = perf_now_ns();
+    for (i = 0; i < count; i++)
+        if (pico_enqueue_segment(&t->tcpq_out, seg[i]) <= 0)
+            return -1;
+    tm->enqueue += perf_now_ns() - t0;
+
+    t0 = perf_now_ns();
+    for (i = 0, f = first_segment(&t->tcpq_out); f; i++)
+        f = next_segment(&t->tcpq_out, f);
+    tm->walk += perf_now_ns() - t0;
+    if (i != count)
+        return -1;
+
+    t0 = perf_now_ns();
+    for (i = 1; i + 2 < count; i += perf_tcpq_block_step(count))
+        tcp_process_sack(t, SEQN(seg[i]), SEQN(seg[i]) + 2 * PERF_TCPQ_MSS);
+    tm->sack += perf_now_ns() - t0;
+
+    t0 = perf_now_ns();
+    for (ack = SEQN(seg[0]) + 2 * PERF_TCPQ_MSS; t->tcpq_out.frames; ack += 2 * PERF_TCPQ_MSS)
+        release_all_until(&t->tcpq_out, ack, &ts);
+    tm->release += perf_now_ns() - t0;
+    return 0;
+}
+
+static void perf_tcpq_print(const char *name, struct perf_tcpq_times *tm, uint32_t rounds, uint32_t count)
+{
+    uint32_t blocks = (count - 4) / perf_tcpq_block_step(count) + 1;
+
+    printf("  %-4s enqueue %6.1f ns  walk %6.1f ns  release %6.1f ns per segment, SACK %9.1f ns per block\n", name,
+           tm->enqueue / (rounds * count), tm->walk / (rounds * count), tm->release / (rounds * count),
+           tm->sack / (rounds * blocks));
+}
+
+int main(void)
+{
+    struct pico_socket_tcp *t;
+    struct perf_tcpq_times tree, ring;
+    struct pico_frame **seg;
+    uint32_t n, r, rounds, count;
+
+    pico_stack_init();
+    t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    seg = PICO_ZALLOC(perf_tcpq_counts[sizeof(perf_tcpq_counts) / sizeof(perf_tcpq_counts[0]) - 1] * sizeof(struct pico_frame *));
+    if (!t || !seg) {
+        printf("tcpqbench: out of memory\n");
+        return 1;
+    }
+
+    t->tcpq_out.max_size = 0xffffffffu;
+    for (n = 0; n < sizeof(perf_tcpq_counts) / sizeof(perf_tcpq_counts[0]); n++) {
+        count = perf_tcpq_counts[n];
+        rounds = PERF_TCPQ_SEGMENTS / count;
+        memset(&tree, 0, sizeof(tree));
+        memset(&ring, 0, sizeof(ring));
+        for (r = 0; r < rounds; r++) {
+            if ((perf_tcpq_fill(seg, count) < 0) || (perf_tree_run(seg, count, &tree) < 0) ||
+                (perf_tcpq_fill(seg, count) < 0) || (perf_ring_run(t, seg, count, &ring) < 0)) {
+                printf("tcpqbench: failed\n");
+                return 1;
+            }
+        }
+        printf("%u segments in flight:\n", count);
+        perf_tcpq_print("tree", &tree, rounds, count);
+        perf_tcpq_print("ring", &ring, rounds, count);
+    }
+    return 0;
+}
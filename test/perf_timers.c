@@ -0,0 +1,113 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   Timer backend benchmark: 'make timerbench' builds this file once against
+   the timer heap and once against the timer wheel, and runs both.
+ *********************************************************************/
+#include "pico_config.h"
+
+#ifdef PERF_TIMERS_HEAP
+# undef PICO_SUPPORT_TIMER_WHEEL
+/* The default heap tops out at about a thousand timers */
+# define MAX_BLOCK_COUNT 4096
+# define PERF_TIMERS_BACKEND "heap"
+#else
+# ifndef PICO_SUPPORT_TIMER_WHEEL
+#  define PICO_SUPPORT_TIMER_WHEEL
+# endif
+# define PERF_TIMERS_BACKEND "wheel"
+#endif
+
+#include "pico_stack.h"
+/* Thousands of live timers are the point here: no warning for each one */
+#undef PICO_MAX_TIMERS
+#define PICO_MAX_TIMERS (1u << 30)
+
+#include "stack/pico_stack.c"
+#include <time.h>
+
+#define PERF_TIMERS_CHURN  10000
+#define PERF_TIMERS_CHECKS 10000
+
+static uint32_t perf_seed = 0x5eed;
+
+static uint32_t perf_rand(void)
+{
+    perf_seed = perf_seed * 1103515245u + 12345u;
+    return perf_seed >> 8;
+}
+
+static double perf_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void perf_timer_cb(pico_time now, void *arg)
+{
+    IGNORE_PARAMETER(now);
+    IGNORE_PARAMETER(arg);
+}
+
+static int perf_timers_run(uint32_t live)
+{
+    uint32_t *ids = PICO_ZALLOC(live * sizeof(uint32_t));
+    double t0, t_add, t_churn, t_check;
+    uint32_t i;
+
+    if (!ids)
+        return -1;
+
+#ifdef PICO_SUPPORT_TIMER_WHEEL
+    Timers = pico_timer_wheel_init();
+#else
+    Timers = heap_init();
+#endif
+    if (!Timers)
+        return -1;
+
+    /* Retransmission-like spread: between one second and ten minutes out */
+    t0 = perf_now_ns();
+    for (i = 0; i < live; i++) {
+        ids[i] = pico_timer_add(1000 + (perf_rand() % 600000), perf_timer_cb, NULL);
+        if (!ids[i])
+            return -1;
+    }
+    t_add = (perf_now_ns() - t0) / live;
+
+    /* Re-arm random live timers, as TCP does on every ACK */
+    t0 = perf_now_ns();
+    for (i = 0; i < PERF_TIMERS_CHURN; i++) {
+        uint32_t victim = perf_rand() % live;
+        pico_timer_cancel(ids[victim]);
+        ids[victim] = pico_timer_add(1000 + (perf_rand() % 600000), perf_timer_cb, NULL);
+        if (!ids[victim])
+            return -1;
+    }
+    t_churn = (perf_now_ns() - t0) / PERF_TIMERS_CHURN;
+
+    t0 = perf_now_ns();
+    for (i = 0; i < PERF_TIMERS_CHECKS; i++)
+        pico_check_timers();
+    t_check = (perf_now_ns() - t0) / PERF_TIMERS_CHECKS;
+
+    printf("%-5s %7u live timers: add %8.1f ns, cancel+add %10.1f ns, check %8.1f ns\n",
+           PERF_TIMERS_BACKEND, live, t_add, t_churn, t_check);
+
+    for (i = 0; i < live; i++)
+        pico_timer_cancel(ids[i]);
+    PICO_FREE(ids);
+    return 0;
+}
+
+int main(void)
+{
+    if ((perf_timers_run(10000) < 0) || (perf_timers_run(100000) < 0)) {
+        printf("%s: out of memory\n", PERF_TIMERS_BACKEND);
+        return 1;
+    }
+
+    return 0;
+}
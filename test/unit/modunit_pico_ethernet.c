@@ -33,6 +33,13 @@
             printf(s, ##__VA_ARGS__);                                          \
             fflush(stdout)
 
+#ifdef PICO_SUPPORT_RUN_TO_COMPLETION
+/* The network layer takes the frame in place: nothing is left queued */
+#define ENQUEUED(q, f) ((q)->size == 0)
+#else
+#define ENQUEUED(q, f) ((q)->size == (f)->buffer_len)
+#endif
+
 Suite *pico_suite(void);
 
 START_TEST(tc_destination_is_bcast)
@@ -164,7 +171,7 @@ START_TEST(tc_pico_ipv4_ethernet_receive)
     fail_unless(ret > 0, "Was correct frame should've returned size of frame\n");
     SUCCESS();
     CHECKING(count);
-    fail_unless(pico_proto_ipv4.q_in->size == f->buffer_len, "Frame not enqueued\n");
+    fail_unless(ENQUEUED(pico_proto_ipv4.q_in, f), "Frame not enqueued\n");
     SUCCESS();
 
     ENDING(count);
@@ -197,10 +204,10 @@ START_TEST(tc_pico_ipv6_ethernet_receive)
     TRYING("With correct network type\n");
     ret = pico_ipv6_ethernet_receive(f);
     CHECKING(count);
-    fail_unless(ret == (int32_t)f->buffer_len, "Was correct frame, should've returned success\n");
+    fail_unless(ret == (int32_t)sizeof(struct pico_ipv6_hdr), "Was correct frame, should've returned success\n");
     SUCCESS();
     CHECKING(count);
-    fail_unless(pico_proto_ipv6.q_in->size == f->buffer_len, "Frame not enqueued\n");
+    fail_unless(ENQUEUED(pico_proto_ipv6.q_in, f), "Frame not enqueued\n");
     SUCCESS();
 
     ENDING(count);
@@ -240,13 +247,15 @@ START_TEST(tc_pico_eth_receive)
     TRYING("With correct network type\n");
     ret = pico_eth_receive(f);
     CHECKING(count);
-    fail_unless(ret == (int32_t)f->buffer_len, "Was correct frame, should've returned success\n");
+    fail_unless(ret == (int32_t)(sizeof(struct pico_ipv6_hdr) + sizeof(struct pico_eth_hdr)), "Was correct frame, should've returned success\n");
     SUCCESS();
     CHECKING(count);
-    fail_unless(pico_proto_ipv6.q_in->size == f->buffer_len, "Frame not enqueued\n");
+    fail_unless(ENQUEUED(pico_proto_ipv6.q_in, f), "Frame not enqueued\n");
     SUCCESS();
 
+#ifndef PICO_SUPPORT_RUN_TO_COMPLETION
     pico_frame_discard(f);
+#endif
 
     f = pico_frame_alloc(sizeof(struct pico_ipv4_hdr) + sizeof(struct pico_eth_hdr));
     f->datalink_hdr = f->buffer;
@@ -273,7 +282,7 @@ START_TEST(tc_pico_eth_receive)
     fail_unless(ret > 0, "Was correct frame should've returned size of frame\n");
     SUCCESS();
     CHECKING(count);
-    fail_unless(pico_proto_ipv4.q_in->size == f->buffer_len, "Frame not enqueued\n");
+    fail_unless(ENQUEUED(pico_proto_ipv4.q_in, f), "Frame not enqueued\n");
     SUCCESS();
 
     ENDING(count);
@@ -127,10 +127,13 @@ START_TEST(tc_pico_ipv6_fragments_complete)
     pico_tree_insert(&ipv6_fragments, a);
     pico_tree_insert(&ipv6_fragments, b);
 
+#ifndef PICO_SUPPORT_FRAME_POOL
+    /* Pooled frames do not fail with the allocator, see modunit_pico_frame */
     pico_set_mm_failure(1);
     pico_fragments_complete(64, TESTPROTO, PICO_PROTO_IPV6);
     fail_if(transport_recv_called != 0);
     fail_if(timer_cancel_called != 0);
+#endif
 
     pico_fragments_complete(64, TESTPROTO, PICO_PROTO_IPV6);
     fail_if(transport_recv_called != 1);
@@ -165,10 +168,13 @@ START_TEST(tc_pico_ipv4_fragments_complete)
     pico_tree_insert(&ipv4_fragments, a);
     pico_tree_insert(&ipv4_fragments, b);
 
+#ifndef PICO_SUPPORT_FRAME_POOL
+    /* Pooled frames do not fail with the allocator, see modunit_pico_frame */
     pico_set_mm_failure(1);
     pico_fragments_complete(64, TESTPROTO, PICO_PROTO_IPV4);
     fail_if(transport_recv_called != 0);
     fail_if(timer_cancel_called != 0);
+#endif
 
     pico_fragments_complete(64, TESTPROTO, PICO_PROTO_IPV4);
     fail_if(transport_recv_called != 1);
@@ -904,6 +910,8 @@ START_TEST(tc_pico_fragments_reassemble)
     fail_if(buffer_len_transport_receive != 64 + PICO_SIZE_IP6HDR);
     fail_if(!pico_tree_empty(&ipv4_fragments));
 
+#ifndef PICO_SUPPORT_FRAME_POOL
+    /* Pooled frames do not fail with the allocator, see modunit_pico_frame */
     /* Case 3: IPV4 with mm failure*/
     transport_recv_called = 0;
     buffer_len_transport_receive = 0;
@@ -964,6 +972,7 @@ START_TEST(tc_pico_fragments_reassemble)
     fail_if(transport_recv_called == 1);
     fail_if(buffer_len_transport_receive != 0);
     fail_if(pico_tree_empty(&ipv6_fragments));
+#endif
 }
 END_TEST
 
@@ -4,12 +4,28 @@
 #include "stack/pico_frame.c"
 #include "check.h"
 
-volatile pico_err_t pico_err;
+PICO_TLS volatile pico_err_t pico_err;
 
 #define FRAME_SIZE 1000
 
 Suite *pico_suite(void);
 
+#ifdef PICO_SUPPORT_FRAME_POOL
+/* Empty the free lists, so that the next chunks come from PICO_ZALLOC and
+ * an injected allocation failure hits them */
+static void frame_pools_exhaust(void)
+{
+    uint32_t i;
+    if (!frame_pools_ready)
+        frame_pools_init();
+
+    for (i = 0; i < PICO_FRAME_POOL_CLASSES; i++)
+        frame_pools[i].free = NULL;
+}
+#else
+#define frame_pools_exhaust() do {} while(0)
+#endif
+
 START_TEST(tc_pico_frame_alloc_discard)
 {
     struct pico_frame *f = pico_frame_alloc(FRAME_SIZE);
@@ -27,7 +43,8 @@ START_TEST(tc_pico_frame_alloc_discard)
     /* Test empty discard */
     pico_frame_discard(NULL);
 
-#ifdef PICO_FAULTY
+#if defined(PICO_FAULTY) && !defined(PICO_SUPPORT_FRAME_POOL)
+    /* Pooled frames fall back to the heap, see tc_pico_frame_pool */
     printf("Testing with faulty memory in frame_alloc (1)\n");
     pico_set_mm_failure(1);
     f = pico_frame_alloc(FRAME_SIZE);
@@ -86,8 +103,10 @@ START_TEST(tc_pico_frame_grow)
     struct pico_frame *f = pico_frame_alloc(3);
     struct pico_frame *f2 = pico_frame_alloc(0);
     fail_if(f->buffer_len != 3);
+#ifndef PICO_SUPPORT_FRAME_POOL
     /* Ensure that the usage_count starts at byte 4, for good alignment */
     fail_if(((void*)f->usage_count - (void *)f->buffer) != 4);
+#endif
 
     ((uint8_t *)f->buffer)[0] = 'a';
     ((uint8_t *)f->buffer)[1] = 'b';
@@ -98,7 +117,7 @@ START_TEST(tc_pico_frame_grow)
     /* First, the failing cases. */
     fail_if(pico_frame_grow(NULL, 30) == 0);
     fail_if(pico_frame_grow(f, 2) == 0);
-    f->flags = 0;
+    f->flags &= (PICO_FRAME_FLAG_POOL_DESC | PICO_FRAME_FLAG_POOL_BUF);
 
     /* Check for dereferencing OOB */
     fail_if(pico_frame_grow(f2, 3) != 0);
@@ -129,7 +148,7 @@ START_TEST(tc_pico_frame_grow)
     f->buffer = PICO_ZALLOC(10);
 
     fail_if(pico_frame_grow(f, 22) != 0);
-    fail_if (f->flags);
+    fail_if (f->flags & (PICO_FRAME_FLAG_EXT_BUFFER | PICO_FRAME_FLAG_EXT_USAGE_COUNTER));
     pico_frame_discard(f);
 
 }
@@ -171,6 +190,7 @@ START_TEST(tc_pico_frame_copy)
 
 #ifdef PICO_FAULTY
     printf("Testing with faulty memory in frame_copy (1)\n");
+    frame_pools_exhaust();
     pico_set_mm_failure(1);
     c3 = pico_frame_copy(f);
     fail_if(c3);
@@ -197,7 +217,7 @@ START_TEST(tc_pico_frame_deepcopy)
     fail_if(*f->usage_count != 1);
     fail_if(*dc->usage_count != 1);
     fail_if(dc->buffer == f->buffer);
-#ifdef PICO_FAULTY
+#if defined(PICO_FAULTY) && !defined(PICO_SUPPORT_FRAME_POOL)
     printf("Testing with faulty memory in frame_deepcopy (1)\n");
     pico_set_mm_failure(1);
     dc = pico_frame_deepcopy(f);
@@ -207,6 +227,386 @@ START_TEST(tc_pico_frame_deepcopy)
 }
 END_TEST
 
+START_TEST(tc_pico_frame_chain)
+{
+    struct pico_frame *f, *c, *dc;
+    struct pico_iovec iov[PICO_FRAME_MAX_SEGMENTS];
+    uint8_t *payload;
+    uint32_t i;
+
+    /* A packet with no headroom */
+    f = pico_frame_alloc(100);
+    fail_if(!f);
+    for (i = 0; i < 100; i++)
+        f->buffer[i] = (uint8_t)i;
+    f->net_hdr = f->buffer;
+    f->transport_hdr = f->buffer + 20;
+    payload = f->buffer;
+
+    fail_if(pico_frame_linearize(f) != 0);
+    fail_if(pico_frame_segments(f, iov, PICO_FRAME_MAX_SEGMENTS) != 1);
+
+    /* The payload stays where it is, a header segment goes in front */
+    fail_if(pico_frame_prepend_segment(f, 14) != 0);
+    fail_if(!f->chain);
+    fail_if(f->chain->start != payload);
+    fail_if(f->net_hdr != payload);
+    fail_if(f->len != 0);
+    fail_if(f->start - f->buffer != 14);
+    f->start -= 14;
+    f->len += 14;
+    f->datalink_hdr = f->start;
+    memset(f->start, 0xee, 14);
+    fail_if(pico_frame_total_len(f) != 114);
+    fail_if(pico_frame_segments(f, iov, PICO_FRAME_MAX_SEGMENTS) != 2);
+    fail_if(iov[0].base != f->start || iov[0].len != 14);
+    fail_if(iov[1].base != payload || iov[1].len != 100);
+    fail_if(pico_frame_segments(f, iov, 1) != -1);
+
+    /* Copies share every segment */
+    c = pico_frame_copy(f);
+    fail_if(!c);
+    fail_if(c->chain == f->chain);
+    fail_if(c->chain->buffer != f->chain->buffer);
+    fail_if(*f->chain->usage_count != 2);
+    fail_if(*f->usage_count != 2);
+
+    /* Linearizing a copy leaves the original alone */
+    fail_if(pico_frame_linearize(c) != 0);
+    fail_if(c->chain);
+    fail_if(c->len != 114);
+    fail_if(c->net_hdr != c->start + 14);
+    fail_if(c->transport_hdr != c->start + 34);
+    fail_if(c->datalink_hdr != c->start);
+    fail_if(c->start[0] != 0xee || c->start[13] != 0xee);
+    fail_if(memcmp(c->start + 14, payload, 100) != 0);
+    fail_if(*f->chain->usage_count != 1);
+    fail_if(*f->usage_count != 1);
+    pico_frame_discard(c);
+
+    dc = pico_frame_deepcopy(f);
+    fail_if(!dc);
+    fail_if(dc->chain);
+    fail_if(memcmp(dc->start + 14, payload, 100) != 0);
+    pico_frame_discard(dc);
+
+    /* Growing works on the linearized frame */
+    fail_if(pico_frame_grow_head(f, pico_frame_total_len(f) + 16) != 0);
+    fail_if(f->chain);
+    fail_if(f->len != 114);
+    fail_if(f->net_hdr != f->start + 14);
+    fail_if(f->net_hdr[0] != 0 || f->net_hdr[99] != 99);
+    pico_frame_discard(f);
+}
+END_TEST
+
+START_TEST(tc_pico_frame_payload_ref)
+{
+    struct pico_frame *f, *r;
+    uint32_t i;
+
+    /* 20 bytes of header and 40 of payload, then 60 more chained */
+    f = pico_frame_alloc(60);
+    fail_if(!f);
+    for (i = 0; i < 60; i++)
+        f->buffer[i] = (uint8_t)i;
+    f->payload = f->buffer + 20;
+    f->chain = pico_frame_alloc(60);
+    fail_if(!f->chain);
+    for (i = 0; i < 60; i++)
+        f->chain->buffer[i] = (uint8_t)(60 + i);
+    f->payload_len = 100;
+
+    /* Within the head */
+    r = pico_frame_payload_ref(f, 10, 20);
+    fail_if(!r);
+    fail_if(r->chain);
+    fail_if(r->start != f->payload + 10 || r->len != 20);
+    fail_if(r->buffer != f->buffer);
+    fail_if(*f->usage_count != 2);
+    pico_frame_discard(r);
+    fail_if(*f->usage_count != 1);
+
+    /* Across the boundary */
+    r = pico_frame_payload_ref(f, 30, 30);
+    fail_if(!r);
+    fail_if(!r->chain || r->chain->chain);
+    fail_if(r->start[0] != 50 || r->len != 10);
+    fail_if(r->chain->start != f->chain->buffer || r->chain->len != 20);
+    fail_if(pico_frame_total_len(r) != 30);
+    fail_if(*f->chain->usage_count != 2);
+    pico_frame_discard(r);
+    fail_if(*f->chain->usage_count != 1);
+
+    /* Only in the chain */
+    r = pico_frame_payload_ref(f, 70, 30);
+    fail_if(!r);
+    fail_if(r->chain);
+    fail_if(r->start[0] != 90 || r->len != 30);
+    pico_frame_discard(r);
+
+    /* Past the end */
+    fail_if(pico_frame_payload_ref(f, 90, 11));
+    fail_if(*f->usage_count != 1);
+    fail_if(*f->chain->usage_count != 1);
+    pico_frame_discard(f);
+}
+END_TEST
+
+#ifdef PICO_SUPPORT_FRAME_POOL
+START_TEST(tc_pico_frame_pool)
+{
+    struct pico_frame_pool_stats st0, st1, st;
+    struct pico_frame *f, *c, *big;
+    uint32_t hits;
+
+    f = pico_frame_alloc(100);
+    fail_if(!f);
+    fail_if(!(f->flags & PICO_FRAME_FLAG_POOL_DESC));
+    fail_if(!(f->flags & PICO_FRAME_FLAG_POOL_BUF));
+    fail_if(((uintptr_t)f->buffer) & (FRAME_POOL_ALIGN - 1u));
+    fail_if(pico_frame_pool_stats(1, &st1) != 0);
+    fail_if(st1.size != PICO_FRAME_POOL_SIZE_1);
+    fail_if(st1.in_use != 1);
+    fail_if(st1.hits != 1);
+    fail_if(st1.free == 0);
+    fail_if(pico_frame_pool_stats(PICO_FRAME_POOL_CLASSES, &st) == 0);
+
+    /* Copies only take a descriptor, and may outlive the original */
+    c = pico_frame_copy(f);
+    fail_if(!c);
+    fail_if(c->buffer != f->buffer);
+    fail_if(!(c->flags & PICO_FRAME_FLAG_POOL_BUF));
+    fail_if(pico_frame_pool_stats(0, &st0) != 0);
+    fail_if(st0.in_use != 1);
+    pico_frame_discard(f);
+    fail_if(pico_frame_pool_stats(1, &st) != 0);
+    fail_if(st.in_use != 1);
+    fail_if(*c->usage_count != 1);
+    pico_frame_discard(c);
+    fail_if(pico_frame_pool_stats(1, &st) != 0);
+    fail_if(st.in_use != 0);
+    fail_if(st.high_water != 1);
+    fail_if(pico_frame_pool_stats(0, &st) != 0);
+    fail_if(st.in_use != 0);
+
+    /* Recycled chunks come back zeroed */
+    f = pico_frame_alloc(100);
+    fail_if(f->buffer[0] != 0);
+    f->buffer[0] = 0xaa;
+    pico_frame_discard(f);
+    f = pico_frame_alloc(100);
+    fail_if(f->buffer[0] != 0);
+
+    /* Growing moves the data to the heap and releases the chunk buffer */
+    f->buffer[0] = 'a';
+    fail_if(pico_frame_grow(f, 4000) != 0);
+    fail_if(f->buffer[0] != 'a');
+    fail_if(f->flags & PICO_FRAME_FLAG_POOL_BUF);
+    fail_if(!(f->flags & PICO_FRAME_FLAG_POOL_DESC));
+    pico_frame_discard(f);
+    fail_if(pico_frame_pool_stats(1, &st) != 0);
+    fail_if(st.in_use != 0);
+
+    /* Frames too large for any class only get their descriptor pooled */
+    big = pico_frame_alloc(PICO_FRAME_POOL_SIZE_3 + 1);
+    fail_if(!big);
+    fail_if(big->flags & PICO_FRAME_FLAG_POOL_BUF);
+    fail_if(!(big->flags & PICO_FRAME_FLAG_POOL_DESC));
+    pico_frame_discard(big);
+
+    /* Zero-copy frames keep their usage counter in the descriptor chunk */
+    f = pico_frame_alloc_skeleton(10, 1);
+    fail_if(!f);
+    fail_if(f->flags & PICO_FRAME_FLAG_EXT_USAGE_COUNTER);
+    pico_frame_discard(f);
+    fail_if(pico_frame_pool_stats(0, &st) != 0);
+    fail_if(st.in_use != 0);
+
+    /* Steady state: no more misses */
+    fail_if(pico_frame_pool_stats(1, &st1) != 0);
+    hits = st1.hits;
+    f = pico_frame_alloc(64);
+    pico_frame_discard(f);
+    fail_if(pico_frame_pool_stats(1, &st) != 0);
+    fail_if(st.hits != hits + 1);
+    fail_if(st.misses != st1.misses);
+
+#ifdef PICO_FAULTY
+    /* An exhausted class grows from the heap. If that fails, the buffer
+     * comes from the heap instead. */
+    frame_pools_exhaust();
+    fail_if(pico_frame_pool_stats(1, &st1) != 0);
+    pico_set_mm_failure(1);
+    f = pico_frame_alloc(64);
+    fail_if(!f);
+    fail_if(f->flags & PICO_FRAME_FLAG_POOL_BUF);
+    fail_if(pico_frame_pool_stats(1, &st) != 0);
+    fail_if(st.misses != st1.misses + 1);
+    fail_if(st.free != 0 || st.in_use != 0);
+    pico_frame_discard(f);
+
+    /* A copy only needs a descriptor, lost with the heap */
+    c = pico_frame_alloc(64);
+    fail_if(!c);
+    frame_pools_exhaust();
+    pico_set_mm_failure(1);
+    fail_if(pico_frame_copy(c) != NULL);
+    pico_frame_discard(c);
+
+    /* The new chunk is recycled */
+    f = pico_frame_alloc(64);
+    fail_if(!f);
+    fail_if(!(f->flags & PICO_FRAME_FLAG_POOL_BUF));
+    fail_if(pico_frame_pool_stats(1, &st1) != 0);
+    fail_if(st1.in_use != 1);
+    pico_frame_discard(f);
+    fail_if(pico_frame_pool_stats(1, &st) != 0);
+    fail_if(st.free != 1 || st.in_use != 0);
+    f = pico_frame_alloc(64);
+    fail_if(!f);
+    fail_if(pico_frame_pool_stats(1, &st1) != 0);
+    fail_if(st1.hits != st.hits + 1);
+    pico_frame_discard(f);
+#endif
+}
+END_TEST
+#endif
+
+START_TEST(tc_pico_checksum_kernels)
+{
+    static uint8_t buf[4096 + 64];
+    uint32_t i, k, off, len, seed = 0x1234;
+    uint32_t sum, ref;
+    uint16_t csum;
+
+    for (i = 0; i < sizeof(buf); i++) {
+        seed = seed * 1103515245u + 12345u;
+        buf[i] = (uint8_t)(seed >> 16);
+    }
+
+    for (k = 0; k < PICO_CHECKSUM_KERNELS; k++) {
+        const struct pico_checksum_kernel *kern = &pico_checksum_kernels[k];
+        if (!pico_checksum_kernel_usable(kern)) {
+            printf("Checksum kernel %s not supported here\n", kern->name);
+            continue;
+        }
+
+        printf("Checking checksum kernel %s\n", kern->name);
+        /* Every short length at every alignment, then random ones */
+        for (i = 0; i < 2000; i++) {
+            if (i < 64 * 16) {
+                off = i % 16;
+                len = i / 16;
+            } else {
+                seed = seed * 1103515245u + 12345u;
+                off = (seed >> 8) % 64;
+                seed = seed * 1103515245u + 12345u;
+                len = (seed >> 8) % 4097;
+            }
+
+            sum = (i & 1) ? (seed & 0xFFFFu) : 0;
+            ref = pico_checksum_adder(sum, buf + off, len);
+            fail_if(pico_checksum_finalize(kern->adder(sum, buf + off, len)) != pico_checksum_finalize(ref),
+                    "kernel %s: len %u, offset %u", kern->name, len, off);
+        }
+
+        /* All ones must not collapse into zero */
+        memset(buf, 0xFF, 256);
+        fail_if(pico_checksum_finalize(kern->adder(0, buf, 256)) != pico_checksum_finalize(pico_checksum_adder(0, buf, 256)));
+        memset(buf, 0, 256);
+        fail_if(pico_checksum_finalize(kern->adder(0, buf, 256)) != pico_checksum_finalize(pico_checksum_adder(0, buf, 256)));
+    }
+
+    /* The selected kernel is used by the public functions */
+    csum = pico_checksum(buf + 1, 1001);
+    pico_checksum_init();
+    fail_if(pico_checksum(buf + 1, 1001) != csum);
+    fail_if(pico_dualbuffer_checksum(buf, 20, buf + 20, 1001) != pico_checksum(buf, 1021));
+}
+END_TEST
+
+START_TEST(tc_pico_frame_dualbuffer_checksum)
+{
+    uint8_t pseudo[12], data[1031];
+    uint8_t lin[sizeof(pseudo) + sizeof(data)];
+    struct pico_frame *f, *s1, *s2;
+    uint32_t i, head;
+
+    for (i = 0; i < sizeof(pseudo); i++)
+        pseudo[i] = (uint8_t)(0xa0 + i);
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = (uint8_t)(i * 13 + 7);
+    memcpy(lin, pseudo, sizeof(pseudo));
+    memcpy(lin + sizeof(pseudo), data, sizeof(data));
+
+    /* Head of 'head' bytes, then two external segments of odd length */
+    for (head = 19; head <= 21; head++) {
+        f = pico_frame_alloc(head);
+        s1 = pico_frame_alloc_skeleton(333, 1);
+        s2 = pico_frame_alloc_skeleton((uint32_t)(sizeof(data) - head - 333), 1);
+        fail_if(!f || !s1 || !s2);
+        memcpy(f->buffer, data, head);
+        pico_frame_skeleton_set_buffer(s1, data + head);
+        pico_frame_skeleton_set_buffer(s2, data + head + 333);
+        f->chain = s1;
+        s1->chain = s2;
+        fail_if(pico_frame_dualbuffer_checksum(pseudo, sizeof(pseudo), f, f->buffer, sizeof(data)) !=
+                pico_checksum(lin, sizeof(lin)), "head %u", head);
+        pico_frame_discard(f);
+    }
+
+    /* Without a chain it is the plain dual buffer checksum */
+    f = pico_frame_alloc(sizeof(data));
+    fail_if(!f);
+    memcpy(f->buffer, data, sizeof(data));
+    fail_if(pico_frame_dualbuffer_checksum(pseudo, sizeof(pseudo), f, f->buffer, sizeof(data)) != pico_checksum(lin, sizeof(lin)));
+    pico_frame_discard(f);
+}
+END_TEST
+
+START_TEST(tc_pico_checksum_adjust)
+{
+    uint8_t hdr[20];
+    uint32_t i, seed = 0x4321;
+    uint32_t old32, new32;
+    uint16_t old16, new16, crc;
+
+    for (i = 0; i < 5000; i++) {
+        uint32_t j;
+        for (j = 0; j < sizeof(hdr); j++) {
+            seed = seed * 1103515245u + 12345u;
+            hdr[j] = (uint8_t)(seed >> 16);
+        }
+        /* Include the corner cases of all-zero and all-ones fields */
+        if (i % 7 == 0)
+            memset(hdr + 12, (i & 8) ? 0xFF : 0, 8);
+
+        hdr[10] = hdr[11] = 0;
+        crc = short_be(pico_checksum(hdr, sizeof(hdr)));
+        memcpy(hdr + 10, &crc, sizeof(crc));
+
+        /* 16 bit field (e.g. ttl/proto, port) */
+        memcpy(&old16, hdr + 8, sizeof(old16));
+        seed = seed * 1103515245u + 12345u;
+        new16 = (i % 5 == 0) ? (uint16_t)~old16 : (uint16_t)(seed >> 8);
+        memcpy(hdr + 8, &new16, sizeof(new16));
+        crc = pico_checksum_adjust16(crc, old16, new16);
+        memcpy(hdr + 10, &crc, sizeof(crc));
+        fail_if(pico_checksum(hdr, sizeof(hdr)) != 0, "adjust16: %04x -> %04x", old16, new16);
+
+        /* 32 bit field (e.g. address) */
+        memcpy(&old32, hdr + 12, sizeof(old32));
+        seed = seed * 1103515245u + 12345u;
+        new32 = (i % 3 == 0) ? ~old32 : seed;
+        memcpy(hdr + 12, &new32, sizeof(new32));
+        crc = pico_checksum_adjust32(crc, old32, new32);
+        memcpy(hdr + 10, &crc, sizeof(crc));
+        fail_if(pico_checksum(hdr, sizeof(hdr)) != 0, "adjust32: %08x -> %08x", old32, new32);
+    }
+}
+END_TEST
+
 START_TEST(tc_pico_is_digit)
 {
     fail_if(pico_is_digit('a'));
@@ -245,8 +645,16 @@ Suite *pico_suite(void)
     TCase *TCase_pico_frame_grow = tcase_create("Unit test for pico_frame_grow");
     TCase *TCase_pico_frame_grow_head = tcase_create("Unit test for pico_frame_grow_head");
     TCase *TCase_pico_frame_deepcopy = tcase_create("Unit test for pico_frame_deepcopy");
+    TCase *TCase_pico_frame_chain = tcase_create("Unit test for scatter-gather frames");
+    TCase *TCase_pico_frame_payload_ref = tcase_create("Unit test for pico_frame_payload_ref");
     TCase *TCase_pico_is_digit = tcase_create("Unit test for pico_is_digit");
     TCase *TCase_pico_is_hex = tcase_create("Unit test for pico_is_hex");
+    TCase *TCase_pico_checksum_kernels = tcase_create("Unit test for the checksum kernels");
+    TCase *TCase_pico_checksum_adjust = tcase_create("Unit test for pico_checksum_adjust");
+    TCase *TCase_pico_frame_dualbuffer_checksum = tcase_create("Unit test for pico_frame_dualbuffer_checksum");
+#ifdef PICO_SUPPORT_FRAME_POOL
+    TCase *TCase_pico_frame_pool = tcase_create("Unit test for the frame pool");
+#endif
     tcase_add_test(TCase_pico_frame_alloc_discard, tc_pico_frame_alloc_discard);
     tcase_add_test(TCase_pico_frame_copy, tc_pico_frame_copy);
     tcase_add_test(TCase_pico_frame_grow, tc_pico_frame_grow);
@@ -259,6 +667,20 @@ Suite *pico_suite(void)
     suite_add_tcase(s, TCase_pico_frame_grow);
     suite_add_tcase(s, TCase_pico_frame_grow_head);
     suite_add_tcase(s, TCase_pico_frame_deepcopy);
+    tcase_add_test(TCase_pico_frame_chain, tc_pico_frame_chain);
+    suite_add_tcase(s, TCase_pico_frame_chain);
+    tcase_add_test(TCase_pico_frame_payload_ref, tc_pico_frame_payload_ref);
+    suite_add_tcase(s, TCase_pico_frame_payload_ref);
+    tcase_add_test(TCase_pico_checksum_kernels, tc_pico_checksum_kernels);
+    suite_add_tcase(s, TCase_pico_checksum_kernels);
+    tcase_add_test(TCase_pico_checksum_adjust, tc_pico_checksum_adjust);
+    suite_add_tcase(s, TCase_pico_checksum_adjust);
+    tcase_add_test(TCase_pico_frame_dualbuffer_checksum, tc_pico_frame_dualbuffer_checksum);
+    suite_add_tcase(s, TCase_pico_frame_dualbuffer_checksum);
+#ifdef PICO_SUPPORT_FRAME_POOL
+    tcase_add_test(TCase_pico_frame_pool, tc_pico_frame_pool);
+    suite_add_tcase(s, TCase_pico_frame_pool);
+#endif
     return s;
 }
 
@@ -24,7 +24,7 @@ void pico_frame_discard(struct pico_frame *f)
     (void)f;
 }
 
-volatile pico_err_t pico_err;
+PICO_TLS volatile pico_err_t pico_err;
 
 
 
@@ -5,7 +5,7 @@
 
 Suite *pico_suite(void);
 
-volatile pico_err_t pico_err = 0;
+PICO_TLS volatile pico_err_t pico_err = 0;
 
 static int protocol_passby = 0;
 
@@ -132,6 +132,68 @@ START_TEST(tc_proto_loop)
 }
 END_TEST
 
+START_TEST(tc_pico_protocol_deliver)
+{
+    struct pico_queue qin = {
+        0
+    }, qout = {
+        0
+    };
+    struct pico_frame a = {
+        .buffer_len = 64
+    }, b = {
+        .buffer_len = 64
+    };
+    struct pico_protocol p = {
+        .process_in = modunit_proto_loop_cb_in,
+        .process_out = modunit_proto_loop_cb_out,
+        .q_in = &qin,
+        .q_out = &qout
+    };
+#ifdef PICO_SUPPORT_RUN_TO_COMPLETION
+    /* Empty queue: processed within the call */
+    protocol_passby = 0;
+    fail_if(pico_protocol_deliver_in(&p, &a) <= 0);
+    fail_if(protocol_passby != KEY_IN);
+    fail_if(qin.frames != 0);
+    protocol_passby = 0;
+    fail_if(pico_protocol_deliver_out(&p, &a) <= 0);
+    fail_if(protocol_passby != KEY_OUT);
+    fail_if(qout.frames != 0);
+
+    /* Frames already waiting keep their order */
+    pico_enqueue(&qin, &a);
+    protocol_passby = 0;
+    fail_if(pico_protocol_deliver_in(&p, &b) <= 0);
+    fail_if(protocol_passby != 0);
+    fail_if(qin.frames != 2);
+    fail_if(pico_dequeue(&qin) != &a);
+    fail_if(pico_dequeue(&qin) != &b);
+
+    /* Too deep: deferred to the queue */
+    proto_rtc_depth = PICO_RUN_TO_COMPLETION_DEPTH;
+    fail_if(pico_protocol_deliver_out(&p, &a) <= 0);
+    fail_if(protocol_passby != 0);
+    fail_if(qout.frames != 1);
+    proto_rtc_depth = 0;
+    fail_if(proto_loop_out(&p, 1) != 0);
+    fail_if(protocol_passby != KEY_OUT);
+#else
+    protocol_passby = 0;
+    fail_if(pico_protocol_deliver_in(&p, &a) <= 0);
+    fail_if(pico_protocol_deliver_out(&p, &b) <= 0);
+    fail_if(protocol_passby != 0);
+    fail_if(qin.frames != 1);
+    fail_if(qout.frames != 1);
+    fail_if(proto_loop_in(&p, 1) != 0);
+    fail_if(protocol_passby != KEY_IN);
+    protocol_passby = 0;
+    fail_if(proto_loop_out(&p, 1) != 0);
+    fail_if(protocol_passby != KEY_OUT);
+#endif
+}
+END_TEST
+
 START_TEST(tc_pico_tree_node)
 {
     struct pico_proto_rr rr = {
@@ -192,6 +254,7 @@ Suite *pico_suite(void)
     TCase *TCase_proto_loop_in = tcase_create("Unit test for proto_loop_in");
     TCase *TCase_proto_loop_out = tcase_create("Unit test for proto_loop_out");
     TCase *TCase_proto_loop = tcase_create("Unit test for proto_loop");
+    TCase *TCase_pico_protocol_deliver = tcase_create("Unit test for pico_protocol_deliver");
     TCase *TCase_pico_tree_node = tcase_create("Unit test for pico_tree_node");
     TCase *TCase_roundrobin_end = tcase_create("Unit test for roundrobin_end");
     TCase *TCase_pico_protocol_generic_loop = tcase_create("Unit test for pico_protocol_generic_loop");
@@ -206,6 +269,8 @@ Suite *pico_suite(void)
     suite_add_tcase(s, TCase_proto_loop_out);
     tcase_add_test(TCase_proto_loop, tc_proto_loop);
     suite_add_tcase(s, TCase_proto_loop);
+    tcase_add_test(TCase_pico_protocol_deliver, tc_pico_protocol_deliver);
+    suite_add_tcase(s, TCase_pico_protocol_deliver);
     tcase_add_test(TCase_pico_tree_node, tc_pico_tree_node);
     suite_add_tcase(s, TCase_pico_tree_node);
     tcase_add_test(TCase_roundrobin_end, tc_roundrobin_end);
@@ -3,8 +3,8 @@
 #include "check.h"
 #include "pico_socket.h"
 /* Mocking functions, variables, ... */
-volatile pico_time pico_tick = 0ull;
-volatile pico_err_t pico_err = 0;
+PICO_TLS volatile pico_time pico_tick = 0ull;
+PICO_TLS volatile pico_err_t pico_err = 0;
 
 Suite *pico_suite(void);
 void cb_synced(pico_err_t status);
@@ -68,12 +68,10 @@ START_TEST(tc_calc_score)
 }
 END_TEST
 
-#ifdef PICO_FAULTY
 void fake_timer(pico_time __attribute__((unused)) now, void __attribute__((unused)) *n)
 {
 
 }
-#endif
 
 START_TEST(tc_stack_generic)
 {
@@ -93,6 +91,254 @@ START_TEST(tc_stack_generic)
 }
 END_TEST
 
+static int fake_poll(struct pico_device __attribute__((unused)) *dev, int loop_score)
+{
+    return loop_score;
+}
+
+static int fake_wait_fd(struct pico_device __attribute__((unused)) *dev)
+{
+    return 0;
+}
+
+START_TEST(tc_stack_next_deadline)
+{
+    struct pico_device dev = {
+        0
+    };
+    struct pico_queue q_in = {
+        0
+    }, q_out = {
+        0
+    };
+    pico_time now;
+    uint32_t id_short, id_mid;
+
+#ifdef PICO_SUPPORT_TIMER_WHEEL
+    Timers = pico_timer_wheel_init();
+#else
+    Timers = heap_init();
+#endif
+    fail_if(!Timers);
+
+    /* Nothing to do at all */
+    fail_if(pico_stack_next_deadline() != PICO_TIME_NEVER);
+
+    now = PICO_TIME_MS();
+    id_mid = pico_timer_add(1000, fake_timer, NULL);
+    fail_if(pico_stack_next_deadline() < now + 1001);
+    fail_if(pico_stack_next_deadline() > PICO_TIME_MS() + 1001);
+
+    now = PICO_TIME_MS();
+    id_short = pico_timer_add(50, fake_timer, NULL);
+    fail_if(pico_stack_next_deadline() < now + 51);
+    fail_if(pico_stack_next_deadline() > PICO_TIME_MS() + 51);
+
+    /* Far timers sit in the upper levels of the wheel */
+    now = PICO_TIME_MS();
+    pico_timer_add(100000, fake_timer, NULL);
+    pico_timer_cancel(id_short);
+    pico_timer_cancel(id_mid);
+#ifdef PICO_SUPPORT_TIMER_WHEEL
+    fail_if(pico_stack_next_deadline() < now + 100001);
+#endif
+    fail_if(pico_stack_next_deadline() > PICO_TIME_MS() + 100001);
+
+    /* A device that can only be polled keeps the stack busy */
+    dev.hash = 0x1234;
+    dev.q_in = &q_in;
+    dev.q_out = &q_out;
+    dev.poll = fake_poll;
+    pico_tree_insert(&Device_tree, &dev);
+    now = PICO_TIME_MS();
+    fail_if(pico_stack_next_deadline() > PICO_TIME_MS());
+    fail_if(pico_stack_next_deadline() < now);
+
+    /* ...unless it can be waited on */
+    dev.wait_fd = fake_wait_fd;
+    fail_if(pico_stack_next_deadline() <= PICO_TIME_MS());
+
+    /* ...and has nothing queued */
+    q_out.frames = 1;
+    fail_if(pico_stack_next_deadline() > PICO_TIME_MS());
+    q_out.frames = 0;
+    pico_tree_delete(&Device_tree, &dev);
+}
+END_TEST
+
+static int batch_tx_budget, batch_tx_calls, batch_rx_left;
+
+static int fake_send_batch(struct pico_device __attribute__((unused)) *dev, struct pico_frame **f, int count)
+{
+    int i;
+    batch_tx_calls++;
+    for (i = 0; (i < count) && (batch_tx_budget > 0); i++) {
+        fail_if(!f[i]);
+        batch_tx_budget--;
+    }
+    return i;
+}
+
+static int fake_poll_batch(struct pico_device __attribute__((unused)) *dev, struct pico_iovec *pkt, int count)
+{
+    int n;
+    fail_if(count > PICO_DEVICE_BATCH);
+    for (n = 0; (n < count) && (batch_rx_left > 0); n++, batch_rx_left--) {
+        fail_if(pkt[n].len < PICO_DEVICE_BATCH_BUFSIZE);
+        memset(pkt[n].base, 0x55, 60);
+        pkt[n].len = 60;
+    }
+    return n;
+}
+
+START_TEST(tc_device_batch)
+{
+    struct pico_device *dev = PICO_ZALLOC(sizeof(struct pico_device));
+    struct pico_frame *f;
+    int i;
+
+    pico_stack_init();
+    fail_if(!dev);
+    fail_if(pico_device_init(dev, "batch", NULL) != 0);
+    dev->send_batch = fake_send_batch;
+    dev->poll_batch = fake_poll_batch;
+
+    /* TX: frames go out in batches, and stay queued while the device is busy */
+    for (i = 0; i < 20; i++) {
+        f = pico_frame_alloc(60);
+        fail_if(!f);
+        f->dev = dev;
+        fail_if(pico_enqueue(dev->q_out, f) <= 0);
+    }
+    batch_tx_budget = 18;
+    pico_devices_loop(64, PICO_LOOP_DIR_OUT);
+    fail_if(batch_tx_calls != 2);
+    fail_if(dev->q_out->frames != 2);
+    batch_tx_budget = 100;
+    pico_devices_loop(64, PICO_LOOP_DIR_OUT);
+    fail_if(dev->q_out->frames != 0);
+
+    /* RX: polling stops when the loop score is used up */
+    batch_rx_left = 40;
+    fail_if(pico_devices_loop(34, PICO_LOOP_DIR_IN) != 0);
+    fail_if(batch_rx_left != 6);
+    fail_if(dev->q_in->frames != 34);
+    f = pico_queue_peek(dev->q_in);
+    fail_if(f->len != 60);
+    fail_if(f->buffer[59] != 0x55);
+    fail_if(f->dev != dev);
+
+    pico_device_destroy(dev);
+}
+END_TEST
+
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+START_TEST(tc_stack_recv_ring)
+{
+    struct pico_device *dev = PICO_ZALLOC(sizeof(struct pico_device));
+    uint8_t pkt[101];
+    int i;
+
+    pico_stack_init();
+    fail_if(!dev);
+    fail_if(pico_device_init(dev, "ring", NULL) != 0);
+    memset(pkt, 0x55, sizeof(pkt));
+
+    /* Not set up yet */
+    fail_if(pico_stack_recv_ring(dev, pkt, 60) >= 0);
+    fail_if(pico_device_rx_ring_init(dev, 4, 0) == 0);
+    fail_if(pico_device_rx_ring_init(dev, 4, 100) != 0);
+    fail_if(pico_device_rx_ring_init(dev, 4, 100) == 0);
+    fail_if(!dev->q_in->ring);
+    fail_if(dev->q_rx_free->frames != 4);
+
+    /* Packets fill the ready frames, until there are no more */
+    fail_if(pico_stack_recv_ring(dev, pkt, 101) >= 0);
+    for (i = 0; i < 4; i++)
+        fail_if(pico_stack_recv_ring(dev, pkt, 60) <= 0);
+    fail_if(pico_stack_recv_ring(dev, pkt, 60) >= 0);
+    fail_if(dev->q_in->frames != 4);
+    fail_if(dev->q_rx_free->frames != 0);
+    fail_if(pico_queue_peek(dev->q_in)->len != 60);
+    fail_if(pico_queue_peek(dev->q_in)->buffer[59] != 0x55);
+    fail_if(pico_queue_peek(dev->q_in)->dev != dev);
+
+    /* The stack takes them and refills */
+    pico_devices_loop(64, PICO_LOOP_DIR_IN);
+    fail_if(dev->q_in->frames != 0);
+    pico_devices_loop(64, PICO_LOOP_DIR_IN);
+    fail_if(dev->q_rx_free->frames != 4);
+
+    /* A frame q_in has no room for waits for the next packet */
+    dev->q_in->max_frames = 1;
+    fail_if(pico_stack_recv_ring(dev, pkt, 60) <= 0);
+    fail_if(pico_stack_recv_ring(dev, pkt, 60) >= 0);
+    fail_if(!dev->rx_spare);
+    fail_if(dev->q_rx_free->frames != 2);
+    dev->q_in->max_frames = 0;
+    fail_if(pico_stack_recv_ring(dev, pkt, 60) <= 0);
+    fail_if(dev->rx_spare);
+    fail_if(dev->q_rx_free->frames != 2);
+    fail_if(dev->q_in->frames != 2);
+
+    pico_device_destroy(dev);
+}
+END_TEST
+#endif
+
+#ifdef PICO_SUPPORT_MULTI_INSTANCE
+#include <pthread.h>
+
+struct shard_result {
+    int own_dev;
+    int other_dev;
+    pico_err_t err;
+};
+
+static void *shard_thread(void *arg)
+{
+    struct shard_result *res = (struct shard_result *)arg;
+    struct pico_device *dev = PICO_ZALLOC(sizeof(struct pico_device));
+
+    pico_stack_init();
+    if (!dev || pico_device_init(dev, "shard1", NULL) != 0)
+        return NULL;
+
+    pico_err = PICO_ERR_EINVAL;
+    pico_stack_tick();
+    res->own_dev = (pico_get_device("shard1") == dev);
+    res->other_dev = (pico_get_device("shard0") != NULL);
+    res->err = pico_err;
+    pico_device_destroy(dev);
+    return res;
+}
+
+START_TEST(tc_multi_instance)
+{
+    struct pico_device *dev = PICO_ZALLOC(sizeof(struct pico_device));
+    struct shard_result res = { 0 };
+    pthread_t th;
+    void *ret = NULL;
+
+    pico_stack_init();
+    fail_if(!dev);
+    fail_if(pico_device_init(dev, "shard0", NULL) != 0);
+    pico_err = PICO_ERR_NOERR;
+
+    /* A second thread drives its own stack: no state leaks either way */
+    fail_if(pthread_create(&th, NULL, shard_thread, &res) != 0);
+    fail_if(pthread_join(th, &ret) != 0);
+    fail_if(ret != &res);
+    fail_unless(res.own_dev);
+    fail_if(res.other_dev);
+    fail_if(res.err != PICO_ERR_EINVAL);
+    fail_if(pico_err != PICO_ERR_NOERR);
+    fail_if(pico_get_device("shard1") != NULL);
+    fail_if(pico_get_device("shard0") != dev);
+    pico_device_destroy(dev);
+}
+END_TEST
+#endif
 
 Suite *pico_suite(void)
 {
@@ -108,6 +354,14 @@ Suite *pico_suite(void)
     TCase *TCase_pico_ethsend_dispatch = tcase_create("Unit test for pico_ethsend_dispatch");
     TCase *TCase_calc_score = tcase_create("Unit test for calc_score");
     TCase *TCase_stack_generic = tcase_create("GENERIC stack initialization unit test");
+    TCase *TCase_stack_next_deadline = tcase_create("Unit test for pico_stack_next_deadline");
+    TCase *TCase_device_batch = tcase_create("Unit test for batched device callbacks");
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    TCase *TCase_stack_recv_ring = tcase_create("Unit test for lock-free driver receive");
+#endif
+#ifdef PICO_SUPPORT_MULTI_INSTANCE
+    TCase *TCase_multi_instance = tcase_create("Unit test for per-thread stack instances");
+#endif
 
 
     tcase_add_test(TCase_pico_ll_receive, tc_pico_ll_receive);
@@ -130,6 +384,18 @@ Suite *pico_suite(void)
     suite_add_tcase(s, TCase_calc_score);
     tcase_add_test(TCase_stack_generic, tc_stack_generic);
     suite_add_tcase(s, TCase_stack_generic);
+    tcase_add_test(TCase_stack_next_deadline, tc_stack_next_deadline);
+    suite_add_tcase(s, TCase_stack_next_deadline);
+    tcase_add_test(TCase_device_batch, tc_device_batch);
+    suite_add_tcase(s, TCase_device_batch);
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    tcase_add_test(TCase_stack_recv_ring, tc_stack_recv_ring);
+    suite_add_tcase(s, TCase_stack_recv_ring);
+#endif
+#ifdef PICO_SUPPORT_MULTI_INSTANCE
+    tcase_add_test(TCase_multi_instance, tc_multi_instance);
+    suite_add_tcase(s, TCase_multi_instance);
+#endif
     return s;
 }
 
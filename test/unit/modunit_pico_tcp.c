@@ -79,6 +79,193 @@ START_TEST(tc_tcp_input_segment)
 
 }
 END_TEST
+START_TEST(tc_tcp_read_zerocopy)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct pico_zerocopy_chunk c[4];
+    struct pico_frame *f[3];
+    struct tcp_input_segment *seg;
+    uint32_t seq[3] = {
+        1000, 1020, 1100
+    };
+    int i, en = 1;
+
+    fail_if(!t);
+    t->sock.proto = &pico_proto_tcp;
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_ZEROCOPY_RX, &en) != 0);
+    en = 0;
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_ZEROCOPY_RX, &en) != 0);
+    fail_if(en != 1);
+    t->tcpq_in.max_size = 1000;
+
+    /* Segments reference the received frame instead of copying it */
+    for (i = 0; i < 3; i++) {
+        f[i] = pico_frame_alloc(60);
+        fail_if(!f[i]);
+        f[i]->transport_hdr = f[i]->start;
+        f[i]->transport_len = 60;
+        f[i]->payload = f[i]->start + 40;
+        f[i]->payload_len = 20;
+        memset(f[i]->payload, 'a' + i, 20);
+        ((struct pico_tcp_hdr *)(f[i]->transport_hdr))->seq = long_be(seq[i]);
+        seg = segment_ref_frame(f[i]);
+        fail_if(!seg);
+        fail_if(seg->payload != f[i]->payload);
+        fail_if(seg->seq != seq[i]);
+        fail_if(*f[i]->usage_count != 2);
+        fail_if(pico_enqueue_segment(&t->tcpq_in, seg) <= 0);
+        /* The stack drops its own reference after delivery */
+        pico_frame_discard(f[i]);
+    }
+
+    /* In-order data up to the hole, starting mid-segment after a read */
+    t->rcv_processed = 1005;
+    fail_if(pico_tcp_read_zerocopy(&t->sock, c, 4) != 2);
+    fail_if(c[0].len != 15);
+    fail_if(c[0].data[0] != 'a');
+    fail_if(c[1].len != 20);
+    fail_if(c[1].data[19] != 'b');
+    fail_if(t->rcv_processed != 1040);
+    fail_if(t->tcpq_in.frames != 1);
+    fail_if(pico_tcp_read_zerocopy(&t->sock, c + 2, 2) != 0);
+
+    /* Chunks the application holds keep the window closed over them */
+    fail_if(t->tcpq_in.size != 20);
+    fail_if(t->rcv_held != 40);
+    fail_if(t->wnd != 940);
+
+    /* Chunks stay valid until released */
+    pico_socket_zerocopy_release(&c[0]);
+    fail_if(c[0].handle);
+    fail_if(t->rcv_held != 20);
+    fail_if(t->wnd != 960);
+    pico_socket_zerocopy_release(&c[0]);
+    fail_if(t->rcv_held != 20);
+    pico_socket_zerocopy_release(&c[1]);
+    fail_if(t->rcv_held != 0);
+    fail_if(t->rcv_held_list);
+    fail_if(t->wnd != 980);
+
+    /* Hole filled: the last segment comes out as one chunk */
+    t->rcv_processed = 1100;
+    fail_if(pico_tcp_read_zerocopy(&t->sock, c, 1) != 1);
+    fail_if(c[0].len != 20);
+    fail_if(t->tcpq_in.frames != 0);
+
+    /* A chunk may outlive its socket: pico_tcp_cleanup_queues() disowns it */
+    tcp_zerocopy_disown(t);
+    fail_if(t->rcv_held != 0);
+    fail_if(((struct tcp_input_segment *)c[0].handle)->owner);
+    pico_tcp_zerocopy_release(c[0].handle);
+
+    /* Chained frames are not contiguous and get copied */
+    f[0] = pico_frame_alloc(60);
+    f[1] = pico_frame_alloc(20);
+    fail_if(!f[0] || !f[1]);
+    f[0]->transport_hdr = f[0]->start;
+    f[0]->payload = f[0]->start + 40;
+    f[0]->payload_len = 20;
+    f[0]->chain = f[1];
+    seg = segment_ref_frame(f[0]);
+    fail_if(!seg);
+    fail_if(seg->frame);
+    segment_free(seg);
+    pico_frame_discard(f[0]);
+    PICO_FREE(t);
+}
+END_TEST
+
+static int tcp_zc_calls;
+static int tcp_zc_len;
+
+static void tcp_zc_done(const void *buf, int len, void *arg)
+{
+    IGNORE_PARAMETER(buf);
+    fail_if(arg != &tcp_zc_calls);
+    tcp_zc_calls++;
+    tcp_zc_len = len;
+}
+
+static int tcp_zc_dev_send(struct pico_device *dev, void *buf, int len)
+{
+    IGNORE_PARAMETER(dev);
+    IGNORE_PARAMETER(buf);
+    return len;
+}
+
+static struct pico_frame *tcp_test_segment(uint32_t seq, uint16_t len, uint8_t flags);
+
+START_TEST(tc_tcp_send_zerocopy)
+{
+    static uint8_t buf[2500];
+    struct pico_socket *s;
+    struct pico_socket_tcp *t;
+    struct pico_device *dev;
+    struct pico_ip4 local, dst, netmask;
+    struct pico_frame *f, *ack;
+    uint16_t port = short_be(5555);
+    uint32_t pos, off = 0, last = 0, packets = 0;
+    int nodelay = 1;
+
+    pico_stack_init();
+    local.addr = long_be(0x0a280002);
+    dst.addr = long_be(0x0a280003);
+    netmask.addr = long_be(0xFFFF0000);
+    dev = PICO_ZALLOC(sizeof(struct pico_device));
+    fail_if(!dev);
+    fail_if(pico_device_init(dev, "zc", NULL) != 0);
+    dev->send = tcp_zc_dev_send;
+    fail_if(pico_ipv4_link_add(dev, local, netmask) < 0);
+
+    s = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, NULL);
+    fail_if(!s);
+    fail_if(pico_socket_bind(s, &local, &port) < 0);
+    fail_if(pico_socket_setoption(s, PICO_TCP_NODELAY, &nodelay) < 0);
+    fail_if(pico_socket_connect(s, &dst, port) < 0);
+    t = TCP_SOCK(s);
+    s->state = (uint16_t)((s->state & 0x00FFU) | PICO_SOCKET_STATE_TCP_ESTABLISHED);
+    t->mss = 1000;
+
+    /* Split at the MSS, every segment referencing the application buffer */
+    fail_if(pico_socket_send_zerocopy(s, buf, (int)sizeof(buf), tcp_zc_done, &tcp_zc_calls) != (int)sizeof(buf));
+    tcp_ring_foreach(&t->tcpq_out, pos, f) {
+        fail_if((f->payload_len > t->mss) && (output_segment_packets(f) < 2));
+        packets += output_segment_packets(f);
+        fail_if(!f->chain || (f->chain->start != buf + off));
+        fail_if(f->chain->len != f->payload_len);
+        off += f->payload_len;
+        last = SEQN(f) + f->payload_len;
+    }
+    fail_if(off != sizeof(buf));
+    fail_if(packets != 3);
+    fail_if(tcp_zc_calls != 0);
+    fail_if(pico_socket_send_zerocopy(s, buf, 100, tcp_zc_done, &tcp_zc_calls) != -1);
+    fail_if(pico_err != PICO_ERR_EBUSY);
+
+    /* Acknowledged segments let go of the buffer; done once the last one is */
+    f = first_segment(&t->tcpq_out);
+    ack = tcp_test_segment(0, 0, PICO_TCP_ACK);
+    off = SEQN(f) + (uint32_t)(f->payload_len / output_segment_packets(f));
+    ((struct pico_tcp_hdr *)ack->transport_hdr)->ack = long_be(off);
+    tcp_ack(s, ack);
+    f = first_segment(&t->tcpq_out);
+    fail_if(!f || (SEQN(f) != off));
+    fail_if(tcp_zc_calls != 0);
+    ((struct pico_tcp_hdr *)ack->transport_hdr)->ack = long_be(last);
+    tcp_ack(s, ack);
+    fail_if(t->tcpq_out.frames != 0);
+    fail_if(tcp_zc_calls != 1);
+    fail_if(tcp_zc_len != (int)sizeof(buf));
+    pico_frame_discard(ack);
+
+    /* The buffer may be sent again */
+    fail_if(pico_socket_send_zerocopy(s, buf, 100, tcp_zc_done, &tcp_zc_calls) != 100);
+    fail_if(t->tcpq_out.frames != 1);
+    tcp_discard_all_segments(&t->tcpq_out);
+    fail_if(tcp_zc_calls != 2);
+    fail_if(tcp_zc_len != 100);
+}
+END_TEST
 START_TEST(tc_segment_compare)
 {
     /* TODO: test this: static int segment_compare(void *ka, void *kb) */
@@ -411,7 +598,32 @@ START_TEST(tc_tcp_send_ack)
 END_TEST
 START_TEST(tc_tcp_set_space)
 {
-    /* TODO: test this: static void tcp_set_space(struct pico_socket_tcp *t) */
+    /* static void tcp_set_space(struct pico_socket_tcp *t) */
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    fail_if(!t);
+
+    /* Windows above 64K are scaled, but never the one of a SYN */
+    t->tcpq_in.max_size = 1024u * 1024u;
+    tcp_set_space(t);
+    fail_if(t->wnd_scale == 0);
+    fail_if(((uint32_t)t->wnd << t->wnd_scale) > t->tcpq_in.max_size);
+    fail_if(tcp_syn_window(t) != 0xFFFF);
+    t->tcpq_in.max_size = 4096;
+    t->tcpq_in.size = 1000;
+    fail_if(tcp_syn_window(t) != 3096);
+    t->tcpq_in.size = 4096;
+    fail_if(tcp_syn_window(t) != 0);
+    t->tcpq_in.size = 0;
+
+    /* Once synchronized, a peer that did not offer scaling gets it unscaled */
+    t->sock.state = PICO_SOCKET_STATE_TCP_ESTABLISHED;
+    t->tcpq_in.max_size = 1024u * 1024u;
+    tcp_set_space(t);
+    fail_if(t->wnd_scale != 0 || t->wnd != 0xFFFF);
+    t->scale_ok = 1;
+    tcp_set_space(t);
+    fail_if(t->wnd_scale == 0);
+    PICO_FREE(t);
 }
 END_TEST
 START_TEST(tc_tcp_options_size)
@@ -419,11 +631,6 @@ START_TEST(tc_tcp_options_size)
     /* TODO: test this: static uint16_t tcp_options_size(struct pico_socket_tcp *t, uint16_t flags) */
 }
 END_TEST
-START_TEST(tc_tcp_process_sack)
-{
-    /* TODO: test this: static void tcp_process_sack(struct pico_socket_tcp *t, uint32_t start, uint32_t end) */
-}
-END_TEST
 START_TEST(tc_tcp_rcv_sack)
 {
     /* TODO: test this: static void tcp_rcv_sack(struct pico_socket_tcp *t, uint8_t *opt, int len) */
@@ -479,9 +686,54 @@ START_TEST(tc_tcp_sack_prepare)
     /* TODO: test this: static void tcp_sack_prepare(struct pico_socket_tcp *t) */
 }
 END_TEST
+static void tcp_test_data_insert(struct pico_socket_tcp *t, uint32_t seq, uint16_t len, uint32_t pos_out)
+{
+    struct pico_frame *f = tcp_test_segment(seq, len, PICO_TCP_ACK);
+    uint32_t pos = seq;
+
+    f->payload = f->transport_hdr + PICO_SIZE_TCPHDR;
+    f->payload_len = len;
+    fail_if(tcp_data_in_insert(t, f, &pos, 0) != 0);
+    fail_if(pos != pos_out);
+    pico_frame_discard(f);
+}
+
 START_TEST(tc_tcp_data_in)
 {
     /* TODO: test this: static int tcp_data_in(struct pico_socket *s, struct pico_frame *f) */
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct tcp_input_segment *seg;
+
+    fail_if(!t);
+    t->rcv_nxt = 1000;
+    tcp_test_data_insert(t, 1300, 100, 1400);
+    tcp_test_data_insert(t, 1100, 100, 1200);
+
+    /* The segment holding a sequence number, or else the next one */
+    fail_if(tcp_input_segment_from(t, 1000) != peek_segment(&t->tcpq_in, 1100));
+    fail_if(tcp_input_segment_from(t, 1150) != peek_segment(&t->tcpq_in, 1100));
+    fail_if(tcp_input_segment_from(t, 1200) != peek_segment(&t->tcpq_in, 1300));
+    fail_if(tcp_input_segment_from(t, 1399) != peek_segment(&t->tcpq_in, 1300));
+    fail_if(tcp_input_segment_from(t, 1400));
+    fail_if(tcp_input_queue_ends_by(t, 1000));
+    fail_if(!tcp_input_queue_ends_by(t, 1400));
+
+    /* Only the gaps of the in-order data are queued */
+    tcp_test_data_insert(t, 1000, 250, 1250);
+    fail_if(t->tcpq_in.frames != 4);
+    seg = peek_segment(&t->tcpq_in, 1200);
+    fail_if(!seg || (seg->payload_len != 50) || (seg->payload[0] != (uint8_t)1200));
+
+    /* Past everything queued: appended as it is */
+    t->rcv_nxt = 1400;
+    tcp_test_data_insert(t, 1400, 100, 1500);
+    fail_if(t->tcpq_in.frames != 5);
+    fail_if(t->tcpq_in.size != 450);
+    seg = peek_segment(&t->tcpq_in, 1400);
+    fail_if(!seg || (seg->payload_len != 100) || (seg->payload[99] != (uint8_t)1499));
+
+    tcp_discard_all_segments(&t->tcpq_in);
+    PICO_FREE(t);
 }
 END_TEST
 START_TEST(tc_tcp_ack_advance_una)
@@ -496,13 +748,813 @@ START_TEST(tc_time_diff)
 END_TEST
 START_TEST(tc_tcp_rtt)
 {
-    /* TODO: test this: static void tcp_rtt(struct pico_socket_tcp *t, uint32_t rtt) */
+    /* static void tcp_rtt(struct pico_socket_tcp *t, uint32_t rtt) */
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    int i;
 
+    fail_if(!t);
+    tcp_rtt(t, 200);
+    fail_if(t->avg_rtt != 200 || t->rttvar != 100 || t->rto != 600);
+
+    /* A steady RTT still leaves G of margin */
+    for (i = 0; i < 40; i++)
+        tcp_rtt(t, 200);
+    fail_if(t->avg_rtt != 200 || t->rttvar != 0);
+    fail_if(t->rto != 200 + PICO_TCP_RTO_G);
+
+    /* Above G, the variation takes over */
+    tcp_rtt(t, 600);
+    fail_if(t->rto != t->avg_rtt + (t->rttvar << 2));
+    fail_if(t->rto <= 200 + PICO_TCP_RTO_G);
+    PICO_FREE(t);
 }
 END_TEST
 START_TEST(tc_tcp_congestion_control)
 {
-    /* TODO: test this: static void tcp_congestion_control(struct pico_socket_tcp *t) */
+    /* static void tcp_congestion_control(struct pico_socket_tcp *t, uint32_t acked) */
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    uint32_t cwnd, ssthresh, counter = 0, segs, i;
+
+    fail_if(!t);
+    fail_if(t->cc.ops != &pico_tcp_cc_reno);
+    t->mss = 1000;
+    t->autotune = 0; /* slow start ends below a fixed send queue */
+    tcp_cc_init(t);
+    segs = PICO_DEFAULT_SOCKETQ / 1000;
+    fail_if(t->cwnd != PICO_TCP_IW);
+    fail_if(t->cc.cwnd != PICO_TCP_IW * 1000);
+    fail_if(t->cc.ssthresh != (segs - (segs >> 3)) * 1000);
+
+    /* Reno counts ACKs exactly like the segment-based code did */
+    cwnd = PICO_TCP_IW;
+    ssthresh = segs - (segs >> 3);
+    t->x_mode = PICO_TCP_LOOKAHEAD;
+    for (i = 0; i < 200; i++) {
+        if (cwnd < ssthresh) {
+            cwnd++;
+        } else if (++counter >= cwnd) {
+            cwnd++;
+            counter = 0;
+        }
+
+        tcp_congestion_control(t, 1);
+        fail_if(t->cwnd != cwnd);
+        fail_if(t->cc.cwnd != cwnd * 1000);
+    }
+
+    /* No growth outside of look-ahead */
+    t->x_mode = PICO_TCP_RECOVER;
+    tcp_congestion_control(t, 1);
+    fail_if(t->cwnd != cwnd);
+
+    /* Fast recovery: cwnd follows the flight size, ssthresh halves */
+    t->in_flight = 10;
+    t->cc.ssthresh = 8000;
+    t->cc.ops->on_loss(&t->cc, t->in_flight * t->cc.mss, 0);
+    tcp_cc_sync(t);
+    fail_if(t->cwnd != 10);
+    fail_if(t->cc.ssthresh != 5000);
+    t->in_flight = 1;
+    t->cc.ops->on_loss(&t->cc, t->in_flight * t->cc.mss, 0);
+    tcp_cc_sync(t);
+    fail_if(t->cwnd != PICO_TCP_IW);
+    fail_if(t->cc.ssthresh != 2000);
+
+    /* RTO: back to the initial window, ssthresh untouched */
+    tcp_cc_set_cwnd(t, 40);
+    tcp_first_timeout(t);
+    fail_if(t->cwnd != PICO_TCP_IW);
+    fail_if(t->cc.ssthresh != 2000);
+    fail_if(t->in_flight != 0);
+
+    /* A smaller peer MSS keeps the window size in segments */
+    tcp_cc_set_cwnd(t, 12);
+    t->mss = 500;
+    tcp_cc_mss_update(t);
+    fail_if(t->cwnd != 12);
+    fail_if(t->cc.cwnd != 6000);
+    fail_if(t->cc.ssthresh != 1000);
+
+    /* Byte state is wide enough for multi-megabyte windows */
+    tcp_cc_set_cwnd(t, 20000);
+    fail_if(t->cc.cwnd != 10000000);
+    fail_if(t->cwnd != 20000);
+    PICO_FREE(t);
+}
+END_TEST
+START_TEST(tc_tcp_cubic)
+{
+    struct pico_tcp_cc cc;
+    pico_time now;
+    uint32_t i, w_max = 100000, prev;
+
+    memset(&cc, 0, sizeof(cc));
+    cc.ops = &pico_tcp_cc_cubic;
+    cc.mss = 1000;
+    cc.cwnd = w_max;
+    cc.ssthresh = 0xFFFFFFFFu;
+    cc.ops->init(&cc);
+
+    /* Slow start with byte counting, at most two segments per ACK */
+    cc.cwnd = 10000;
+    cc.ops->on_ack(&cc, 1000, 1);
+    fail_if(cc.cwnd != 11000);
+    cc.ops->on_ack(&cc, 5000, 1);
+    fail_if(cc.cwnd != 13000);
+    cc.ops->on_ack(&cc, 0, 1);
+    fail_if(cc.cwnd != 13000);
+
+    /* Multiplicative decrease, beta = 0.7 */
+    cc.cwnd = w_max;
+    cc.ops->on_loss(&cc, w_max, 1000);
+    fail_if(cc.ops->get_cwnd(&cc) != 70000);
+    fail_if(cc.ops->get_ssthresh(&cc) != 70000);
+
+    /* Concave growth up to W_max at K = cbrt(30 / 0.4) s ~= 4217 ms, then
+     * convex probing beyond it: W(2K) = W_max + 30 segments. No RTT sample,
+     * so the TCP-friendly region stays out of the way. */
+    prev = cc.cwnd;
+    for (now = 1000; now <= 1000 + 2 * 4217; now += 10) {
+        for (i = 0; i < 50; i++)
+            cc.ops->on_ack(&cc, 1000, now);
+        fail_if(cc.cwnd < prev);
+        prev = cc.cwnd;
+        if (now == 1000 + 2000)
+            fail_if((cc.cwnd < 94000) || (cc.cwnd > 97000));
+
+        if (now == 1000 + 4210)
+            fail_if((cc.cwnd < 98000) || (cc.cwnd > 100500));
+    }
+    fail_if((cc.cwnd < 128000) || (cc.cwnd > 131000));
+
+    /* Fast convergence: a loss below the previous W_max lowers the plateau */
+    cc.cwnd = 90000;
+    cc.ops->on_loss(&cc, 90000, now);
+    fail_if(cc.cwnd != 63000);
+    cc.ops->on_loss(&cc, 63000, now);
+    fail_if(cc.cwnd != 44100);
+
+    /* With an RTT sample the window grows at least as fast as Reno's */
+    cc.cwnd = 20000;
+    cc.ssthresh = 20000;
+    cc.srtt = 100;
+    cc.ops->init(&cc);
+    for (now = 100000; now < 100000 + 1000; now += 100) {
+        for (i = 0; i < cc.cwnd / cc.mss; i++)
+            cc.ops->on_ack(&cc, 1000, now);
+    }
+    fail_if(cc.cwnd < 24000);
+
+    /* RTO: ssthresh = 0.7 * cwnd, back to the initial window */
+    cc.cwnd = 50000;
+    cc.ops->on_rto(&cc, 50000, now);
+    fail_if(cc.cwnd != PICO_TCP_IW * 1000);
+    fail_if(cc.ssthresh != 35000);
+}
+END_TEST
+START_TEST(tc_tcp_pacing)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct pico_tcp_pacing_stats st;
+    uint32_t timers;
+    int en = -1;
+
+    fail_if(!t);
+    t->sock.proto = &pico_proto_tcp;
+    t->mss = 1000;
+    tcp_cc_init(t);
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_PACING, &en) != 0);
+    fail_if(en != 0);
+
+    /* Disabled, or no RTT sample yet: never held back */
+    t->avg_rtt = 100;
+    fail_if(tcp_pacing_hold(t, 1000, 5000) != 0);
+    en = 1;
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_PACING, &en) != 0);
+    t->avg_rtt = 0;
+    fail_if(tcp_pacing_hold(t, 1000, 5000) != 0);
+
+    /* 100 kB window over 100 ms in congestion avoidance: 1.2 MB/s, and the
+     * first slot may carry two segments */
+    t->avg_rtt = 100;
+    t->cc.cwnd = 100000;
+    t->cc.ssthresh = 50000;
+    fail_if(tcp_pacing_rate(t) != 1200000);
+    timers = timers_added;
+    fail_if(tcp_pacing_hold(t, 1000, 5000) != 0);
+    tcp_pacing_sent(t, 1000);
+    fail_if(tcp_pacing_hold(t, 1000, 5000) != 0);
+    tcp_pacing_sent(t, 1000);
+    fail_if(tcp_pacing_hold(t, 1000, 5000) != 1);
+    fail_if(timers_added != timers + 1);
+    fail_if(!t->pacing_tmr);
+
+    /* Still waiting: one timer only */
+    fail_if(tcp_pacing_hold(t, 1000, 5000) != 1);
+    fail_if(timers_added != timers + 1);
+
+    /* One millisecond later 1200 bytes have been earned */
+    t->pacing_tmr = 0;
+    fail_if(tcp_pacing_hold(t, 1000, 5001) != 0);
+    tcp_pacing_sent(t, 1000);
+    fail_if(t->pacing_tokens != 200);
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_PACING_STATS, &st) != 0);
+    fail_if(st.rate != 1200000);
+    fail_if(st.holds != 1);
+    fail_if(st.delay != 1);
+
+    /* Slow start paces at twice the window rate */
+    t->cc.ssthresh = 200000;
+    fail_if(tcp_pacing_rate(t) != 2000000);
+
+    en = 0;
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_PACING, &en) != 0);
+    fail_if(tcp_pacing_hold(t, 1000, 5001) != 0);
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_PACING_STATS, &st) != 0);
+    fail_if(st.rate != 0);
+    PICO_FREE(t);
+}
+END_TEST
+
+START_TEST(tc_tcp_info)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct pico_frame *f = pico_frame_alloc(PICO_SIZE_TCPHDR + 100);
+    struct pico_tcp_info info;
+
+    fail_if(!t || !f);
+    t->sock.proto = &pico_proto_tcp;
+    t->sock.state = PICO_SOCKET_STATE_TCP_ESTABLISHED;
+    t->mss = 1000;
+    tcp_cc_init(t);
+    t->avg_rtt = 40;
+    t->rto = 240;
+    t->in_flight = 3;
+    t->recv_wnd = 100;
+    t->recv_wnd_scale = 4;
+
+    /* A zero window advertised twice is a single event */
+    t->wnd = 1000;
+    tcp_set_space_check_winupdate(t, 0, 0);
+    tcp_set_space_check_winupdate(t, 0, 1);
+    f->payload_len = 100;
+    tcp_info_received(t, f);
+    t->retrans = 2;
+    t->fast_retrans = 1;
+    t->rto_events = 1;
+
+    /* 50 ms waiting for the congestion window, then for the peer */
+    t->limited = TCP_LIMITED_CWND;
+    t->limited_since = TCP_TIME - 50;
+    tcp_limited(t, TCP_LIMITED_RWND);
+    tcp_limited(t, TCP_LIMITED_RWND);
+    fail_if(t->cwnd_limited < 50);
+    fail_if(t->limited != TCP_LIMITED_RWND);
+    t->limited_since -= 20;
+
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_INFO, &info) != 0);
+    fail_if(info.version != PICO_TCP_INFO_VERSION);
+    fail_if(info.state != (PICO_SOCKET_STATE_TCP_ESTABLISHED >> 8));
+    fail_if(info.rtt != 40 || info.rto != 240 || info.mss != 1000);
+    fail_if(info.cwnd != t->cc.cwnd || info.in_flight != 3);
+    fail_if(info.snd_wnd != 1600);
+    fail_if(info.zero_wnd_local != 1);
+    fail_if(info.segs_in != 1 || info.bytes_in != 100);
+    fail_if(info.retrans != 2 || info.fast_retrans != 1 || info.rto_events != 1);
+    fail_if(info.cwnd_limited != t->cwnd_limited);
+    fail_if(info.rwnd_limited < 20);
+
+    /* Output no longer waits: the time stops */
+    tcp_limited(t, TCP_LIMITED_NONE);
+    fail_if(t->rwnd_limited < 20);
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_INFO, &info) != 0);
+    fail_if(info.rwnd_limited != t->rwnd_limited);
+    pico_frame_discard(f);
+    PICO_FREE(t);
+}
+END_TEST
+#ifdef PICO_SUPPORT_TCP_GSO
+START_TEST(tc_tcp_gso_segment)
+{
+    struct pico_frame *f, *pkt, *next;
+    struct pico_ipv4_hdr *ip;
+    struct pico_tcp_hdr *hdr;
+    uint32_t i, off = 0;
+    int n = 0;
+
+    /* 3000 bytes of payload cut in packets of at most 1400 */
+    f = pico_frame_alloc(PICO_SIZE_IP4HDR + PICO_SIZE_TCPHDR + 3000);
+    fail_if(!f);
+    memset(f->buffer, 0, PICO_SIZE_IP4HDR + PICO_SIZE_TCPHDR);
+    f->net_hdr = f->buffer;
+    f->net_len = PICO_SIZE_IP4HDR;
+    f->transport_hdr = f->net_hdr + PICO_SIZE_IP4HDR;
+    f->transport_len = PICO_SIZE_TCPHDR + 3000;
+    f->payload = f->transport_hdr + PICO_SIZE_TCPHDR;
+    f->payload_len = 3000;
+    f->gso_size = 1400;
+    for (i = 0; i < 3000; i++)
+        f->payload[i] = (uint8_t)i;
+    ip = (struct pico_ipv4_hdr *)f->net_hdr;
+    ip->vhl = 0x45;
+    ip->id = short_be(7);
+    ip->proto = PICO_PROTO_TCP;
+    ip->src.addr = long_be(0x0a000001);
+    ip->dst.addr = long_be(0x0a000002);
+    hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    hdr->len = (uint8_t)(PICO_SIZE_TCPHDR << 2);
+    hdr->seq = long_be(1000);
+    hdr->flags = PICO_TCP_ACK | PICO_TCP_PSH;
+
+    pkt = pico_tcp_gso_segment(f);
+    fail_if(!pkt);
+    while (pkt) {
+        next = pkt->next;
+        ip = (struct pico_ipv4_hdr *)pkt->net_hdr;
+        hdr = (struct pico_tcp_hdr *)pkt->transport_hdr;
+        fail_if(pkt->payload_len != ((n < 2) ? 1400 : 200));
+        fail_if(pkt->len != PICO_SIZE_IP4HDR + PICO_SIZE_TCPHDR);
+        fail_if(!pkt->chain || pkt->chain->buffer != f->buffer);
+        fail_if(pkt->chain->start[0] != (uint8_t)off);
+        fail_if(short_be(ip->len) != PICO_SIZE_IP4HDR + PICO_SIZE_TCPHDR + pkt->payload_len);
+        fail_if(short_be(ip->id) != 7 + n);
+        fail_if(pico_checksum(ip, PICO_SIZE_IP4HDR) != 0);
+        fail_if(long_be(hdr->seq) != 1000 + off);
+        fail_if(((hdr->flags & PICO_TCP_PSH) != 0) != (next == NULL));
+        fail_if(pico_tcp_checksum(pkt) != 0);
+        off += pkt->payload_len;
+        pico_frame_discard(pkt);
+        pkt = next;
+        n++;
+    }
+    fail_if(n != 3);
+    fail_if(off != 3000);
+    fail_if(*f->usage_count != 1);
+    pico_frame_discard(f);
+}
+END_TEST
+#endif
+static struct pico_frame *tcp_test_segment(uint32_t seq, uint16_t len, uint8_t flags)
+{
+    struct pico_frame *f = pico_frame_alloc((uint32_t)(PICO_SIZE_IP4HDR + PICO_SIZE_TCPHDR + len));
+    struct pico_ipv4_hdr *ip;
+    struct pico_tcp_hdr *hdr;
+    uint16_t i;
+
+    fail_if(!f);
+    memset(f->buffer, 0, PICO_SIZE_IP4HDR + PICO_SIZE_TCPHDR);
+    f->net_hdr = f->buffer;
+    f->net_len = PICO_SIZE_IP4HDR;
+    f->transport_hdr = f->net_hdr + PICO_SIZE_IP4HDR;
+    f->transport_len = (uint16_t)(PICO_SIZE_TCPHDR + len);
+    for (i = 0; i < len; i++)
+        f->transport_hdr[PICO_SIZE_TCPHDR + i] = (uint8_t)(seq + i);
+    ip = (struct pico_ipv4_hdr *)f->net_hdr;
+    ip->vhl = 0x45;
+    ip->proto = PICO_PROTO_TCP;
+    ip->src.addr = long_be(0x0a000001);
+    ip->dst.addr = long_be(0x0a000002);
+    hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    hdr->trans.sport = short_be(5555);
+    hdr->trans.dport = short_be(80);
+    hdr->len = (uint8_t)(PICO_SIZE_TCPHDR << 2);
+    hdr->seq = long_be(seq);
+    hdr->ack = long_be(42);
+    hdr->flags = flags;
+    hdr->rwnd = short_be(len);
+    hdr->crc = short_be(pico_tcp_checksum(f));
+    return f;
+}
+
+static struct pico_socket_tcp *tcp_test_sack_flight(struct pico_frame **seg, uint32_t n, pico_time now)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    uint32_t i;
+
+    fail_if(!t);
+    t->sack_ok = 1;
+    t->snd_nxt = 1000 + 1000 * n;
+    t->in_flight = n;
+    /* Two segments per 10 ms, the first pair 100 ms ago */
+    for (i = 0; i < n; i++) {
+        seg[i] = tcp_test_segment(1000 + 1000 * i, 1000, PICO_TCP_PSHACK);
+        seg[i]->payload = seg[i]->transport_hdr + PICO_SIZE_TCPHDR;
+        seg[i]->payload_len = 1000;
+        seg[i]->timestamp = now - 100 + (i >> 1) * 10;
+        fail_if(pico_enqueue_segment(&t->tcpq_out, seg[i]) <= 0);
+    }
+    return t;
+}
+
+START_TEST(tc_tcp_process_sack)
+{
+    struct pico_frame *seg[6];
+    pico_time now = TCP_TIME;
+    struct pico_socket_tcp *t = tcp_test_sack_flight(seg, 6, now);
+
+    /* With nothing retransmitted, the last segment acknowledged was sent last */
+    tcp_rack_ack(t, 2500);
+    fail_if((t->rack_xmit_ts != seg[0]->timestamp) || (t->rack_end != 2000));
+
+    /* Only the segments a block covers entirely are marked */
+    tcp_process_sack(t, 3000, 5500);
+    fail_if(!(seg[2]->flags & PICO_FRAME_FLAG_SACKED) || !(seg[3]->flags & PICO_FRAME_FLAG_SACKED));
+    fail_if(seg[4]->flags & PICO_FRAME_FLAG_SACKED);
+    fail_if(t->delivered != 2);
+    fail_if((t->tcpq_out.sacked != 2) || (t->sack_high != 5000));
+    fail_if((t->rack_xmit_ts != seg[3]->timestamp) || (t->rack_end != 5000) || (t->rack_rtt < 90));
+    t->rack_rtt = 90;
+
+    /* RACK: what was sent before the delivered segment is lost one
+     * reordering window (min_rtt / 4) after it should have arrived */
+    t->rack_min_rtt = 40;
+    fail_if(tcp_rack_detect_loss(t, now - 1) != now);
+    fail_if(TCP_SEG_FLAGS(seg[0]) & TCP_SEG_LOST);
+    fail_if(tcp_rack_detect_loss(t, now) != 0);
+    fail_if(!(TCP_SEG_FLAGS(seg[0]) & TCP_SEG_LOST) || !(TCP_SEG_FLAGS(seg[1]) & TCP_SEG_LOST));
+    fail_if(TCP_SEG_FLAGS(seg[4]) & TCP_SEG_LOST);
+    fail_if(t->tcpq_out.lost != 2);
+    fail_if(tcp_sack_scoreboard(t) != 2);
+    fail_if(tcp_sack_next_lost(t) != seg[0]);
+
+    /* The next pass starts past the segments already SACKed or lost */
+    fail_if(tcp_rack_detect_loss(t, now + 1000) != 0);
+    fail_if(TCP_SEG_FLAGS(seg[4]) & TCP_SEG_LOST);
+    fail_if(t->rack_hint != 5000);
+
+    /* Scoreboard: a hole with PICO_TCP_DUPTHRESH SACKed segments above is lost */
+    tcp_seg_mark(t, seg[0], 0);
+    tcp_seg_mark(t, seg[1], 0);
+    fail_if((t->tcpq_out.lost != 0) || (t->rack_hint != 1000));
+    tcp_process_sack(t, 6000, 7000);
+    fail_if(tcp_sack_scoreboard(t) != 1);
+    fail_if(!(TCP_SEG_FLAGS(seg[0]) & TCP_SEG_LOST) || !(TCP_SEG_FLAGS(seg[1]) & TCP_SEG_LOST));
+    fail_if(TCP_SEG_FLAGS(seg[4]) & TCP_SEG_LOST);
+    fail_if(t->sack_mark != 3000);
+
+    /* ...unless it was retransmitted already */
+    tcp_seg_mark(t, seg[0], TCP_SEG_RETRANS);
+    fail_if((t->tcpq_out.lost != 1) || (t->tcpq_out.retrans != 1));
+    fail_if(tcp_sack_scoreboard(t) != 2);
+    fail_if(tcp_sack_next_lost(t) != seg[1]);
+    fail_if(t->lost_hint != 2000);
+
+    /* Once snd_nxt went back below them, the scoreboard walks the queue */
+    t->snd_nxt = 1000;
+    fail_if(tcp_sack_scoreboard(t) != 0);
+
+    tcp_discard_all_segments(&t->tcpq_out);
+    PICO_FREE(t);
+}
+END_TEST
+
+START_TEST(tc_tcp_retrans_options)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct pico_frame *f;
+    uint16_t optsiz, i;
+    uint8_t ts, round;
+
+    fail_if(!t);
+    for (ts = 0; ts < 2; ts++) {
+        t->ts_ok = ts;
+        /* Laid out as the socket layer does before queuing it */
+        f = pico_frame_alloc(PICO_SIZE_TCPHDR + 40 + 100);
+        fail_if(!f);
+        f->transport_hdr = f->buffer;
+        pico_tcp_flags_update(f, &t->sock);
+        optsiz = tcp_options_size_frame(f);
+        f->payload = f->transport_hdr + PICO_SIZE_TCPHDR + optsiz;
+        f->payload_len = 100;
+        for (i = 0; i < f->payload_len; i++)
+            f->payload[i] = (uint8_t)i;
+
+        /* Marked lost, then sent again: the scoreboard does not change the options */
+        TCP_SEG_FLAGS(f) = TCP_SEG_LOST;
+        for (round = 0; round < 2; round++) {
+            tcp_add_options_frame(t, f);
+            fail_if(tcp_options_size_frame(f) != optsiz);
+            fail_if((f->transport_hdr[PICO_SIZE_TCPHDR + PICO_TCPOPTLEN_WS] == PICO_TCP_OPTION_TIMESTAMP) != ts);
+            for (i = 0; i < f->payload_len; i++)
+                fail_if(f->payload[i] != (uint8_t)i);
+            TCP_SEG_FLAGS(f) = TCP_SEG_RETRANS;
+        }
+        pico_frame_discard(f);
+    }
+    PICO_FREE(t);
+}
+END_TEST
+
+START_TEST(tc_tcp_prr)
+{
+    struct pico_frame *seg[8];
+    pico_time now = TCP_TIME;
+    struct pico_socket_tcp *t = tcp_test_sack_flight(seg, 8, now);
+
+    t->mss = (uint16_t)1000;
+    t->cc.mss = (uint32_t)t->mss;
+    t->cc.ssthresh = 4000;
+    t->prr_recover_fs = 8;
+
+    /* Above ssthresh: one segment out for every second one delivered */
+    t->in_flight = 7;
+    fail_if(tcp_prr_sndcnt(t, 1) != 1);
+    t->prr_out = 1;
+    fail_if(tcp_prr_sndcnt(t, 1) != 0);
+    fail_if(tcp_prr_sndcnt(t, 2) != 1);
+
+    /* At or below it: catch up, at most one segment beyond what was delivered */
+    t->prr_out = 2;
+    t->in_flight = 2;
+    fail_if(tcp_prr_sndcnt(t, 1) != 2);
+    t->in_flight = 3;
+    t->prr_out = 10;
+    fail_if(tcp_prr_sndcnt(t, 0) != 1);
+
+    /* Tail loss probe: two round trips, never at or past the RTO */
+    t->x_mode = PICO_TCP_LOOKAHEAD;
+    t->avg_rtt = 20;
+    t->rto = 1000;
+    tcp_tlp_arm(t);
+    fail_if(!t->rack_tmr || !t->rack_tlp);
+    fail_if((t->rack_tmr_due < now + 40) || (t->rack_tmr_due > TCP_TIME + 40));
+    t->rack_tmr = 0;
+    t->rack_tmr_due = 0;
+    t->tlp_high = t->snd_nxt;
+    tcp_tlp_arm(t);
+    fail_if(t->rack_tmr);
+    t->tlp_high = 0;
+    t->avg_rtt = 600;
+    tcp_tlp_arm(t);
+    fail_if(t->rack_tmr);
+
+    tcp_discard_all_segments(&t->tcpq_out);
+    PICO_FREE(t);
+}
+END_TEST
+
+START_TEST(tc_tcp_ring)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct pico_frame *f[30], *g;
+    pico_time tm;
+    uint32_t i, pos;
+
+    fail_if(!t);
+    for (i = 0; i < 30; i++) {
+        f[i] = tcp_test_segment(1000 + 100 * i, 100, PICO_TCP_PSHACK);
+        f[i]->payload_len = 100;
+    }
+
+    /* Release from the head while appending: the ring wraps, then grows */
+    for (i = 0; i < 12; i++)
+        fail_if(pico_enqueue_segment(&t->tcpq_out, f[i]) <= 0);
+    fail_if(release_all_until(&t->tcpq_out, 1800, &tm) != 8);
+    for (i = 12; i < 30; i++)
+        fail_if(pico_enqueue_segment(&t->tcpq_out, f[i]) <= 0);
+    fail_if((t->tcpq_out.frames != 22) || (t->tcpq_out.ring_size != 32));
+    i = 8;
+    tcp_ring_foreach(&t->tcpq_out, pos, g) {
+        fail_if(g != f[i++]);
+    }
+    fail_if(i != 30);
+
+    /* next_segment() follows the cursor, peek_segment() falls back to a search */
+    for (i = 8, g = first_segment(&t->tcpq_out); g; i++, g = next_segment(&t->tcpq_out, g))
+        fail_if(g != f[i]);
+    fail_if(i != 30);
+    fail_if(peek_segment(&t->tcpq_out, 2000) != f[10]);
+    fail_if(peek_segment(&t->tcpq_out, 2050) != NULL);
+
+    /* Duplicates are refused; a frame taken from the middle goes back in place */
+    fail_if(pico_enqueue_segment(&t->tcpq_out, f[15]) != 0);
+    fail_if(pico_unlink_segment(&t->tcpq_out, f[15]) != f[15]);
+    fail_if(next_segment(&t->tcpq_out, f[14]) != NULL);
+    fail_if(tcp_ring_search(&t->tcpq_out, 2550) != 7);
+    fail_if(pico_enqueue_segment(&t->tcpq_out, f[15]) <= 0);
+    fail_if(next_segment(&t->tcpq_out, f[14]) != f[15]);
+    fail_if(tcp_ring_search(&t->tcpq_out, 2550) != 8);
+
+    tcp_discard_all_segments(&t->tcpq_out);
+    fail_if(t->tcpq_out.ring || t->tcpq_out.frames || t->tcpq_out.size);
+    PICO_FREE(t);
+}
+END_TEST
+
+START_TEST(tc_tcp_delack)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct pico_frame *f;
+    uint32_t timers, ms = 0;
+    int en = -1;
+
+    fail_if(!t);
+    /* Binds the output queue, which multi-instance builds only do at init */
+    pico_protocol_init(&pico_proto_tcp);
+    t->sock.proto = &pico_proto_tcp;
+    t->sock.net = &pico_proto_ipv4;
+    t->sock.state = PICO_SOCKET_STATE_BOUND | PICO_SOCKET_STATE_CONNECTED | PICO_SOCKET_STATE_TCP_ESTABLISHED;
+    t->mss = 1000;
+    t->rcv_nxt = t->rcv_ackd = 1000;
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_DELACK, &en) != 0);
+    fail_if(en != PICO_TCP_DELACK_DEFAULT);
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_DELACK_TIMEOUT, &ms) != 0);
+    fail_if(ms != PICO_TCP_DELACK_TIMEOUT);
+    ms = 0;
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_DELACK_TIMEOUT, &ms) != -1);
+    ms = PICO_TCP_DELACK_TIMEOUT_MAX + 1;
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_DELACK_TIMEOUT, &ms) != -1);
+    ms = 100;
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_DELACK_TIMEOUT, &ms) != 0);
+    en = 1;
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_DELACK, &en) != 0);
+
+    /* Quick-ack: the first segments are acknowledged at once */
+    t->quickack = 2;
+    f = tcp_test_segment(1000, 500, PICO_TCP_PSHACK);
+    tcp_data_in(&t->sock, f);
+    pico_frame_discard(f);
+    fail_if(t->rcv_ackd != 1500);
+    f = tcp_test_segment(1500, 500, PICO_TCP_PSHACK);
+    tcp_data_in(&t->sock, f);
+    pico_frame_discard(f);
+    fail_if(t->rcv_ackd != 2000);
+    fail_if(t->quickack != 0);
+
+    /* Then every second full segment, or when the timer expires */
+    timers = timers_added;
+    f = tcp_test_segment(2000, 500, PICO_TCP_PSHACK);
+    tcp_data_in(&t->sock, f);
+    pico_frame_discard(f);
+    fail_if(t->rcv_ackd != 2000);
+    fail_if(!t->delack_tmr || (timers_added != timers + 1));
+    f = tcp_test_segment(2500, 1000, PICO_TCP_PSHACK);
+    tcp_data_in(&t->sock, f);
+    pico_frame_discard(f);
+    fail_if(t->rcv_ackd != 2000);
+    fail_if(timers_added != timers + 1);
+    f = tcp_test_segment(3500, 500, PICO_TCP_PSHACK);
+    tcp_data_in(&t->sock, f);
+    pico_frame_discard(f);
+    fail_if(t->rcv_ackd != 4000);
+    tcp_delack_timeout(0, t);
+    fail_if(t->delack_tmr || (t->rcv_ackd != 4000));
+    f = tcp_test_segment(4000, 100, PICO_TCP_PSHACK);
+    tcp_data_in(&t->sock, f);
+    pico_frame_discard(f);
+    fail_if(t->rcv_ackd != 4000);
+    tcp_delack_timeout(0, t);
+    fail_if(t->rcv_ackd != 4100);
+
+    /* Out-of-order data is acknowledged at once, and so is what follows */
+    t->sack_ok = 1;
+    f = tcp_test_segment(4200, 100, PICO_TCP_PSHACK);
+    tcp_data_in(&t->sock, f);
+    pico_frame_discard(f);
+    fail_if(t->quickack != PICO_TCP_QUICKACKS);
+    t->quickack = 0;
+    f = tcp_test_segment(4100, 100, PICO_TCP_PSHACK);
+    tcp_data_in(&t->sock, f);
+    pico_frame_discard(f);
+    fail_if(t->rcv_nxt != 4300);
+    fail_if(t->rcv_ackd != 4300);
+
+    /* Disabled: every segment */
+    t->quickack = 0;
+    en = 0;
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_DELACK, &en) != 0);
+    f = tcp_test_segment(4300, 100, PICO_TCP_PSHACK);
+    tcp_data_in(&t->sock, f);
+    pico_frame_discard(f);
+    fail_if(t->rcv_ackd != 4400);
+
+    tcp_discard_all_segments(&t->tcpq_in);
+    while ((f = pico_dequeue(pico_proto_tcp.q_out)) != NULL)
+        pico_frame_discard(f);
+    PICO_FREE(t);
+}
+END_TEST
+#ifdef PICO_SUPPORT_TCP_GRO
+START_TEST(tc_tcp_gro_merge)
+{
+    struct pico_queue q = {
+        0
+    };
+    struct pico_socket_tcp *t;
+    struct tcp_input_segment *seg;
+    struct pico_frame *f;
+    uint32_t i, pos;
+
+    /* Odd lengths, with and without PSH: merged up to the hole before 1400 */
+    f = tcp_test_segment(1000, 101, PICO_TCP_ACK | PICO_TCP_PSH);
+    pico_enqueue(&q, tcp_test_segment(1101, 200, PICO_TCP_ACK));
+    pico_enqueue(&q, tcp_test_segment(1301, 49, PICO_TCP_ACK | PICO_TCP_PSH));
+    pico_enqueue(&q, tcp_test_segment(1400, 10, PICO_TCP_ACK | PICO_TCP_PSH));
+    fail_if(tcp_gro_merge(&q, f) != f);
+    fail_if(!f->chain);
+    fail_if(f->payload_len != 350);
+    fail_if(f->transport_len != PICO_SIZE_TCPHDR + 350);
+    fail_if(short_be(((struct pico_tcp_hdr *)f->transport_hdr)->rwnd) != 49);
+    fail_if(pico_tcp_checksum(f) != 0);
+    fail_if(q.frames != 1);
+    seg = segment_from_frame_at(f, 0, 350);
+    fail_if(!seg);
+    for (i = 0; i < 350; i++)
+        fail_if(seg->payload[i] != (uint8_t)(1000 + i));
+    segment_free(seg);
+
+    /* Data that is already queued is skipped, only the gaps are added */
+    t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    fail_if(!t);
+    seg = segment_from_frame_at(f, 101, 200);
+    fail_if(!seg || seg->seq != 1101);
+    fail_if(pico_enqueue_segment(&t->tcpq_in, seg) <= 0);
+    pos = 1000;
+    fail_if(tcp_data_in_insert(t, f, &pos, 0) != 0);
+    fail_if(pos != 1350);
+    fail_if(t->tcpq_in.frames != 3);
+    fail_if(t->tcpq_in.size != 350);
+    seg = peek_segment(&t->tcpq_in, 1000);
+    fail_if(!seg || seg->payload_len != 101);
+    seg = peek_segment(&t->tcpq_in, 1301);
+    fail_if(!seg || seg->payload_len != 49 || seg->payload[0] != (uint8_t)1301);
+    pico_frame_discard(f);
+
+    /* The end of the stream and a different flow are never merged */
+    f = pico_dequeue(&q);
+    pico_enqueue(&q, tcp_test_segment(1410, 10, PICO_TCP_ACK | PICO_TCP_FIN));
+    fail_if(tcp_gro_merge(&q, f) != f);
+    fail_if(f->chain || q.frames != 1);
+    pico_frame_discard(f);
+    f = pico_dequeue(&q);
+    fail_if(tcp_gro_merge(&q, f) != f);
+    pico_frame_discard(f);
+    f = tcp_test_segment(2000, 10, PICO_TCP_ACK);
+    pico_enqueue(&q, tcp_test_segment(2010, 10, PICO_TCP_ACK));
+    ((struct pico_tcp_hdr *)q.head->transport_hdr)->trans.sport = short_be(5556);
+    fail_if(tcp_gro_merge(&q, f) != f);
+    fail_if(f->chain || q.frames != 1);
+    pico_frame_discard(f);
+    pico_frame_discard(pico_dequeue(&q));
+}
+END_TEST
+#endif
+static void cc_test_init(struct pico_tcp_cc *cc)
+{
+    cc->priv[0] = 0xc0ffee;
+}
+static void cc_test_event(struct pico_tcp_cc *cc, uint32_t bytes, pico_time now)
+{
+    IGNORE_PARAMETER(bytes);
+    IGNORE_PARAMETER(now);
+    cc->cwnd = 4 * cc->mss;
+}
+static uint32_t cc_test_get(struct pico_tcp_cc *cc)
+{
+    return cc->cwnd;
+}
+static struct pico_tcp_cc_ops cc_test_ops = {
+    "test", cc_test_init, cc_test_event, cc_test_event, cc_test_event, cc_test_get, cc_test_get, NULL
+};
+START_TEST(tc_tcp_congestion_option)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    const char *name = NULL;
+
+    fail_if(!t);
+    t->sock.proto = &pico_proto_tcp;
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_CONGESTION, &name) != 0);
+    fail_if(strcmp(name, "reno") != 0);
+
+    name = "cubic";
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_CONGESTION, &name) != 0);
+    fail_if(t->cc.ops != &pico_tcp_cc_cubic);
+    fail_if(pico_socket_getoption(&t->sock, PICO_TCP_CONGESTION, &name) != 0);
+    fail_if(strcmp(name, "cubic") != 0);
+
+    pico_err = PICO_ERR_NOERR;
+    name = "vegas";
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_CONGESTION, &name) == 0);
+    fail_if(pico_err != PICO_ERR_ENOENT);
+    fail_if(t->cc.ops != &pico_tcp_cc_cubic);
+
+    /* Connected sockets switch algorithm and keep their window */
+    t->mss = 1000;
+    tcp_cc_init(t);
+    tcp_cc_set_cwnd(t, 30);
+    fail_if(pico_tcp_cc_register(&cc_test_ops) != 0);
+    fail_if(pico_tcp_cc_register(&cc_test_ops) == 0);
+    fail_if(pico_err != PICO_ERR_EEXIST);
+    name = "test";
+    fail_if(pico_socket_setoption(&t->sock, PICO_TCP_CONGESTION, &name) != 0);
+    fail_if(t->cc.priv[0] != 0xc0ffee);
+    fail_if(t->cwnd != 30);
+    tcp_first_timeout(t);
+    fail_if(t->cwnd != 4);
+
+    fail_if(pico_tcp_cc_find("reno") != &pico_tcp_cc_reno);
+    fail_if(pico_tcp_cc_default() != &pico_tcp_cc_reno);
+    PICO_FREE(t);
 }
 END_TEST
 START_TEST(tc_add_retransmission_timer)
@@ -575,11 +1627,529 @@ START_TEST(tc_tcp_lastackwait)
     /* TODO: test this: static int tcp_lastackwait(struct pico_socket *s, struct pico_frame *f) */
 }
 END_TEST
+/* Handshake segment with MSS 1400, window scale 7, SACK and timestamps */
+static struct pico_frame *tcp_test_handshake(uint32_t seq, uint32_t ack, uint8_t flags, uint32_t tsecr)
+{
+    static const uint8_t opt[20] = {
+        2, 4, 0x05, 0x78, 1, 3, 3, 7, 4, 2, 8, 10, 0, 0, 0x04, 0xd2, 0, 0, 0, 0
+    };
+    struct pico_frame *f = tcp_test_segment(seq, 20, flags);
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+
+    memcpy(f->transport_hdr + PICO_SIZE_TCPHDR, opt, sizeof(opt));
+    tsecr = long_be(tsecr);
+    memcpy(f->transport_hdr + PICO_SIZE_TCPHDR + 16, &tsecr, 4);
+    hdr->len = (uint8_t)((PICO_SIZE_TCPHDR + 20) << 2);
+    hdr->ack = long_be(ack);
+    return f;
+}
+
 START_TEST(tc_tcp_syn)
 {
-    /* TODO: test this: static int tcp_syn(struct pico_socket *s, struct pico_frame *f) */
+    struct pico_socket_tcp *l = PICO_ZALLOC(sizeof(struct pico_socket_tcp));
+    struct pico_frame *syn = tcp_test_handshake(1000, 0, PICO_TCP_SYN, 0);
+    struct tcp_halfopen p;
+#ifdef PICO_SUPPORT_TCP_HALFOPEN
+    struct pico_tcp_syn_stats st;
+    struct tcp_halfopen *h;
+#endif
+#ifdef PICO_SUPPORT_TCP_SYNCOOKIES
+    struct tcp_halfopen c, back;
+    struct pico_frame *ack;
+#endif
+
+    fail_if(!l);
+    l->sock.state = PICO_SOCKET_STATE_BOUND | PICO_SOCKET_STATE_TCP_LISTEN;
+    l->sock.max_backlog = 1;
+    fail_if(tcp_halfopen_find(&l->sock, syn) != NULL);
+    fail_if(invalid_flags(&l->sock, PICO_TCP_ACK));
+    fail_if(!invalid_flags(&l->sock, PICO_TCP_FIN));
+
+    /* The options of the SYN are kept until the socket exists */
+    memset(&p, 0, sizeof(p));
+    tcp_halfopen_parse(&p, syn);
+    fail_if(p.irs != 1000);
+    fail_if(p.mss != 1400 || p.wscale != 7 || !p.ws_ok || !p.sack_ok || !p.ts_ok || p.ts_recent != 1234);
+
+#ifdef PICO_SUPPORT_TCP_HALFOPEN
+    /* A SYN only takes a half-open entry */
+    h = tcp_halfopen_add(&l->sock, syn);
+    fail_if(!h);
+    l->sock.number_of_pending_conn++;
+    fail_if(tcp_halfopen_find(&l->sock, syn) != h);
+    fail_if(tcp_halfopen_find((struct pico_socket *)syn, syn) != NULL);
+    fail_if(pico_tcp_syn_stats(&st) < 0);
+    fail_if(st.half_open != 1);
+    fail_if(pico_tcp_syn_stats(NULL) == 0);
+
+    /* Entries go away when they expire, or with their listener */
+    tcp_halfopen_purge(NULL, h->expire - 1);
+    fail_if(tcp_halfopen_find(&l->sock, syn) != h);
+    tcp_halfopen_purge(NULL, h->expire);
+    fail_if(tcp_halfopen_find(&l->sock, syn) != NULL);
+    fail_if(l->sock.number_of_pending_conn != 0);
+    fail_if(!tcp_halfopen_add(&l->sock, syn));
+    l->sock.number_of_pending_conn++;
+    tcp_halfopen_purge(&l->sock, 0);
+    fail_if(tcp_halfopen_count != 0 || l->sock.number_of_pending_conn != 0);
+#endif
+
+#ifdef PICO_SUPPORT_TCP_SYNCOOKIES
+    /* The cookie gives back the MSS; the echoed timestamp the other options */
+    memset(&c, 0, sizeof(c));
+    tcp_halfopen_parse(&c, syn);
+    c.mss = 1450;
+    c.iss = tcp_syncookie_make(syn, &c);
+    fail_if(c.mss != 1440);
+    ack = tcp_test_handshake(1001, c.iss + 1, PICO_TCP_ACK, 0x100u | TCP_COOKIE_TS_SACK | 7u);
+    fail_if(tcp_syncookie_check(ack, &back) < 0);
+    fail_if(back.iss != c.iss || back.irs != 1000 || back.mss != 1440);
+    fail_if(back.wscale != 7 || !back.ws_ok || !back.sack_ok || !back.ts_ok);
+    pico_frame_discard(ack);
+    ack = tcp_test_handshake(1001, c.iss + 1, PICO_TCP_ACK, 0x100u | TCP_COOKIE_TS_WS);
+    fail_if(tcp_syncookie_check(ack, &back) < 0);
+    fail_if(back.wscale != 0 || back.ws_ok || back.sack_ok);
+    pico_frame_discard(ack);
+
+    ack = tcp_test_handshake(1001, c.iss + 2, PICO_TCP_ACK, 0);
+    fail_if(tcp_syncookie_check(ack, &back) == 0);
+    pico_frame_discard(ack);
+    ack = tcp_test_handshake(1002, c.iss + 1, PICO_TCP_ACK, 0);
+    fail_if(tcp_syncookie_check(ack, &back) == 0);
+    pico_frame_discard(ack);
+#endif
+    /* Window scaling is only offered on a SYN */
+    syn->sock = &l->sock;
+    syn->payload = syn->transport_hdr + syn->transport_len;
+    ((struct pico_tcp_hdr *)syn->transport_hdr)->flags = PICO_TCP_ACK;
+    tcp_parse_options(syn);
+    fail_if(l->scale_ok || l->recv_wnd_scale != 7);
+    ((struct pico_tcp_hdr *)syn->transport_hdr)->flags = PICO_TCP_SYN;
+    tcp_parse_options(syn);
+    fail_if(!l->scale_ok || l->recv_wnd_scale != 7);
+    pico_frame_discard(syn);
+    PICO_FREE(l);
 }
 END_TEST
+#ifdef PICO_SUPPORT_TCP_TIMEWAIT
+START_TEST(tc_tcp_time_wait)
+{
+    struct pico_socket_tcp *t = PICO_ZALLOC(sizeof(struct pico_socket_tcp));
+    struct pico_frame *f = tcp_test_segment(5000, 0, PICO_TCP_ACK);
+    struct tcp_timewait *tw;
+    uint16_t port;
+
+    fail_if(!t);
+    fail_if(pico_tcp_timewait_input(f) == 0);
+    t->sock.net = &pico_proto_ipv4;
+    t->sock.local_addr.ip4.addr = long_be(0x0a000002);
+    t->sock.remote_addr.ip4.addr = long_be(0x0a000001);
+    t->sock.local_port = short_be(80);
+    t->snd_nxt = 9000;
+    t->rcv_nxt = 5000;
+    t->linger_timeout = 3000;
+
+    /* One record per connection, found again from its segments */
+    for (port = 1; port <= 200; port++) {
+        t->sock.remote_port = short_be((uint16_t)(5555 + port - 1));
+        fail_if(tcp_timewait_add(t) < 0);
+    }
+    fail_if(tcp_timewait_count != 200 || tcp_timewait_buckets < 200);
+    tw = tcp_timewait_find(f);
+    fail_if(!tw);
+    fail_if(tw->snd_nxt != 9000 || tw->rcv_nxt != 5000 || tw->addr_len != PICO_SIZE_IP4);
+    /* 32 bytes with 32-bit pointers */
+    fail_if(sizeof(struct tcp_timewait) + 2 * PICO_SIZE_IP4 > 28 + 2 * sizeof(void *));
+
+    /* A pure ACK is taken in silence, a SYN past rcv_nxt opens a new connection */
+    fail_if(pico_tcp_timewait_input(f) != 0);
+    f = tcp_test_segment(5001, 0, PICO_TCP_SYN);
+    fail_if(pico_tcp_timewait_input(f) == 0);
+    fail_if(tcp_timewait_find(f) != NULL);
+    fail_if(tcp_timewait_count != 199);
+    pico_frame_discard(f);
+
+    /* Records go when they expire, the table with the last one */
+    tcp_timewait_sweep(TCP_TIME + 1000, NULL);
+    fail_if(tcp_timewait_count != 199);
+    tcp_timewait_sweep(TCP_TIME + 3001, NULL);
+    fail_if(tcp_timewait_count != 0 || tcp_timewait_table != NULL);
+    PICO_FREE(t);
+}
+END_TEST
+#endif
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+/* A SYN or SYN-ACK with a Fast Open option, cookie of len bytes, and payload */
+static struct pico_frame *tcp_test_fastopen(uint32_t seq, uint8_t flags, const uint8_t *cookie, uint8_t len, uint16_t payload)
+{
+    struct pico_frame *f = tcp_test_segment(seq, (uint16_t)(20 + payload), flags);
+    struct pico_tcp_hdr *hdr = (struct pico_tcp_hdr *)f->transport_hdr;
+    uint8_t *opt = f->transport_hdr + PICO_SIZE_TCPHDR;
+
+    memset(opt, PICO_TCP_OPTION_NOOP, 20);
+    opt[0] = PICO_TCP_OPTION_FASTOPEN;
+    opt[1] = (uint8_t)(PICO_TCPOPTLEN_FASTOPEN + len);
+    memcpy(opt + 2, cookie, len);
+    hdr->len = (uint8_t)((PICO_SIZE_TCPHDR + 20) << 2);
+    hdr->ack = long_be(seq + 1000);
+    f->payload = opt + 20;
+    f->payload_len = payload;
+    return f;
+}
+
+START_TEST(tc_tcp_fastopen)
+{
+    struct pico_socket_tcp *l = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct pico_socket_tcp *child = NULL;
+    struct pico_tree_node *index;
+    struct pico_sockport *sp;
+    struct pico_tcp_syn_stats st;
+    struct pico_frame *f;
+    uint8_t cookie[TCP_FASTOPEN_COOKIE], other[TCP_FASTOPEN_COOKIE], buf[64];
+    const uint8_t *opt;
+    uint8_t len = 0;
+    int on = 0;
+    uint32_t i;
+
+    fail_if(!l || !t);
+    pico_protocol_init(&pico_proto_tcp);
+    l->sock.net = &pico_proto_ipv4;
+    l->sock.proto = &pico_proto_tcp;
+    t->sock.net = &pico_proto_ipv4;
+    fail_if(pico_tcp_get_fastopen(&t->sock, &on) < 0 || on);
+    fail_if(pico_tcp_set_fastopen(&t->sock, 1) < 0);
+    fail_if(pico_tcp_get_fastopen(&t->sock, &on) < 0 || !on);
+
+    /* The cookie is bound to the addresses of the client */
+    f = tcp_test_fastopen(1000, PICO_TCP_SYN, cookie, 0, 0);
+    opt = tcp_fastopen_option(f, &len);
+    fail_if(!opt || len != 0);
+    tcp_fastopen_cookie(f, cookie);
+    tcp_fastopen_cookie(f, other);
+    fail_if(memcmp(cookie, other, TCP_FASTOPEN_COOKIE));
+    ((struct pico_ipv4_hdr *)f->net_hdr)->src.addr = long_be(0x0a000003);
+    tcp_fastopen_cookie(f, other);
+    fail_if(!memcmp(cookie, other, TCP_FASTOPEN_COOKIE));
+    pico_frame_discard(f);
+    f = tcp_test_segment(1000, 0, PICO_TCP_SYN);
+    fail_if(tcp_fastopen_option(f, &len) != NULL);
+    pico_frame_discard(f);
+
+    /* The client keeps the cookie of a SYN-ACK, for that server only */
+    t->sock.remote_addr.ip4.addr = long_be(0x0a000001);
+    t->mss = 1000;
+    f = tcp_test_fastopen(5000, PICO_TCP_SYN | PICO_TCP_ACK, cookie, 3, 0);
+    tcp_fastopen_synack(t, f, 0);
+    fail_if(tcp_fastopen_find(&t->sock) != NULL);
+    pico_frame_discard(f);
+    f = tcp_test_fastopen(5000, PICO_TCP_SYN | PICO_TCP_ACK, cookie, TCP_FASTOPEN_COOKIE, 0);
+    tcp_fastopen_synack(t, f, 0);
+    fail_if(!tcp_fastopen_find(&t->sock));
+    fail_if(tcp_fastopen_find(&t->sock)->mss != 1000 || memcmp(tcp_fastopen_find(&t->sock)->cookie, cookie, TCP_FASTOPEN_COOKIE));
+    for (i = 0; i < PICO_TCP_FASTOPEN_CACHE; i++) {
+        t->sock.remote_addr.ip4.addr = long_be(0x0b000000 + i);
+        fail_if(tcp_fastopen_find(&t->sock) != NULL);
+        tcp_fastopen_synack(t, f, 0);
+    }
+    t->sock.remote_addr.ip4.addr = long_be(0x0a000001);
+    fail_if(tcp_fastopen_find(&t->sock) != NULL);
+    pico_frame_discard(f);
+
+    /* With a cookie, the SYN waits a tick for the data written after connect() */
+    t->sock.remote_addr.ip4.addr = long_be(0x0b000001);
+    fail_if(pico_tcp_initconn(&t->sock) < 0);
+    while ((f = pico_dequeue(pico_proto_tcp.q_out)) != NULL)
+        pico_frame_discard(f);
+    f = tcp_test_segment(t->snd_last + 1, 1500, PICO_TCP_PSHACK);
+    f->payload = f->transport_hdr + PICO_SIZE_TCPHDR;
+    f->payload_len = 1500;
+    fail_if(pico_enqueue_segment(&t->tcpq_out, f) <= 0);
+    t->snd_last += 1500;
+    tcp_fastopen_connect(TCP_TIME, t);
+    fail_if(t->syn_data != 1000 - 32);
+    f = pico_dequeue(pico_proto_tcp.q_out);
+    fail_if(!f);
+    opt = tcp_fastopen_option(f, &len);
+    fail_if(!opt || len != TCP_FASTOPEN_COOKIE || memcmp(opt, cookie, len));
+    fail_if(f->transport_len != PICO_SIZE_TCPHDR + 32 + t->syn_data || f->payload_len != 0);
+    fail_if(f->transport_hdr[PICO_SIZE_TCPHDR + 32] != (uint8_t)(t->snd_nxt + 1));
+    pico_frame_discard(f);
+
+    /* A listener answers a cookie request with a cookie */
+    l->sock.state = PICO_SOCKET_STATE_BOUND | PICO_SOCKET_STATE_TCP_LISTEN;
+    l->sock.local_port = short_be(80);
+    l->sock.max_backlog = 2;
+    f = tcp_test_fastopen(1000, PICO_TCP_SYN, cookie, TCP_FASTOPEN_COOKIE, 10);
+    fail_if(tcp_fastopen_accept(&l->sock, f) == 0);
+    fail_if(pico_tcp_set_fastopen(&l->sock, 1) < 0);
+    fail_if(pico_tcp_syn_stats(&st) < 0);
+    fail_if(st.fastopen_accepted != 0 || st.fastopen_failed != 0);
+
+    /* Data with a bad cookie waits for the handshake */
+    memset(other, 0, sizeof(other));
+    pico_frame_discard(f);
+    f = tcp_test_fastopen(1000, PICO_TCP_SYN, other, TCP_FASTOPEN_COOKIE, 10);
+    fail_if(tcp_fastopen_accept(&l->sock, f) == 0);
+    fail_if(pico_tcp_syn_stats(&st) < 0 || st.fastopen_failed != 1);
+    pico_frame_discard(f);
+
+    /* With a good one, the child socket has it before the final ACK */
+    f = tcp_test_fastopen(1000, PICO_TCP_SYN, cookie, TCP_FASTOPEN_COOKIE, 10);
+    fail_if(tcp_fastopen_accept(&l->sock, f) < 0);
+    fail_if(pico_tcp_syn_stats(&st) < 0 || st.fastopen_accepted != 1);
+    fail_if(l->sock.number_of_pending_conn != 1);
+    sp = pico_get_sockport(PICO_PROTO_TCP, short_be(80));
+    fail_if(!sp);
+    pico_tree_foreach(index, &sp->socks) {
+        if (((struct pico_socket *)index->keyValue)->parent == &l->sock)
+            child = (struct pico_socket_tcp *)index->keyValue;
+    }
+    fail_if(!child);
+    fail_if(!pico_tcp_fastopen_child(&child->sock) || pico_tcp_fastopen_child(&l->sock));
+    fail_if(TCPSTATE(&child->sock) != PICO_SOCKET_STATE_TCP_SYN_RECV);
+    fail_if(child->rcv_nxt != 1011 || child->snd_nxt != child->snd_last + 1);
+    fail_if(pico_tcp_read(&child->sock, buf, sizeof(buf)) != 10);
+    for (i = 0; i < 10; i++)
+        fail_if(buf[i] != (uint8_t)(1000 + 20 + i));
+    pico_frame_discard(f);
+
+    /* A retransmitted SYN is still that of the child */
+    f = tcp_test_fastopen(1000, PICO_TCP_SYN, cookie, TCP_FASTOPEN_COOKIE, 10);
+    fail_if(tcp_synrecv_syn(&child->sock, f) < 0);
+    pico_frame_discard(f);
+    PICO_FREE(t);
+}
+END_TEST
+
+/* Active open with Fast Open on, cookie cached first if not NULL, and 1500
+ * bytes written before the SYN went out */
+static struct pico_socket *tcp_test_fastopen_open(struct pico_ip4 *dst, const uint8_t *cookie, uint8_t *buf)
+{
+    struct pico_socket *s = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, NULL);
+    struct pico_frame *f;
+    int on = 1;
+
+    fail_if(!s);
+    fail_if(pico_socket_setoption(s, PICO_TCP_FASTOPEN, &on) < 0);
+    if (cookie) {
+        s->remote_addr.ip4.addr = dst->addr;
+        TCP_SOCK(s)->mss = 1000;
+        f = tcp_test_fastopen(5000, PICO_TCP_SYN | PICO_TCP_ACK, cookie, TCP_FASTOPEN_COOKIE, 0);
+        tcp_fastopen_synack(TCP_SOCK(s), f, 0);
+        pico_frame_discard(f);
+    }
+
+    fail_if(pico_socket_connect(s, dst, short_be(80)) < 0);
+    fail_if(pico_socket_send(s, buf, 1500) != 1500);
+    tcp_fastopen_connect(TCP_TIME, TCP_SOCK(s));
+    while ((f = pico_dequeue(pico_proto_tcp.q_out)) != NULL)
+        pico_frame_discard(f);
+    return s;
+}
+
+/* Sequence number after the last byte queued for output */
+static uint32_t tcp_test_out_end(struct pico_socket_tcp *t)
+{
+    struct pico_frame *f;
+
+    if (!t->tcpq_out.frames)
+        return 0;
+
+    f = TCP_RING_AT(&t->tcpq_out, t->tcpq_out.frames - 1u);
+    return SEQN(f) + f->payload_len;
+}
+
+START_TEST(tc_tcp_fastopen_synack)
+{
+    static uint8_t buf[1500];
+    struct pico_socket *s;
+    struct pico_socket_tcp *t;
+    struct pico_device *dev;
+    struct pico_ip4 local, dst, netmask;
+    struct pico_frame *f, *synack;
+    uint8_t cookie[TCP_FASTOPEN_COOKIE];
+    uint8_t len = 0xff;
+    uint32_t iss;
+
+    pico_stack_init();
+    local.addr = long_be(0x0a280002);
+    dst.addr = long_be(0x0a280003);
+    netmask.addr = long_be(0xFFFF0000);
+    dev = PICO_ZALLOC(sizeof(struct pico_device));
+    fail_if(!dev);
+    fail_if(pico_device_init(dev, "tfo", NULL) != 0);
+    dev->send = tcp_zc_dev_send;
+    fail_if(pico_ipv4_link_add(dev, local, netmask) < 0);
+    memset(cookie, 0xa5, sizeof(cookie));
+
+    /* A SYN-ACK acknowledging the SYN data: that data is done, the cookie stays */
+    s = tcp_test_fastopen_open(&dst, cookie, buf);
+    t = TCP_SOCK(s);
+    fail_if(t->syn_data == 0 || t->syn_data >= 1500);
+    iss = t->snd_nxt;
+    synack = tcp_test_segment(9000, 0, PICO_TCP_SYN | PICO_TCP_ACK);
+    ((struct pico_tcp_hdr *)synack->transport_hdr)->ack = long_be(iss + 1u + t->syn_data);
+    fail_if(tcp_synack(s, synack) < 0);
+    fail_if(TCPSTATE(s) != PICO_SOCKET_STATE_TCP_ESTABLISHED);
+    fail_if(t->snd_nxt != iss + 1u + t->syn_data);
+    f = first_segment(&t->tcpq_out);
+    fail_if(!f || (SEQN(f) != t->snd_nxt));
+    fail_if(tcp_test_out_end(t) != iss + 1u + 1500u);
+    fail_if(!tcp_fastopen_find(s));
+    pico_frame_discard(synack);
+
+    /* One acknowledging the SYN alone: the data goes again, without the cookie */
+    s = tcp_test_fastopen_open(&dst, NULL, buf);
+    t = TCP_SOCK(s);
+    fail_if(t->syn_data == 0);
+    iss = t->snd_nxt;
+    synack = tcp_test_segment(9000, 0, PICO_TCP_SYN | PICO_TCP_ACK);
+    ((struct pico_tcp_hdr *)synack->transport_hdr)->ack = long_be(iss + 1u);
+    fail_if(tcp_synack(s, synack) < 0);
+    fail_if(TCPSTATE(s) != PICO_SOCKET_STATE_TCP_ESTABLISHED);
+    fail_if(t->snd_nxt != iss + 1u);
+    f = first_segment(&t->tcpq_out);
+    fail_if(!f || (SEQN(f) != iss + 1u) || (f->payload_len != t->syn_data));
+    fail_if(tcp_test_out_end(t) != iss + 1u + 1500u);
+    fail_if(tcp_fastopen_find(s) != NULL);
+    pico_frame_discard(synack);
+
+    /* Without a cookie, the next SYN goes out at once and asks for one */
+    s = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, NULL);
+    fail_if(!s);
+    fail_if(pico_tcp_set_fastopen(s, 1) < 0);
+    while ((f = pico_dequeue(pico_proto_tcp.q_out)) != NULL)
+        pico_frame_discard(f);
+    fail_if(pico_socket_connect(s, &dst, short_be(80)) < 0);
+    f = pico_dequeue(pico_proto_tcp.q_out);
+    fail_if(!f);
+    fail_if(!tcp_fastopen_option(f, &len) || (len != 0));
+    pico_frame_discard(f);
+}
+END_TEST
+#endif
+#ifdef PICO_SUPPORT_TCP_AUTOTUNE
+START_TEST(tc_tcp_autotune)
+{
+    struct pico_socket_tcp *t = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    struct pico_socket_tcp *u = (struct pico_socket_tcp *)pico_tcp_open(PICO_PROTO_IPV4);
+    uint8_t shift = tcp_autotune_wscale(TCP_AUTOTUNE_DEFAULT);
+    uint32_t used = tcp_autotune_mem;
+    uint32_t ssthresh;
+    struct pico_frame f;
+
+    fail_if(!t || !u);
+    fail_if(t->autotune != (TCP_AUTOTUNE_RCV | TCP_AUTOTUNE_SND));
+
+    /* Slow start runs up to what the send queue can fill, headers aside */
+    t->mss = 1000;
+    t->autotune &= (uint8_t)~TCP_AUTOTUNE_SND;
+    tcp_cc_init(t);
+    fail_if(t->autotune & TCP_AUTOTUNE_SSTHRESH);
+    fail_if(t->cc.ssthresh > PICO_DEFAULT_SOCKETQ || t->cc.ssthresh < (PICO_DEFAULT_SOCKETQ / 4u) * 3u);
+    t->autotune |= TCP_AUTOTUNE_SND;
+    tcp_cc_init(t);
+    fail_if(!(t->autotune & TCP_AUTOTUNE_SSTHRESH));
+    fail_if(t->cc.ssthresh != tcp_ssthresh_queue(t));
+
+    /* The shift on our SYN covers the largest receive queue */
+    fail_if(tcp_autotune_wscale(0) != 0);
+    fail_if(shift == 0 || ((uint32_t)0xFFFFu << shift) < PICO_TCP_RMEM_MAX);
+    fail_if(((uint32_t)0xFFFFu << (shift - 1)) >= PICO_TCP_RMEM_MAX);
+
+    /* Windows keep that shift, except on SYNs */
+    t->rcv_wscale = shift;
+    tcp_set_space(t);
+    fail_if(t->wnd_scale != shift || t->wnd != (PICO_DEFAULT_SOCKETQ >> shift));
+    fail_if(tcp_syn_window(t) != PICO_DEFAULT_SOCKETQ);
+
+    /* Round trip of a receiver from the timestamps echoed, lowest samples kept */
+    memset(&f, 0, sizeof(f));
+    f.payload_len = 100;
+    f.timestamp = (uint32_t)TCP_TIME - 80u;
+    tcp_autotune_rcv_rtt(t, &f);
+    fail_if(t->rcv_rtt < 80 || t->rcv_rtt > 85);
+    t->rcv_rtt = 80;
+    f.timestamp = (uint32_t)TCP_TIME - 160u;
+    tcp_autotune_rcv_rtt(t, &f);
+    fail_if(t->rcv_rtt < 90 || t->rcv_rtt > 95);
+    f.timestamp = (uint32_t)TCP_TIME - 50u;
+    tcp_autotune_rcv_rtt(t, &f);
+    fail_if(t->rcv_rtt < 50 || t->rcv_rtt > 55);
+
+    /* Nothing is measured before a round trip is known */
+    t->rcv_rtt = 0;
+    t->rcv_processed = 1000;
+    tcp_autotune_rcv(t);
+    fail_if(t->rcv_space_stamp != 0);
+
+    /* The receive queue grows to twice what was read in a round trip */
+    t->rcv_rtt = 100;
+    tcp_autotune_rcv(t);
+    fail_if(t->rcv_space_seq != 1000 || t->tcpq_in.max_size != PICO_DEFAULT_SOCKETQ);
+    t->rcv_processed += 3 * PICO_DEFAULT_SOCKETQ;
+    tcp_autotune_rcv(t);
+    fail_if(t->tcpq_in.max_size != PICO_DEFAULT_SOCKETQ);
+    t->rcv_space_stamp -= 100;
+    tcp_autotune_rcv(t);
+    fail_if(t->tcpq_in.max_size != 6 * PICO_DEFAULT_SOCKETQ);
+    fail_if(tcp_autotune_mem != used + 5 * PICO_DEFAULT_SOCKETQ);
+    t->rcv_processed += PICO_TCP_RMEM_MAX;
+    t->rcv_space_stamp -= 100;
+    tcp_autotune_rcv(t);
+    fail_if(t->tcpq_in.max_size != PICO_TCP_RMEM_MAX);
+
+    /* Without window scaling, only up to what a window can tell */
+    u->rcv_rtt = 100;
+    u->rcv_space_stamp = TCP_TIME - 100;
+    u->rcv_processed = PICO_TCP_RMEM_MAX;
+    tcp_autotune_rcv(u);
+    fail_if(u->tcpq_in.max_size != 0xFFFFu);
+
+    /* The send queue grows to two congestion windows once a write did not fit */
+    t->cc.cwnd = 20 * PICO_DEFAULT_SOCKETQ;
+    tcp_autotune_snd(t);
+    fail_if(t->tcpq_out.max_size != PICO_DEFAULT_SOCKETQ);
+    t->autotune |= TCP_AUTOTUNE_SND_FULL;
+    tcp_autotune_snd(t);
+    fail_if(t->tcpq_out.max_size != 40 * PICO_DEFAULT_SOCKETQ);
+    fail_if(t->autotune & TCP_AUTOTUNE_SND_FULL);
+
+    /* ...and ssthresh with it, until a loss sets it */
+    fail_if(t->cc.ssthresh != tcp_ssthresh_queue(t) || t->cc.ssthresh < 30 * PICO_DEFAULT_SOCKETQ);
+    tcp_first_timeout(t);
+    fail_if(t->autotune & TCP_AUTOTUNE_SSTHRESH);
+    ssthresh = t->cc.ssthresh;
+    t->cc.cwnd = 30 * PICO_DEFAULT_SOCKETQ;
+    t->autotune |= TCP_AUTOTUNE_SND_FULL;
+    tcp_autotune_snd(t);
+    fail_if(t->tcpq_out.max_size != 60 * PICO_DEFAULT_SOCKETQ);
+    fail_if(t->cc.ssthresh != ssthresh);
+
+    /* All connections share PICO_TCP_AUTOTUNE_MEM */
+    u->cc.cwnd = PICO_TCP_WMEM_MAX;
+    u->autotune |= TCP_AUTOTUNE_SND_FULL;
+    tcp_autotune_snd(u);
+    fail_if(tcp_autotune_mem != PICO_TCP_AUTOTUNE_MEM);
+    fail_if(u->tcpq_out.max_size >= PICO_TCP_WMEM_MAX);
+
+    /* A size set by the application stops the tuning and gives the memory back */
+    fail_if(pico_tcp_set_bufsize_in(&t->sock, 4096) < 0);
+    fail_if(t->autotune & TCP_AUTOTUNE_RCV);
+    fail_if(tcp_autotune_mem != PICO_TCP_AUTOTUNE_MEM - (PICO_TCP_RMEM_MAX - PICO_DEFAULT_SOCKETQ));
+    t->rcv_processed += PICO_TCP_RMEM_MAX;
+    t->rcv_space_stamp -= 100;
+    tcp_autotune_rcv(t);
+    fail_if(t->tcpq_in.max_size != 4096);
+    tcp_autotune_release(t, TCP_AUTOTUNE_RCV | TCP_AUTOTUNE_SND);
+    tcp_autotune_release(u, TCP_AUTOTUNE_RCV | TCP_AUTOTUNE_SND);
+    fail_if(tcp_autotune_mem != used);
+    PICO_FREE(t);
+    PICO_FREE(u);
+}
+END_TEST
+#endif
 START_TEST(tc_tcp_set_init_point)
 {
     /* TODO: test this: static void tcp_set_init_point(struct pico_socket *s) */
@@ -662,6 +2232,8 @@ Suite *pico_suite(void)
 
     TCase *TCase_input_segment_compare = tcase_create("Unit test for input_segment_compare");
     TCase *TCase_tcp_input_segment = tcase_create("Unit test for tcp_input_segment");
+    TCase *TCase_tcp_read_zerocopy = tcase_create("Unit test for pico_tcp_read_zerocopy");
+    TCase *TCase_tcp_send_zerocopy = tcase_create("Unit test for TCP zero-copy send");
     TCase *TCase_segment_compare = tcase_create("Unit test for segment_compare");
     TCase *TCase_tcp_discard_all_segments = tcase_create("Unit test for tcp_discard_all_segments");
     TCase *TCase_release_until = tcase_create("Unit test for release_until");
@@ -676,6 +2248,7 @@ Suite *pico_suite(void)
     TCase *TCase_tcp_set_space = tcase_create("Unit test for tcp_set_space");
     TCase *TCase_tcp_options_size = tcase_create("Unit test for tcp_options_size");
     TCase *TCase_tcp_process_sack = tcase_create("Unit test for tcp_process_sack");
+    TCase *TCase_tcp_retrans_options = tcase_create("Unit test for the options of a retransmitted segment");
     TCase *TCase_tcp_rcv_sack = tcase_create("Unit test for tcp_rcv_sack");
     TCase *TCase_tcp_parse_options = tcase_create("Unit test for tcp_parse_options");
     TCase *TCase_tcp_send = tcase_create("Unit test for tcp_send");
@@ -692,6 +2265,19 @@ Suite *pico_suite(void)
     TCase *TCase_time_diff = tcase_create("Unit test for time_diff");
     TCase *TCase_tcp_rtt = tcase_create("Unit test for tcp_rtt");
     TCase *TCase_tcp_congestion_control = tcase_create("Unit test for tcp_congestion_control");
+    TCase *TCase_tcp_cubic = tcase_create("Unit test for CUBIC congestion control");
+    TCase *TCase_tcp_congestion_option = tcase_create("Unit test for PICO_TCP_CONGESTION");
+    TCase *TCase_tcp_pacing = tcase_create("Unit test for TCP pacing");
+    TCase *TCase_tcp_info = tcase_create("Unit test for PICO_TCP_INFO");
+    TCase *TCase_tcp_ring = tcase_create("Unit test for the output queue ring");
+    TCase *TCase_tcp_prr = tcase_create("Unit test for SACK recovery rate and tail loss probe");
+    TCase *TCase_tcp_delack = tcase_create("Unit test for delayed ACKs");
+#ifdef PICO_SUPPORT_TCP_GSO
+    TCase *TCase_tcp_gso_segment = tcase_create("Unit test for TCP segmentation offload");
+#endif
+#ifdef PICO_SUPPORT_TCP_GRO
+    TCase *TCase_tcp_gro_merge = tcase_create("Unit test for TCP receive coalescing");
+#endif
     TCase *TCase_add_retransmission_timer = tcase_create("Unit test for add_retransmission_timer");
     TCase *TCase_tcp_first_timeout = tcase_create("Unit test for tcp_first_timeout");
     TCase *TCase_tcp_rto_xmit = tcase_create("Unit test for tcp_rto_xmit");
@@ -707,6 +2293,16 @@ Suite *pico_suite(void)
     TCase *TCase_tcp_closewaitack = tcase_create("Unit test for tcp_closewaitack");
     TCase *TCase_tcp_lastackwait = tcase_create("Unit test for tcp_lastackwait");
     TCase *TCase_tcp_syn = tcase_create("Unit test for tcp_syn");
+#ifdef PICO_SUPPORT_TCP_TIMEWAIT
+    TCase *TCase_tcp_time_wait = tcase_create("Unit test for TIME_WAIT records");
+#endif
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    TCase *TCase_tcp_fastopen = tcase_create("Unit test for TCP Fast Open");
+    TCase *TCase_tcp_fastopen_synack = tcase_create("Unit test for the SYN-ACK of a Fast Open");
+#endif
+#ifdef PICO_SUPPORT_TCP_AUTOTUNE
+    TCase *TCase_tcp_autotune = tcase_create("Unit test for TCP buffer autotuning");
+#endif
     TCase *TCase_tcp_set_init_point = tcase_create("Unit test for tcp_set_init_point");
     TCase *TCase_tcp_synack = tcase_create("Unit test for tcp_synack");
     TCase *TCase_tcp_first_ack = tcase_create("Unit test for tcp_first_ack");
@@ -728,6 +2324,10 @@ Suite *pico_suite(void)
     suite_add_tcase(s, TCase_input_segment_compare);
     tcase_add_test(TCase_tcp_input_segment, tc_tcp_input_segment);
     suite_add_tcase(s, TCase_tcp_input_segment);
+    tcase_add_test(TCase_tcp_read_zerocopy, tc_tcp_read_zerocopy);
+    suite_add_tcase(s, TCase_tcp_read_zerocopy);
+    tcase_add_test(TCase_tcp_send_zerocopy, tc_tcp_send_zerocopy);
+    suite_add_tcase(s, TCase_tcp_send_zerocopy);
     tcase_add_test(TCase_segment_compare, tc_segment_compare);
     suite_add_tcase(s, TCase_segment_compare);
     tcase_add_test(TCase_tcp_discard_all_segments, tc_tcp_discard_all_segments);
@@ -756,6 +2356,8 @@ Suite *pico_suite(void)
     suite_add_tcase(s, TCase_tcp_options_size);
     tcase_add_test(TCase_tcp_process_sack, tc_tcp_process_sack);
     suite_add_tcase(s, TCase_tcp_process_sack);
+    tcase_add_test(TCase_tcp_retrans_options, tc_tcp_retrans_options);
+    suite_add_tcase(s, TCase_tcp_retrans_options);
     tcase_add_test(TCase_tcp_rcv_sack, tc_tcp_rcv_sack);
     suite_add_tcase(s, TCase_tcp_rcv_sack);
     tcase_add_test(TCase_tcp_parse_options, tc_tcp_parse_options);
@@ -788,6 +2390,28 @@ Suite *pico_suite(void)
     suite_add_tcase(s, TCase_tcp_rtt);
     tcase_add_test(TCase_tcp_congestion_control, tc_tcp_congestion_control);
     suite_add_tcase(s, TCase_tcp_congestion_control);
+    tcase_add_test(TCase_tcp_cubic, tc_tcp_cubic);
+    suite_add_tcase(s, TCase_tcp_cubic);
+    tcase_add_test(TCase_tcp_congestion_option, tc_tcp_congestion_option);
+    suite_add_tcase(s, TCase_tcp_congestion_option);
+    tcase_add_test(TCase_tcp_pacing, tc_tcp_pacing);
+    suite_add_tcase(s, TCase_tcp_pacing);
+    tcase_add_test(TCase_tcp_info, tc_tcp_info);
+    suite_add_tcase(s, TCase_tcp_info);
+    tcase_add_test(TCase_tcp_ring, tc_tcp_ring);
+    suite_add_tcase(s, TCase_tcp_ring);
+    tcase_add_test(TCase_tcp_prr, tc_tcp_prr);
+    suite_add_tcase(s, TCase_tcp_prr);
+    tcase_add_test(TCase_tcp_delack, tc_tcp_delack);
+    suite_add_tcase(s, TCase_tcp_delack);
+#ifdef PICO_SUPPORT_TCP_GSO
+    tcase_add_test(TCase_tcp_gso_segment, tc_tcp_gso_segment);
+    suite_add_tcase(s, TCase_tcp_gso_segment);
+#endif
+#ifdef PICO_SUPPORT_TCP_GRO
+    tcase_add_test(TCase_tcp_gro_merge, tc_tcp_gro_merge);
+    suite_add_tcase(s, TCase_tcp_gro_merge);
+#endif
     tcase_add_test(TCase_add_retransmission_timer, tc_add_retransmission_timer);
     suite_add_tcase(s, TCase_add_retransmission_timer);
     tcase_add_test(TCase_tcp_first_timeout, tc_tcp_first_timeout);
@@ -818,6 +2442,20 @@ Suite *pico_suite(void)
     suite_add_tcase(s, TCase_tcp_lastackwait);
     tcase_add_test(TCase_tcp_syn, tc_tcp_syn);
     suite_add_tcase(s, TCase_tcp_syn);
+#ifdef PICO_SUPPORT_TCP_TIMEWAIT
+    tcase_add_test(TCase_tcp_time_wait, tc_tcp_time_wait);
+    suite_add_tcase(s, TCase_tcp_time_wait);
+#endif
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    tcase_add_test(TCase_tcp_fastopen, tc_tcp_fastopen);
+    suite_add_tcase(s, TCase_tcp_fastopen);
+    tcase_add_test(TCase_tcp_fastopen_synack, tc_tcp_fastopen_synack);
+    suite_add_tcase(s, TCase_tcp_fastopen_synack);
+#endif
+#ifdef PICO_SUPPORT_TCP_AUTOTUNE
+    tcase_add_test(TCase_tcp_autotune, tc_tcp_autotune);
+    suite_add_tcase(s, TCase_tcp_autotune);
+#endif
     tcase_add_test(TCase_tcp_set_init_point, tc_tcp_set_init_point);
     suite_add_tcase(s, TCase_tcp_set_init_point);
     tcase_add_test(TCase_tcp_synack, tc_tcp_synack);
@@ -61,6 +61,106 @@ START_TEST(tc_q)
 }
 END_TEST
 
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+#include <pthread.h>
+
+#define RING_FRAMES 100000
+
+/* Empty frames go to the producer through 'free', filled ones come back
+ * through 'q': the producer never allocates nor frees */
+static struct pico_queue ring_free = {
+    0
+};
+
+static void *ring_producer(void *arg)
+{
+    struct pico_queue *q = (struct pico_queue *)arg;
+    struct pico_frame *f;
+    uint32_t i;
+
+    for (i = 0; i < RING_FRAMES; i++) {
+        while (!(f = pico_dequeue(&ring_free)))
+            sched_yield();
+
+        memcpy(f->buffer, &i, sizeof(i));
+        while (pico_enqueue(q, f) <= 0)
+            sched_yield();
+    }
+    return q;
+}
+
+START_TEST(tc_q_ring)
+{
+    struct pico_queue q = {
+        0
+    };
+    struct pico_frame *f[4], *b[4];
+    struct pico_frame *p;
+    pthread_t th;
+    void *ret = NULL;
+    uint32_t i, seq;
+    int k;
+
+    fail_if(pico_queue_ring_init(&q, 0) == 0);
+    fail_if(pico_queue_ring_init(&q, 3) != 0);
+    fail_if(q.ring_mask != 3);
+    fail_if(pico_queue_ring_init(&q, 8) == 0);
+
+    /* Same accounting and limits as the list mode */
+    q.max_frames = 3;
+    for (k = 0; k < 4; k++)
+        f[k] = pico_frame_alloc(100);
+    fail_if(pico_enqueue(&q, f[0]) != 100);
+    fail_if(pico_enqueue(&q, f[1]) != 200);
+    fail_if(pico_enqueue(&q, f[2]) != 300);
+    fail_if(pico_enqueue(&q, f[3]) >= 0);
+    q.max_frames = 0;
+    fail_if(pico_enqueue(&q, f[3]) != 400);
+    fail_if(q.frames != 4);
+    fail_if(pico_queue_peek(&q) != f[0]);
+    fail_if(pico_dequeue(&q) != f[0]);
+    fail_if(pico_enqueue(&q, f[0]) != 400);
+    fail_if(pico_queue_peek_batch(&q, b, 4) != 4);
+    fail_if(b[0] != f[1] || b[3] != f[0]);
+    pico_queue_empty(&q);
+    fail_if(q.frames != 0);
+    fail_if(q.size != 0);
+    fail_if(pico_dequeue(&q) != NULL);
+    fail_if(pico_queue_peek(&q) != NULL);
+
+    /* One producer thread, one consumer: nothing lost or reordered */
+    fail_if(pico_queue_ring_init(&ring_free, 16) != 0);
+    fail_if(pthread_create(&th, NULL, ring_producer, &q) != 0);
+    for (seq = 0, i = 0; seq < RING_FRAMES; ) {
+        /* The consumer side allocates and frees */
+        while ((i < RING_FRAMES) && !pico_queue_ring_full(&ring_free)) {
+            p = pico_frame_alloc(4);
+            fail_if(!p);
+            fail_if(pico_enqueue(&ring_free, p) <= 0);
+            i++;
+        }
+
+        p = pico_dequeue(&q);
+        if (!p) {
+            sched_yield();
+            continue;
+        }
+
+        fail_if(memcmp(p->buffer, &seq, sizeof(seq)) != 0);
+        pico_frame_discard(p);
+        seq++;
+    }
+    fail_if(pthread_join(th, &ret) != 0);
+    fail_if(ret != &q);
+    fail_if(q.frames != 0);
+    fail_if(q.size != 0);
+    fail_if(ring_free.frames != 0);
+    pico_queue_deinit(&q);
+    pico_queue_deinit(&ring_free);
+    fail_if(q.ring != NULL);
+}
+END_TEST
+#endif
 
 Suite *pico_suite(void)
 {
@@ -69,6 +169,9 @@ Suite *pico_suite(void)
     TCase *TCase_q = tcase_create("Unit test for pico_queue.c");
     tcase_add_test(TCase_q, tc_q);
     suite_add_tcase(s, TCase_q);
+#ifdef PICO_SUPPORT_SPSC_QUEUE
+    tcase_add_test(TCase_q, tc_q_ring);
+#endif
     return s;
 }
 
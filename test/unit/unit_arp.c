@@ -94,7 +94,7 @@ START_TEST(tc_pico_arp_queue)
     pico_arp_postpone(f);
     fail_if(frames_queued[0]->buffer != f->buffer);
     pico_arp_unreachable(&addr);
-    PICO_FREE(f);
+    pico_frame_discard(f);
 }
 END_TEST
 
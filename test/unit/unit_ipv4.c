@@ -306,7 +306,7 @@ START_TEST (test_ipfilter)
     ret = pico_ipv4_filter_del(filter_id1);
     fail_if(ret != -1, "Deleting non existing filter failed\n");
 
-    f = (struct pico_frame *)PICO_ZALLOC(200);
+    f = (struct pico_frame *)PICO_ZALLOC(sizeof(struct pico_frame));
     f->buffer = PICO_ZALLOC(20);
     f->usage_count = PICO_ZALLOC(sizeof(uint32_t));
     f->buffer = ipv4_buf;
@@ -338,7 +338,7 @@ START_TEST (test_ipfilter)
     filter_id1 = pico_ipv4_filter_add(dev, proto, &src_addr, &saddr_netmask, &dst_addr, &daddr_netmask, sport, dport, priority, tos, FILTER_DROP);
     fail_if(filter_id1 <= 0, "Error adding masked filter\n");
 
-    f = (struct pico_frame *)PICO_ZALLOC(200);
+    f = (struct pico_frame *)PICO_ZALLOC(sizeof(struct pico_frame));
     f->buffer = PICO_ZALLOC(20);
     f->usage_count = PICO_ZALLOC(sizeof(uint32_t));
     f->buffer = ipv4_buf;
@@ -358,7 +358,7 @@ START_TEST (test_ipfilter)
     filter_id1 = pico_ipv4_filter_add(dev, proto, &src_addr, &saddr_netmask, &dst_addr, &daddr_netmask, sport, dport, priority, tos, FILTER_DROP);
     fail_if(filter_id1 <= 0, "Error adding bad filter\n");
 
-    f = (struct pico_frame *)PICO_ZALLOC(200);
+    f = (struct pico_frame *)PICO_ZALLOC(sizeof(struct pico_frame));
     f->buffer = PICO_ZALLOC(20);
     f->usage_count = PICO_ZALLOC(sizeof(uint32_t));
     f->buffer = ipv4_buf;
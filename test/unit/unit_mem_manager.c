@@ -8,7 +8,7 @@
 #include "pico_tree.c"
 #include <check.h>
 
-volatile pico_err_t pico_err;
+PICO_TLS volatile pico_err_t pico_err;
 
 START_TEST (test_compare_slab_keys)
 {
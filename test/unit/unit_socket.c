@@ -412,6 +412,248 @@ START_TEST (test_socket)
 }
 END_TEST
 
+#ifdef PICO_SUPPORT_FLOW_TABLE
+START_TEST (test_socket_flow_table)
+{
+    struct pico_socket *sk[300], *s6, *sl;
+    struct pico_ip4 local;
+    struct pico_ip6 local6, remote6;
+    uint8_t buf[PICO_SIZE_IP6HDR + PICO_SIZE_TRANS];
+    struct pico_ipv4_hdr *hdr = (struct pico_ipv4_hdr *) buf;
+    struct pico_ipv6_hdr *hdr6 = (struct pico_ipv6_hdr *) buf;
+    struct pico_trans *tr;
+    struct pico_frame f;
+    uint16_t i;
+
+    printf("START SOCKET FLOW TABLE TEST\n");
+    pico_stack_init();
+    pico_string_to_ipv4("10.40.0.2", &local.addr);
+    memset(&f, 0, sizeof(f));
+    memset(buf, 0, sizeof(buf));
+
+    /* A listener and enough connections on the same port to grow the table */
+    sl = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, NULL);
+    fail_if(!sl);
+    sl->local_port = short_be(80);
+    fail_if(pico_socket_add(sl) != 0);
+    for (i = 0; i < 300; i++) {
+        sk[i] = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, NULL);
+        fail_if(!sk[i]);
+        sk[i]->local_port = short_be(80);
+        sk[i]->local_addr.ip4 = local;
+        sk[i]->remote_addr.ip4.addr = long_be(0x0a280000u + (uint32_t)(i % 7));
+        sk[i]->remote_port = short_be((uint16_t)(1024 + i));
+        fail_if(pico_socket_add(sk[i]) != 0);
+    }
+
+    hdr->vhl = 0x45;
+    hdr->dst = local;
+    f.net_hdr = buf;
+    f.transport_hdr = buf + PICO_SIZE_IP4HDR;
+    tr = (struct pico_trans *) f.transport_hdr;
+    tr->dport = short_be(80);
+    for (i = 0; i < 300; i++) {
+        hdr->src.addr = long_be(0x0a280000u + (uint32_t)(i % 7));
+        tr->sport = short_be((uint16_t)(1024 + i));
+        fail_if(pico_socket_flow_find(PICO_PROTO_TCP, &f) != sk[i]);
+    }
+    fail_if(pico_socket_flow_find(PICO_PROTO_UDP, &f) != NULL);
+    hdr->src.addr = long_be(0x0a2800ffu);
+    fail_if(pico_socket_flow_find(PICO_PROTO_TCP, &f) != NULL);
+
+    /* Removed sockets are no longer found */
+    hdr->src.addr = long_be(0x0a280000u + 5u);
+    tr->sport = short_be(1024 + 5);
+    fail_if(pico_socket_del(sk[5]) != 0);
+    fail_if(pico_socket_flow_find(PICO_PROTO_TCP, &f) != NULL);
+    for (i = 0; i < 300; i++)
+        if (i != 5)
+            pico_socket_del(sk[i]);
+    pico_socket_del(sl);
+
+    /* Same for IPv6 */
+    pico_string_to_ipv6("2001:db8::1", local6.addr);
+    pico_string_to_ipv6("2001:db8::2", remote6.addr);
+    s6 = pico_socket_open(PICO_PROTO_IPV6, PICO_PROTO_UDP, NULL);
+    fail_if(!s6);
+    s6->local_port = short_be(5353);
+    s6->local_addr.ip6 = local6;
+    s6->remote_addr.ip6 = remote6;
+    s6->remote_port = short_be(4000);
+    fail_if(pico_socket_add(s6) != 0);
+    memset(buf, 0, sizeof(buf));
+    hdr6->vtf = long_be(0x60000000u);
+    hdr6->src = remote6;
+    hdr6->dst = local6;
+    f.transport_hdr = buf + PICO_SIZE_IP6HDR;
+    tr = (struct pico_trans *) f.transport_hdr;
+    tr->sport = short_be(4000);
+    tr->dport = short_be(5353);
+    fail_if(pico_socket_flow_find(PICO_PROTO_UDP, &f) != s6);
+    tr->sport = short_be(4001);
+    fail_if(pico_socket_flow_find(PICO_PROTO_UDP, &f) != NULL);
+    pico_socket_del(s6);
+}
+END_TEST
+#endif
+
+static int zc_done_calls;
+static const void *zc_done_buf;
+static int zc_done_len;
+
+static void zc_done(const void *buf, int len, void *arg)
+{
+    zc_done_calls++;
+    zc_done_buf = buf;
+    zc_done_len = len;
+    fail_if(arg != &zc_done_calls);
+}
+
+START_TEST (test_socket_send_zerocopy)
+{
+    static uint8_t buf[3000];
+    struct pico_socket *sk_udp, *sk_udp2, *sk_tcp;
+    struct pico_device *dev;
+    struct pico_ip4 local, dst, netmask;
+    uint16_t port = short_be(5555), port2 = short_be(5556);
+    int i, ret;
+
+    printf("START SOCKET ZEROCOPY SEND TEST\n");
+    pico_stack_init();
+    pico_string_to_ipv4("10.40.0.2", &local.addr);
+    pico_string_to_ipv4("10.40.0.3", &dst.addr);
+    netmask.addr = long_be(0xFFFF0000);
+    dev = pico_null_create("zc");
+    fail_if(!dev);
+    fail_if(pico_ipv4_link_add(dev, local, netmask) < 0);
+
+    sk_udp = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_UDP, NULL);
+    fail_if(!sk_udp);
+    fail_if(pico_socket_bind(sk_udp, &local, &port) < 0);
+
+    /* Wrong arguments */
+    fail_if(pico_socket_sendto_zerocopy(NULL, buf, 100, &dst, port, zc_done, NULL) != -1);
+    fail_if(pico_socket_sendto_zerocopy(sk_udp, buf, 100, &dst, port, NULL, NULL) != -1);
+    fail_if(pico_socket_sendto_zerocopy(sk_udp, buf, 0, &dst, port, zc_done, NULL) != -1);
+    fail_if(pico_socket_send_zerocopy(sk_udp, buf, 100, zc_done, NULL) != -1);
+    fail_if(pico_err != PICO_ERR_ENOTCONN);
+
+    /* Zero-copy datagrams are not fragmented; nothing queued, no callback */
+    fail_if(pico_socket_sendto_zerocopy(sk_udp, buf, (int)sizeof(buf), &dst, port, zc_done, &zc_done_calls) != -1);
+    fail_if(pico_err != PICO_ERR_EINVAL);
+    fail_if(zc_done_calls != 0);
+
+    /* The buffer is in use until the device has sent the datagram */
+    ret = pico_socket_sendto_zerocopy(sk_udp, buf, 1000, &dst, port, zc_done, &zc_done_calls);
+    fail_if(ret != 1000, "zerocopy sendto returned %d: %s", ret, strerror(pico_err));
+    fail_if(zc_done_calls != 0);
+    fail_if(pico_socket_sendto_zerocopy(sk_udp, buf, 1000, &dst, port, zc_done, &zc_done_calls) != -1);
+    fail_if(pico_err != PICO_ERR_EBUSY);
+    for (i = 0; (i < 100) && !zc_done_calls; i++)
+        pico_stack_tick();
+    fail_if(zc_done_calls != 1);
+    fail_if(zc_done_buf != buf || zc_done_len != 1000);
+
+    /* Once done, the same buffer can be sent again */
+    fail_if(pico_socket_sendto_zerocopy(sk_udp, buf, 1000, &dst, port, zc_done, &zc_done_calls) != 1000);
+    for (i = 0; (i < 100) && (zc_done_calls < 2); i++)
+        pico_stack_tick();
+    fail_if(zc_done_calls != 2);
+
+    /* The key is the buffer alone: busy on any socket, other buffers are not */
+    sk_udp2 = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_UDP, NULL);
+    fail_if(!sk_udp2);
+    fail_if(pico_socket_bind(sk_udp2, &local, &port2) < 0);
+    fail_if(pico_socket_sendto_zerocopy(sk_udp, buf, 1000, &dst, port, zc_done, &zc_done_calls) != 1000);
+    fail_if(pico_socket_sendto_zerocopy(sk_udp2, buf, 1000, &dst, port, zc_done, &zc_done_calls) != -1);
+    fail_if(pico_err != PICO_ERR_EBUSY);
+    fail_if(pico_socket_sendto_zerocopy(sk_udp2, buf + 1000, 1000, &dst, port, zc_done, &zc_done_calls) != 1000);
+    for (i = 0; (i < 100) && (zc_done_calls < 4); i++)
+        pico_stack_tick();
+    fail_if(zc_done_calls != 4);
+    pico_socket_close(sk_udp2);
+    pico_socket_close(sk_udp);
+
+    /* TCP needs a connection */
+    sk_tcp = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, NULL);
+    fail_if(!sk_tcp);
+    fail_if(pico_socket_send_zerocopy(sk_tcp, buf, 100, zc_done, NULL) != -1);
+    fail_if(pico_err != PICO_ERR_ENOTCONN);
+    pico_socket_close(sk_tcp);
+    fail_if(zc_done_calls != 4);
+}
+END_TEST
+
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+START_TEST (test_socket_sendto_fastopen)
+{
+    static uint8_t buf[100];
+    struct pico_socket *sk_tcp;
+    struct pico_device *dev;
+    struct pico_frame *synack;
+    struct pico_ip4 local, dst, netmask;
+    uint16_t port = short_be(80);
+    int on = 1, i;
+
+    printf("START SOCKET FAST OPEN SENDTO TEST\n");
+    pico_stack_init();
+    local.addr = long_be(0x0a320002);
+    dst.addr = long_be(0x0a320003);
+    netmask.addr = long_be(0xFFFF0000);
+    dev = pico_null_create("tfo");
+    fail_if(!dev);
+    fail_if(pico_ipv4_link_add(dev, local, netmask) < 0);
+
+    /* Without Fast Open, sendto() does not connect a TCP socket */
+    sk_tcp = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, NULL);
+    fail_if(!sk_tcp);
+    fail_if(pico_socket_sendto(sk_tcp, buf, (int)sizeof(buf), &dst, port) > 0);
+    fail_if(sk_tcp->state & PICO_SOCKET_STATE_CONNECTED);
+    pico_socket_close(sk_tcp);
+
+    /* With it, sendto() connects and queues the data behind the SYN */
+    sk_tcp = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, NULL);
+    fail_if(!sk_tcp);
+    fail_if(pico_socket_setoption(sk_tcp, PICO_TCP_FASTOPEN, &on) < 0);
+    fail_if(pico_socket_sendto(sk_tcp, buf, (int)sizeof(buf), &dst, port) != (int)sizeof(buf));
+    fail_if(!(sk_tcp->state & PICO_SOCKET_STATE_CONNECTED));
+    fail_if(TCPSTATE(sk_tcp) != PICO_SOCKET_STATE_TCP_SYN_SENT);
+    fail_if(sk_tcp->remote_port != port || sk_tcp->remote_addr.ip4.addr != dst.addr);
+    fail_if(TCP_SOCK(sk_tcp)->tcpq_out.frames != 1);
+    fail_if(TCP_SOCK(sk_tcp)->syn_data != 0);
+
+    /* Once connecting, it is not connected again */
+    fail_if(pico_socket_sendto(sk_tcp, buf, (int)sizeof(buf), &dst, port) != (int)sizeof(buf));
+    fail_if(TCP_SOCK(sk_tcp)->tcpq_out.frames != 2);
+
+    /* The server gives a cookie: the next connection sends its data on the SYN */
+    synack = pico_frame_alloc(PICO_SIZE_TCPHDR + 20);
+    fail_if(!synack);
+    synack->transport_hdr = synack->start;
+    synack->transport_len = PICO_SIZE_TCPHDR + 20;
+    memset(synack->transport_hdr, PICO_TCP_OPTION_NOOP, synack->transport_len);
+    ((struct pico_tcp_hdr *)synack->transport_hdr)->len = (uint8_t)((PICO_SIZE_TCPHDR + 20) << 2);
+    synack->transport_hdr[PICO_SIZE_TCPHDR] = PICO_TCP_OPTION_FASTOPEN;
+    synack->transport_hdr[PICO_SIZE_TCPHDR + 1] = PICO_TCPOPTLEN_FASTOPEN + 8;
+    tcp_fastopen_synack(TCP_SOCK(sk_tcp), synack, 0);
+    pico_frame_discard(synack);
+    pico_socket_close(sk_tcp);
+
+    sk_tcp = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, NULL);
+    fail_if(!sk_tcp);
+    fail_if(pico_socket_setoption(sk_tcp, PICO_TCP_FASTOPEN, &on) < 0);
+    fail_if(pico_socket_sendto(sk_tcp, buf, (int)sizeof(buf), &dst, port) != (int)sizeof(buf));
+    fail_if(TCPSTATE(sk_tcp) != PICO_SOCKET_STATE_TCP_SYN_SENT);
+    for (i = 0; (i < 10) && !TCP_SOCK(sk_tcp)->syn_data; i++) {
+        usleep(2000);
+        pico_stack_tick();
+    }
+    fail_if(TCP_SOCK(sk_tcp)->syn_data != sizeof(buf));
+    pico_socket_close(sk_tcp);
+}
+END_TEST
+#endif
+
 #ifdef PICO_SUPPORT_CRC_FAULTY_UNIT_TEST
 START_TEST (test_crc_check)
 {
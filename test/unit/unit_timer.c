@@ -1,6 +1,129 @@
 #define EXISTING_TIMERS 7
 
 
+#ifdef PICO_SUPPORT_TIMER_WHEEL
+static struct pico_timer *timer_wheel_find(uint32_t id)
+{
+    struct pico_timer *t = Timers->ids[timer_wheel_bucket(id)];
+    while (t && (t->id != id))
+        t = t->id_next;
+    return t;
+}
+
+START_TEST (test_timers)
+{
+    uint32_t T[128];
+    uint32_t armed;
+    int i;
+    struct pico_timer *t;
+    pico_stack_init();
+    armed = Timers->n;
+    for (i = 0; i < 128; i++) {
+        pico_time expire = (pico_time)(999999 + i);
+        void (*timer)(pico_time, void *) =(void (*)(pico_time, void *))0xff00 + i;
+        void *arg = ((void*)0xaa00 + i);
+
+        T[i] = pico_timer_add(expire, timer, arg);
+        printf("New timer %u\n", T[i]);
+    }
+    fail_unless(Timers->n == armed + 128);
+    for (i = 0; i < 128; i++) {
+        void (*timer)(pico_time, void *) =(void (*)(pico_time, void *))0xff00 + i;
+        void *arg = ((void*)0xaa00 + i);
+
+        t = timer_wheel_find(T[i]);
+        fail_if(!t);
+        fail_unless(t->timer == timer);
+        fail_unless(t->arg == arg);
+    }
+    for (i = 127; i >= 0; i--) {
+        pico_timer_cancel(T[i]);
+        fail_unless(timer_wheel_find(T[i]) == NULL);
+    }
+    fail_unless(Timers->n == armed);
+    pico_stack_tick();
+    pico_stack_tick();
+    pico_stack_tick();
+    pico_stack_tick();
+}
+END_TEST
+
+static int timer_wheel_fired[6];
+
+static void timer_wheel_cb(pico_time now, void *arg)
+{
+    IGNORE_PARAMETER(now);
+    timer_wheel_fired[(int)(uintptr_t)arg]++;
+}
+
+/* Free a private wheel with whatever timers it still holds */
+static void timer_wheel_free(struct pico_timer_wheel *w)
+{
+    struct pico_timer *t;
+    uint32_t i;
+
+    for (i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        while ((t = w->slot[i]) != NULL) {
+            w->slot[i] = t->next;
+            PICO_FREE(t);
+        }
+    }
+    while ((t = w->pool) != NULL) {
+        w->pool = t->next;
+        PICO_FREE(t);
+    }
+    PICO_FREE(w->ids);
+    PICO_FREE(w);
+}
+
+START_TEST (test_timer_wheel_cascade)
+{
+    /* One timer per level, plus one beyond the horizon of the wheel */
+    const pico_time delay[6] = {
+        0, 5, 300, 20000, 2000000, 100000000
+    };
+    uint32_t T[6];
+    pico_time expire[6];
+    int i, j;
+    struct pico_timer_wheel *stack_timers = Timers;
+    /* A private wheel: stack timers would re-arm against the wall clock */
+    Timers = pico_timer_wheel_init();
+    fail_if(!Timers);
+    memset(timer_wheel_fired, 0, sizeof(timer_wheel_fired));
+    for (i = 0; i < 6; i++) {
+        T[i] = pico_timer_add(delay[i], timer_wheel_cb, (void *)(uintptr_t)i);
+        fail_if(T[i] == 0);
+        expire[i] = timer_wheel_find(T[i])->expire;
+    }
+    for (i = 0; i < 6; i++) {
+        pico_timer_wheel_run(expire[i]);
+        for (j = 0; j < 6; j++)
+            fail_unless(timer_wheel_fired[j] == (j < i ? 1 : 0));
+        pico_timer_wheel_run(expire[i] + 1);
+        fail_unless(timer_wheel_fired[i] == 1);
+        fail_unless(timer_wheel_find(T[i]) == NULL);
+    }
+
+    /* Cancel in the middle of a cascade chain, and by hash */
+    timer_wheel_free(Timers);
+    Timers = pico_timer_wheel_init();
+    fail_if(!Timers);
+    T[0] = pico_timer_add(20000, timer_wheel_cb, (void *)(uintptr_t)0);
+    T[1] = pico_timer_add_hashed(20000, timer_wheel_cb, (void *)(uintptr_t)1, 0xbeef);
+    T[2] = pico_timer_add_hashed(300, timer_wheel_cb, (void *)(uintptr_t)2, 0xbeef);
+    expire[0] = timer_wheel_find(T[0])->expire;
+    pico_timer_cancel_hashed(0xbeef);
+    fail_unless(timer_wheel_find(T[1]) == NULL);
+    fail_unless(timer_wheel_find(T[2]) == NULL);
+    pico_timer_wheel_run(expire[0] + 1);
+    fail_unless(timer_wheel_fired[0] == 2);
+    fail_unless(timer_wheel_fired[1] == 1);
+    fail_unless(timer_wheel_fired[2] == 1);
+    timer_wheel_free(Timers);
+    Timers = stack_timers;
+}
+END_TEST
+#else
 START_TEST (test_timers)
 {
     uint32_t T[128];
@@ -38,3 +161,4 @@ START_TEST (test_timers)
     pico_stack_tick();
 }
 END_TEST
+#endif
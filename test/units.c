@@ -26,6 +26,8 @@
 #include "pico_dev_mock.c"
 #include "pico_udp.c"
 #include "pico_tcp.c"
+#include "pico_tcp_cc.c"
+#include "pico_tcp_cubic.c"
 #include "pico_arp.c"
 #include "pico_icmp4.c"
 #include "pico_dns_client.c"
@@ -165,6 +167,13 @@ Suite *pico_suite(void)
     suite_add_tcase(s, rb2);
 
     tcase_add_test(socket, test_socket);
+    tcase_add_test(socket, test_socket_send_zerocopy);
+#ifdef PICO_SUPPORT_TCP_FASTOPEN
+    tcase_add_test(socket, test_socket_sendto_fastopen);
+#endif
+#ifdef PICO_SUPPORT_FLOW_TABLE
+    tcase_add_test(socket, test_socket_flow_table);
+#endif
     suite_add_tcase(s, socket);
 
     tcase_add_test(nat, test_nat_enable_disable);
@@ -191,6 +200,9 @@ Suite *pico_suite(void)
     suite_add_tcase(s, frame);
 
     tcase_add_test(timers, test_timers);
+#ifdef PICO_SUPPORT_TIMER_WHEEL
+    tcase_add_test(timers, test_timer_wheel_cascade);
+#endif
     suite_add_tcase(s, timers);
 
     tcase_add_test(slaacv4, test_slaacv4);